@@ -0,0 +1,71 @@
+#include "audio-ring.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+AudioRing::AudioRing( std::size_t capacity )
+    : _buffer( std::bit_ceil( std::max<std::size_t>( capacity, 2 ) ) ), _mask( _buffer.size() - 1 )
+{
+}
+
+std::size_t AudioRing::Write( const Sample *samples, std::size_t count )
+{
+  u64 const   writePos = _writePos.load( std::memory_order_relaxed );
+  u64 const   readPos = _readPos.load( std::memory_order_acquire );
+  std::size_t free = Capacity() - static_cast<std::size_t>( writePos - readPos );
+  std::size_t n = std::min( count, free );
+
+  if ( n < count ) {
+    _overruns.fetch_add( 1, std::memory_order_relaxed );
+    _droppedSamples.fetch_add( count - n, std::memory_order_relaxed );
+  }
+
+  // At most two pieces, up to the end of the buffer and then from the start
+  std::size_t const start = writePos & _mask;
+  std::size_t const first = std::min( n, Capacity() - start );
+  std::memcpy( &_buffer[start], samples, first * sizeof( Sample ) );
+  std::memcpy( _buffer.data(), samples + first, ( n - first ) * sizeof( Sample ) );
+
+  _writePos.store( writePos + n, std::memory_order_release );
+  return n;
+}
+
+std::size_t AudioRing::Read( Sample *out, std::size_t count )
+{
+  u64 const   readPos = _readPos.load( std::memory_order_relaxed );
+  u64 const   writePos = _writePos.load( std::memory_order_acquire );
+  std::size_t n = std::min( count, static_cast<std::size_t>( writePos - readPos ) );
+
+  std::size_t const start = readPos & _mask;
+  std::size_t const first = std::min( n, Capacity() - start );
+  std::memcpy( out, &_buffer[start], first * sizeof( Sample ) );
+  std::memcpy( out + first, _buffer.data(), ( n - first ) * sizeof( Sample ) );
+  _readPos.store( readPos + n, std::memory_order_release );
+
+  if ( n < count ) {
+    std::memset( out + n, 0, ( count - n ) * sizeof( Sample ) );
+    _underruns.fetch_add( 1, std::memory_order_relaxed );
+    _missingSamples.fetch_add( count - n, std::memory_order_relaxed );
+  }
+  return n;
+}
+
+std::size_t AudioRing::Fill() const
+{
+  // Read position first: it only grows, so this can't come out negative
+  u64 const readPos = _readPos.load( std::memory_order_acquire );
+  u64 const writePos = _writePos.load( std::memory_order_acquire );
+  return static_cast<std::size_t>( writePos - readPos );
+}
+
+void AudioRing::ResetStats()
+{
+  _overruns.store( 0, std::memory_order_relaxed );
+  _droppedSamples.store( 0, std::memory_order_relaxed );
+  _underruns.store( 0, std::memory_order_relaxed );
+  _missingSamples.store( 0, std::memory_order_relaxed );
+}
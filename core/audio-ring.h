@@ -0,0 +1,69 @@
+#pragma once
+#include "global-types.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/*
+################################
+||         Audio Ring         ||
+################################
+  Lock-free single producer / single consumer sample queue between the emulation thread and
+  the audio callback.
+
+  Neither side ever blocks. A write that doesn't fit keeps what does and drops the rest (an
+  overrun), a read that comes up short pads with silence (an underrun). Both are counted, and
+  the fill level can be read from either thread, so the frame pacer can steer on it.
+
+  The read and write positions are free running 64-bit counters, the fill level is just their
+  difference, and the capacity is rounded up to a power of two so indexing is a mask.
+*/
+
+class AudioRing
+{
+public:
+  using Sample = s16;
+
+  explicit AudioRing( std::size_t capacity );
+
+  AudioRing( const AudioRing & ) = delete;
+  AudioRing &operator=( const AudioRing & ) = delete;
+  AudioRing( AudioRing && ) = delete;
+  AudioRing &operator=( AudioRing && ) = delete;
+
+  // Producer: queues as many samples as fit and returns how many did
+  std::size_t Write( const Sample *samples, std::size_t count );
+
+  // Consumer: fills out with up to count queued samples, pads the rest with silence, and returns
+  // how many real samples were copied
+  std::size_t Read( Sample *out, std::size_t count );
+
+  // Samples waiting to be read, safe to call from either thread
+  [[nodiscard]] std::size_t Fill() const;
+  [[nodiscard]] std::size_t Capacity() const { return _buffer.size(); }
+  [[nodiscard]] double      FillRatio() const { return static_cast<double>( Fill() ) / Capacity(); }
+
+  // Number of writes that dropped samples / reads that came up short
+  [[nodiscard]] u64 Overruns() const { return _overruns.load( std::memory_order_relaxed ); }
+  [[nodiscard]] u64 Underruns() const { return _underruns.load( std::memory_order_relaxed ); }
+
+  // Dropped samples and silence padded in, for the same events
+  [[nodiscard]] u64 DroppedSamples() const { return _droppedSamples.load( std::memory_order_relaxed ); }
+  [[nodiscard]] u64 MissingSamples() const { return _missingSamples.load( std::memory_order_relaxed ); }
+
+  void ResetStats();
+
+private:
+  std::vector<Sample> _buffer;
+  std::size_t         _mask;
+
+  // Each position is only written by its own side, keep them on separate cache lines
+  alignas( 64 ) std::atomic<u64> _writePos{ 0 };
+  alignas( 64 ) std::atomic<u64> _readPos{ 0 };
+
+  alignas( 64 ) std::atomic<u64> _overruns{ 0 };
+  std::atomic<u64> _droppedSamples{ 0 };
+  std::atomic<u64> _underruns{ 0 };
+  std::atomic<u64> _missingSamples{ 0 };
+};
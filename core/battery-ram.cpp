@@ -0,0 +1,115 @@
+#include "battery-ram.h"
+#include "global-types.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fmt/base.h>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+BatteryRam::~BatteryRam()
+{
+  Unmap();
+}
+
+bool BatteryRam::Map( const std::string &path, std::size_t size )
+{
+  Unmap();
+#if defined( _WIN32 )
+  (void) path;
+  (void) size;
+  return false;
+#else
+  namespace fs = std::filesystem;
+  fs::path const target( path );
+  if ( target.has_parent_path() && !fs::exists( target.parent_path() ) ) {
+    fs::create_directories( target.parent_path() );
+  }
+
+  int const fd = open( path.c_str(), O_RDWR | O_CREAT, 0644 ); // NOLINT
+  if ( fd < 0 ) {
+    fmt::print( "BatteryRam: could not open {}\n", path );
+    return false;
+  }
+
+  // Grow new (or truncated) files to full size, the kernel zero fills the gap
+  struct stat st {};
+  if ( fstat( fd, &st ) != 0 || ( static_cast<std::size_t>( st.st_size ) < size &&
+                                  ftruncate( fd, static_cast<off_t>( size ) ) != 0 ) ) {
+    fmt::print( "BatteryRam: could not size {}\n", path );
+    close( fd );
+    return false;
+  }
+
+  void *mem = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd ); // the mapping keeps its own reference
+  if ( mem == MAP_FAILED ) { // NOLINT
+    fmt::print( "BatteryRam: could not map {}\n", path );
+    return false;
+  }
+
+  _data = static_cast<u8 *>( mem );
+  _size = size;
+  _path = path;
+  _dirty.store( false, std::memory_order_relaxed );
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _stop = false;
+  }
+  _flusher = std::thread( &BatteryRam::Run, this );
+  return true;
+#endif
+}
+
+void BatteryRam::Unmap()
+{
+  if ( _flusher.joinable() ) {
+    {
+      std::lock_guard<std::mutex> const lock( _mutex );
+      _stop = true;
+    }
+    _cv.notify_all();
+    _flusher.join();
+  }
+  if ( _data == nullptr ) {
+    return;
+  }
+  Sync();
+#if !defined( _WIN32 )
+  munmap( _data, _size );
+#endif
+  _data = nullptr;
+  _size = 0;
+  _path.clear();
+}
+
+void BatteryRam::Sync()
+{
+  if ( _data == nullptr || !_dirty.exchange( false, std::memory_order_acq_rel ) ) {
+    return;
+  }
+#if !defined( _WIN32 )
+  if ( msync( _data, _size, MS_SYNC ) != 0 ) {
+    fmt::print( "BatteryRam: msync failed for {}\n", _path );
+    _dirty.store( true, std::memory_order_relaxed );
+  }
+#endif
+}
+
+void BatteryRam::Run()
+{
+  std::unique_lock<std::mutex> lock( _mutex );
+  while ( !_cv.wait_for( lock, flushInterval, [this] { return _stop; } ) ) {
+    lock.unlock();
+    Sync();
+    lock.lock();
+  }
+}
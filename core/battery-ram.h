@@ -0,0 +1,66 @@
+#pragma once
+#include "global-types.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+################################
+||         Battery RAM        ||
+################################
+  File backed battery PRG RAM.
+
+  The save file under paths::saves() is mapped straight into memory, so every write the game
+  makes lands in the page cache immediately and survives an emulator crash. Writes only flip a
+  dirty flag; a background thread msyncs the mapping every flushInterval while it is dirty,
+  which also covers OS crashes and power loss without any I/O on the emulation thread.
+
+  Mapping is POSIX only. When Map() fails (or on Windows), the cartridge keeps its in-memory
+  PRG RAM and falls back to explicit saves through the save writer.
+*/
+
+class BatteryRam
+{
+public:
+  BatteryRam() = default;
+  ~BatteryRam();
+
+  BatteryRam( const BatteryRam & ) = delete;
+  BatteryRam &operator=( const BatteryRam & ) = delete;
+  BatteryRam( BatteryRam && ) = delete;
+  BatteryRam &operator=( BatteryRam && ) = delete;
+
+  // Map path (created and zero filled if needed) to size bytes. Unmaps any previous file.
+  bool Map( const std::string &path, std::size_t size );
+  void Unmap();
+
+  [[nodiscard]] bool               IsMapped() const { return _data != nullptr; }
+  [[nodiscard]] u8                *Data() const { return _data; }
+  [[nodiscard]] const std::string &Path() const { return _path; }
+
+  // Called on every PRG RAM write, must stay trivially cheap
+  void MarkDirty() { _dirty.store( true, std::memory_order_relaxed ); }
+
+  // Synchronously msync the mapping, if dirty
+  void Sync();
+
+  std::chrono::milliseconds flushInterval{ 1000 };
+
+private:
+  void Run();
+
+  u8               *_data = nullptr;
+  std::size_t       _size = 0;
+  std::string       _path;
+  std::atomic<bool> _dirty{ false };
+
+  std::mutex              _mutex;
+  std::condition_variable _cv;
+  bool                    _stop = false;
+  std::thread             _flusher;
+};
@@ -0,0 +1,273 @@
+#include "block-cache.h"
+#include "bus.h"
+#include "cpu-types.h"
+#include "cpu.h"
+#include "global-types.h"
+#include "mappers/mapper-base.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+namespace
+{
+// Instructions after which the next pc isn't the next instruction
+bool EndsBlock( const std::string &name, const std::string &mode )
+{
+  return mode == "REL" || name == "JMP" || name == "JSR" || name == "RTS" || name == "RTI" || name == "BRK";
+}
+
+// First CPU address of a page in the block cache's RAM page numbering
+u16 PageAddress( std::size_t page )
+{
+  return page < 8 ? static_cast<u16>( page << 8 ) : static_cast<u16>( 0x6000 + ( ( page - 8 ) << 8 ) );
+}
+} // namespace
+
+void BlockCache::Flush()
+{
+  _blocks.clear();
+  _ops.clear();
+  _ramCode.fill( false );
+  _ramBlocks.clear();
+  _cursor = 0;
+  _cursorEnd = 0;
+  _rom = nullptr;
+}
+
+void BlockCache::BeforeStateLoad()
+{
+  _loadPages.clear();
+  _loadBytes.clear();
+  for ( std::size_t page = 0; page < ramPages; ++page ) {
+    if ( !_ramCode[page] ) {
+      continue;
+    }
+    _loadPages.push_back( page );
+    for ( u16 offset = 0; offset < 0x100; ++offset ) {
+      _loadBytes.push_back( _bus->Read( PageAddress( page ) + offset, true ) );
+    }
+  }
+}
+
+void BlockCache::AfterStateLoad()
+{
+  // ROM blocks are keyed by where they are in ROM, so a different bank setup just picks others
+  for ( std::size_t i = 0; i < _loadPages.size(); ++i ) {
+    u16 const address = PageAddress( _loadPages[i] );
+    for ( u16 offset = 0; offset < 0x100; ++offset ) {
+      if ( _bus->Read( address + offset, true ) != _loadBytes[( i * 0x100 ) + offset] ) {
+        InvalidateRamPage( _loadPages[i] );
+        break;
+      }
+    }
+  }
+  _cursor = _cursorEnd; // the pc is somewhere else now
+}
+
+void BlockCache::OnCartridgeWrite( u16 address )
+{
+  // PRG RAM is plain memory, everything else may be a mapper register and move banks around
+  if ( address >= 0x6000 && address < 0x8000 ) {
+    std::size_t const page = 8 + ( ( address - 0x6000 ) >> 8 );
+    if ( _ramCode[page] ) {
+      InvalidateRamPage( page );
+    }
+    return;
+  }
+  // Mappers that bank PRG RAM can swap the code under its blocks too
+  for ( std::size_t page = 8; page < ramPages; ++page ) {
+    if ( _ramCode[page] ) {
+      InvalidateRamPage( page );
+    }
+  }
+  _cursor = _cursorEnd;
+}
+
+void BlockCache::InvalidateRamPage( std::size_t page )
+{
+  std::erase_if( _ramBlocks, [&]( const std::pair<u64, int> &block ) {
+    if ( static_cast<std::size_t>( block.second ) != page ) {
+      return false;
+    }
+    _blocks.erase( block.first );
+    return true;
+  } );
+  _ramCode[page] = false;
+
+  // The instruction doing the write may be in that page, pick up the new code right away
+  _cursor = _cursorEnd;
+}
+
+bool BlockCache::Key( u16 pc, u64 &key, int &ramPage ) const
+{
+  if ( pc >= 0x8000 ) {
+    key = ( u64{ _bus->cartridge.GetMapper()->MapCpuAddr( pc ) } << 16 ) | pc;
+    ramPage = -1;
+    return true;
+  }
+  if ( pc < 0x2000 ) {
+    ramPage = ( pc & 0x07FF ) >> 8;
+  } else if ( pc >= 0x6000 ) {
+    ramPage = 8 + ( ( pc - 0x6000 ) >> 8 );
+  } else {
+    return false; // registers, expansion area
+  }
+  key = ramKey | pc;
+  return true;
+}
+
+bool BlockCache::Execute()
+{
+  CPU &cpu = _bus->cpu;
+  if ( !enabled || !cpu.UsesProductionStep() ) {
+    _cursor = _cursorEnd;
+    return false;
+  }
+  // Still in the block from the last instruction, unless something (an interrupt, a jump the
+  // idle loop skipper ran) moved the pc
+  if ( _cursor == _cursorEnd || _ops[_cursor].pc != cpu.pc ) {
+    if ( !Enter( cpu.pc ) ) {
+      return false;
+    }
+  }
+  Run( _ops[_cursor++] );
+  return true;
+}
+
+bool BlockCache::Enter( u16 pc )
+{
+  _cursor = _cursorEnd;
+  if ( _bus->cartridge.GetMapper() == nullptr ) {
+    return false;
+  }
+  u8 const *rom = _bus->cartridge.GetPrgRom().data();
+  if ( rom != _rom || _ops.size() > maxOps ) {
+    Flush();
+    _rom = rom;
+  }
+
+  u64 key = 0;
+  int ramPage = -1;
+  if ( !Key( pc, key, ramPage ) ) {
+    return false;
+  }
+
+  auto found = _blocks.find( key );
+  if ( found == _blocks.end() ) {
+    u32 const first = static_cast<u32>( _ops.size() );
+    u32 const count = Translate( pc );
+    found = _blocks.emplace( key, Block{ first, count } ).first;
+    if ( ramPage >= 0 ) {
+      _ramCode.at( ramPage ) = true;
+      _ramBlocks.emplace_back( key, ramPage );
+    }
+  }
+  if ( found->second.count == 0 ) {
+    return false;
+  }
+  _cursor = found->second.first;
+  _cursorEnd = found->second.first + found->second.count;
+  return true;
+}
+
+u32 BlockCache::Translate( u16 pc )
+{
+  /** @brief Decodes the block at pc onto the end of _ops, returns how many micro-ops it has
+   * Blocks stay inside one 256-byte page, which keeps them inside one bank and one RAM page.
+   */
+  CPU const &cpu = _bus->cpu;
+  auto const read = [&]( u16 address ) { return cpu.Read( address, true ); };
+  u32 const  page = pc & 0xFF00;
+  u32        count = 0;
+  u32        at = pc;
+
+  while ( count < maxBlockOps ) {
+    u8 const           opcode = read( at );
+    std::string const &name = gInstructionNames.at( opcode );
+    std::string const &mode = gAddressingModes.at( opcode );
+
+    u32 const bytes = mode == "IMP" ? 1 : ( mode.starts_with( "ABS" ) || mode == "IND" ) ? 3 : 2;
+    // The operand spills into the next page, leave the instruction to the interpreter
+    if ( ( ( at + bytes - 1 ) & 0xFF00 ) != page ) {
+      break;
+    }
+
+    MicroOp op{ .handler = CPU::OpcodeTable<ProductionStep>().at( opcode ).handler,
+                .pc = static_cast<u16>( at ),
+                .opcode = opcode,
+                .pageCrossPenalty = isPageCrossPenalty( opcode ),
+                .writeModify = isWriteModify( opcode ) };
+    if ( mode == "IMP" ) {
+      op.fetchTicks = 2; // opcode, dummy read
+    } else if ( mode == "IMM" ) {
+      op.operand = at + 1;
+      op.fetchTicks = 1;
+    } else if ( mode == "REL" ) {
+      op.operand = at + 2 + static_cast<s8>( read( at + 1 ) );
+      op.fetchTicks = 2;
+    } else if ( mode == "ZPG" || mode == "ZPGX" || mode == "ZPGY" ) {
+      op.operand = read( at + 1 );
+      op.fetchTicks = 2;
+      op.mode = mode == "ZPG" ? Operand::Fixed : mode == "ZPGX" ? Operand::ZeroPageX : Operand::ZeroPageY;
+    } else if ( mode == "INDX" ) {
+      op.operand = read( at + 1 );
+      op.fetchTicks = 3; // opcode, dummy read, operand
+      op.mode = Operand::IndirectX;
+    } else if ( mode == "INDY" ) {
+      op.operand = read( at + 1 );
+      op.fetchTicks = 2;
+      op.mode = Operand::IndirectY;
+    } else {
+      op.operand = read( at + 1 ) | ( read( at + 2 ) << 8 );
+      op.fetchTicks = 3;
+      op.mode = mode == "ABSX"   ? Operand::AbsoluteX
+                : mode == "ABSY" ? Operand::AbsoluteY
+                : mode == "IND"  ? Operand::Indirect
+                                 : Operand::Fixed;
+    }
+    op.next = static_cast<u16>( at + bytes );
+    _ops.push_back( op );
+    ++count;
+    at += bytes;
+    if ( EndsBlock( name, mode ) || ( at & 0xFF00 ) != page ) {
+      break;
+    }
+  }
+  return count;
+}
+
+void BlockCache::Run( const MicroOp &op )
+{
+  /** @brief The micro-op version of CPU::DecodeExecute()
+   * Handlers still look at the instruction name and addressing mode strings (ASL A vs ASL $10 and
+   * so on), so those are set like the interpreter does.
+   */
+  CPU &cpu = _bus->cpu;
+  cpu.didMesenTrace = false;
+  for ( u8 i = 0; i < op.fetchTicks; ++i ) {
+    cpu.Tick();
+  }
+  cpu.pc = op.next;
+  cpu.opcode = op.opcode;
+  cpu.pageCrossPenalty = op.pageCrossPenalty;
+  cpu.writeModify = op.writeModify;
+  cpu.instructionName = gInstructionNames[op.opcode];
+  cpu.addrMode = gAddressingModes[op.opcode];
+
+  u16 address = op.operand;
+  switch ( op.mode ) {
+    case Operand::Fixed    : break;
+    case Operand::ZeroPageX: address = cpu.ZeroPageX( op.operand ); break;
+    case Operand::ZeroPageY: address = cpu.ZeroPageY( op.operand ); break;
+    case Operand::AbsoluteX: address = cpu.AbsoluteIndexed( op.operand, cpu.x ); break;
+    case Operand::AbsoluteY: address = cpu.AbsoluteIndexed( op.operand, cpu.y ); break;
+    case Operand::Indirect : address = cpu.Indirect<ProductionStep>( op.operand ); break;
+    case Operand::IndirectX: address = cpu.IndirectX<ProductionStep>( op.operand ); break;
+    case Operand::IndirectY: address = cpu.IndirectY<ProductionStep>( op.operand ); break;
+  }
+  ( cpu.*op.handler )( address );
+
+  cpu.writeModify = false;
+  cpu.didMesenTrace = false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Bus;
+class CPU;
+
+/*
+################################
+||         Block Cache        ||
+################################
+  Threaded code for the interpreter. The first time the CPU runs an address, the straight-line
+  block starting there (up to the next jump, branch, return or page boundary) is decoded into
+  micro-ops: the resolved handler, the operand bytes, how many cycles the opcode and operand
+  fetches take and the page-cross and write-modify flags. From then on Bus::Clock() runs the
+  instruction from its micro-op instead of going through Fetch() and the opcode table.
+
+  A micro-op spends its fetch cycles as plain ticks, since fetching from ROM or RAM has no side
+  effects, then runs the same post-fetch address step (CPU::AbsoluteIndexed() and friends) and
+  the same handler as the interpreter. Data reads and writes, dummy cycles and the PPU ticks in
+  between happen exactly as before; only the decode work is gone.
+
+  Blocks are keyed by CPU address and where that address maps to: the PRG ROM offset for
+  $8000-$FFFF, or CPU RAM ($0000-$1FFF) and PRG RAM ($6000-$7FFF). A bank switch therefore can't
+  hit a stale block, it changes the key, and switching back reuses the old blocks. Writes to
+  mapper registers drop the block in progress, and a write into a RAM page holding translated code
+  throws that page's blocks away. A state load (every frame for run-ahead and rollback) keeps the
+  ROM blocks and only drops the RAM pages whose code it changed, see BeforeStateLoad(). Loading
+  another ROM, and anything else that replaces memory wholesale, calls Flush().
+
+  Trace logging and the JSON test mode always go through the interpreter.
+*/
+
+class BlockCache
+{
+public:
+  explicit BlockCache( Bus *bus ) : _bus( bus ) {}
+
+  bool enabled = true;
+
+  // Runs the instruction at the CPU's pc through its block, translating the block first if needed.
+  // False, having run nothing, if the pc can't be translated; the interpreter runs it instead.
+  bool Execute();
+
+  // Write hooks, called by the bus. offset is into the 2KB of CPU RAM.
+  void OnRamWrite( u16 offset )
+  {
+    if ( _ramCode[offset >> 8] ) {
+      InvalidateRamPage( offset >> 8 );
+    }
+  }
+  void OnCartridgeWrite( u16 address );
+
+  // Around a state load. BeforeStateLoad() keeps a copy of the RAM pages holding translated code,
+  // AfterStateLoad() throws away the blocks of those the load changed.
+  void BeforeStateLoad();
+  void AfterStateLoad();
+
+  void                      Flush();
+  [[nodiscard]] std::size_t BlockCount() const { return _blocks.size(); }
+
+  static constexpr std::size_t maxBlockOps = 32;
+  static constexpr std::size_t maxOps = 1 << 18; // total across blocks before everything is flushed
+
+private:
+  // How the operand becomes the effective address at run time
+  enum class Operand : u8 { Fixed, ZeroPageX, ZeroPageY, AbsoluteX, AbsoluteY, Indirect, IndirectX, IndirectY };
+
+  struct MicroOp {
+    void ( CPU::*handler )( u16 ){};
+    u16     pc = 0;
+    u16     next = 0;    // pc once the operand is fetched
+    u16     operand = 0; // the effective address for Fixed, otherwise the operand bytes
+    u8      opcode = 0;
+    u8      fetchTicks = 0; // cycles spent before the address step
+    Operand mode = Operand::Fixed;
+    bool    pageCrossPenalty = false;
+    bool    writeModify = false;
+  };
+
+  struct Block {
+    u32 first = 0;
+    u32 count = 0; // 0: pc can't be translated, don't try again
+  };
+
+  // CPU RAM pages 0-7, then PRG RAM pages 8-39
+  static constexpr std::size_t ramPages = 40;
+  static constexpr u64         ramKey = u64{ 1 } << 63;
+
+  bool Enter( u16 pc );
+  bool Key( u16 pc, u64 &key, int &ramPage ) const;
+  u32  Translate( u16 pc );
+  void InvalidateRamPage( std::size_t page );
+  void Run( const MicroOp &op );
+
+  Bus                             *_bus;
+  const u8                        *_rom = nullptr; // blocks belong to this PRG ROM
+  std::unordered_map<u64, Block>   _blocks;
+  std::vector<MicroOp>             _ops;
+  std::array<bool, ramPages>       _ramCode{};
+  std::vector<std::pair<u64, int>> _ramBlocks; // keys and pages of blocks in RAM
+  u32                              _cursor = 0;
+  u32                              _cursorEnd = 0; // _cursor == _cursorEnd: not in a block
+  std::vector<std::size_t>         _loadPages; // BeforeStateLoad()'s copies of the code pages
+  std::vector<u8>                  _loadBytes;
+};
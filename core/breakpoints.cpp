@@ -0,0 +1,497 @@
+#include "breakpoints.h"
+#include "bus.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using Op = BreakCondition::Op;
+using Variable = BreakCondition::Variable;
+
+struct BinaryOperator {
+  std::string_view text;
+  int              precedence;
+  Op               op;
+};
+
+// Two-character operators go before their one-character prefixes
+constexpr std::array<BinaryOperator, 13> binaryOperators = { {
+    { "||", 1, Op::Or },
+    { "&&", 2, Op::And },
+    { "|", 3, Op::BitOr },
+    { "^", 4, Op::BitXor },
+    { "&", 5, Op::BitAnd },
+    { "==", 6, Op::Equal },
+    { "!=", 6, Op::NotEqual },
+    { "<=", 7, Op::LessEqual },
+    { ">=", 7, Op::GreaterEqual },
+    { "<", 7, Op::Less },
+    { ">", 7, Op::Greater },
+    { "+", 8, Op::Add },
+    { "-", 8, Op::Subtract },
+} };
+
+constexpr std::array<std::pair<std::string_view, Variable>, 12> variables = { {
+    { "a", Variable::A },
+    { "x", Variable::X },
+    { "y", Variable::Y },
+    { "s", Variable::S },
+    { "sp", Variable::S },
+    { "p", Variable::P },
+    { "pc", Variable::PC },
+    { "scanline", Variable::Scanline },
+    { "dot", Variable::Dot },
+    { "cycle", Variable::Cycle },
+    { "value", Variable::Value },
+    { "address", Variable::Address },
+} };
+
+// Recursive descent over unary and primary expressions, precedence climbing over binary ones
+class Parser
+{
+public:
+  Parser( std::string_view source, std::vector<BreakCondition::Instruction> &code )
+      : _source( source ), _code( code )
+  {
+  }
+
+  bool Parse( std::string &error )
+  {
+    if ( !Expression( 1 ) ) {
+      error = _error;
+      return false;
+    }
+    SkipSpace();
+    if ( _pos != _source.size() ) {
+      error = "Unexpected '" + std::string( _source.substr( _pos, 1 ) ) + "' at " + std::to_string( _pos );
+      return false;
+    }
+    return true;
+  }
+
+private:
+  void SkipSpace()
+  {
+    while ( _pos < _source.size() && std::isspace( static_cast<unsigned char>( _source[_pos] ) ) != 0 ) {
+      _pos++;
+    }
+  }
+
+  bool Fail( const std::string &message )
+  {
+    _error = message + " at " + std::to_string( _pos );
+    return false;
+  }
+
+  bool Expression( int minPrecedence )
+  {
+    if ( !Unary() ) {
+      return false;
+    }
+    while ( true ) {
+      SkipSpace();
+      auto const found = std::ranges::find_if(
+          binaryOperators, [&]( const BinaryOperator &op ) { return _source.substr( _pos ).starts_with( op.text ); } );
+      if ( found == binaryOperators.end() || found->precedence < minPrecedence ) {
+        return true;
+      }
+      _pos += found->text.size();
+      if ( !Expression( found->precedence + 1 ) ) {
+        return false;
+      }
+      _code.push_back( { .op = found->op } );
+    }
+  }
+
+  bool Unary()
+  {
+    SkipSpace();
+    if ( _pos < _source.size() && ( _source[_pos] == '!' || _source[_pos] == '~' || _source[_pos] == '-' ) ) {
+      char const symbol = _source[_pos++];
+      if ( !Unary() ) {
+        return false;
+      }
+      _code.push_back( { .op = symbol == '!' ? Op::Not : symbol == '~' ? Op::Complement : Op::Negate } );
+      return true;
+    }
+    return Primary();
+  }
+
+  bool Primary()
+  {
+    SkipSpace();
+    if ( _pos >= _source.size() ) {
+      return Fail( "Expected a value" );
+    }
+
+    char const c = _source[_pos];
+    if ( c == '(' || c == '[' ) {
+      char const close = c == '(' ? ')' : ']';
+      _pos++;
+      if ( !Expression( 1 ) ) {
+        return false;
+      }
+      SkipSpace();
+      if ( _pos >= _source.size() || _source[_pos] != close ) {
+        return Fail( std::string( "Expected '" ) + close + "'" );
+      }
+      _pos++;
+      if ( c == '[' ) {
+        _code.push_back( { .op = Op::Memory } );
+      }
+      return true;
+    }
+
+    if ( std::isdigit( static_cast<unsigned char>( c ) ) != 0 || c == '$' ) {
+      return Number();
+    }
+
+    std::size_t const start = _pos;
+    while ( _pos < _source.size() && std::isalpha( static_cast<unsigned char>( _source[_pos] ) ) != 0 ) {
+      _pos++;
+    }
+    std::string name( _source.substr( start, _pos - start ) );
+    std::ranges::transform( name, name.begin(), []( unsigned char ch ) { return std::tolower( ch ); } );
+    auto const found = std::ranges::find( variables, name, &std::pair<std::string_view, Variable>::first );
+    if ( name.empty() || found == variables.end() ) {
+      _pos = start;
+      return Fail( name.empty() ? "Expected a value" : "Unknown name '" + name + "'" );
+    }
+    _code.push_back( { .op = Op::Variable, .operand = static_cast<s64>( found->second ) } );
+    return true;
+  }
+
+  bool Number()
+  {
+    int base = 10;
+    if ( _source[_pos] == '$' ) {
+      base = 16;
+      _pos++;
+    } else if ( _source.substr( _pos ).starts_with( "0x" ) || _source.substr( _pos ).starts_with( "0X" ) ) {
+      base = 16;
+      _pos += 2;
+    }
+
+    s64         value = 0;
+    std::size_t digits = 0;
+    while ( _pos < _source.size() ) {
+      char const ch = static_cast<char>( std::tolower( static_cast<unsigned char>( _source[_pos] ) ) );
+      int const  digit = std::isdigit( static_cast<unsigned char>( ch ) ) != 0 ? ch - '0'
+                         : ( base == 16 && ch >= 'a' && ch <= 'f' ) ? ch - 'a' + 10
+                                                                    : -1;
+      if ( digit < 0 ) {
+        break;
+      }
+      value = ( value * base ) + digit;
+      if ( value > 0xFFFFFFFF ) {
+        return Fail( "Number too large" );
+      }
+      digits++;
+      _pos++;
+    }
+    if ( digits == 0 ) {
+      return Fail( "Expected digits" );
+    }
+    _code.push_back( { .op = Op::Push, .operand = value } );
+    return true;
+  }
+
+  std::string_view                          _source;
+  std::vector<BreakCondition::Instruction> &_code;
+  std::size_t                               _pos = 0;
+  std::string                               _error;
+};
+} // namespace
+
+/*
+################################
+||       Break Condition      ||
+################################
+*/
+bool BreakCondition::Compile( const std::string &source, std::string &error )
+{
+  _code.clear();
+  _source.clear();
+  if ( source.find_first_not_of( " \t" ) == std::string::npos ) {
+    return true;
+  }
+
+  std::vector<Instruction> code;
+  if ( !Parser( source, code ).Parse( error ) ) {
+    return false;
+  }
+
+  // Values pushed minus values popped, Holds() runs on a fixed stack
+  std::size_t depth = 0;
+  std::size_t maxDepth = 0;
+  for ( const Instruction &instruction : code ) {
+    if ( instruction.op == Op::Push || instruction.op == Op::Variable ) {
+      depth++;
+    } else if ( instruction.op >= Op::Add ) {
+      depth--;
+    }
+    maxDepth = std::max( maxDepth, depth );
+  }
+  if ( maxDepth > maxStack ) {
+    error = "Condition nests too deeply";
+    return false;
+  }
+
+  _code = std::move( code );
+  _source = source;
+  return true;
+}
+
+bool BreakCondition::Holds( Bus &bus, u16 address, u8 value ) const // NOLINT
+{
+  if ( _code.empty() ) {
+    return true;
+  }
+
+  std::array<s64, maxStack> stack{};
+  std::size_t               top = 0; // values on the stack
+  for ( const Instruction &instruction : _code ) {
+    if ( instruction.op == Op::Push ) {
+      stack[top++] = instruction.operand;
+      continue;
+    }
+    if ( instruction.op == Op::Variable ) {
+      CPU const &cpu = bus.cpu;
+      switch ( static_cast<Variable>( instruction.operand ) ) {
+        case Variable::A       : stack[top] = cpu.a; break;
+        case Variable::X       : stack[top] = cpu.x; break;
+        case Variable::Y       : stack[top] = cpu.y; break;
+        case Variable::S       : stack[top] = cpu.s; break;
+        case Variable::P       : stack[top] = cpu.GetStatusRegister(); break;
+        case Variable::PC      : stack[top] = cpu.pc; break;
+        case Variable::Scanline: stack[top] = bus.ppu.scanline; break;
+        case Variable::Dot     : stack[top] = bus.ppu.cycle; break;
+        case Variable::Cycle   : stack[top] = static_cast<s64>( cpu.GetCycles() ); break;
+        case Variable::Value   : stack[top] = value; break;
+        case Variable::Address : stack[top] = address; break;
+      }
+      top++;
+      continue;
+    }
+
+    s64 &operand = stack[top - 1];
+    switch ( instruction.op ) {
+      case Op::Memory    : operand = bus.Read( static_cast<u16>( operand ), true ); continue;
+      case Op::Not       : operand = operand == 0 ? 1 : 0; continue;
+      case Op::Complement: operand = ~operand; continue;
+      case Op::Negate    : operand = -operand; continue;
+      default            : break;
+    }
+
+    // Binary: the right operand is on top
+    s64 const right = stack[--top];
+    s64      &left = stack[top - 1];
+    switch ( instruction.op ) {
+      case Op::Add         : left = left + right; break;
+      case Op::Subtract    : left = left - right; break;
+      case Op::BitAnd      : left = left & right; break;
+      case Op::BitXor      : left = left ^ right; break;
+      case Op::BitOr       : left = left | right; break;
+      case Op::Equal       : left = left == right ? 1 : 0; break;
+      case Op::NotEqual    : left = left != right ? 1 : 0; break;
+      case Op::Less        : left = left < right ? 1 : 0; break;
+      case Op::LessEqual   : left = left <= right ? 1 : 0; break;
+      case Op::Greater     : left = left > right ? 1 : 0; break;
+      case Op::GreaterEqual: left = left >= right ? 1 : 0; break;
+      case Op::And         : left = ( left != 0 && right != 0 ) ? 1 : 0; break;
+      case Op::Or          : left = ( left != 0 || right != 0 ) ? 1 : 0; break;
+      default              : break;
+    }
+  }
+  return stack[0] != 0;
+}
+
+/*
+################################
+||        Breakpoint List     ||
+################################
+*/
+int Breakpoints::Add( Breakpoint breakpoint, const std::string &condition, std::string &error )
+{
+  if ( !breakpoint.condition.Compile( condition, error ) ) {
+    return -1;
+  }
+  if ( breakpoint.last < breakpoint.first ) {
+    breakpoint.last = breakpoint.first;
+  }
+  breakpoint.id = _nextId++;
+  _breakpoints.push_back( std::move( breakpoint ) );
+  Rebuild();
+  return _breakpoints.back().id;
+}
+
+bool Breakpoints::Remove( int id )
+{
+  if ( std::erase_if( _breakpoints, [id]( const Breakpoint &breakpoint ) { return breakpoint.id == id; } ) == 0 ) {
+    return false;
+  }
+  Rebuild();
+  return true;
+}
+
+bool Breakpoints::SetEnabled( int id, bool enabled )
+{
+  auto found = std::ranges::find( _breakpoints, id, &Breakpoint::id );
+  if ( found == _breakpoints.end() ) {
+    return false;
+  }
+  found->enabled = enabled;
+  Rebuild();
+  return true;
+}
+
+void Breakpoints::Clear()
+{
+  _breakpoints.clear();
+  Rebuild();
+}
+
+void Breakpoints::Rebuild()
+{
+  for ( auto &bitmap : _bitmaps ) {
+    bitmap.reset();
+  }
+  _timed = false;
+  _armed = false;
+  for ( const Breakpoint &breakpoint : _breakpoints ) {
+    if ( !breakpoint.enabled ) {
+      continue;
+    }
+    _armed = true;
+    if ( breakpoint.kind == BreakKind::Scanline || breakpoint.kind == BreakKind::Cycle ) {
+      _timed = true;
+      continue;
+    }
+    for ( u32 address = breakpoint.first; address <= breakpoint.last; ++address ) {
+      _bitmaps[Index( breakpoint.kind )].set( address );
+    }
+  }
+  for ( std::size_t kind = 0; kind < addressKinds; ++kind ) {
+    _watch[kind] = _bitmaps[kind].any();
+  }
+  if ( !_armed ) {
+    _hit = false;
+  }
+
+  // Timed breaks count from here, not from whenever the last armed instruction ran
+  SyncTiming();
+  _bus->cpu.SelectStep();
+}
+
+void Breakpoints::SyncTiming()
+{
+  _lastPosition = ( _bus->ppu.scanline * 341U ) + _bus->ppu.cycle;
+  _lastCycle = _bus->cpu.GetCycles();
+}
+
+/*
+################################
+||             Hits           ||
+################################
+*/
+void Breakpoints::Resume()
+{
+  // Execute and timed breaks stopped before their instruction, watchpoints after theirs
+  BreakKind const kind = _lastHit.kind;
+  _skipChecks = _hit && ( kind == BreakKind::Execute || kind == BreakKind::Scanline || kind == BreakKind::Cycle );
+  _hit = false;
+}
+
+/*
+################################
+||           Checks           ||
+################################
+*/
+void Breakpoints::StartChecks()
+{
+  // Unless this carries on right where the last checks stopped, the CPU got here through plain
+  // RunFrame() calls or a state load
+  if ( _bus->cpu.GetCycles() != _checkedTo ) {
+    SyncTiming();
+  }
+  _checking = true;
+}
+
+void Breakpoints::StopChecks()
+{
+  _checking = false;
+  _checkedTo = _bus->cpu.GetCycles();
+}
+
+bool Breakpoints::BeforeInstruction()
+{
+  CPU const &cpu = _bus->cpu;
+  u32 const  position = ( _bus->ppu.scanline * 341U ) + _bus->ppu.cycle;
+  u64 const  cycle = cpu.GetCycles();
+  _instructionPc = cpu.pc;
+
+  if ( _skipChecks ) {
+    _skipChecks = false;
+  } else if ( !_hit ) {
+    if ( _bitmaps[Index( BreakKind::Execute )].test( cpu.pc ) ) {
+      Check( BreakKind::Execute, cpu.pc, 0 );
+    }
+    if ( _timed && !_hit ) {
+      // Passed since the last instruction, allowing for the PPU wrapping to a new frame
+      auto const passed = [&]( u32 target ) {
+        return _lastPosition <= position ? _lastPosition < target && target <= position
+                                         : _lastPosition < target || target <= position;
+      };
+      for ( const Breakpoint &breakpoint : _breakpoints ) {
+        bool due = false;
+        if ( breakpoint.kind == BreakKind::Scanline ) {
+          due = passed( ( breakpoint.scanline * 341U ) + breakpoint.dot );
+        } else if ( breakpoint.kind == BreakKind::Cycle ) {
+          due = _lastCycle < breakpoint.cycle && breakpoint.cycle <= cycle;
+        }
+        if ( breakpoint.enabled && due && breakpoint.condition.Holds( *_bus, cpu.pc, 0 ) ) {
+          Trigger( breakpoint, cpu.pc, 0 );
+          break;
+        }
+      }
+    }
+  }
+
+  _lastPosition = position;
+  _lastCycle = cycle;
+  return _hit;
+}
+
+void Breakpoints::Check( BreakKind kind, u16 address, u8 value )
+{
+  // An instruction can make several accesses, the first hit is the one reported
+  if ( _hit ) {
+    return;
+  }
+  for ( const Breakpoint &breakpoint : _breakpoints ) {
+    if ( breakpoint.enabled && breakpoint.kind == kind && address >= breakpoint.first && address <= breakpoint.last &&
+         breakpoint.condition.Holds( *_bus, address, value ) ) {
+      Trigger( breakpoint, address, value );
+      return;
+    }
+  }
+}
+
+void Breakpoints::Trigger( const Breakpoint &breakpoint, u16 address, u8 value )
+{
+  _hit = true;
+  _lastHit = BreakHit{ .id = breakpoint.id,
+                       .kind = breakpoint.kind,
+                       .pc = _instructionPc,
+                       .address = address,
+                       .value = value,
+                       .cycle = _bus->cpu.GetCycles() };
+}
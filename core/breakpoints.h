@@ -0,0 +1,206 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Bus;
+
+/*
+################################
+||         Breakpoints        ||
+################################
+  Execution breakpoints, CPU and PPU read/write watchpoints, and breaks on a PPU position or a
+  CPU cycle, for the debugger.
+
+  Each address kind has a 64K-entry bitmap with a bit set for every address some enabled
+  breakpoint covers, so a check is one bit test and only a hit looks at the breakpoints
+  themselves. Nothing is checked while no breakpoint is enabled:
+
+  - only Bus::RunFrameUntilBreak(), the debugger's frame step, checks anything, and it takes the
+    checking loop (execute, scanline and cycle breaks before each instruction) only when Armed(),
+    a check made once per frame. Bus::RunFrame() always runs a whole frame, whatever is armed, so
+    movies, rollback and run-ahead keep one call per frame
+  - CPU reads and writes only go through Bus::WatchedRead() / WatchedWrite() while a watchpoint
+    of that direction is enabled; otherwise the CPU's bus pointers point straight at Read() and
+    Write() (see CPU::SelectStep())
+  - armed, the CPU leaves its production step, which turns the block cache and idle loop skipping
+    off, so every instruction really passes the checks
+
+  PPU watchpoints cover the PPU address space as the CPU reaches it through PPUDATA ($2007).
+  Rendering fetches aren't watched.
+
+  A breakpoint may have a condition, e.g. "A == 0x20 && [0x0300] > 5", compiled once into a
+  small stack machine program (BreakCondition) and only run on a bitmap hit. Execute breaks stop
+  before the instruction; watchpoints let the instruction doing the access finish. Either way
+  RunFrameUntilBreak() returns early with Hit() set, and the next one after Resume() carries on
+  from there.
+*/
+
+enum class BreakKind : u8 { Execute, CpuRead, CpuWrite, PpuRead, PpuWrite, Scanline, Cycle };
+
+constexpr std::array<const char *, 7> breakKindNames = { "Execute",   "CPU read", "CPU write", "PPU read",
+                                                         "PPU write", "Scanline", "Cycle" };
+constexpr const char                 *BreakKindName( BreakKind kind )
+{
+  return breakKindNames[static_cast<std::size_t>( kind )];
+}
+
+class BreakCondition
+{
+public:
+  // False, with error set, if source doesn't parse. Empty source always holds.
+  //
+  //   values:    numbers (10, 0x1F, $1F), A X Y S P PC, Scanline Dot Cycle, Value Address (the
+  //              accessed byte and its address, for watchpoints), [expr] (a byte of CPU memory)
+  //   operators: ! ~ - (unary), + -, == != < <= > >=, & ^ |, && || with C precedence, ( )
+  bool Compile( const std::string &source, std::string &error );
+
+  [[nodiscard]] bool Holds( Bus &bus, u16 address, u8 value ) const;
+  [[nodiscard]] bool Empty() const { return _code.empty(); }
+  [[nodiscard]] const std::string &Source() const { return _source; }
+
+  static constexpr std::size_t maxStack = 16;
+
+  enum class Op : u8 {
+    Push,
+    Variable, // operand is a Variable
+    Memory,
+    Not,
+    Complement,
+    Negate,
+    Add,
+    Subtract,
+    BitAnd,
+    BitXor,
+    BitOr,
+    Equal,
+    NotEqual,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    And,
+    Or,
+  };
+  enum class Variable : u8 { A, X, Y, S, P, PC, Scanline, Dot, Cycle, Value, Address };
+
+  struct Instruction {
+    Op  op = Op::Push;
+    s64 operand = 0;
+  };
+
+private:
+  std::vector<Instruction> _code;
+  std::string              _source;
+};
+
+struct Breakpoint {
+  int       id = 0;
+  BreakKind kind = BreakKind::Execute;
+  u16       first = 0; // address range for execute and watchpoints
+  u16       last = 0;
+  u16       scanline = 0; // Scanline: stop on the first instruction at or past scanline and dot
+  u16       dot = 0;
+  u64       cycle = 0; // Cycle: stop on the first instruction at or past this CPU cycle
+  bool      enabled = true;
+
+  BreakCondition condition;
+};
+
+struct BreakHit {
+  int       id = 0;
+  BreakKind kind = BreakKind::Execute;
+  u16       pc = 0;      // instruction that hit, or that's up next for execute, scanline and cycle
+  u16       address = 0; // watchpoints: the address accessed and the byte read or written
+  u8        value = 0;
+  u64       cycle = 0;
+};
+
+class Breakpoints
+{
+public:
+  explicit Breakpoints( Bus *bus ) : _bus( bus ) {}
+
+  /*
+  ################################
+  ||        Breakpoint List     ||
+  ################################
+  */
+  // Returns the new breakpoint's id, or -1 with error set if its condition doesn't compile
+  int  Add( Breakpoint breakpoint, const std::string &condition, std::string &error );
+  bool Remove( int id );
+  bool SetEnabled( int id, bool enabled );
+  void Clear();
+
+  [[nodiscard]] const std::vector<Breakpoint> &List() const { return _breakpoints; }
+  [[nodiscard]] bool                           Armed() const { return _armed; }
+  [[nodiscard]] bool                           WatchesReads() const
+  {
+    return _watch[Index( BreakKind::CpuRead )] || _watch[Index( BreakKind::PpuRead )];
+  }
+  [[nodiscard]] bool WatchesWrites() const
+  {
+    return _watch[Index( BreakKind::CpuWrite )] || _watch[Index( BreakKind::PpuWrite )];
+  }
+
+  /*
+  ################################
+  ||             Hits           ||
+  ################################
+  */
+  [[nodiscard]] bool            Hit() const { return _hit; }
+  [[nodiscard]] const BreakHit &LastHit() const { return _lastHit; }
+
+  // Clears the hit. The instruction an execute break stopped at runs without stopping again.
+  void Resume();
+
+  /*
+  ################################
+  ||           Checks           ||
+  ################################
+  */
+  // Around Bus::RunFrameUntilBreak(). Outside them nothing hits, and breaks the CPU passed
+  // meanwhile (scanline and cycle ones) don't fire late.
+  void StartChecks();
+  void StopChecks();
+
+  // Before each instruction, from RunFrameUntilBreak() while armed. True if it must not run yet.
+  bool BeforeInstruction();
+
+  // From Bus::WatchedRead() and WatchedWrite(), after the access
+  void OnAccess( BreakKind kind, u16 address, u8 value )
+  {
+    if ( _checking && _bitmaps[Index( kind )].test( address ) ) {
+      Check( kind, address, value );
+    }
+  }
+
+private:
+  static constexpr std::size_t Index( BreakKind kind ) { return static_cast<std::size_t>( kind ); }
+  static constexpr std::size_t addressKinds = 5; // Execute through PpuWrite
+
+  void Check( BreakKind kind, u16 address, u8 value );
+  void Trigger( const Breakpoint &breakpoint, u16 address, u8 value );
+  void Rebuild();
+  void SyncTiming();
+
+  Bus                                           *_bus;
+  std::vector<Breakpoint>                        _breakpoints;
+  std::array<std::bitset<0x10000>, addressKinds> _bitmaps;
+  std::array<bool, addressKinds>                 _watch{}; // any bit set in the bitmap
+  bool                                           _timed = false; // any Scanline or Cycle breakpoint enabled
+  bool                                           _armed = false;
+  int                                            _nextId = 1;
+  bool                                           _hit = false;
+  BreakHit                                       _lastHit;
+  bool                                           _skipChecks = false; // set by Resume()
+  bool                                           _checking = false; // inside StartChecks() / StopChecks()
+  u64                                            _checkedTo = 0; // CPU cycle at the last StopChecks()
+  u16                                            _instructionPc = 0;
+  u32                                            _lastPosition = 0; // scanline * 341 + dot, at the last instruction
+  u64                                            _lastCycle = 0;
+};
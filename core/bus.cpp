@@ -1,15 +1,23 @@
 #include "bus.h"
 #include "Nes_Apu.h"
+#include "byte-stream.h"
 #include "cartridge.h"
+#include "cow-memory.h"
 #include "paths.h"
 #include "utils.h"
 #include "global-types.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <exception>
 #include <functional>
-#include <iostream>
+#include <memory>
+#include <mutex>
+#include <fmt/base.h>
+#include <fmt/format.h>
 // NOLINTBEGIN
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/vector.hpp>
@@ -19,10 +27,26 @@
 #include <string>
 #include <stdexcept>
 #include <system_error>
+#include <utility>
+#include <vector>
 
 // Constructor to initialize the bus with a flat memory model
-Bus::Bus() : cpu( this ), ppu( this ), cartridge( this )
+Bus::Bus() : cpu( this ), ppu( this ), cartridge( this ), idleLoop( this ), blockCache( this ), breakpoints( this )
 {
+  cpu.SelectStep();
+
+  // The APU runs on the CPU's clock and fetches DMC samples through the bus
+  apu.dmc_reader( Bus::ReadDmc, this );
+  apu.cpu_clock( Bus::CpuClock, this );
+}
+
+void Bus::Log( const std::string &message ) const
+{
+  if ( logSink ) {
+    logSink( message );
+  } else {
+    fmt::print( "{}\n", message );
+  }
 }
 
 /*
@@ -38,7 +62,7 @@ u8 Bus::Read( const u16 address, bool debugMode )
 
   // System RAM: 0x0000 - 0x1FFF (mirrored every 2KB)
   if ( address >= 0x0000 && address <= 0x1FFF ) {
-    return _ram.at( address & 0x07FF );
+    return _ram.Read( address & 0x07FF );
   }
 
   // PPU Registers: 0x2000 - 0x3FFF (mirrored every 8 bytes)
@@ -66,7 +90,7 @@ u8 Bus::Read( const u16 address, bool debugMode )
   }
 
   // Unhandled address ranges return open bus value
-  std::cout << "Unhandled read from address: " << std::hex << address << "\n";
+  Log( fmt::format( "Unhandled read from address: {:x}", address ) );
   return 0x00;
 }
 
@@ -85,7 +109,9 @@ void Bus::Write( const u16 address, const u8 data )
 
   // System RAM: 0x0000 - 0x1FFF (mirrored every 2KB)
   if ( address >= 0x0000 && address <= 0x1FFF ) {
-    _ram.at( address & 0x07FF ) = data;
+    _ram.Write( address & 0x07FF, data );
+    stateHasher.MarkDirty( StateRegion::Ram, address & 0x07FF );
+    blockCache.OnRamWrite( address & 0x07FF );
     return;
   }
 
@@ -104,9 +130,10 @@ void Bus::Write( const u16 address, const u8 data )
     return;
   }
 
-  // Controller input
-  if ( address >= 0x4016 && address <= 0x4017 ) { // FIX: 0x4017 for controllers or APU?
-    controllerState[address & 0x0001] = controller[address & 0x0001];
+  // Controller strobe latches both controllers. $4017 writes go to the APU frame counter.
+  if ( address == 0x4016 ) {
+    controllerState[0] = controller[0];
+    controllerState[1] = controller[1];
     return;
   }
 
@@ -116,14 +143,43 @@ void Bus::Write( const u16 address, const u8 data )
     return;
   }
 
-  // 4020 and up is cartridge territory
+  // 4020 and up is cartridge territory. Mapper writes can swap the code under an idle loop.
   if ( address >= 0x4020 && address <= 0xFFFF ) {
     cartridge.Write( address, data );
+    idleLoop.Reset();
+    blockCache.OnCartridgeWrite( address );
     return;
   }
   // Unhandled address ranges
   // Optionally log a warning or ignore
-  std::cout << "Unhandled write to address: " << std::hex << address << "\n";
+  Log( fmt::format( "Unhandled write to address: {:x}", address ) );
+}
+
+u8 Bus::WatchedRead( const u16 address, bool debugMode )
+{
+  if ( debugMode ) {
+    return Read( address, true );
+  }
+  // PPUDATA reads come from where v points before the read moves it on
+  bool const ppuData = address >= 0x2000 && address <= 0x3FFF && ( address & 0x0007 ) == 0x0007;
+  u16 const  ppuAddress = ppu.GetVramAddr() & 0x3FFF;
+  u8 const   data = Read( address );
+  breakpoints.OnAccess( BreakKind::CpuRead, address, data );
+  if ( ppuData ) {
+    breakpoints.OnAccess( BreakKind::PpuRead, ppuAddress, data );
+  }
+  return data;
+}
+
+void Bus::WatchedWrite( const u16 address, const u8 data )
+{
+  bool const ppuData = address >= 0x2000 && address <= 0x3FFF && ( address & 0x0007 ) == 0x0007;
+  u16 const  ppuAddress = ppu.GetVramAddr() & 0x3FFF;
+  Write( address, data );
+  breakpoints.OnAccess( BreakKind::CpuWrite, address, data );
+  if ( ppuData ) {
+    breakpoints.OnAccess( BreakKind::PpuWrite, ppuAddress, data );
+  }
 }
 
 void Bus::ProcessDma()
@@ -133,19 +189,20 @@ void Bus::ProcessDma()
   u8 const oamAddr = ppu.oamAddr;
   // Wait first read is on an odd cycle, wait it out.
   if ( dmaOffset == 0 && cycle % 2 == 1 ) {
-    cpu.Tick();
+    cpu.TracedTick();
     return;
   }
 
   // Read into OAM on even, load next byte on odd
   if ( cycle % 2 == 0 ) {
     auto data = Read( dmaAddr + dmaOffset );
-    cpu.Tick();
+    cpu.TracedTick();
     ppu.oam.data.at( ( oamAddr + dmaOffset ) & 0xFF ) = data;
+    stateHasher.MarkDirty( StateRegion::Oam, 0 );
     dmaOffset++;
   } else {
     dmaInProgress = dmaOffset < 256;
-    cpu.Tick();
+    cpu.TracedTick();
   }
 }
 
@@ -154,9 +211,17 @@ void Bus::Clock()
   if ( dmaInProgress ) {
     ProcessDma();
   } else {
-    cpu.DecodeExecute();
+    u16 const pc = cpu.GetProgramCounter();
+    if ( !blockCache.Execute() ) {
+      cpu.DecodeExecute();
+    }
+    idleLoop.Observe( pc );
   }
+  ServiceEvents();
+}
 
+void Bus::ServiceEvents()
+{
   if ( ppu.nmiReady ) {
     ppu.nmiReady = false;
     cpu.NMI();
@@ -167,6 +232,52 @@ void Bus::Clock()
     cartridge.GetMapper()->IrqClear();
     cpu.IRQ();
   }
+
+  // The APU only catches up to the CPU when a DMC fetch or IRQ is due. Each fetch steals cycles.
+  if ( cpu.GetCycles() >= apu.next_event() ) {
+    int const stall = apu.run() * dmcStallCycles;
+    for ( int i = 0; i < stall; ++i ) {
+      cpu.TracedTick();
+    }
+  }
+
+  // Frame counter and DMC IRQs stay asserted until acknowledged
+  if ( apu.irq_pending() ) {
+    cpu.IRQ();
+  }
+}
+
+void Bus::RunFrame()
+{
+  u64 const frame = ppu.frame;
+  while ( ppu.frame == frame ) {
+    // Idle loops run up to the next instruction that leaves the bus something to do
+    if ( !dmaInProgress && idleLoop.Run( frame ) ) {
+      ServiceEvents();
+    } else {
+      Clock();
+    }
+  }
+}
+
+bool Bus::RunFrameUntilBreak()
+{
+  if ( !breakpoints.Armed() ) {
+    RunFrame();
+    return true;
+  }
+
+  // Armed, the CPU is off its production step, so there's no idle loop skipping to do
+  u64 const frame = ppu.frame;
+  breakpoints.StartChecks();
+  while ( ppu.frame == frame && !breakpoints.Hit() ) {
+    if ( !dmaInProgress && breakpoints.BeforeInstruction() ) {
+      break;
+    }
+    Clock();
+  }
+  breakpoints.StopChecks();
+  return !breakpoints.Hit();
 }
 
 /*
@@ -185,6 +296,10 @@ void Bus::DebugReset()
   cpu.Reset();
   ppu.Reset();
   cartridge.Reset();
+  stateHasher.MarkAllDirty();
+  idleLoop.Reset();
+  blockCache.Flush();
+  idleLoop.ResetStats( cpu.GetCycles() );
 }
 
 /*
@@ -199,6 +314,12 @@ int Bus::ReadDmc( void *objPtr, cpu_addr_t addr )
   return self->Read( addr );
 }
 
+unsigned long long Bus::CpuClock( void *objPtr )
+{
+  Bus const *self = static_cast<Bus const *>( objPtr );
+  return self->cpu.GetCycles();
+}
+
 /*
 ################################
 ||        Other Methods       ||
@@ -206,26 +327,34 @@ int Bus::ReadDmc( void *objPtr, cpu_addr_t addr )
 */
 void Bus::QuickSaveState( u8 idx )
 {
+  /** @brief Snapshots the current state into slot idx
+   * Only the serialization happens here. Compressing and writing the file is handed off to the
+   * save writer thread, which reports back through saveWriter.TakeResults().
+   */
   namespace fs = std::filesystem;
-  fs::path const path = fs::path( paths::states() ) / cartridge.GetRomHash();
-
-  if ( !fs::exists( path ) || !fs::is_directory( path ) )
-    fs::create_directories( path );
+  fs::path const path = fs::path( SlotDirectory() );
 
   // filename format: save_slot0
   std::string const stateFilename = "save_slot" + std::to_string( idx ) + statefileExt;
   fs::path const    stateFilepath = path / stateFilename;
-  SaveState( stateFilepath.string() );
+
+  std::vector<u8> buffer = saveWriter.AcquireBuffer();
+  SaveStateToMemory( buffer );
+  saveWriter.Submit( stateFilepath.string(), std::move( buffer ), true,
+                     "State saved to slot " + std::to_string( idx ) + "." );
 }
 
 void Bus::QuickLoadState( u8 idx )
 {
   namespace fs = std::filesystem;
-  fs::path const path = fs::path( paths::states() ) / cartridge.GetRomHash();
+  fs::path const path = fs::path( SlotDirectory() );
 
   if ( !fs::exists( path ) || !fs::is_directory( path ) )
     fs::create_directories( path );
 
+  // A save to this slot may still be in flight
+  saveWriter.Flush();
+
   std::string const stateFilename = "save_slot" + std::to_string( idx ) + statefileExt;
   fs::path const    stateFilepath = path / stateFilename;
   LoadState( stateFilepath.string() );
@@ -242,29 +371,86 @@ void Bus::SaveState( const std::string &filename )
     cereal::BinaryOutputArchive archive( outStream );
     archive( *this );
   } catch ( const std::exception &e ) {
-    std::cerr << "Error saving state: " << e.what() << "\n";
+    Log( std::string( "Error saving state: " ) + e.what() );
   }
 }
 
 void Bus::LoadState( const std::string &filename )
 {
+  /** @brief Loads a state file, either raw or compressed by the save writer
+   * Every failure, the file's or the state's, is logged once, below.
+   */
+  std::string error;
   try {
     std::ifstream inStream( filename, std::ios::in | std::ios::binary );
     if ( !inStream ) {
       throw std::runtime_error( "Could not open '" + filename + "' for reading" );
     }
 
+    std::vector<u8> const contents( ( std::istreambuf_iterator<char>( inStream ) ), std::istreambuf_iterator<char>() );
+    if ( SaveWriter::IsCompressed( contents.data(), contents.size() ) ) {
+      std::vector<u8> raw;
+      if ( !SaveWriter::Decompress( contents.data(), contents.size(), raw ) ) {
+        throw std::runtime_error( "Corrupt compressed state '" + filename + "'" );
+      }
+      if ( !RestoreState( raw.data(), raw.size(), error ) ) {
+        throw std::runtime_error( error );
+      }
+    } else if ( !RestoreState( contents.data(), contents.size(), error ) ) {
+      throw std::runtime_error( error );
+    }
+  } catch ( const std::exception &e ) {
+    Log( std::string( "Error loading state: " ) + e.what() );
+  }
+}
+
+void Bus::SaveStateToMemory( std::vector<u8> &buffer )
+{
+  ByteOutStream               outStream( buffer );
+  cereal::BinaryOutputArchive archive( outStream );
+  archive( *this );
+}
+
+bool Bus::LoadStateFromMemory( const u8 *data, std::size_t size )
+{
+  std::string error;
+  if ( !RestoreState( data, size, error ) ) {
+    Log( "Error loading state: " + error );
+    return false;
+  }
+  return true;
+}
+
+bool Bus::RestoreState( const u8 *data, std::size_t size, std::string &error )
+{
+  blockCache.BeforeStateLoad();
+  try {
+    ByteInStream               inStream( data, size );
     cereal::BinaryInputArchive archive( inStream );
     archive( *this );
   } catch ( const std::exception &e ) {
-    std::cerr << "Error loading state: " << e.what() << "\n";
+    error = e.what();
+    stateHasher.MarkAllDirty();
+    idleLoop.Reset();
+    blockCache.Flush();
+    return false;
   }
+  stateHasher.MarkAllDirty();
+  idleLoop.Reset();
+  blockCache.AfterStateLoad();
+  return true;
+}
+
+std::string Bus::SlotDirectory() const
+{
+  namespace fs = std::filesystem;
+  return ( fs::path( statesDir.empty() ? paths::states() : statesDir ) / cartridge.GetRomHash() ).string();
 }
 
 bool Bus::DoesSaveSlotExist( int idx ) const
 {
   namespace fs = std::filesystem;
-  fs::path const hashDir = fs::path( paths::states() ) / cartridge.GetRomHash();
+  fs::path const hashDir = fs::path( SlotDirectory() );
   if ( !( fs::exists( hashDir ) && fs::is_directory( hashDir ) ) ) {
     return false;
   }
@@ -299,6 +485,61 @@ bool Bus::IsRomSignatureValid( const std::string &stateFile )
   return oldHash == newHash;
 }
 
+void Bus::ForkFrom( const Bus &other )
+{
+  /** @brief Copies other's state field by field
+   * CPU and PPU copy the fields their serialize() lists, which leaves the bus back pointers and
+   * the opcode table alone. Blargg's APU has no copy support, it goes through its save state.
+   */
+  if ( this == &other ) {
+    return;
+  }
+  std::lock_guard<std::mutex> const lock( other._forkMutex );
+  CopySerializedFields( cpu, other.cpu );
+  CopySerializedFields( ppu, other.ppu );
+  ppu.nesPaletteRgbValues = other.ppu.nesPaletteRgbValues;
+
+  // The APU reads the CPU clock while loading, so this goes after the CPU
+  thread_local std::vector<u8> apuState;
+  apuState.clear();
+  {
+    ByteOutStream               outStream( apuState );
+    cereal::BinaryOutputArchive archive( outStream );
+    archive( other.apu );
+  }
+  {
+    ByteInStream               inStream( apuState.data(), apuState.size() );
+    cereal::BinaryInputArchive archive( inStream );
+    archive( apu );
+  }
+
+  cartridge.ForkFrom( other.cartridge );
+
+  dmaInProgress = other.dmaInProgress;
+  dmaAddr = other.dmaAddr;
+  dmaOffset = other.dmaOffset;
+  std::copy( std::begin( other.controllerState ), std::end( other.controllerState ), std::begin( controllerState ) );
+  std::copy( std::begin( other.controller ), std::end( other.controller ), std::begin( controller ) );
+  _ram = other._ram;
+  _useFlatMemory = other._useFlatMemory;
+  if ( _useFlatMemory ) {
+    _flatMemory = other._flatMemory;
+  }
+  cpu.SelectStep();
+
+  // Same contents, so other's page hashes are still valid here
+  stateHasher = other.stateHasher;
+  idleLoop.Reset();
+  blockCache.Flush();
+}
+
+std::unique_ptr<Bus> Bus::Clone() const
+{
+  auto bus = std::make_unique<Bus>();
+  bus->ForkFrom( *this );
+  return bus;
+}
+
 void Bus::PowerCycle()
 {
   cartridge.SaveBatteryRam();
@@ -307,4 +548,43 @@ void Bus::PowerCycle()
   apu.reset();
   cpu.Reset();
   cartridge.LoadBatteryRam();
+  stateHasher.MarkAllDirty();
+  idleLoop.Reset();
+  blockCache.Flush();
+}
+
+/*
+################################
+||         State Hash         ||
+################################
+*/
+u64 Bus::StateHash( bool incremental )
+{
+  if ( !incremental ) {
+    stateHasher.MarkAllDirty();
+  }
+
+  // Registers and latches are tiny, they're rehashed every time
+  statehash::ScalarArchive scalars;
+  scalars( cpu.GetProgramCounter(), cpu.GetAccumulator(), cpu.GetXRegister(), cpu.GetYRegister(),
+           cpu.GetStackPointer(), cpu.GetStatusRegister(), cpu.GetCycles() );
+  scalars( ppu.scanline, ppu.cycle, ppu.frame, ppu.ppuCtrl, ppu.ppuMask, ppu.ppuStatus, ppu.oamAddr, ppu.vramAddr,
+           ppu.tempAddr, ppu.fineX, ppu.addrLatch, ppu.vramBuffer );
+  scalars( dmaInProgress, dmaAddr, dmaOffset, controllerState );
+  if ( cartridge.DoesMapperExist() ) {
+    cartridge.SerializeMapperRegisters( scalars, cartridge.iNes.GetMapper() );
+  }
+
+  const u8 *const    mappedPrgRam = cartridge.GetMappedPrgRam();
+  std::array<u64, 7> parts = {
+      statehash::HashBytes( scalars.Bytes().data(), scalars.Bytes().size() ),
+      stateHasher.Region( StateRegion::Ram, _ram ),
+      stateHasher.Region( StateRegion::Nametables, ppu.nameTables ),
+      stateHasher.Region( StateRegion::Palette, ppu.paletteMemory.data(), ppu.paletteMemory.size() ),
+      stateHasher.Region( StateRegion::Oam, ppu.oam.data.data(), ppu.oam.data.size() ),
+      mappedPrgRam != nullptr ? stateHasher.Region( StateRegion::PrgRam, mappedPrgRam, 8192 )
+                              : stateHasher.Region( StateRegion::PrgRam, cartridge.GetPrgRam() ),
+      stateHasher.Region( StateRegion::ChrRam, cartridge.GetChrRam() ),
+  };
+  return statehash::HashBytes( reinterpret_cast<const u8 *>( parts.data() ), sizeof( parts ) ); // NOLINT
 }
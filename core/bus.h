@@ -1,16 +1,28 @@
 #pragma once
 #include "Nes_Apu.h"
+#include "block-cache.h"
+#include "breakpoints.h"
 #include "global-types.h"
 #include "cartridge.h"
+#include "cow-memory.h"
 #include "cpu.h"
+#include "idle-loop.h"
 #include "ppu.h"
+#include "save-writer.h"
+#include "state-hash.h"
 
 // Blargg's apu
 #include "Simple_Apu.h"
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 class Cartridge;
 class CPU;
@@ -24,12 +36,43 @@ public:
   // Initialized with flat memory disabled by default. Enabled in json tests only
   Bus();
 
+  // Every save state starts with these. Bump stateVersion whenever the layout of anything
+  // serialize() writes changes; states of any other version, or from before there was one, are
+  // rejected before any of this bus is touched.
+  static constexpr u32 stateMagic = 0x5353454E; // "NESS" in the archive
+  static constexpr u32 stateVersion = 1;
+
   template <class Archive> void serialize( Archive &ar ) // NOLINT
   {
-    ar( cpu, ppu, apu, cartridge, dmaInProgress, dmaAddr, dmaOffset, controllerState, controller, _ram, _useFlatMemory,
-        _flatMemory );
+    u32 magic = stateMagic;
+    u32 version = stateVersion;
+    ar( magic, version );
+    if ( magic != stateMagic ) {
+      throw std::runtime_error( "not a save state, or one saved before states had a format version" );
+    }
+    if ( version != stateVersion ) {
+      throw std::runtime_error( "save state format version " + std::to_string( version ) +
+                                ", this build loads version " + std::to_string( stateVersion ) );
+    }
+    ar( cpu, ppu, apu, cartridge, dmaInProgress, dmaAddr, dmaOffset, controllerState, controller, _ram, _useFlatMemory );
+    // 64KB that only the json tests use, keep it out of regular (and run-ahead) snapshots
+    if ( _useFlatMemory ) {
+      ar( _flatMemory );
+    }
+    cpu.SelectStep();
   }
 
+  /*
+  ################################
+  ||           Logging          ||
+  ################################
+  */
+  // Diagnostics from the bus and its peripherals go through Log(). They're printed to stdout
+  // unless a sink is set, which is how EmulatorPool keeps each instance's messages to itself.
+  // Declared ahead of the peripherals so it's usable while they're constructed.
+  std::function<void( const std::string & )> logSink;
+  void                                       Log( const std::string &message ) const;
+
   /*
   ################################
   ||         Peripherals        ||
@@ -48,6 +91,9 @@ public:
   u8   Read( uint16_t address, bool debugMode = false );
   void Write( u16 address, u8 data );
   void Clock();
+  void RunFrame(); // clocks until the PPU wraps to the next frame
+  // The debugger's RunFrame(): stops early, returning false, when a breakpoint hits
+  bool RunFrameUntilBreak();
   void ProcessDma();
   void PowerCycle();
   void PowerOff();
@@ -58,12 +104,38 @@ public:
   ################################
   */
   void QuickLoadState( u8 idx = 0 );
-  void QuickSaveState( u8 idx = 0 );
+  void QuickSaveState( u8 idx = 0 ); // asynchronous, see saveWriter
   void SaveState( const std::string &filename );
   void LoadState( const std::string &filename );
+  void SaveStateToMemory( std::vector<u8> &buffer );
+  bool LoadStateFromMemory( const u8 *data, std::size_t size );
   bool DoesSaveSlotExist( int idx = 0 ) const;
   bool IsRomSignatureValid( const std::string &stateFile );
 
+  /*
+  ################################
+  ||           Forking          ||
+  ################################
+  */
+  // Become a copy of other's emulation state, as if its save state had been loaded, without
+  // serializing. The ROM image is shared and bulk memory (CPU RAM, nametables, cartridge RAM) is
+  // copy-on-write, so a fork costs the registers plus the pages either side writes afterwards.
+  // Like LoadState(), the frame buffer, log sink and frame callback stay this bus's own.
+  // So does a mapped battery save of the same game, which takes other's PRG RAM; Clone() copies never map one.
+  // Several threads may fork from the same other at once, but other must not be running meanwhile.
+  void                 ForkFrom( const Bus &other );
+  std::unique_ptr<Bus> Clone() const; // ForkFrom() into a new bus
+
+  /*
+  ################################
+  ||         State Hash         ||
+  ################################
+  */
+  // 64-bit hash of CPU registers, RAM, nametables, palette, OAM, mapper registers, PRG RAM and
+  // CHR RAM. Incremental mode only rehashes pages written since the last call; pass false after
+  // poking memory directly (debuggers, tests) to rehash everything.
+  u64 StateHash( bool incremental = true );
+
   /*
   ################################
   ||      Global Variables      ||
@@ -75,6 +147,23 @@ public:
   u8          controllerState[2]{};
   u8          controller[2]{};
   std::string statefileExt = ".nesstate";
+  std::string statesDir; // quick save slots go here, under the ROM hash. Empty: paths::states()
+
+  // Background writer for quick saves and battery RAM. Not part of the serialized state.
+  SaveWriter saveWriter;
+
+  // Page cache and dirty tracking behind StateHash()
+  StateHasher stateHasher;
+
+  // Idle loop detection. RunFrame() replays idle iterations without re-decoding them, every cycle
+  // still runs. Not part of the serialized state.
+  IdleLoop idleLoop;
+
+  // Pre-decoded instructions for Clock(), see block-cache.h. Not part of the serialized state.
+  BlockCache blockCache;
+
+  // Debugger breakpoints and watchpoints, see breakpoints.h. Not part of the serialized state.
+  Breakpoints breakpoints;
 
   /*
   ################################
@@ -83,24 +172,54 @@ public:
   */
   [[nodiscard]] bool IsTestMode() const;
   void               DebugReset();
-  void               EnableJsonTestMode() { _useFlatMemory = true; }
-  void               DisableJsonTestMode() { _useFlatMemory = false; }
+  void               EnableJsonTestMode()
+  {
+    _useFlatMemory = true;
+    cpu.SelectStep();
+  }
+  void DisableJsonTestMode()
+  {
+    _useFlatMemory = false;
+    cpu.SelectStep();
+  }
+
+  // Read() and Write() plus the watchpoint checks. The CPU only calls these while a watchpoint of
+  // that direction is enabled.
+  u8   WatchedRead( u16 address, bool debugMode = false );
+  void WatchedWrite( u16 address, u8 data );
+
+  // The 2KB of CPU RAM, without going through Read()'s mirroring and side effects
+  [[nodiscard]] const CowMemory<2048> &GetRam() const { return _ram; }
 
   /*
   ################################
   ||  Blargg's APU Integration  ||
   ################################
   */
-  const long sampleRate = 44100;
-  static int ReadDmc( void *objPtr, cpu_addr_t addr );
+  const long                sampleRate = 44100;
+  static constexpr int      dmcStallCycles = 4; // CPU cycles a DMC sample fetch steals
+  static int                ReadDmc( void *objPtr, cpu_addr_t addr );
+  static unsigned long long CpuClock( void *objPtr );
 
 private:
+  // The part of Clock() after the instruction: interrupts, APU events and DMC stalls
+  void ServiceEvents();
+
+  // LoadStateFromMemory() without the logging, error says why it failed
+  bool RestoreState( const u8 *data, std::size_t size, std::string &error );
+  // Where quick save slots of the loaded ROM live
+  [[nodiscard]] std::string SlotDirectory() const;
+
   /*
   ################################
   ||           CPU RAM          ||
   ################################
   */
-  std::array<u8, 2048> _ram{}; // 2KB internal cpu RAM
+  CowMemory<2048> _ram; // 2KB internal cpu RAM
+
+  // Held while other buses fork from this one. Forking reads this bus's state but also catches its
+  // APU up and reselects its CPU step, so concurrent forks take turns at that part.
+  mutable std::mutex _forkMutex;
 
   /*
   ################################
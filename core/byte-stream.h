@@ -0,0 +1,70 @@
+#pragma once
+#include "global-types.h"
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+/*
+################################
+||        Byte Streams        ||
+################################
+  Minimal streambufs over plain byte buffers. Cereal archives take a std::ostream / std::istream,
+  these let us serialize straight into (or out of) a caller-owned buffer without going through
+  a std::stringstream and its extra copies.
+*/
+
+class ByteSink : public std::streambuf
+{
+public:
+  explicit ByteSink( std::vector<u8> &buffer ) : _buffer( buffer ) {}
+
+protected:
+  int_type overflow( int_type ch ) override
+  {
+    if ( !traits_type::eq_int_type( ch, traits_type::eof() ) ) {
+      _buffer.push_back( static_cast<u8>( ch ) );
+    }
+    return ch;
+  }
+
+  std::streamsize xsputn( const char *s, std::streamsize n ) override
+  {
+    _buffer.insert( _buffer.end(), s, s + n ); // NOLINT
+    return n;
+  }
+
+private:
+  std::vector<u8> &_buffer;
+};
+
+class ByteSource : public std::streambuf
+{
+public:
+  ByteSource( const u8 *data, std::size_t size )
+  {
+    // streambuf wants mutable pointers, but we never write through them
+    char *begin = const_cast<char *>( reinterpret_cast<const char *>( data ) ); // NOLINT
+    setg( begin, begin, begin + size );                                      // NOLINT
+  }
+};
+
+class ByteOutStream : public std::ostream
+{
+public:
+  explicit ByteOutStream( std::vector<u8> &buffer ) : std::ostream( &_sink ), _sink( buffer ) {}
+
+private:
+  ByteSink _sink;
+};
+
+class ByteInStream : public std::istream
+{
+public:
+  ByteInStream( const u8 *data, std::size_t size ) : std::istream( &_source ), _source( data, size ) {}
+
+private:
+  ByteSource _source;
+};
@@ -3,13 +3,17 @@
 #include <cstring>
 #include <filesystem>
 #include <fmt/base.h>
+#include <fmt/format.h>
 #include <fstream>
 #include <ios>
-#include <iostream>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "bus.h"
+#include "cow-memory.h"
 #include "global-types.h"
 #include "utils.h"
 #include "paths.h"
@@ -24,8 +28,54 @@
 
 using utils::between;
 
-Cartridge::Cartridge( Bus *bus ) : bus( bus )
+namespace
 {
+// What the ROM views show before a game is loaded
+constexpr std::array<u8, 16384> emptyPrgRom{};
+constexpr std::array<u8, 8192>  emptyChrRom{};
+} // namespace
+
+Cartridge::Cartridge( Bus *bus ) : bus( bus ), _prgRom( emptyPrgRom ), _chrRom( emptyChrRom )
+{
+}
+
+u8 Cartridge::RomByte( std::span<const u8> rom, u32 offset )
+{
+  if ( offset >= rom.size() ) {
+    throw std::out_of_range( fmt::format( "Cartridge: ROM offset {:#x} out of range ({:#x} bytes)", offset,
+                                          rom.size() ) );
+  }
+  return rom[offset];
+}
+
+std::shared_ptr<Mapper> Cartridge::MakeMapper( int mapperNumber, const iNes2Instance &header )
+{
+  switch ( mapperNumber ) {
+    case 0 : return std::make_shared<Mapper0>( header );
+    case 1 : return std::make_shared<Mapper1>( header );
+    case 2 : return std::make_shared<Mapper2>( header );
+    case 3 : return std::make_shared<Mapper3>( header );
+    case 4 : return std::make_shared<Mapper4>( header );
+    default: throw std::runtime_error( "Unsupported mapper: " + std::to_string( mapperNumber ) );
+  };
+}
+
+void Cartridge::SetChrROM( u16 address, u8 data )
+{
+  if ( _chrRomCopy.empty() ) {
+    _chrRomCopy.assign( _chrRom.begin(), _chrRom.end() );
+    _chrRom = _chrRomCopy;
+  }
+  _chrRomCopy.at( address ) = data;
+}
+
+void Cartridge::Log( const std::string &message ) const
+{
+  if ( bus != nullptr ) {
+    bus->Log( message );
+  } else {
+    fmt::print( "{}\n", message );
+  }
 }
 
 bool Cartridge::IsRomValid( const std::string &filePath )
@@ -48,33 +98,15 @@ void Cartridge::LoadRom( const std::string &filePath )
    */
   didMapperLoad = false;
   _romPath = filePath;
-  std::ifstream romFile( filePath, std::ios::binary );
-  if ( !romFile.is_open() ) {
-    throw std::runtime_error( "Failed to open ROM file: " + filePath );
-  }
-
-  // Read in the iNES header
-  std::array<char, 16> header{};
-  if ( !romFile.read( header.data(), header.size() ) ) {
-    if ( romFile.eof() ) {
-      throw std::runtime_error( "Failed to read ROM header: Unexpected end of file." );
-    }
-    if ( romFile.fail() ) {
-      throw std::runtime_error( "Failed to read ROM header: I/O error." );
-    }
-    if ( romFile.bad() ) {
-      throw std::runtime_error( "Failed to read ROM header: Fatal I/O error." );
-    }
-  }
 
-  // Load in a unique rom hash
-  romHash = utils::GetRomHash( filePath );
+  // Release the previous game's save file
+  _batteryRam.Unmap();
+  _batteryData = nullptr;
 
-  memcpy( iNes.header.value, header.data(), header.size() );
-
-  if ( iNes.GetIdentification() != "NES\x1A" ) {
-    throw std::runtime_error( "Invalid ROM file" );
-  }
+  // Shared with every other cartridge running this file, only read from disk the first time
+  std::shared_ptr<const RomImage> image = rom_cache::Acquire( filePath );
+  romHash = image->Hash();
+  memcpy( iNes.header.value, image->Header().data(), image->Header().size() );
 
   /*
   ################################
@@ -83,46 +115,20 @@ void Cartridge::LoadRom( const std::string &filePath )
   ||                            ||
   ################################
   */
+  _rom = std::move( image );
+  _chrRomCopy.clear();
 
-  // Skip 512 bytes if there is trainer data
-  bool const hasTrainer = iNes.GetTrainerMode() == 1;
-  if ( hasTrainer ) {
-    romFile.seekg( 512, std::ios::cur );
-  }
-
-  int const prgRomSize = iNes.GetPrgRomSizeBytes();
-  int const chrRomSize = iNes.GetChrRomSizeBytes();
-
-  // Set the PRG and CHR vector sizes
-  if ( prgRomSize > 0 ) {
-    _prgRom.resize( prgRomSize );
-  }
-
-  // Sometimes, chr rom isn't provided. Some games use chr ram instead.
-  _usesChrRam = chrRomSize == 0;
-  if ( _usesChrRam ) {
-    // _chrRam is already an 8 KiB array, so do nothing
+  // Keep the minimum sized blank view if the header says there is no PRG ROM
+  if ( !_rom->Prg().empty() ) {
+    _prgRom = _rom->Prg();
   } else {
-    _chrRom.resize( chrRomSize );
+    _prgRom = emptyPrgRom;
+    Log( "Cartridge:LoadRom:No PRG ROM data found." );
   }
 
-  // Read data into the PRG and CHR ROM vectors
-  if ( prgRomSize > 0 ) {
-
-    romFile.read( reinterpret_cast<char *>( _prgRom.data() ), // NOLINT
-                  static_cast<std::streamsize>( prgRomSize ) );
-  } else {
-    fmt::print( "Cartridge:romFile.read:No PRG ROM data found. No read occured.\n" );
-  }
-  if ( !_usesChrRam ) {
-
-    if ( chrRomSize > 0 ) {
-      romFile.read( reinterpret_cast<char *>( _chrRom.data() ), // NOLINT
-                    static_cast<std::streamsize>( chrRomSize ) );
-    } else {
-      fmt::print( "Cartridge:romFile.read:No CHR ROM data found. No read occured.\n" );
-    }
-  }
+  // Sometimes, chr rom isn't provided. Some games use chr ram instead.
+  _usesChrRam = _rom->Chr().empty();
+  _chrRom = _usesChrRam ? std::span<const u8>( emptyChrRom ) : _rom->Chr();
 
   /*
   ################################
@@ -131,22 +137,16 @@ void Cartridge::LoadRom( const std::string &filePath )
   ||                            ||
   ################################
   */
-  auto const mapperNumber = iNes.GetMapper();
-  switch ( mapperNumber ) {
-    case 0 : _mapper = std::make_shared<Mapper0>( iNes ); break;
-    case 1 : _mapper = std::make_shared<Mapper1>( iNes ); break;
-    case 2 : _mapper = std::make_shared<Mapper2>( iNes ); break;
-    case 3 : _mapper = std::make_shared<Mapper3>( iNes ); break;
-    case 4 : _mapper = std::make_shared<Mapper4>( iNes ); break;
-    default: throw std::runtime_error( "Unsupported mapper: " + std::to_string( mapperNumber ) );
-  };
+  _mapper = MakeMapper( iNes.GetMapper(), iNes );
 
   if ( _mapper != nullptr ) {
     didMapperLoad = true;
   }
 
-  romFile.close();
-
+  if ( bus != nullptr ) {
+    bus->stateHasher.MarkAllDirty();
+    bus->blockCache.Flush();
+  }
   LoadBatteryRam();
 }
 
@@ -222,11 +222,11 @@ void Cartridge::Write( u16 addr, u8 data )
    */
   if ( between( addr, 0x8000, 0xFFFF ) ) {
     if ( _mapper == nullptr ) {
-      fmt::print( "Cartridge:ReadPrgROM:Mapper is null. Rom file was likely not loaded.\n" );
-      return _prgRom.at( addr & 0x3FFF );
+      Log( "Cartridge:ReadPrgROM:Mapper is null. Rom file was likely not loaded." );
+      return RomByte( _prgRom, addr & 0x3FFF );
     }
     u32 const prgOffset = _mapper->MapCpuAddr( addr );
-    return _prgRom.at( prgOffset );
+    return RomByte( _prgRom, prgOffset );
   }
   return 0xFF;
 }
@@ -240,15 +240,15 @@ void Cartridge::Write( u16 addr, u8 data )
     return 0xFF;
 
   if ( _mapper == nullptr ) {
-    fmt::print( "Cartridge:ReadChrROM:Mapper is null. Rom file was likely not loaded.\n" );
-    return _chrRom.at( addr & 0x1FFF );
+    Log( "Cartridge:ReadChrROM:Mapper is null. Rom file was likely not loaded." );
+    return RomByte( _chrRom, addr & 0x1FFF );
   }
 
   u32 const chrOffset = _mapper->MapPpuAddr( addr );
   if ( _usesChrRam ) {
-    return _chrRam.at( chrOffset );
+    return _chrRam.Read( chrOffset );
   }
-  return _chrRom.at( chrOffset );
+  return RomByte( _chrRom, chrOffset );
 }
 
 [[nodiscard]] u8 Cartridge::ReadPrgRAM( u16 addr )
@@ -260,11 +260,11 @@ void Cartridge::Write( u16 addr, u8 data )
    * a game uses PRG RAM or not will be determined by the mapper.
    */
   if ( _mapper == nullptr ) {
-    fmt::print( "Cartridge:ReadPrgRAM:Mapper is null. Rom file was likely not loaded.\n" );
-    return _prgRam.at( addr - 0x6000 );
+    Log( "Cartridge:ReadPrgRAM:Mapper is null. Rom file was likely not loaded." );
+    return PrgRamByte( addr & 0x1FFF );
   }
   if ( between( addr, 0x6000, 0x7FFF ) && _mapper->SupportsPrgRam() ) {
-    return _prgRam.at( addr & 0x1FFF );
+    return PrgRamByte( addr & 0x1FFF );
   }
   return 0xFF;
 }
@@ -275,12 +275,12 @@ void Cartridge::Write( u16 addr, u8 data )
    * Expansion ROM is rarely used, but when it is, it's used for additional program data
    */
   if ( _mapper == nullptr ) {
-    fmt::print( "Cartridge:ReadExpansionROM:Mapper is null. Rom file was likely not loaded.\n" );
-    return _expansionMemory.at( addr - 0x4020 );
+    Log( "Cartridge:ReadExpansionROM:Mapper is null. Rom file was likely not loaded." );
+    return _expansionMemory.Read( addr - 0x4020 );
   }
 
   if ( between( addr, 0x4020, 0x5FFF ) && _mapper->HasExpansionRam() ) {
-    return _expansionMemory.at( addr - 0x4020 );
+    return _expansionMemory.Read( addr - 0x4020 );
   }
   return 0xFF;
 }
@@ -299,14 +299,14 @@ void Cartridge::WritePrgROM( u16 addr, u8 data )
    * to trigger bank switching.
    */
   if ( _mapper == nullptr ) {
-    fmt::print( "Cartridge:WritePrgROM:Mapper is null. Rom file was likely not loaded.\n" );
+    Log( "Cartridge:WritePrgROM:Mapper is null. Rom file was likely not loaded." );
     return;
   }
 
   if ( between( addr, 0x8000, 0xFFFF ) ) {
     _mapper->HandleCPUWrite( addr, data );
   } else {
-    fmt::print( "Cartridge:WritePrgROM:Address out of range.\n" );
+    Log( "Cartridge:WritePrgROM:Address out of range." );
   }
 }
 
@@ -334,11 +334,14 @@ void Cartridge::WriteChrRAM( u16 addr, u8 data )
    */
   if ( between( addr, 0x0000, 0x1FFF ) && _usesChrRam ) {
     if ( _mapper == nullptr ) {
-      fmt::print( "Cartridge:WriteChrRAM:Mapper is null. Rom file was likely not loaded.\n" );
+      Log( "Cartridge:WriteChrRAM:Mapper is null. Rom file was likely not loaded." );
       return;
     }
     u16 const translatedAddress = _mapper->MapPpuAddr( addr );
-    _chrRam.at( translatedAddress & 0x1FFF ) = data;
+    _chrRam.Write( translatedAddress & 0x1FFF, data );
+    if ( bus != nullptr ) {
+      bus->stateHasher.MarkDirty( StateRegion::ChrRam, translatedAddress & 0x1FFF );
+    }
   }
 }
 
@@ -351,12 +354,20 @@ void Cartridge::WritePrgRAM( u16 addr, u8 data )
    * a game uses PRG RAM or not will be determined by the mapper.
    */
   if ( _mapper == nullptr ) {
-    fmt::print( "Cartridge:WritePrgRAM:Mapper is null. Rom file was likely not loaded.\n" );
+    Log( "Cartridge:WritePrgRAM:Mapper is null. Rom file was likely not loaded." );
     return;
   }
 
   if ( between( addr, 0x6000, 0x7FFF ) && _mapper->SupportsPrgRam() ) {
-    _prgRam.at( addr - 0x6000 ) = data;
+    if ( _batteryData != nullptr ) {
+      _batteryData[addr & 0x1FFF] = data; // NOLINT
+      _batteryRam.MarkDirty();
+    } else {
+      _prgRam.Write( addr & 0x1FFF, data );
+    }
+    if ( bus != nullptr ) {
+      bus->stateHasher.MarkDirty( StateRegion::PrgRam, addr & 0x1FFF );
+    }
   }
 }
 
@@ -366,12 +377,12 @@ void Cartridge::WriteExpansionRAM( u16 addr, u8 data )
    * Expansion ROM is rarely used, but when it is, it's used for additional program data
    */
   if ( _mapper == nullptr ) {
-    fmt::print( "Cartridge:WriteExpansionRAM:Mapper is null. Rom file was likely not loaded.\n" );
+    Log( "Cartridge:WriteExpansionRAM:Mapper is null. Rom file was likely not loaded." );
     return;
   }
 
   if ( between( addr, 0x4020, 0x5FFF ) && _mapper->HasExpansionRam() ) {
-    _expansionMemory.at( addr - 0x4020 ) = data;
+    _expansionMemory.Write( addr - 0x4020, data );
   }
 }
 
@@ -402,42 +413,169 @@ void Cartridge::Reset()
   }
 }
 
+void Cartridge::ForkFrom( const Cartridge &other )
+{
+  /** @brief Copies other's cartridge state without copying its memory
+   * The ROM image is shared as is. CHR, PRG and expansion RAM share other's pages until either
+   * side writes them. A cartridge with this game's save file mapped keeps it, and other's PRG RAM
+   * is written into it, the way a state load would. Any other cartridge (a fresh fork, one running
+   * another game) gets other's PRG RAM as private memory and never writes a save file.
+   */
+  bool const keepSave = _batteryRam.IsMapped() && romHash == other.romHash;
+  if ( !keepSave ) {
+    _batteryRam.Unmap();
+    _batteryData = nullptr;
+  }
+
+  iNes = other.iNes;
+  romHash = other.romHash;
+  _romPath = other._romPath;
+  _rom = other._rom;
+  _prgRom = other._prgRom;
+  _chrRomCopy = other._chrRomCopy;
+  _chrRom = _chrRomCopy.empty() ? other._chrRom : std::span<const u8>( _chrRomCopy );
+  _usesChrRam = other._usesChrRam;
+
+  _chrRam = other._chrRam;
+  _expansionMemory = other._expansionMemory;
+  if ( _batteryData != nullptr ) {
+    std::array<u8, 8192> prgRam{};
+    if ( other._batteryData != nullptr ) {
+      std::memcpy( prgRam.data(), other._batteryData, prgRam.size() );
+    } else {
+      other._prgRam.CopyTo( prgRam.data() );
+    }
+    if ( std::memcmp( _batteryData, prgRam.data(), prgRam.size() ) != 0 ) {
+      std::memcpy( _batteryData, prgRam.data(), prgRam.size() );
+      _batteryRam.MarkDirty();
+    }
+  } else if ( other._batteryData != nullptr ) {
+    _prgRam.CopyFrom( other._batteryData );
+  } else {
+    _prgRam = other._prgRam;
+  }
+
+  // Mappers aren't copyable, build a fresh one and copy the registers a save state would
+  _mapperNumber = other._mapperNumber;
+  didMapperLoad = other.didMapperLoad;
+  _mapper = nullptr;
+  if ( other._mapper != nullptr ) {
+    int const mapperNumber = other.iNes.GetMapper();
+    _mapper = MakeMapper( mapperNumber, other._mapper->iNes );
+
+    FieldSource source;
+    other.SerializeMapperRegisters( source, mapperNumber );
+    FieldTarget target( source );
+    SerializeMapperRegisters( target, mapperNumber );
+  }
+}
+
+void Cartridge::BeginSpeculation()
+{
+  /** @brief Sends PRG RAM writes to a private copy instead of the save file
+   * The copy starts out equal to the file, so reads, save states and the state hash don't see the
+   * switch. Without a mapped save file, or when already speculating, there's nothing to do.
+   */
+  if ( _batteryData == nullptr ) {
+    return;
+  }
+  _prgRam.CopyFrom( _batteryData );
+  _batteryData = nullptr;
+}
+
+void Cartridge::EndSpeculation()
+{
+  /** @brief Writes the private PRG RAM back into the save file and maps it again
+   * Only what PRG RAM holds now reaches the file. Callers that want to drop the speculative
+   * writes load their snapshot first, which leaves nothing to write.
+   */
+  if ( !_batteryRam.IsMapped() || _batteryData != nullptr ) {
+    return;
+  }
+  _batteryData = _batteryRam.Data();
+  std::array<u8, 8192> prgRam{};
+  _prgRam.CopyTo( prgRam.data() );
+  if ( std::memcmp( _batteryData, prgRam.data(), prgRam.size() ) != 0 ) {
+    std::memcpy( _batteryData, prgRam.data(), prgRam.size() );
+    _batteryRam.MarkDirty();
+  }
+}
+
 void Cartridge::LoadBatteryRam()
 {
-  if ( iNes.GetBatteryMode() != 1 )
+  /** @brief Attaches battery backed PRG RAM to its save file
+   * The save file is memory mapped, so PRG RAM writes persist without any explicit save. If
+   * mapping isn't available, the file is read into the in-memory PRG RAM instead.
+   */
+  if ( iNes.GetBatteryMode() != 1 || privateBatteryRam )
     return;
   namespace fs = std::filesystem;
   fs::path const dir = fs::path( paths::saves() );
   if ( !fs::exists( dir ) )
     fs::create_directories( dir );
 
+  // Don't read the file out from under a pending battery save. PRG RAM contents change below.
+  if ( bus != nullptr ) {
+    bus->saveWriter.Flush();
+    bus->stateHasher.MarkAllDirty();
+    bus->blockCache.Flush();
+  }
+
   fs::path const savePath = dir / GetRomHash();
-  std::ifstream  in( savePath, std::ios::in | std::ios::binary );
+  if ( _batteryRam.IsMapped() && _batteryRam.Path() == savePath.string() ) {
+    return;
+  }
+  if ( _batteryRam.Map( savePath.string(), _prgRam.size() ) ) {
+    _batteryData = _batteryRam.Data();
+    return;
+  }
+  _batteryData = nullptr;
+
+  std::ifstream in( savePath, std::ios::in | std::ios::binary );
   if ( !in ) {
-    fmt::print( "No save file: {}\n", savePath.string() );
+    Log( fmt::format( "No save file: {}", savePath.string() ) );
     return;
   }
-  in.read( reinterpret_cast<char *>( _prgRam.data() ), _prgRam.size() ); // NOLINT
-  if ( in.gcount() != static_cast<std::streamsize>( _prgRam.size() ) ) {
-    fmt::print( "Save file truncated: {}\n", savePath.string() );
+  // A short file only overwrites the start of PRG RAM
+  std::array<u8, 8192> contents{};
+  _prgRam.CopyTo( contents.data() );
+  in.read( reinterpret_cast<char *>( contents.data() ), contents.size() ); // NOLINT
+  if ( in.gcount() != static_cast<std::streamsize>( contents.size() ) ) {
+    Log( fmt::format( "Save file truncated: {}", savePath.string() ) );
   }
+  _prgRam.CopyFrom( contents.data() );
 }
 
 void Cartridge::SaveBatteryRam()
 {
-  if ( iNes.GetBatteryMode() != 1 )
+  /** @brief Persists battery backed PRG RAM
+   * A mapped save file only needs an msync. Otherwise the RAM is copied and handed off to the
+   * bus save writer, which writes it in the background. Either way the file stays a raw 8KiB
+   * dump so it remains compatible with other emulators.
+   */
+  if ( iNes.GetBatteryMode() != 1 || privateBatteryRam )
     return;
-  namespace fs = std::filesystem;
-  fs::path const dir = fs::path( paths::saves() );
-  if ( !fs::exists( dir ) )
-    fs::create_directories( dir );
 
-  fs::path const savePath = dir / GetRomHash();
-  std::ofstream  out( savePath, std::ios::out | std::ios::binary | std::ios::trunc );
-  if ( !out ) {
-    fmt::print( "Failed to open save file for writing: {}\n", savePath.string() );
+  if ( _batteryRam.IsMapped() ) {
+    _batteryRam.Sync();
     return;
   }
-  out.write( reinterpret_cast<char *>( _prgRam.data() ), _prgRam.size() ); // NOLINT
-  out.flush();
+
+  namespace fs = std::filesystem;
+  fs::path const savePath = fs::path( paths::saves() ) / GetRomHash();
+
+  if ( bus == nullptr ) {
+    std::string           error;
+    std::vector<u8> contents( _prgRam.size() );
+    _prgRam.CopyTo( contents.data() );
+    if ( !SaveWriter::WriteFileAtomic( savePath.string(), contents, error ) ) {
+      Log( fmt::format( "Failed to write save file {}: {}", savePath.string(), error ) );
+    }
+    return;
+  }
+
+  std::vector<u8> buffer = bus->saveWriter.AcquireBuffer();
+  buffer.resize( _prgRam.size() );
+  _prgRam.CopyTo( buffer.data() );
+  bus->saveWriter.Submit( savePath.string(), std::move( buffer ), false );
 }
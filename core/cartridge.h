@@ -3,10 +3,15 @@
 #include "global-types.h"
 #include "mappers/mapper-base.h"
 #include <array>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <memory>
+#include <span>
+#include "battery-ram.h"
 #include "cartridge-header.h"
+#include "cow-memory.h"
+#include "rom-cache.h"
 #include "mappers/mapper1.h"
 #include "mappers/mapper2.h"
 #include "mappers/mapper3.h"
@@ -24,62 +29,62 @@ public:
 
   template <class Archive> void save( Archive &ar ) const // NOLINT
   {
-    ar( _chrRam, _prgRam, _expansionMemory, romHash );
+    // PRG RAM may live in a file mapping, save whichever is active
+    std::array<u8, 8192> prgRam{};
+    if ( _batteryData != nullptr ) {
+      std::memcpy( prgRam.data(), _batteryData, prgRam.size() );
+    } else {
+      _prgRam.CopyTo( prgRam.data() );
+    }
+    ar( _chrRam, prgRam, _expansionMemory, romHash );
     int const m = iNes.GetMapper();
     ar( m );
-    switch ( m ) {
-      case 1: {
-        auto m1 = std::static_pointer_cast<Mapper1>( _mapper );
-        ar( m1->controlRegister, m1->prgBank16Lo, m1->prgBank16Hi, m1->prgBank32, m1->chrBank4Lo, m1->chrBank4Hi,
-            m1->chrBank8, m1->shiftRegister, m1->writeCount, m1->mirroring );
-        break;
-      }
-      case 2: {
-        auto m2 = std::static_pointer_cast<Mapper2>( _mapper );
-        ar( m2->prgBank16Lo, m2->mirroring );
-        break;
-      }
-      case 3: {
-        auto m3 = std::static_pointer_cast<Mapper3>( _mapper );
-        ar( m3->chrBank, m3->mirroring );
-        break;
-      }
-      case 4: {
-        auto m4 = std::static_pointer_cast<Mapper4>( _mapper );
-        ar( m4->nTargetRegister, m4->bPrgBankMode, m4->bChrInversion, m4->pRegister, m4->pChrBank, m4->pPrgBank,
-            m4->bIsIrqRequested, m4->bIrqEnabled, m4->nIrqCounter, m4->nIrqReload, m4->mirroring );
-        break;
-      }
-      default:
-    }
+    SerializeMapperRegisters( ar, m );
   }
   template <class Archive> void load( Archive &ar ) // NOLINT
   {
-    ar( _chrRam, _prgRam, _expansionMemory, romHash );
+    std::array<u8, 8192> prgRam{};
+    ar( _chrRam, prgRam, _expansionMemory, romHash );
+    // Skip unchanged PRG RAM, a mapped save file would otherwise be flushed on every load
+    if ( _batteryData == nullptr ) {
+      _prgRam.CopyFrom( prgRam.data() );
+    } else if ( std::memcmp( _batteryData, prgRam.data(), prgRam.size() ) != 0 ) {
+      std::memcpy( _batteryData, prgRam.data(), prgRam.size() );
+      _batteryRam.MarkDirty();
+    }
     int m = 0;
     ar( m );
     switch ( m ) {
+      case 1 : _mapper = std::make_shared<Mapper1>( iNes ); break;
+      case 2 : _mapper = std::make_shared<Mapper2>( iNes ); break;
+      case 3 : _mapper = std::make_shared<Mapper3>( iNes ); break;
+      case 4 : _mapper = std::make_shared<Mapper4>( iNes ); break;
+      default: break;
+    }
+    SerializeMapperRegisters( ar, m );
+  }
+
+  // Mapper register fields, shared by save / load and the state hash
+  template <class Archive> void SerializeMapperRegisters( Archive &ar, int mapperNum ) const // NOLINT
+  {
+    switch ( mapperNum ) {
       case 1: {
-        _mapper = std::make_shared<Mapper1>( iNes );
         auto m1 = std::static_pointer_cast<Mapper1>( _mapper );
         ar( m1->controlRegister, m1->prgBank16Lo, m1->prgBank16Hi, m1->prgBank32, m1->chrBank4Lo, m1->chrBank4Hi,
             m1->chrBank8, m1->shiftRegister, m1->writeCount, m1->mirroring );
         break;
       }
       case 2: {
-        _mapper = std::make_shared<Mapper2>( iNes );
         auto m2 = std::static_pointer_cast<Mapper2>( _mapper );
         ar( m2->prgBank16Lo, m2->mirroring );
         break;
       }
       case 3: {
-        _mapper = std::make_shared<Mapper3>( iNes );
         auto m3 = std::static_pointer_cast<Mapper3>( _mapper );
         ar( m3->chrBank, m3->mirroring );
         break;
       }
       case 4: {
-        _mapper = std::make_shared<Mapper4>( iNes );
         auto m4 = std::static_pointer_cast<Mapper4>( _mapper );
         ar( m4->nTargetRegister, m4->bPrgBankMode, m4->bChrInversion, m4->pRegister, m4->pChrBank, m4->pPrgBank,
             m4->bIsIrqRequested, m4->bIrqEnabled, m4->nIrqCounter, m4->nIrqReload, m4->mirroring );
@@ -131,11 +136,33 @@ public:
   void       LoadRom( const std::string &filePath );
   bool       IsRomValid( const std::string &filePath );
 
-  std::shared_ptr<Mapper> GetMapper() const { return _mapper; }
-  u8                      GetMapperNum() const { return _mapperNumber; }
+  const std::shared_ptr<Mapper> &GetMapper() const { return _mapper; }
+  u8                             GetMapperNum() const { return _mapperNumber; }
+
+  // The loaded ROM image's PRG ROM, the same memory for as long as the ROM stays loaded (state
+  // loads replace the mapper object, not this)
+  [[nodiscard]] std::span<const u8> GetPrgRom() const { return _prgRom; }
 
   void SaveBatteryRam();
   void LoadBatteryRam();
+  bool IsBatteryRamMapped() const { return _batteryRam.IsMapped(); }
+
+  // Between these, PRG RAM writes go to a private copy and the save file keeps what it had, so
+  // speculative frames (run-ahead, rollback) can't leave mispredicted bytes in it. EndSpeculation()
+  // writes PRG RAM as it is then into the file; load the snapshot first to drop the writes.
+  void BeginSpeculation();
+  void EndSpeculation();
+  bool IsSpeculating() const { return _batteryRam.IsMapped() && _batteryData == nullptr; }
+
+  // Views for the state hash. PRG RAM is the mapped save file instead when GetMappedPrgRam() isn't null.
+  const CowMemory<8192> &GetPrgRam() const { return _prgRam; }
+  const u8              *GetMappedPrgRam() const { return _batteryData; }
+  const CowMemory<8192> &GetChrRam() const { return _chrRam; }
+
+  // Become a copy of other, sharing its ROM image and (copy-on-write) RAM, see Bus::ForkFrom().
+  // A cartridge with this game's save file mapped keeps writing it, any other one gets a private
+  // copy of other's PRG RAM and never writes a save file.
+  void ForkFrom( const Cartridge &other );
 
   /*
   ################################
@@ -144,7 +171,7 @@ public:
   */
   bool DidMapperLoad() const { return didMapperLoad; }
   bool DoesMapperExist() const { return _mapper != nullptr; }
-  void SetChrROM( u16 address, u8 data ) { _chrRom.at( address ) = data; }
+  void SetChrROM( u16 address, u8 data ); // copies CHR ROM out of the shared image first
   /*
   ################################
   ||       Debug Variables      ||
@@ -162,7 +189,23 @@ public:
   std::string romHash;
   std::string GetRomHash() const { return romHash; }
 
+  // Keeps battery backed PRG RAM in memory: no save file is read, mapped or written. Set before
+  // LoadRom() by hosts running many copies of one game (EmulatorPool), which mustn't share a save
+  bool privateBatteryRam = false;
+
+  // Shared image the PRG and CHR ROM views point into, null before the first LoadRom()
+  std::shared_ptr<const RomImage> GetRomImage() const { return _rom; }
+
 private:
+  // Through the bus log when there is a bus
+  void Log( const std::string &message ) const;
+
+  // Bounds checked like std::vector::at
+  static u8 RomByte( std::span<const u8> rom, u32 offset );
+
+  // Throws std::runtime_error for mappers we don't implement
+  static std::shared_ptr<Mapper> MakeMapper( int mapperNumber, const iNes2Instance &header );
+
   /*
   ################################
   ||      Memory Variables      ||
@@ -173,10 +216,14 @@ private:
     Program Read-Only Memory, stores the game's code
     Each cartridge provides 16KiB PRG ROM banks. For simpler cartridges
     The size is fixed, but for others, many banks are provided.
-    The iNes header specifies how many PRG ROM banks are provided, so we
-    can define _prg_rom as a vector and resize it during ROM initialization
+    The iNes header specifies how many PRG ROM banks are provided.
+
+    ROM is read-only, so both PRG and CHR ROM are views into the game's RomImage, which every
+    cartridge running the same file shares (see rom-cache.h). Until a ROM is loaded, they view
+    zero filled blocks of the minimum sizes.
   */
-  std::vector<u8> _prgRom = std::vector<u8>( 16384 ); // 16KiB
+  std::shared_ptr<const RomImage> _rom;
+  std::span<const u8>             _prgRom;
 
   /* CHR ROM and RAM
     Character Read-Only Memory and Character Random Access Memory
@@ -197,17 +244,26 @@ private:
     table data dynamically. Having dynamic pattern tables allowed devs to
     create dynamic tiles.
   */
-  std::vector<u8>      _chrRom = std::vector<u8>( 8192 ); // 8KiB
-  std::array<u8, 8192> _chrRam{};                         // 8192 bytes (8 KiB)
+  std::span<const u8> _chrRom;
+  std::vector<u8>     _chrRomCopy; // private CHR ROM after SetChrROM(), for tests
+  CowMemory<8192>     _chrRam;     // 8192 bytes (8 KiB)
 
   // PRG RAM: Program RAM, also known as Save RAM (SRAM) or Work RAM sometimes
   // Its usage is determined by the mapper
-  std::array<u8, 8192> _prgRam{}; // 8KiB PRG RAM, also known as Save RAM (SRAM) or Work RAM sometimes
+  CowMemory<8192> _prgRam; // 8KiB PRG RAM, also known as Save RAM (SRAM) or Work RAM sometimes
+
+  // Battery backed carts map their save file instead, _batteryData points at the mapping
+  BatteryRam _batteryRam;
+  u8        *_batteryData = nullptr;
+  u8         PrgRamByte( u16 offset ) const
+  {
+    return _batteryData != nullptr ? _batteryData[offset] : _prgRam.Read( offset ); // NOLINT
+  }
 
   // Expansion ROM
   // Almost never used, but here it is anyway.
   // Can be both ROM or RAM, determined by the mapper
-  std::array<u8, 8192> _expansionMemory{};
+  CowMemory<8192> _expansionMemory;
 
   // Cartrdige VRAM
   // The PPU has 2KiB of vram for nametables (background layout information).
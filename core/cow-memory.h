@@ -0,0 +1,258 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+/*
+################################
+||     Copy-on-write Memory    ||
+################################
+  Bulk memory (CPU RAM, nametables, cartridge RAM) that can be shared between forked emulator
+  instances, see Bus::ForkFrom().
+
+  Contents live in 256-byte pages (StateHasher pages). Every page points either into a base
+  block, which is immutable once shared, or into this memory's private block. The first write
+  to a page that isn't private copies it there, so a fork pays for the pages it actually
+  changes and nothing up front.
+
+  Sharing freezes the source first: its private pages go into a new base block, or straight
+  into its current base when nobody else holds that one. A source that hasn't been written
+  since its last fork is shared as is, so forking one state many times only copies pointers.
+  Freezing and taking the base happen under the source's lock, so several threads can share
+  from one source at once (a tree search forking every branch from the same root) as long as
+  nothing writes to the source meanwhile.
+
+  Reads are one indirection more than a plain array. Writes to private pages add one bit test.
+*/
+
+template <std::size_t Size> class CowMemory
+{
+public:
+  static constexpr std::size_t pageSize = 256;
+  static constexpr std::size_t pageCount = Size / pageSize;
+  static_assert( Size % pageSize == 0 && pageCount <= 64, "pages are tracked in a u64 mask" );
+
+  using Block = std::array<u8, Size>;
+
+  CowMemory() : _base( Zeros() ) { PointAt( *_base ); }
+
+  // Copies share pages, see ShareFrom()
+  CowMemory( const CowMemory &other ) { ShareFrom( other ); }
+  CowMemory &operator=( const CowMemory &other )
+  {
+    if ( this != &other ) {
+      ShareFrom( other );
+    }
+    return *this;
+  }
+  CowMemory( CowMemory && ) = delete;
+  CowMemory &operator=( CowMemory && ) = delete;
+  ~CowMemory() = default;
+
+  [[nodiscard]] static constexpr std::size_t size() { return Size; }
+
+  // Bounds checked like std::array::at
+  [[nodiscard]] u8 Read( std::size_t index ) const
+  {
+    return _pages.at( index / pageSize )[index % pageSize]; // NOLINT
+  }
+
+  void Write( std::size_t index, u8 value )
+  {
+    if ( index >= Size ) {
+      throw std::out_of_range( "CowMemory::Write: index out of range" );
+    }
+    std::size_t const page = index / pageSize;
+    if ( ( _owned & ( u64{ 1 } << page ) ) == 0 ) {
+      Own( page );
+    }
+    ( *_private )[index] = value;
+  }
+
+  void Fill( u8 value )
+  {
+    EnsurePrivate();
+    _private->fill( value );
+    OwnAll();
+  }
+
+  void CopyFrom( const u8 *data )
+  {
+    EnsurePrivate();
+    std::memcpy( _private->data(), data, Size );
+    OwnAll();
+  }
+
+  void CopyTo( u8 *out ) const
+  {
+    for ( std::size_t page = 0; page < pageCount; ++page ) {
+      std::memcpy( out + ( page * pageSize ), _pages[page], pageSize ); // NOLINT
+    }
+  }
+
+  // Start of every page, for per-page hashing
+  [[nodiscard]] const std::array<const u8 *, pageCount> &Pages() const { return _pages; }
+
+  /*
+  ################################
+  ||           Sharing          ||
+  ################################
+  */
+  // Take other's contents without copying them. Other threads may share from other at the same
+  // time, but none may write to it. This memory's private block is kept for reuse.
+  void ShareFrom( const CowMemory &other )
+  {
+    std::shared_ptr<Block> base;
+    {
+      std::lock_guard<std::mutex> const lock( other._shareMutex );
+      other.FreezeLocked();
+      base = other._base;
+    }
+    _base = std::move( base );
+    _owned = 0;
+    PointAt( *_base );
+  }
+
+  // Make the current contents shareable, see above
+  void Freeze() const
+  {
+    std::lock_guard<std::mutex> const lock( _shareMutex );
+    FreezeLocked();
+  }
+
+  /*
+  ################################
+  ||        Serialization       ||
+  ################################
+  */
+  // Same bytes as a std::array<u8, Size>, so save states are unchanged
+  template <class Archive> void save( Archive &ar ) const
+  {
+    Block bytes;
+    CopyTo( bytes.data() );
+    ar( bytes );
+  }
+  template <class Archive> void load( Archive &ar )
+  {
+    Block bytes;
+    ar( bytes );
+    CopyFrom( bytes.data() );
+  }
+
+private:
+  void FreezeLocked() const
+  {
+    if ( _owned == 0 ) {
+      return;
+    }
+    // Nobody else sees the base block, update it in place with just the changed pages
+    if ( _base.use_count() == 1 && _base != Zeros() ) {
+      for ( u64 owned = _owned; owned != 0; owned &= owned - 1 ) {
+        std::size_t const page = std::countr_zero( owned );
+        std::memcpy( _base->data() + ( page * pageSize ), _private->data() + ( page * pageSize ), pageSize );
+      }
+    } else {
+      auto block = std::make_shared<Block>();
+      CopyTo( block->data() );
+      _base = std::move( block );
+    }
+    _owned = 0;
+    PointAt( *_base );
+  }
+
+  // Shared by every fresh memory of this size, its use count never drops to one
+  static const std::shared_ptr<Block> &Zeros()
+  {
+    static const std::shared_ptr<Block> zeros = std::make_shared<Block>();
+    return zeros;
+  }
+
+  void PointAt( const Block &block ) const
+  {
+    for ( std::size_t page = 0; page < pageCount; ++page ) {
+      _pages[page] = block.data() + ( page * pageSize );
+    }
+  }
+
+  void EnsurePrivate()
+  {
+    if ( !_private ) {
+      _private = std::make_unique<Block>();
+    }
+  }
+
+  void Own( std::size_t page )
+  {
+    EnsurePrivate();
+    u8 *const dest = _private->data() + ( page * pageSize );
+    std::memcpy( dest, _pages[page], pageSize );
+    _pages[page] = dest;
+    _owned |= u64{ 1 } << page;
+  }
+
+  void OwnAll()
+  {
+    PointAt( *_private );
+    _owned = pageCount == 64 ? ~u64{ 0 } : ( u64{ 1 } << pageCount ) - 1;
+  }
+
+  // Freezing changes where pages live, not what they hold, so it's allowed on const memory
+  mutable std::shared_ptr<Block>            _base;
+  mutable std::array<const u8 *, pageCount> _pages{};
+  mutable u64                               _owned = 0;
+  std::unique_ptr<Block>                    _private;
+  mutable std::mutex                        _shareMutex; // guards freezing, see ShareFrom()
+};
+
+/*
+################################
+||        Field Copying       ||
+################################
+  Copies the fields a serialize() method lists from one object to another of the same type,
+  through plain assignment (which for CowMemory shares pages). Lets Bus::ForkFrom() reuse the
+  save state field lists instead of keeping a second copy of them.
+
+    FieldSource source;
+    const_cast<PPU &>( other ).serialize( source );
+    FieldTarget target( source );
+    serialize( target );
+*/
+class FieldSource
+{
+public:
+  template <class... Ts> void operator()( const Ts &...values ) { ( _fields.push_back( &values ), ... ); }
+
+private:
+  friend class FieldTarget;
+  std::vector<const void *> _fields;
+};
+
+class FieldTarget
+{
+public:
+  explicit FieldTarget( const FieldSource &source ) : _source( source ) {}
+
+  template <class... Ts> void operator()( Ts &...values ) { ( Assign( values ), ... ); }
+
+private:
+  template <class T> void Assign( T &value ) { value = *static_cast<const T *>( _source._fields.at( _next++ ) ); }
+
+  const FieldSource &_source;
+  std::size_t        _next = 0;
+};
+
+// Copy the serialized fields of from into to
+template <class T> void CopySerializedFields( T &to, const T &from )
+{
+  FieldSource source;
+  const_cast<T &>( from ).serialize( source ); // NOLINT, serialize() only reads through a FieldSource
+  FieldTarget target( source );
+  to.serialize( target );
+}
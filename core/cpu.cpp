@@ -7,7 +7,9 @@
 #include "cpu.h"
 #include "cpu-types.h"
 #include "global-types.h"
+#include "trace-writer.h"
 #include "utils.h"
+#include <fmt/format.h>
 #include <string>
 #include <stdexcept>
 
@@ -25,126 +27,29 @@ std::string CPU::LogLineAtPC( bool verbose ) // NOLINT
    * @brief Disassembles the instruction at the current program counter
    * Useful to understand what the current instruction is doing
    */
-  std::string output;
-
-  u8 const           opcode = Read( pc );
-  std::string const &name = gInstructionNames.at( opcode );
-  std::string const &addrMode = gAddressingModes.at( opcode );
-
-  // Program counter address
-  // i.e. FFFF
-  output += utils::toHex( pc, 4 ) + " ";
-
-  if ( verbose ) {
-    output += "  ";
-    // Hex instruction
-    // i.e. 4C F5 C5, this is the hex instruction
-    u8 const    bytes = gInstructionBytes.at( opcode );
-    std::string hexInstruction;
-    for ( u8 i = 0; i < bytes; i++ ) {
-      hexInstruction += utils::toHex( Read( pc + i ), 2 ) + ' ';
-    }
-
-    // formatting, the instruction hex_instruction will be 9 characters long, with space padding to
-    // the right. This makes sure the hex line is the same length for all instructions
-    hexInstruction += std::string( 9 - ( bytes * 3 ), ' ' );
-    output += hexInstruction;
-  }
-
-  // If name starts with a "*", it is an illegal opcode
-  ( name[0] == '*' ) ? output += "*" + name.substr( 1 ) + " " : output += name + " ";
-
-  // Addressing mode and operand
-
-  std::string assemblyStr;
-  u8          value = 0x00;
-  u8          low = 0x00;
-  u8          high = 0x00;
-  if ( addrMode == "IMP" ) {
-    // Nothing to prefix
-  } else if ( addrMode == "IMM" ) {
-    value = Read( pc + 1 );
-    assemblyStr += "#$" + utils::toHex( value, 2 );
-  } else if ( addrMode == "ZPG" || addrMode == "ZPGX" || addrMode == "ZPGY" ) {
-    value = Read( pc + 1 );
-    assemblyStr += "$" + utils::toHex( value, 2 );
-
-    ( addrMode == "ZPGX" ) ? assemblyStr += ", X" : ( addrMode == "ZPGY" ) ? assemblyStr += ", Y" : assemblyStr += "";
-  } else if ( addrMode == "ABS" || addrMode == "ABSX" || addrMode == "ABSY" ) {
-    low = Read( pc + 1 );
-    high = Read( pc + 2 );
-    u16 const address = ( high << 8 ) | low;
-
-    assemblyStr += "$" + utils::toHex( address, 4 );
-    ( addrMode == "ABSX" ) ? assemblyStr += ", X" : ( addrMode == "ABSY" ) ? assemblyStr += ", Y" : assemblyStr += "";
-  } else if ( addrMode == "IND" ) {
-    low = Read( pc + 1 );
-    high = Read( pc + 2 );
-    u16 const address = ( high << 8 ) | low;
-    assemblyStr += "($" + utils::toHex( address, 4 ) + ")";
-  } else if ( addrMode == "INDX" || addrMode == "INDY" ) {
-    value = Read( pc + 1 );
-    ( addrMode == "INDX" ) ? assemblyStr += "($" + utils::toHex( value, 2 ) + ", X)"
-                           : assemblyStr += "($" + utils::toHex( value, 2 ) + "), Y";
-  } else if ( addrMode == "REL" ) {
-    value = Read( pc + 1 );
-    s8 const  offset = static_cast<s8>( value );
-    u16 const address = pc + 2 + offset;
-
-    assemblyStr += "$" + utils::toHex( value, 2 ) + " [$" + utils::toHex( address, 4 ) + "]";
-  } else {
-    // Houston.. yet again
-    throw std::runtime_error( "Unknown addressing mode: " + addrMode );
-  }
-
-  // Pad the assembly string with spaces, for fixed length
-  if ( verbose ) {
-    output += assemblyStr + std::string( 15 - assemblyStr.size(), ' ' );
-  }
-
-  // Add more log info
-  std::string registersStr;
-  // Format
-  // a: 00 x: 00 y: 00 s: FD
-  registersStr += "a: " + utils::toHex( a, 2 ) + " ";
-  registersStr += "x: " + utils::toHex( x, 2 ) + " ";
-  registersStr += "y: " + utils::toHex( y, 2 ) + " ";
-  registersStr += "s: " + utils::toHex( s, 2 ) + " ";
-
-  // status register
-  // Will return a formatted status string
-  // p: hex value, status string (NV-BDIZC). Letter present is flag set, dash is flag unset
-  std::string statusStr;
-  statusStr += "p: " + utils::toHex( p, 2 ) + " ";
-
-  std::string statusFlags = "NV-BDIZC";
-  std::string statusFlagsLower = "nv--dizc";
-  std::string statusFlagsStr;
-  for ( int i = 7; i >= 0; i-- ) {
-    statusFlagsStr += ( p & ( 1 << i ) ) != 0 ? statusFlags[7 - i] : statusFlagsLower[7 - i];
-  }
-  statusStr += statusFlagsStr;
-
-  // Combine to the output string
-  output += registersStr + statusStr;
-
-  // Scanline num (V)
-  if ( verbose ) {
-    std::string const scanlineStr = std::to_string( bus->ppu.scanline );
-    // std::string scanlinestradjusted = std::string( 4 - scanlinestr.size(), ' ' );
-    output += "  V: " + scanlineStr;
-
-    // PPU cycles (H), pad for 3 characters + space
-    u16 const   ppuCycles = bus->ppu.cycle;
-    std::string ppuCyclesStr = std::to_string( ppuCycles );
-    ppuCyclesStr += std::string( 4 - ppuCyclesStr.size(), ' ' );
-    output += "  H: " + ppuCyclesStr; // PPU cycle
+  return FormatTraceLine( CaptureTrace( pc ), verbose );
+}
 
-    // cycle count
-    output += "  Cycle: " + std::to_string( cycles );
+TraceRecord CPU::CaptureTrace( u16 address ) const
+{
+  /*
+   * @brief Everything a trace line shows about the instruction at address, right now
+   */
+  TraceRecord record{ .cycle = cycles,
+                      .pc = address,
+                      .scanline = bus->ppu.scanline,
+                      .dot = bus->ppu.cycle,
+                      .a = a,
+                      .x = x,
+                      .y = y,
+                      .s = s,
+                      .p = GetStatusRegister() };
+  u8 const opcode = Read( address );
+  record.bytes[0] = opcode;
+  for ( u8 i = 1; i < gInstructionBytes.at( opcode ); i++ ) {
+    record.bytes.at( i ) = Read( address + i );
   }
-
-  return output;
+  return record;
 }
 
 /*
@@ -155,47 +60,71 @@ std::string CPU::LogLineAtPC( bool verbose ) // NOLINT
 ################################################################
 */
 
+void CPU::XXX( const u16 address ) // NOLINT
+{
+  (void) address;
+  bus->Log( fmt::format( "Unimplemented opcode: {:02X}", opcode ) );
+}
+
 // Pass off reads and writes to the bus
 auto CPU::Read( u16 address, bool debugMode ) const -> u8
 {
-  return bus->Read( address, debugMode );
+  return ( bus->*busRead )( address, debugMode );
 }
 void CPU::Write( u16 address, u8 data ) const
 {
-  bus->Write( address, data );
+  ( bus->*busWrite )( address, data );
+}
+
+template <class Policy> auto CPU::BusRead( u16 address ) const -> u8
+{
+  if constexpr ( Policy::watch ) {
+    return ( bus->*busRead )( address, false );
+  } else {
+    return bus->Read( address, false );
+  }
+}
+template <class Policy> void CPU::BusWrite( u16 address, u8 data ) const
+{
+  if constexpr ( Policy::watch ) {
+    ( bus->*busWrite )( address, data );
+  } else {
+    bus->Write( address, data );
+  }
 }
 
 // Read with cycle spend
-auto CPU::ReadByte( u16 address ) -> u8
+template <class Policy> auto CPU::ReadByte( u16 address ) -> u8
 {
   if ( address == 0x2002 ) {
     SetReading2002( true );
   }
   Tick();
-  u8 const data = Read( address );
+  u8 const data = BusRead<Policy>( address );
   return data;
 }
 
 // Write and spend a cycle
-auto CPU::WriteByte( u16 address, u8 data ) -> void
+template <class Policy> auto CPU::WriteByte( u16 address, u8 data ) -> void
 {
   Tick();
 
   // Writing to PPUCTRL, PPUMASK, PPUSCROLL, and PPUADDR is ignored until after cycle ~29658
-  if ( !bus->IsTestMode() && ( address == 0x2000 || address == 0x2001 || address == 0x2005 || address == 0x2006 ) ) {
-    if ( cycles < 29658 ) {
+  if constexpr ( Policy::ppuWarmup ) {
+    if ( cycles < ppuWarmupEnd &&
+         ( address == 0x2000 || address == 0x2001 || address == 0x2005 || address == 0x2006 ) ) {
       return;
     }
   }
-  Write( address, data );
+  BusWrite<Policy>( address, data );
 }
 
-u8 CPU::Fetch()
+template <class Policy> u8 CPU::Fetch()
 {
 
   // Read the current PC location and increment it
 
-  u8 const opcode = ReadByte( pc++ );
+  u8 const opcode = ReadByte<Policy>( pc++ );
   return opcode;
 }
 
@@ -205,35 +134,46 @@ void CPU::Tick()
   cycles++;
   bus->ppu.Tick();
   bus->ppu.Tick();
+  bus->ppu.Tick();
+}
+
+void CPU::TracedTick()
+{
+  cycles++;
+  bus->ppu.Tick();
+  bus->ppu.Tick();
 
   // Match mesen trace log, place logger here.
   if ( mesenFormatTraceEnabled && !didMesenTrace ) {
-    pc--;
-    AddMesenTracelog( LogLineAtPC( true ) );
-    pc++;
+    // pc is already past the opcode
+    TraceRecord const record = CaptureTrace( pc - 1 );
+    mesenFormatTraceLog.Push( record );
+    if ( traceWriter != nullptr ) {
+      traceWriter->Append( record );
+    }
     didMesenTrace = true;
   }
 
   bus->ppu.Tick();
 }
 
-void CPU::Reset()
+template <class Policy> void CPU::ResetSequence()
 {
   a = 0x00;
   x = 0x00;
   y = 0x00;
   s = 0xFD;
-  p = 0x00 | Unused;
+  SetStatusRegister( 0x00 | Unused );
 
   // The program counter is usually read from the reset vector of a game, which is
   // located at 0xFFFC and 0xFFFD. If no cartridge, we'll assume 0x00 for both
-  pc = Read( 0xFFFD ) << 8 | Read( 0xFFFC );
+  pc = BusRead<Policy>( 0xFFFD ) << 8 | BusRead<Policy>( 0xFFFC );
 
   // Add 7 cycles
-  if ( !bus->IsTestMode() ) {
+  if constexpr ( Policy::ppuWarmup ) {
 
     for ( u8 i = 0; i < 7; i++ ) {
-      Tick();
+      TracedTick();
     }
   } else {
     cycles = 0;
@@ -242,7 +182,40 @@ void CPU::Reset()
 
 void CPU::DecodeExecute()
 {
+  /**
+   * @brief Decode and execute an instruction, through the step variant SelectStep() picked
+   */
+  ( this->*stepFunction )();
+}
+
+void CPU::SelectStep()
+{
+  if ( bus != nullptr && bus->IsTestMode() ) {
+    UseStep<JsonTestStep>();
+  } else if ( traceEnabled || mesenFormatTraceEnabled ) {
+    UseStep<TraceStep>();
+  } else if ( bus != nullptr && bus->breakpoints.Armed() ) {
+    UseStep<BreakpointStep>();
+  } else {
+    UseStep<ProductionStep>();
+  }
+
+  bool const watchReads = bus != nullptr && bus->breakpoints.WatchesReads();
+  bool const watchWrites = bus != nullptr && bus->breakpoints.WatchesWrites();
+  busRead = watchReads ? &Bus::WatchedRead : &Bus::Read;
+  busWrite = watchWrites ? &Bus::WatchedWrite : &Bus::Write;
+}
+
+template <class Policy> void CPU::UseStep()
+{
+  stepFunction = &CPU::Step<Policy>;
+  resetFunction = &CPU::ResetSequence<Policy>;
+  nmiFunction = &CPU::NmiSequence<Policy>;
+  irqFunction = &CPU::IrqSequence<Policy>;
+}
 
+template <class Policy> void CPU::Step()
+{
   /**
    * @brief Decode and execute an instruction
    *
@@ -251,15 +224,31 @@ void CPU::DecodeExecute()
    *
    */
 
-  if ( traceEnabled ) {
-    AddTraceLog( LogLineAtPC( true ) );
+  if constexpr ( Policy::trace ) {
+    if ( traceEnabled ) {
+      TraceRecord const record = CaptureTrace( pc );
+      traceLog.Push( record );
+      if ( traceWriter != nullptr ) {
+        traceWriter->Append( record );
+      }
+    }
   }
 
   didMesenTrace = false;
 
-  // Fetch the next opcode and increment the program counter
-  opcode = Fetch();
-  auto const &instruction = opcodeTable.at( opcode );
+  // Fetch the next opcode and increment the program counter. The trace variant's fetch cycle
+  // writes the Mesen line, see TracedTick()
+  if constexpr ( Policy::trace ) {
+    u16 const address = pc++;
+    if ( address == 0x2002 ) {
+      SetReading2002( true );
+    }
+    TracedTick();
+    opcode = BusRead<Policy>( address );
+  } else {
+    opcode = Fetch<Policy>();
+  }
+  auto const &instruction = OpcodeTable<Policy>().at( opcode );
   auto        instructionHandler = instruction.handler;
   auto        addressingModeHandler = instruction.addrMode;
 
@@ -287,3 +276,66 @@ void CPU::DecodeExecute()
   writeModify = false;
   didMesenTrace = false;
 }
+
+template void CPU::Step<ProductionStep>();
+template void CPU::Step<TraceStep>();
+template void CPU::Step<JsonTestStep>();
+template void CPU::Step<BreakpointStep>();
+
+template <class Policy> const std::array<CPU::Instruction, 256> &CPU::OpcodeTable()
+{
+  // clang-format off
+#define Imp( op )  Instruction { &CPU::op<Policy>, &CPU::IMP<Policy> }
+#define Imm( op )  Instruction { &CPU::op<Policy>, &CPU::IMM<Policy> }
+#define Zpg( op )  Instruction { &CPU::op<Policy>, &CPU::ZPG<Policy> }
+#define ZpgX( op ) Instruction { &CPU::op<Policy>, &CPU::ZPGX<Policy> }
+#define ZpgY( op ) Instruction { &CPU::op<Policy>, &CPU::ZPGY<Policy> }
+#define Abs( op )  Instruction { &CPU::op<Policy>, &CPU::ABS<Policy> }
+#define AbsX( op ) Instruction { &CPU::op<Policy>, &CPU::ABSX<Policy> }
+#define AbsY( op ) Instruction { &CPU::op<Policy>, &CPU::ABSY<Policy> }
+#define Ind( op )  Instruction { &CPU::op<Policy>, &CPU::IND<Policy> }
+#define IndX( op ) Instruction { &CPU::op<Policy>, &CPU::INDX<Policy> }
+#define IndY( op ) Instruction { &CPU::op<Policy>, &CPU::INDY<Policy> }
+#define Rel( op )  Instruction { &CPU::op<Policy>, &CPU::REL<Policy> }
+
+  static const std::array<Instruction, 256> table = {
+          //0        1          2          3          4           5          6          7          8         9          A         B          C           D          E          F
+    /*0*/ Imp(BRK),  IndX(ORA), Imp(JAM),  IndX(SLO), Zpg(NOP2),  Zpg(ORA),  Zpg(ASL),  Zpg(SLO),  Imp(PHP), Imm(ORA),  Imp(ASL), Imm(ANC),  Abs(NOP2),  Abs(ORA),  Abs(ASL),  Abs(SLO),
+    /*1*/ Rel(BPL),  IndY(ORA), Imp(JAM),  IndY(SLO), ZpgX(NOP2), ZpgX(ORA), ZpgX(ASL), ZpgX(SLO), Imp(CLC), AbsY(ORA), Imp(NOP), AbsY(SLO), AbsX(NOP2), AbsX(ORA), AbsX(ASL), AbsX(SLO),
+    /*2*/ Abs(JSR),  IndX(AND), Imp(JAM),  IndX(RLA), Zpg(BIT),   Zpg(AND),  Zpg(ROL),  Zpg(RLA),  Imp(PLP), Imm(AND),  Imp(ROL), Imm(ANC),  Abs(BIT),   Abs(AND),  Abs(ROL),  Abs(RLA),
+    /*3*/ Rel(BMI),  IndY(AND), Imp(JAM),  IndY(RLA), ZpgX(NOP2), ZpgX(AND), ZpgX(ROL), ZpgX(RLA), Imp(SEC), AbsY(AND), Imp(NOP), AbsY(RLA), AbsX(NOP2), AbsX(AND), AbsX(ROL), AbsX(RLA),
+    /*4*/ Imp(RTI),  IndX(EOR), Imp(JAM),  IndX(SRE), Zpg(NOP2),  Zpg(EOR),  Zpg(LSR),  Zpg(SRE),  Imp(PHA), Imm(EOR),  Imp(LSR), Imm(ALR),  Abs(JMP),   Abs(EOR),  Abs(LSR),  Abs(SRE),
+    /*5*/ Rel(BVC),  IndY(EOR), Imp(JAM),  IndY(SRE), ZpgX(NOP2), ZpgX(EOR), ZpgX(LSR), ZpgX(SRE), Imp(CLI), AbsY(EOR), Imp(NOP), AbsY(SRE), AbsX(NOP2), AbsX(EOR), AbsX(LSR), AbsX(SRE),
+    /*6*/ Imp(RTS),  IndX(ADC), Imp(JAM),  IndX(RRA), Zpg(NOP2),  Zpg(ADC),  Zpg(ROR),  Zpg(RRA),  Imp(PLA), Imm(ADC),  Imp(ROR), Imm(ARR),  Ind(JMP),   Abs(ADC),  Abs(ROR),  Abs(RRA),
+    /*7*/ Rel(BVS),  IndY(ADC), Imp(JAM),  IndY(RRA), ZpgX(NOP2), ZpgX(ADC), ZpgX(ROR), ZpgX(RRA), Imp(SEI), AbsY(ADC), Imp(NOP), AbsY(RRA), AbsX(NOP2), AbsX(ADC), AbsX(ROR), AbsX(RRA),
+    /*8*/ Imm(NOP2), IndX(STA), Imm(NOP2), IndX(SAX), Zpg(STY),   Zpg(STA),  Zpg(STX),  Zpg(SAX),  Imp(DEY), Imm(NOP2), Imp(TXA), Imm(ANE), Abs(STY),   Abs(STA),  Abs(STX),  Abs(SAX),
+    /*9*/ Rel(BCC),  IndY(STA), Imp(JAM),  IndY(SHA), ZpgX(STY),  ZpgX(STA), ZpgY(STX), ZpgY(SAX), Imp(TYA), AbsY(STA), Imp(TXS), AbsY(TAS), AbsX(SHY),  AbsX(STA), AbsY(SHX), AbsY(SHA),
+    /*A*/ Imm(LDY),  IndX(LDA), Imm(LDX),  IndX(LAX), Zpg(LDY),   Zpg(LDA),  Zpg(LDX),  Zpg(LAX),  Imp(TAY), Imm(LDA),  Imp(TAX), Imm(ATX),  Abs(LDY),   Abs(LDA),  Abs(LDX),  Abs(LAX),
+    /*B*/ Rel(BCS),  IndY(LDA), Imp(JAM),  IndY(LAX), ZpgX(LDY),  ZpgX(LDA), ZpgY(LDX), ZpgY(LAX), Imp(CLV), AbsY(LDA), Imp(TSX), AbsY(LAS), AbsX(LDY),  AbsX(LDA), AbsY(LDX), AbsY(LAX),
+    /*C*/ Imm(CPY),  IndX(CMP), Imm(NOP2), IndX(DCP), Zpg(CPY),   Zpg(CMP),  Zpg(DEC),  Zpg(DCP),  Imp(INY), Imm(CMP),  Imp(DEX), Imm(SBX),  Abs(CPY),   Abs(CMP),  Abs(DEC),  Abs(DCP),
+    /*D*/ Rel(BNE),  IndY(CMP), Imp(JAM),  IndY(DCP), ZpgX(NOP2), ZpgX(CMP), ZpgX(DEC), ZpgX(DCP), Imp(CLD), AbsY(CMP), Imp(NOP), AbsY(DCP), AbsX(NOP2), AbsX(CMP), AbsX(DEC), AbsX(DCP),
+    /*E*/ Imm(CPX),  IndX(SBC), Imm(NOP2), IndX(ISC), Zpg(CPX),   Zpg(SBC),  Zpg(INC),  Zpg(ISC),  Imp(INX), Imm(SBC),  Imp(NOP), Imm(SBC),  Abs(CPX),   Abs(SBC),  Abs(INC),  Abs(ISC),
+    /*F*/ Rel(BEQ),  IndY(SBC), Imp(JAM),  IndY(ISC), ZpgX(NOP2), ZpgX(SBC), ZpgX(INC), ZpgX(ISC), Imp(SED), AbsY(SBC), Imp(NOP), AbsY(ISC), AbsX(NOP2), AbsX(SBC), AbsX(INC), AbsX(ISC)
+  };
+  // clang-format on
+#undef Imp
+#undef Imm
+#undef Zpg
+#undef ZpgX
+#undef ZpgY
+#undef Abs
+#undef AbsX
+#undef AbsY
+#undef Ind
+#undef IndX
+#undef IndY
+#undef Rel
+  return table;
+}
+
+// Used outside this file: the block cache and idle loop skipper replay production handlers
+// outside of Step(), and a new CPU points at the production variant before any SelectStep()
+template const std::array<CPU::Instruction, 256> &CPU::OpcodeTable<ProductionStep>();
+template auto CPU::ReadByte<ProductionStep>( u16 address ) -> u8;
+template auto CPU::WriteByte<ProductionStep>( u16 address, u8 data ) -> void;
+template void CPU::ResetSequence<ProductionStep>();
@@ -3,60 +3,71 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
-#include <fmt/base.h>
 #include <string>
 #include "global-types.h"
+#include "trace-ring.h"
 // NOLINTBEGIN
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/string.hpp>
-#include <cereal/types/deque.hpp>
 // NOLINTEND
 
 // Forward declaration for reads and writes
 class Bus;
+class TraceWriter;
+
+/*
+################################
+||        Step Variants       ||
+################################
+  DecodeExecute() runs one of four compile-time variants of the instruction step, picked by
+  SelectStep() whenever tracing, breakpoints or the JSON test mode are switched:
+
+  - ProductionStep: no trace checks anywhere, and bus accesses call Bus::Read() / Write() directly
+  - TraceStep: writes the trace log line before each instruction, and the Mesen trace line on the
+    opcode fetch cycle
+  - JsonTestStep: the trace step without the power-on timing (the 7 reset cycles and the PPU
+    register warm-up), the flat memory tests expect neither
+  - BreakpointStep: the production step with watchable bus accesses, under another name so the
+    block cache and idle loop skipper stand aside while breakpoints are armed
+
+  The policy is a template parameter of every instruction handler, addressing mode and memory
+  access down to BusRead() / BusWrite(), and each variant has its own opcode table, so a variant
+  compiles out the checks it doesn't need. Reset(), NMI() and IRQ() go through the selected
+  variant too.
+
+  Watchable variants reach the bus through pointers SelectStep() aims at Bus::WatchedRead() /
+  WatchedWrite() while watchpoints need them, and at Bus::Read() / Write() otherwise. Watchpoints
+  arm the breakpoints, so the production variant never needs them.
+
+  The Mesen line can only be due on the first cycle of an instruction, interrupt or DMA step, so
+  the Tick() that instructions run on carries no trace check; entry points that may be first use
+  TracedTick().
+*/
+struct ProductionStep {
+  static constexpr bool trace = false;
+  static constexpr bool ppuWarmup = true;
+  static constexpr bool watch = false;
+};
+struct TraceStep {
+  static constexpr bool trace = true;
+  static constexpr bool ppuWarmup = true;
+  static constexpr bool watch = true;
+};
+struct JsonTestStep {
+  static constexpr bool trace = true;
+  static constexpr bool ppuWarmup = false;
+  static constexpr bool watch = true;
+};
+struct BreakpointStep {
+  static constexpr bool trace = false;
+  static constexpr bool ppuWarmup = true;
+  static constexpr bool watch = true;
+};
 
 class CPU
 {
 public:
-  explicit CPU( Bus *bus ) : bus( bus )
-  {
-
-    // clang-format off
-#define Imp( op )  Instruction { &CPU::op, &CPU::IMP }
-#define Imm( op )  Instruction { &CPU::op, &CPU::IMM }
-#define Zpg( op )  Instruction { &CPU::op, &CPU::ZPG }
-#define ZpgX( op ) Instruction { &CPU::op, &CPU::ZPGX }
-#define ZpgY( op ) Instruction { &CPU::op, &CPU::ZPGY }
-#define Abs( op )  Instruction { &CPU::op, &CPU::ABS }
-#define AbsX( op ) Instruction { &CPU::op, &CPU::ABSX }
-#define AbsY( op ) Instruction { &CPU::op, &CPU::ABSY }
-#define Ind( op )  Instruction { &CPU::op, &CPU::IND }
-#define IndX( op ) Instruction { &CPU::op, &CPU::INDX }
-#define IndY( op ) Instruction { &CPU::op, &CPU::INDY }
-#define Rel( op )  Instruction { &CPU::op, &CPU::REL }
-
-        opcodeTable = {
-          //0        1          2          3          4           5          6          7          8         9          A         B          C           D          E          F
-    /*0*/ Imp(BRK),  IndX(ORA), Imp(JAM),  IndX(SLO), Zpg(NOP2),  Zpg(ORA),  Zpg(ASL),  Zpg(SLO),  Imp(PHP), Imm(ORA),  Imp(ASL), Imm(ANC),  Abs(NOP2),  Abs(ORA),  Abs(ASL),  Abs(SLO),
-    /*1*/ Rel(BPL),  IndY(ORA), Imp(JAM),  IndY(SLO), ZpgX(NOP2), ZpgX(ORA), ZpgX(ASL), ZpgX(SLO), Imp(CLC), AbsY(ORA), Imp(NOP), AbsY(SLO), AbsX(NOP2), AbsX(ORA), AbsX(ASL), AbsX(SLO),
-    /*2*/ Abs(JSR),  IndX(AND), Imp(JAM),  IndX(RLA), Zpg(BIT),   Zpg(AND),  Zpg(ROL),  Zpg(RLA),  Imp(PLP), Imm(AND),  Imp(ROL), Imm(ANC),  Abs(BIT),   Abs(AND),  Abs(ROL),  Abs(RLA),
-    /*3*/ Rel(BMI),  IndY(AND), Imp(JAM),  IndY(RLA), ZpgX(NOP2), ZpgX(AND), ZpgX(ROL), ZpgX(RLA), Imp(SEC), AbsY(AND), Imp(NOP), AbsY(RLA), AbsX(NOP2), AbsX(AND), AbsX(ROL), AbsX(RLA),
-    /*4*/ Imp(RTI),  IndX(EOR), Imp(JAM),  IndX(SRE), Zpg(NOP2),  Zpg(EOR),  Zpg(LSR),  Zpg(SRE),  Imp(PHA), Imm(EOR),  Imp(LSR), Imm(ALR),  Abs(JMP),   Abs(EOR),  Abs(LSR),  Abs(SRE),
-    /*5*/ Rel(BVC),  IndY(EOR), Imp(JAM),  IndY(SRE), ZpgX(NOP2), ZpgX(EOR), ZpgX(LSR), ZpgX(SRE), Imp(CLI), AbsY(EOR), Imp(NOP), AbsY(SRE), AbsX(NOP2), AbsX(EOR), AbsX(LSR), AbsX(SRE),
-    /*6*/ Imp(RTS),  IndX(ADC), Imp(JAM),  IndX(RRA), Zpg(NOP2),  Zpg(ADC),  Zpg(ROR),  Zpg(RRA),  Imp(PLA), Imm(ADC),  Imp(ROR), Imm(ARR),  Ind(JMP),   Abs(ADC),  Abs(ROR),  Abs(RRA),
-    /*7*/ Rel(BVS),  IndY(ADC), Imp(JAM),  IndY(RRA), ZpgX(NOP2), ZpgX(ADC), ZpgX(ROR), ZpgX(RRA), Imp(SEI), AbsY(ADC), Imp(NOP), AbsY(RRA), AbsX(NOP2), AbsX(ADC), AbsX(ROR), AbsX(RRA),
-    /*8*/ Imm(NOP2), IndX(STA), Imm(NOP2), IndX(SAX), Zpg(STY),   Zpg(STA),  Zpg(STX),  Zpg(SAX),  Imp(DEY), Imm(NOP2), Imp(TXA), Imm(ANE), Abs(STY),   Abs(STA),  Abs(STX),  Abs(SAX),
-    /*9*/ Rel(BCC),  IndY(STA), Imp(JAM),  IndY(SHA), ZpgX(STY),  ZpgX(STA), ZpgY(STX), ZpgY(SAX), Imp(TYA), AbsY(STA), Imp(TXS), AbsY(TAS), AbsX(SHY),  AbsX(STA), AbsY(SHX), AbsY(SHA),
-    /*A*/ Imm(LDY),  IndX(LDA), Imm(LDX),  IndX(LAX), Zpg(LDY),   Zpg(LDA),  Zpg(LDX),  Zpg(LAX),  Imp(TAY), Imm(LDA),  Imp(TAX), Imm(ATX),  Abs(LDY),   Abs(LDA),  Abs(LDX),  Abs(LAX),
-    /*B*/ Rel(BCS),  IndY(LDA), Imp(JAM),  IndY(LAX), ZpgX(LDY),  ZpgX(LDA), ZpgY(LDX), ZpgY(LAX), Imp(CLV), AbsY(LDA), Imp(TSX), AbsY(LAS), AbsX(LDY),  AbsX(LDA), AbsY(LDX), AbsY(LAX),
-    /*C*/ Imm(CPY),  IndX(CMP), Imm(NOP2), IndX(DCP), Zpg(CPY),   Zpg(CMP),  Zpg(DEC),  Zpg(DCP),  Imp(INY), Imm(CMP),  Imp(DEX), Imm(SBX),  Abs(CPY),   Abs(CMP),  Abs(DEC),  Abs(DCP),
-    /*D*/ Rel(BNE),  IndY(CMP), Imp(JAM),  IndY(DCP), ZpgX(NOP2), ZpgX(CMP), ZpgX(DEC), ZpgX(DCP), Imp(CLD), AbsY(CMP), Imp(NOP), AbsY(DCP), AbsX(NOP2), AbsX(CMP), AbsX(DEC), AbsX(DCP),
-    /*E*/ Imm(CPX),  IndX(SBC), Imm(NOP2), IndX(ISC), Zpg(CPX),   Zpg(SBC),  Zpg(INC),  Zpg(ISC),  Imp(INX), Imm(SBC),  Imp(NOP), Imm(SBC),  Abs(CPX),   Abs(SBC),  Abs(INC),  Abs(ISC),
-    /*F*/ Rel(BEQ),  IndY(SBC), Imp(JAM),  IndY(ISC), ZpgX(NOP2), ZpgX(SBC), ZpgX(INC), ZpgX(ISC), Imp(SED), AbsY(SBC), Imp(NOP), AbsY(ISC), AbsX(NOP2), AbsX(SBC), AbsX(INC), AbsX(ISC)
-        };
-    // clang-format on
-  }
+  explicit CPU( Bus *bus ) : bus( bus ) {}
 
   /*
   ################################
@@ -65,8 +76,9 @@ public:
   */
   template <class Archive> void serialize( Archive &ar ) // NOLINT
   {
-    ar( pc, a, x, y, s, p, cycles, didVblank, pageCrossPenalty, writeModify, reading2002, instructionName, addrMode,
-        opcode, isTestMode, traceEnabled, mesenFormatTraceEnabled, didMesenTrace, traceLog, mesenFormatTraceLog );
+    ar( pc, a, x, y, s, p, nzResult, nzPending, cycles, didVblank, pageCrossPenalty, writeModify, reading2002,
+        instructionName, addrMode, opcode, isTestMode, traceEnabled, mesenFormatTraceEnabled, didMesenTrace );
+    SelectStep();
   }
 
   /*
@@ -77,7 +89,13 @@ public:
   u8   GetAccumulator() const { return a; }
   u8   GetXRegister() const { return x; }
   u8   GetYRegister() const { return y; }
-  u8   GetStatusRegister() const { return p; }
+  u8   GetStatusRegister() const
+  {
+    if ( !nzPending ) {
+      return p;
+    }
+    return ( p & ~( Zero | Negative ) ) | ( nzResult & Negative ) | ( nzResult == 0 ? Zero : 0 );
+  }
   u16  GetProgramCounter() const { return pc; }
   u8   GetStackPointer() const { return s; }
   u64  GetCycles() const { return cycles; }
@@ -85,12 +103,12 @@ public:
 
   // status getters
   u8 GetCarryFlag() const { return ( p & Carry ) >> 0; }
-  u8 GetZeroFlag() const { return ( p & Zero ) >> 1; }
+  u8 GetZeroFlag() const { return ( GetStatusRegister() & Zero ) >> 1; }
   u8 GetInterruptDisableFlag() const { return ( p & InterruptDisable ) >> 2; }
   u8 GetDecimalFlag() const { return ( p & Decimal ) >> 3; }
   u8 GetBreakFlag() const { return ( p & Break ) >> 4; }
   u8 GetOverflowFlag() const { return ( p & Overflow ) >> 6; }
-  u8 GetNegativeFlag() const { return ( p & Negative ) >> 7; }
+  u8 GetNegativeFlag() const { return ( GetStatusRegister() & Negative ) >> 7; }
 
   /*
   ################################
@@ -100,7 +118,11 @@ public:
   void SetAccumulator( u8 value ) { a = value; }
   void SetXRegister( u8 value ) { x = value; }
   void SetYRegister( u8 value ) { y = value; }
-  void SetStatusRegister( u8 value ) { p = value; }
+  void SetStatusRegister( u8 value )
+  {
+    p = value;
+    nzPending = false;
+  }
   void SetProgramCounter( u16 value ) { pc = value; }
   void SetStackPointer( u8 value ) { s = value; }
   void SetCycles( u64 value ) { cycles = value; }
@@ -120,47 +142,57 @@ public:
   ||         CPU Methods        ||
   ################################
   */
-  void Reset();
-  u8   Fetch();
+  void Reset() { ( this->*resetFunction )(); }
+  void NMI() { ( this->*nmiFunction )(); }
+  void IRQ() { ( this->*irqFunction )(); }
   void DecodeExecute();
   void Tick();
+  void TracedTick();
+
+  // Debugger, tool and test access, through whatever Bus function SelectStep() picked
   auto Read( u16 address, bool debugMode = false ) const -> u8;
-  auto ReadByte( u16 address ) -> u8;
   void Write( u16 address, u8 data ) const;
-  void WriteByte( u16 address, u8 data );
 
-  void NMI()
+  // The variants' own accesses. The Byte versions spend a cycle.
+  template <class Policy> auto BusRead( u16 address ) const -> u8;
+  template <class Policy> void BusWrite( u16 address, u8 data ) const;
+  template <class Policy> auto ReadByte( u16 address ) -> u8;
+  template <class Policy> void WriteByte( u16 address, u8 data );
+  template <class Policy> u8   Fetch();
+  template <class Policy> void ResetSequence();
+
+  template <class Policy> void NmiSequence()
   {
     /* @details: Non-maskable Interrupt, called by the PPU during the VBlank period.
      * It interrupts whatever the CPU is doing at its current cycle to go update the PPU.
      * Uses 7 cycles, cannot be disabled.
      */
     // 1) Two dummy cycles (hardware reads the same PC twice, discarding the data)
-    Tick();
+    TracedTick();
     Tick();
 
     // 2) Push PC high, then PC low
-    StackPush( ( pc >> 8 ) & 0xFF );
-    StackPush( pc & 0xFF );
+    StackPush<Policy>( ( pc >> 8 ) & 0xFF );
+    StackPush<Policy>( pc & 0xFF );
 
     // 3) Push status register with B=0; bit 5 (Unused) = 1
-    u8 const pushedStatus = ( p & ~Break ) | Unused;
-    StackPush( pushedStatus );
+    u8 const pushedStatus = ( GetStatusRegister() & ~Break ) | Unused;
+    StackPush<Policy>( pushedStatus );
 
     // 4) Fetch low byte of NMI vector ($FFFA)
-    u8 const low = ReadByte( 0xFFFA );
+    u8 const low = ReadByte<Policy>( 0xFFFA );
 
     // 5) Set I flag
     SetFlags( InterruptDisable );
 
     // 6) Fetch high byte of NMI vector ($FFFB)
-    u8 const high = ReadByte( 0xFFFB );
+    u8 const high = ReadByte<Policy>( 0xFFFB );
 
     // 7) Update PC
     pc = static_cast<u16>( high ) << 8 | low;
   }
 
-  void IRQ()
+  template <class Policy> void IrqSequence()
   {
     /* @brief: IRQ, can be called when interrupt disable is turned off.
      * Uses 7 cycles
@@ -168,15 +200,15 @@ public:
     if ( ( p & InterruptDisable ) != 0 ) {
       return;
     }
+    TracedTick();
     Tick();
-    Tick();
-    StackPush( ( pc >> 8 ) & 0xFF );
-    StackPush( pc & 0xFF );
-    u8 const pushedStatus = ( p & ~Break ) | Unused;
-    StackPush( pushedStatus );
-    u8 const low = ReadByte( 0xFFFE );
+    StackPush<Policy>( ( pc >> 8 ) & 0xFF );
+    StackPush<Policy>( pc & 0xFF );
+    u8 const pushedStatus = ( GetStatusRegister() & ~Break ) | Unused;
+    StackPush<Policy>( pushedStatus );
+    u8 const low = ReadByte<Policy>( 0xFFFE );
     SetFlags( InterruptDisable );
-    u8 const high = ReadByte( 0xFFFF );
+    u8 const high = ReadByte<Policy>( 0xFFFF );
     pc = static_cast<u16>( high ) << 8 | low;
   }
 
@@ -186,46 +218,39 @@ public:
   ################################
   */
   std::string             LogLineAtPC( bool verbose = true );
-  std::deque<std::string> GetTracelog() const { return traceLog; }
-  std::deque<std::string> GetMesenFormatTracelog() const { return mesenFormatTraceLog; }
+  TraceRecord             CaptureTrace( u16 address ) const;
+  const TraceRing        &GetTracelog() const { return traceLog; }
+  const TraceRing        &GetMesenFormatTracelog() const { return mesenFormatTraceLog; }
   void                    EnableTracelog()
   {
     traceEnabled = true;
     mesenFormatTraceEnabled = false;
+    SelectStep();
   }
   void EnableMesenFormatTraceLog()
   {
     mesenFormatTraceEnabled = true;
     traceEnabled = false;
+    SelectStep();
   }
-  void DisableTracelog() { traceEnabled = false; }
-  void DisableMesenFormatTraceLog() { mesenFormatTraceEnabled = false; }
-  void EnableJsonTestMode() { isTestMode = true; }
-  void DisableJsonTestMode() { isTestMode = false; }
-
-  size_t traceSize = 100;
-  size_t mesenTraceSize = 100;
-  void   SetMesenTraceSize( int size ) { mesenTraceSize = size; }
-  void   AddTraceLog( const std::string &log )
+  void DisableTracelog()
   {
-    if ( traceEnabled ) {
-      traceLog.push_back( log + "\n" );
-      if ( traceLog.size() > traceSize ) {
-        traceLog.pop_front();
-      }
-    }
+    traceEnabled = false;
+    SelectStep();
   }
-  void ClearTraceLog() { traceLog.clear(); }
-  void AddMesenTracelog( const std::string &log )
+  void DisableMesenFormatTraceLog()
   {
-    if ( mesenFormatTraceEnabled ) {
-      mesenFormatTraceLog.push_back( log + "\n" );
-      if ( mesenFormatTraceLog.size() > mesenTraceSize ) {
-        mesenFormatTraceLog.pop_front();
-      }
-    }
+    mesenFormatTraceEnabled = false;
+    SelectStep();
   }
-  void ClearMesenTraceLog() { mesenFormatTraceLog.clear(); }
+  void EnableJsonTestMode() { isTestMode = true; }
+  void DisableJsonTestMode() { isTestMode = false; }
+
+  // Lines kept by each trace log, the oldest go first
+  void SetTraceSize( std::size_t size ) { traceLog.SetCapacity( size ); }
+  void SetMesenTraceSize( std::size_t size ) { mesenFormatTraceLog.SetCapacity( size ); }
+  void ClearTraceLog() { traceLog.Clear(); }
+  void ClearMesenTraceLog() { mesenFormatTraceLog.Clear(); }
 
   /*
   ################################
@@ -263,6 +288,12 @@ public:
   u8  p = 0x00 | Unused; // Status register (P), per the specs, the unused flag should always be set
   u64 cycles = 0;        // Number of cycles
 
+  // Lazy N and Z flags. Most instructions set them and the next one overwrites them unread, so
+  // SetZeroAndNegativeFlags() only records the result. While nzPending is set, N and Z in p are
+  // stale and come from nzResult instead; GetStatusRegister() has the real value.
+  u8   nzResult = 0;
+  bool nzPending = false;
+
   /*
   ################################
   ||  Private Global Variables  ||
@@ -286,8 +317,35 @@ public:
   bool mesenFormatTraceEnabled = false;
   bool didMesenTrace = false;
 
-  std::deque<std::string> traceLog;
-  std::deque<std::string> mesenFormatTraceLog;
+  TraceRing traceLog;
+  TraceRing mesenFormatTraceLog;
+
+  // Also receives every record of whichever trace log is enabled, not owned
+  TraceWriter *traceWriter = nullptr;
+
+  // Where Read() and Write() go, see Step Variants
+  u8 ( Bus::*busRead )( u16, bool ) = nullptr;
+  void ( Bus::*busWrite )( u16, u8 ) = nullptr;
+
+  /*
+  ################################
+  ||         Step Variant       ||
+  ################################
+  */
+  // Points DecodeExecute() at the variant for the current trace and test settings, see Step Variants
+  void SelectStep();
+  // The block cache and idle loop skipper replay instructions themselves, only in production
+  [[nodiscard]] bool UsesProductionStep() const { return stepFunction == &CPU::Step<ProductionStep>; }
+
+  template <class Policy> void Step();
+  template <class Policy> void UseStep();
+
+  // With Policy::ppuWarmup, writes to PPUCTRL, PPUMASK, PPUSCROLL and PPUADDR before this are ignored
+  static constexpr u64 ppuWarmupEnd = 29658;
+  void ( CPU::*stepFunction )() = &CPU::Step<ProductionStep>;
+  void ( CPU::*resetFunction )() = &CPU::ResetSequence<ProductionStep>;
+  void ( CPU::*nmiFunction )() = &CPU::NmiSequence<ProductionStep>;
+  void ( CPU::*irqFunction )() = &CPU::IrqSequence<ProductionStep>;
 
   /*
   ################################
@@ -299,9 +357,9 @@ public:
     u16 ( CPU::*addrMode )(){};      // Pointer to the address mode helper method
   };
 
-  // Opcode table
-  std::array<Instruction, 256> opcodeTable;
-  Instruction                  GetInstruction( u8 opcode ) { return opcodeTable[opcode]; }
+  // One opcode table per step variant. The block cache and idle loop skipper use the production one.
+  template <class Policy> static const std::array<Instruction, 256> &OpcodeTable();
+  Instruction GetInstruction( u8 opcode ) { return OpcodeTable<ProductionStep>()[opcode]; }
 
   /*
   ################################################################
@@ -311,26 +369,26 @@ public:
   ################################################################
   */
 
-  void LoadRegister( u16 address, u8 &reg )
+  template <class Policy> void LoadRegister( u16 address, u8 &reg )
   {
     /*
      * @brief It loads a register with a value from memory
      * Used by LDA, LDX, and LDY instructions
      */
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     reg = value;
 
     // Set zero and negative flags
     SetZeroAndNegativeFlags( value );
   };
 
-  void StoreRegister( u16 address, u8 reg )
+  template <class Policy> void StoreRegister( u16 address, u8 reg )
   {
     /*
      * @brief It stores a register value in memory
      * Used by STA, STX, and STY instructions
      */
-    WriteByte( address, reg );
+    WriteByte<Policy>( address, reg );
   };
 
   void SetFlags( const u8 flag )
@@ -345,6 +403,9 @@ public:
      * SetFlags( Status::Carry ); // Set one flag
      * SetFlags( Status::Carry | Status::Zero ); // Set multiple flags
      */
+    if ( ( flag & ( Zero | Negative ) ) != 0 ) {
+      ResolveFlags();
+    }
     p |= flag;
   }
   void ClearFlags( const u8 flag )
@@ -360,6 +421,9 @@ public:
      * ClearFlags( Status::Carry ); // Clear one flag
      * ClearFlags( Status::Carry | Status::Zero ); // Clear multiple flags
      */
+    if ( ( flag & ( Zero | Negative ) ) != 0 ) {
+      ResolveFlags();
+    }
     p &= ~flag;
   }
   bool IsFlagSet( const u8 flag ) const
@@ -376,7 +440,15 @@ public:
      *   // Do something
      * }
      */
-    return ( p & flag ) == flag;
+    return ( GetStatusRegister() & flag ) == flag;
+  }
+
+  void ResolveFlags()
+  {
+    /* @brief Writes pending N and Z flags into p, for code about to change them directly
+     */
+    p = GetStatusRegister();
+    nzPending = false;
   }
 
   void SetZeroAndNegativeFlags( u8 value )
@@ -385,18 +457,9 @@ public:
      * @brief Sets zero flag if value == 0, or negative flag if value is negative (bit 7 is set)
      */
 
-    // Clear zero and negative flags
-    ClearFlags( Status::Zero | Status::Negative );
-
-    // Set zero flag if value is zero
-    if ( value == 0 ) {
-      SetFlags( Status::Zero );
-    }
-
-    // Set negative flag if bit 7 is set
-    if ( ( value & 0b10000000 ) != 0 ) {
-      SetFlags( Status::Negative );
-    }
+    // Evaluated when something reads them, see nzResult
+    nzResult = value;
+    nzPending = true;
   }
 
   void BranchOnStatus( u16 offsetAddress, u8 flag, bool isSet )
@@ -410,7 +473,7 @@ public:
      * BranchOnStatus( Status::Zero, false ); // Branch if zero flag is clear
      */
 
-    bool const willBranch = ( p & flag ) == flag;
+    bool const willBranch = IsFlagSet( flag );
 
     // Path will branch
     if ( willBranch == isSet ) {
@@ -431,7 +494,7 @@ public:
     // Path will not branch, nothing to do
   }
 
-  void CompareAddressWithRegister( u16 address, u8 reg )
+  template <class Policy> void CompareAddressWithRegister( u16 address, u8 reg )
   {
     /*
      * @brief Compare a value in memory with a register
@@ -440,9 +503,9 @@ public:
 
     u8 value = 0;
     if ( instructionName == "*DCP" ) {
-      value = Read( address ); // 0 cycles
+      value = BusRead<Policy>( address ); // 0 cycles
     } else {
-      value = ReadByte( address );
+      value = ReadByte<Policy>( address );
     }
 
     // Set the zero flag if the values are equal
@@ -456,24 +519,24 @@ public:
     ( reg >= value ) ? SetFlags( Status::Carry ) : ClearFlags( Status::Carry );
   }
 
-  void StackPush( u8 value )
+  template <class Policy> void StackPush( u8 value )
   {
     /*
      * @brief Push a value onto the stack
      * The stack pointer is decremented and the value is written to the stack
      * Stack addresses are between 0x0100 and 0x01FF
      */
-    WriteByte( 0x0100 + s--, value );
+    WriteByte<Policy>( 0x0100 + s--, value );
   }
 
-  u8 StackPop()
+  template <class Policy> u8 StackPop()
   {
     /*
      * @brief Pop a value from the stack
      * The stack pointer is incremented and the value is read from the stack
      * Stack addresses are between 0x0100 and 0x01FF
      */
-    return ReadByte( 0x0100 + ++s );
+    return ReadByte<Policy>( 0x0100 + ++s );
   }
 
   /*
@@ -484,7 +547,7 @@ public:
   ################################################################
   */
 
-  auto IMP() -> u16
+  template <class Policy> auto IMP() -> u16
   {
     /*
      * @brief Implicit addressing mode
@@ -494,7 +557,7 @@ public:
     return 0;
   }
 
-  auto IMM() -> u16
+  template <class Policy> auto IMM() -> u16
   {
     /*
      * @brief Returns address of the next byte in memory (the operand itself)
@@ -504,160 +567,190 @@ public:
     return pc++;
   }
 
-  auto ZPG() -> u16
+  template <class Policy> auto ZPG() -> u16
   {
     /*
      * @brief Zero Page addressing mode
      * Returns the address from the zero page (0x0000 - 0x00FF).
      * The value of the next byte is the address in the zero page.
      */
-    return ReadByte( pc++ ) & 0x00FF;
+    return ReadByte<Policy>( pc++ ) & 0x00FF;
   }
 
-  auto ZPGX() -> u16
+  template <class Policy> auto ZPGX() -> u16
   {
     /*
      * @brief Zero Page X addressing mode
      * Returns the address from the zero page (0x0000 - 0x00FF) + X register
      * The value of the next byte is the address in the zero page.
      */
-    u8 const  zeroPageAddress = ReadByte( pc++ );
-    u16 const finalAddress = ( zeroPageAddress + x ) & 0x00FF;
-    Tick(); // Account for calculating the final address
-    return finalAddress;
+    return ZeroPageX( ReadByte<Policy>( pc++ ) );
   }
 
-  auto ZPGY() -> u16
+  template <class Policy> auto ZPGY() -> u16
   {
     /*
      * @brief Zero Page Y addressing mode
      * Returns the address from the zero page (0x0000 - 0x00FF) + Y register
      * The value of the next byte is the address in the zero page.
      */
-    u8 const zeroPageAddress = ( ReadByte( pc++ ) + y ) & 0x00FF;
-
-    if ( writeModify ) {
-      Tick();
-    }
-    return zeroPageAddress;
+    return ZeroPageY( ReadByte<Policy>( pc++ ) );
   }
 
-  auto ABS() -> u16
+  template <class Policy> auto ABS() -> u16
   {
     /*
      * @brief Absolute addressing mode
      * Constructs a 16-bit address from the next two bytes
      */
-    u16 const low = ReadByte( pc++ );
-    u16 const high = ReadByte( pc++ );
+    u16 const low = ReadByte<Policy>( pc++ );
+    u16 const high = ReadByte<Policy>( pc++ );
     return ( high << 8 ) | low;
   }
 
-  auto ABSX() -> u16
+  template <class Policy> auto ABSX() -> u16
   {
     /*
      * @brief Absolute X addressing mode
      * Constructs a 16-bit address from the next two bytes and adds the X register to the final
      * address
      */
-    u16 const low = ReadByte( pc++ );
-    u16 const high = ReadByte( pc++ );
-    u16 const address = ( high << 8 ) | low;
-    u16 const finalAddress = address + x;
+    u16 const low = ReadByte<Policy>( pc++ );
+    u16 const high = ReadByte<Policy>( pc++ );
+    return AbsoluteIndexed( ( high << 8 ) | low, x );
+  }
 
-    // If the final address crosses a page boundary, an additional cycle is required
-    // Instructions that should ignore this: ASL, ROL, LSR, ROR, STA, DEC, INC
-    if ( pageCrossPenalty && ( finalAddress & 0xFF00 ) != ( address & 0xFF00 ) ) {
-      Tick();
-    }
+  template <class Policy> auto ABSY() -> u16
+  {
+    /*
+     * @brief Absolute Y addressing mode
+     * Constructs a 16-bit address from the next two bytes and adds the Y register to the final
+     * address
+     */
+    u16 const low = ReadByte<Policy>( pc++ );
+    u16 const high = ReadByte<Policy>( pc++ );
+    return AbsoluteIndexed( ( high << 8 ) | low, y );
+  }
+
+  template <class Policy> auto IND() -> u16
+  {
+    /*
+     * @brief Indirect addressing mode
+     * This mode implements pointers.
+     * The pointer address will be read from the next two bytes
+     * The returning value is the address stored at the pointer address
+     * There's a hardware bug that prevents the address from crossing a page boundary
+     */
+
+    u16 const ptrLow = ReadByte<Policy>( pc++ );
+    u16 const ptrHigh = ReadByte<Policy>( pc++ );
+    return Indirect<Policy>( ( ptrHigh << 8 ) | ptrLow );
+  }
+
+  template <class Policy> auto INDX() -> u16
+  {
+    /*
+     * @brief Indirect X addressing mode
+     * The next two bytes are a zero-page address
+     * X register is added to the zero-page address to get the pointer address
+     * Final address is the value stored at the POINTER address
+     */
+    Tick(); // Account for operand fetch
+    return IndirectX<Policy>( ReadByte<Policy>( pc++ ) );
+  }
+
+  template <class Policy> auto INDY() -> u16
+  {
+    /*
+     * @brief Indirect Y addressing mode
+     * The next byte is a zero-page address
+     * The value stored at the zero-page address is the pointer address
+     * The value in the Y register is added to the FINAL address
+     */
+    return IndirectY<Policy>( ReadByte<Policy>( pc++ ) );
+  }
+
+  template <class Policy> auto REL() -> u16
+  {
+    /*
+     * @brief Relative addressing mode
+     * The next byte is a signed offset
+     * Sets the program counter between -128 and +127 bytes from the current location
+     */
+    s8 const  offset = static_cast<s8>( ReadByte<Policy>( pc++ ) );
+    u16 const address = pc + offset;
+    return address;
+  }
+
+  /*
+  ################################
+  ||    Operand Address Steps   ||
+  ################################
+  The part of each indexed and indirect mode that comes after the operand bytes are fetched.
+  BlockCache fetches operands once, when it translates a block, and runs just these.
+  */
+  auto ZeroPageX( u8 zeroPageAddress ) -> u16
+  {
+    u16 const finalAddress = ( zeroPageAddress + x ) & 0x00FF;
+    Tick(); // Account for calculating the final address
+    return finalAddress;
+  }
 
+  auto ZeroPageY( u8 zeroPageAddress ) -> u16
+  {
+    u16 const finalAddress = ( zeroPageAddress + y ) & 0x00FF;
     if ( writeModify ) {
-      // Dummy read, in preparation to overwrite the address
       Tick();
     }
     return finalAddress;
   }
 
-  auto ABSY() -> u16
+  auto AbsoluteIndexed( u16 address, u8 index ) -> u16
   {
-    /*
-     * @brief Absolute Y addressing mode
-     * Constructs a 16-bit address from the next two bytes and adds the Y register to the final
-     * address
-     */
-    u16 const low = ReadByte( pc++ );
-    u16 const high = ReadByte( pc++ );
-    u16 const address = ( high << 8 ) | low;
-    u16 const finalAddress = address + y;
+    u16 const finalAddress = address + index;
 
     // If the final address crosses a page boundary, an additional cycle is required
-    // Instructions that should ignore this: STA
+    // Instructions that should ignore this: ASL, ROL, LSR, ROR, STA, DEC, INC
     if ( pageCrossPenalty && ( finalAddress & 0xFF00 ) != ( address & 0xFF00 ) ) {
       Tick();
     }
+
     if ( writeModify ) {
       // Dummy read, in preparation to overwrite the address
       Tick();
     }
-
     return finalAddress;
   }
 
-  auto IND() -> u16
+  template <class Policy> auto Indirect( u16 ptr ) -> u16
   {
-    /*
-     * @brief Indirect addressing mode
-     * This mode implements pointers.
-     * The pointer address will be read from the next two bytes
-     * The returning value is the address stored at the pointer address
-     * There's a hardware bug that prevents the address from crossing a page boundary
-     */
-
-    u16 const ptrLow = ReadByte( pc++ );
-    u16 const ptrHigh = ReadByte( pc++ );
-    u16 const ptr = ( ptrHigh << 8 ) | ptrLow;
-
-    u8 const addressLow = ReadByte( ptr );
+    u8 const addressLow = ReadByte<Policy>( ptr );
     u8       address_high; // NOLINT
 
     // 6502 Bug: If the pointer address wraps around a page boundary (e.g. 0x01FF),
     // the CPU reads the low byte from 0x01FF and the high byte from the start of
     // the same page (0x0100) instead of the start of the next page (0x0200).
-    if ( ptrLow == 0xFF ) {
-      address_high = ReadByte( ptr & 0xFF00 );
+    if ( ( ptr & 0x00FF ) == 0xFF ) {
+      address_high = ReadByte<Policy>( ptr & 0xFF00 );
     } else {
-      address_high = ReadByte( ptr + 1 );
+      address_high = ReadByte<Policy>( ptr + 1 );
     }
 
     return ( address_high << 8 ) | addressLow;
   }
 
-  auto INDX() -> u16
+  template <class Policy> auto IndirectX( u8 operand ) -> u16
   {
-    /*
-     * @brief Indirect X addressing mode
-     * The next two bytes are a zero-page address
-     * X register is added to the zero-page address to get the pointer address
-     * Final address is the value stored at the POINTER address
-     */
-    Tick();                                                           // Account for operand fetch
-    u8 const  zeroPageAddress = ( ReadByte( pc++ ) + x ) & 0x00FF;    // 1 cycle
-    u16 const ptrLow = ReadByte( zeroPageAddress );                   // 1 cycle
-    u16 const ptrHigh = ReadByte( ( zeroPageAddress + 1 ) & 0x00FF ); // 1 cycle
+    u8 const  zeroPageAddress = ( operand + x ) & 0x00FF;
+    u16 const ptrLow = ReadByte<Policy>( zeroPageAddress );                   // 1 cycle
+    u16 const ptrHigh = ReadByte<Policy>( ( zeroPageAddress + 1 ) & 0x00FF ); // 1 cycle
     return ( ptrHigh << 8 ) | ptrLow;
   }
 
-  auto INDY() -> u16
+  template <class Policy> auto IndirectY( u8 zeroPageAddress ) -> u16
   {
-    /*
-     * @brief Indirect Y addressing mode
-     * The next byte is a zero-page address
-     * The value stored at the zero-page address is the pointer address
-     * The value in the Y register is added to the FINAL address
-     */
-    u16 const zeroPageAddress = ReadByte( pc++ );
-    u16 const ptrLow = ReadByte( zeroPageAddress );
-    u16 const ptrHigh = ReadByte( ( zeroPageAddress + 1 ) & 0x00FF );
+    u16 const ptrLow = ReadByte<Policy>( zeroPageAddress );
+    u16 const ptrHigh = ReadByte<Policy>( ( zeroPageAddress + 1 ) & 0x00FF );
 
     u16 const address = ( ( ptrHigh << 8 ) | ptrLow ) + y;
 
@@ -674,18 +767,6 @@ public:
     return address;
   }
 
-  auto REL() -> u16
-  {
-    /*
-     * @brief Relative addressing mode
-     * The next byte is a signed offset
-     * Sets the program counter between -128 and +127 bytes from the current location
-     */
-    s8 const  offset = static_cast<s8>( ReadByte( pc++ ) );
-    u16 const address = pc + offset;
-    return address;
-  }
-
   /*
   ################################################################
   ||                                                            ||
@@ -694,7 +775,7 @@ public:
   ################################################################
     */
 
-  void NOP( u16 address ) // NOLINT
+  template <class Policy> void NOP( u16 address ) // NOLINT
   {
     /*
      * @brief No operation
@@ -735,7 +816,7 @@ public:
     (void) address;
   }
 
-  void LDA( u16 address )
+  template <class Policy> void LDA( u16 address )
   {
     /*
      * @brief Load Accumulator with Memory
@@ -752,10 +833,10 @@ public:
      * LDA Indirect Y: B1(5+)
      */
 
-    LoadRegister( address, a );
+    LoadRegister<Policy>( address, a );
   }
 
-  void LDX( u16 address )
+  template <class Policy> void LDX( u16 address )
   {
     /*
      * @brief Load X Register with Memory
@@ -768,10 +849,10 @@ public:
      * LDX Absolute: AE(4)
      * LDX Absolute Y: BE(4+)
      */
-    LoadRegister( address, x );
+    LoadRegister<Policy>( address, x );
   }
 
-  void LDY( u16 address )
+  template <class Policy> void LDY( u16 address )
   {
     /*
      * @brief Load Y Register with Memory
@@ -784,10 +865,10 @@ public:
      * LDY Absolute: AC(4)
      * LDY Absolute X: BC(4+)
      */
-    LoadRegister( address, y );
+    LoadRegister<Policy>( address, y );
   }
 
-  void STA( const u16 address ) // NOLINT
+  template <class Policy> void STA( const u16 address ) // NOLINT
   {
     /*
      * @brief Store Accumulator in Memory
@@ -802,10 +883,10 @@ public:
      * STA Indirect X: 81(6)
      * STA Indirect Y: 91(6)
      */
-    StoreRegister( address, a );
+    StoreRegister<Policy>( address, a );
   }
 
-  void STX( const u16 address ) // NOLINT
+  template <class Policy> void STX( const u16 address ) // NOLINT
   {
     /*
      * @brief Store X Register in Memory
@@ -816,10 +897,10 @@ public:
      * STX Zero Page Y: 96(4)
      * STX Absolute: 8E(4)
      */
-    StoreRegister( address, x );
+    StoreRegister<Policy>( address, x );
   }
 
-  void STY( const u16 address ) // NOLINT
+  template <class Policy> void STY( const u16 address ) // NOLINT
   {
     /*
      * @brief Store Y Register in Memory
@@ -830,10 +911,10 @@ public:
      * STY Zero Page X: 94(4)
      * STY Absolute: 8C(4)
      */
-    StoreRegister( address, y );
+    StoreRegister<Policy>( address, y );
   }
 
-  void ADC( u16 address )
+  template <class Policy> void ADC( u16 address )
   {
     /*
      * @brief Add Memory to Accumulator with Carry
@@ -852,9 +933,9 @@ public:
     u8 value = 0;
 
     if ( instructionName == "*RRA" ) {
-      value = Read( address ); // No cycle spend
+      value = BusRead<Policy>( address ); // No cycle spend
     } else {
-      value = ReadByte( address );
+      value = ReadByte<Policy>( address );
     }
 
     // Store the sum in a 16-bit variable to check for overflow
@@ -888,7 +969,7 @@ public:
     a = sum & 0xFF;
   }
 
-  void SBC( u16 address )
+  template <class Policy> void SBC( u16 address )
   {
     /* @brief Subtract Memory from Accumulator with Borrow
      * N Z C I D V
@@ -909,9 +990,9 @@ public:
 
     u8 value = 0;
     if ( instructionName == "*ISC" ) {
-      value = Read( address ); // 0 cycles
+      value = BusRead<Policy>( address ); // 0 cycles
     } else {
-      value = ReadByte( address );
+      value = ReadByte<Policy>( address );
     }
     // u8 const value = ReadByte( address );
 
@@ -944,7 +1025,7 @@ public:
     a = diff & 0xFF;
   }
 
-  void INC( u16 address )
+  template <class Policy> void INC( u16 address )
   {
     /*
      * @brief Increment Memory by One
@@ -956,14 +1037,14 @@ public:
      * INC Absolute: EE(6)
      * INC Absolute X: FE(7)
      */
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     Tick(); // Dummy write
     u8 const result = value + 1;
     SetZeroAndNegativeFlags( result );
-    WriteByte( address, result );
+    WriteByte<Policy>( address, result );
   }
 
-  void INX( u16 address )
+  template <class Policy> void INX( u16 address )
   {
     /*
      * @brief Increment X Register by One
@@ -977,7 +1058,7 @@ public:
     SetZeroAndNegativeFlags( x );
   }
 
-  void INY( u16 address )
+  template <class Policy> void INY( u16 address )
   {
     /*
      * @brief Increment Y Register by One
@@ -991,7 +1072,7 @@ public:
     SetZeroAndNegativeFlags( y );
   }
 
-  void DEC( u16 address )
+  template <class Policy> void DEC( u16 address )
   {
     /*
      * @brief Decrement Memory by One
@@ -1003,14 +1084,14 @@ public:
      * DEC Absolute: CE(6)
      * DEC Absolute X: DE(7)
      */
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     Tick(); // Dummy write
     u8 const result = value - 1;
     SetZeroAndNegativeFlags( result );
-    WriteByte( address, result );
+    WriteByte<Policy>( address, result );
   }
 
-  void DEX( u16 address )
+  template <class Policy> void DEX( u16 address )
   {
     /*
      * @brief Decrement X Register by One
@@ -1024,7 +1105,7 @@ public:
     SetZeroAndNegativeFlags( x );
   }
 
-  void DEY( u16 address )
+  template <class Policy> void DEY( u16 address )
   {
     /*
      * @brief Decrement Y Register by One
@@ -1038,7 +1119,7 @@ public:
     SetZeroAndNegativeFlags( y );
   }
 
-  void CLC( const u16 address )
+  template <class Policy> void CLC( const u16 address )
   {
     /* @brief Clear Carry Flag
      * N Z C I D V
@@ -1050,7 +1131,7 @@ public:
     ClearFlags( Carry );
   }
 
-  void CLI( const u16 address )
+  template <class Policy> void CLI( const u16 address )
   {
     /* @brief Clear Interrupt Disable
      * N Z C I D V
@@ -1061,7 +1142,7 @@ public:
     (void) address;
     ClearFlags( InterruptDisable );
   }
-  void CLD( const u16 address )
+  template <class Policy> void CLD( const u16 address )
   {
     /* @brief Clear Decimal Mode
      * N Z C I D V
@@ -1072,7 +1153,7 @@ public:
     (void) address;
     ClearFlags( Decimal );
   }
-  void CLV( const u16 address )
+  template <class Policy> void CLV( const u16 address )
   {
     /* @brief Clear Overflow Flag
      * N Z C I D V
@@ -1084,7 +1165,7 @@ public:
     ClearFlags( Overflow );
   }
 
-  void SEC( const u16 address )
+  template <class Policy> void SEC( const u16 address )
   {
     /* @brief Set Carry Flag
      * N Z C I D V
@@ -1096,7 +1177,7 @@ public:
     SetFlags( Carry );
   }
 
-  void SED( const u16 address )
+  template <class Policy> void SED( const u16 address )
   {
     /* @brief Set Decimal Flag
      * N Z C I D V
@@ -1108,7 +1189,7 @@ public:
     SetFlags( Decimal );
   }
 
-  void SEI( const u16 address )
+  template <class Policy> void SEI( const u16 address )
   {
     /* @brief Set Interrupt Disable
      * N Z C I D V
@@ -1120,7 +1201,7 @@ public:
     SetFlags( InterruptDisable );
   }
 
-  void BPL( const u16 address )
+  template <class Policy> void BPL( const u16 address )
   {
     /* @brief Branch if Positive
      * N Z C I D V
@@ -1131,7 +1212,7 @@ public:
     BranchOnStatus( address, Status::Negative, false );
   }
 
-  void BMI( const u16 address )
+  template <class Policy> void BMI( const u16 address )
   {
     /* @brief Branch if Minus
      * N Z C I D V
@@ -1142,7 +1223,7 @@ public:
     BranchOnStatus( address, Status::Negative, true );
   }
 
-  void BVC( const u16 address )
+  template <class Policy> void BVC( const u16 address )
   {
     /* @brief Branch if Overflow Clear
      * N Z C I D V
@@ -1153,7 +1234,7 @@ public:
     BranchOnStatus( address, Status::Overflow, false );
   }
 
-  void BVS( const u16 address )
+  template <class Policy> void BVS( const u16 address )
   {
     /* @brief Branch if Overflow Set
      * N Z C I D V
@@ -1164,7 +1245,7 @@ public:
     BranchOnStatus( address, Status::Overflow, true );
   }
 
-  void BCC( const u16 address )
+  template <class Policy> void BCC( const u16 address )
   {
     /* @brief Branch if Carry Clear
      * N Z C I D V
@@ -1175,7 +1256,7 @@ public:
     BranchOnStatus( address, Status::Carry, false );
   }
 
-  void BCS( const u16 address )
+  template <class Policy> void BCS( const u16 address )
   {
     /* @brief Branch if Carry Set
      * N Z C I D V
@@ -1186,7 +1267,7 @@ public:
     BranchOnStatus( address, Status::Carry, true );
   }
 
-  void BNE( const u16 address )
+  template <class Policy> void BNE( const u16 address )
   {
     /* @brief Branch if Not Equal
      * N Z C I D V
@@ -1197,7 +1278,7 @@ public:
     BranchOnStatus( address, Status::Zero, false );
   }
 
-  void BEQ( const u16 address )
+  template <class Policy> void BEQ( const u16 address )
   {
     /* @brief Branch if Equal
      * N Z C I D V
@@ -1208,7 +1289,7 @@ public:
     BranchOnStatus( address, Status::Zero, true );
   }
 
-  void CMP( u16 address )
+  template <class Policy> void CMP( u16 address )
   {
     /* @brief Compare Memory and Accumulator
      * N Z C I D V
@@ -1223,10 +1304,10 @@ public:
      *   CMP Indirect X: C1(6)
      *   CMP Indirect Y: D1(5+)
      */
-    CompareAddressWithRegister( address, a );
+    CompareAddressWithRegister<Policy>( address, a );
   }
 
-  void CPX( u16 address )
+  template <class Policy> void CPX( u16 address )
   {
     /* @brief Compare Memory and X Register
      * N Z C I D V
@@ -1236,10 +1317,10 @@ public:
      *   CPX Zero Page: E4(3)
      *   CPX Absolute: EC(4)
      */
-    CompareAddressWithRegister( address, x );
+    CompareAddressWithRegister<Policy>( address, x );
   }
 
-  void CPY( u16 address )
+  template <class Policy> void CPY( u16 address )
   {
     /* @brief Compare Memory and Y Register
      * N Z C I D V
@@ -1249,10 +1330,10 @@ public:
      *   CPY Zero Page: C4(3)
      *   CPY Absolute: CC(4)
      */
-    CompareAddressWithRegister( address, y );
+    CompareAddressWithRegister<Policy>( address, y );
   }
 
-  void PHA( const u16 address )
+  template <class Policy> void PHA( const u16 address )
   {
     /* @brief Push Accumulator on Stack
      * N Z C I D V
@@ -1266,13 +1347,13 @@ public:
     const u8 stackPointer = GetStackPointer();
 
     // Push the accumulator onto the stack
-    WriteByte( 0x0100 + stackPointer, GetAccumulator() );
+    WriteByte<Policy>( 0x0100 + stackPointer, GetAccumulator() );
 
     // Decrement the stack pointer
     SetStackPointer( stackPointer - 1 );
   }
 
-  void PHP( const u16 address )
+  template <class Policy> void PHP( const u16 address )
   {
     /* @brief Push Processor Status on Stack
      * N Z C I D V
@@ -1290,12 +1371,12 @@ public:
     status |= Break;
 
     // Push the modified status register onto the stack
-    WriteByte( 0x0100 + stackPointer, status );
+    WriteByte<Policy>( 0x0100 + stackPointer, status );
 
     SetStackPointer( stackPointer - 1 );
   }
 
-  void PLA( const u16 address )
+  template <class Policy> void PLA( const u16 address )
   {
     /* @brief Pop Accumulator from Stack
      * N Z C I D V
@@ -1309,12 +1390,12 @@ public:
     SetStackPointer( GetStackPointer() + 1 );
 
     // Get the accumulator from the stack and set the zero and negative flags
-    SetAccumulator( ReadByte( 0x100 + GetStackPointer() ) );
+    SetAccumulator( ReadByte<Policy>( 0x100 + GetStackPointer() ) );
     Tick(); // Dummy read
     SetZeroAndNegativeFlags( a );
   }
 
-  void PLP( const u16 address )
+  template <class Policy> void PLP( const u16 address )
   {
     /* @brief Pop Processor Status from Stack
      * N Z C I D V
@@ -1327,13 +1408,13 @@ public:
     // Increment the stack pointer first
     SetStackPointer( GetStackPointer() + 1 );
 
-    SetStatusRegister( ReadByte( 0x100 + GetStackPointer() ) );
+    SetStatusRegister( ReadByte<Policy>( 0x100 + GetStackPointer() ) );
     ClearFlags( Status::Break );
     Tick(); // Dummy read
     SetFlags( Status::Unused );
   }
 
-  void TSX( const u16 address )
+  template <class Policy> void TSX( const u16 address )
   {
     /* @brief Transfer Stack Pointer to X
      * N Z C I D V
@@ -1346,7 +1427,7 @@ public:
     SetZeroAndNegativeFlags( GetXRegister() );
   }
 
-  void TXS( const u16 address )
+  template <class Policy> void TXS( const u16 address )
   {
     /* @brief Transfer X to Stack Pointer
      * N Z C I D V
@@ -1358,7 +1439,7 @@ public:
     SetStackPointer( GetXRegister() );
   }
 
-  void ASL( u16 address )
+  template <class Policy> void ASL( u16 address )
   {
     /* @brief Arithmetic Shift Left
      * N Z C I D V
@@ -1385,7 +1466,7 @@ public:
       // Set the new accumulator value
       SetAccumulator( accumulator );
     } else {
-      u8 const value = ReadByte( address );
+      u8 const value = ReadByte<Policy>( address );
 
       Tick(); // simulate dummy write
 
@@ -1398,11 +1479,11 @@ public:
       SetZeroAndNegativeFlags( result );
 
       // Write the result back to memory
-      WriteByte( address, result );
+      WriteByte<Policy>( address, result );
     }
   }
 
-  void LSR( u16 address )
+  template <class Policy> void LSR( u16 address )
   {
     /* @brief Logical Shift Right
      * N Z C I D V
@@ -1429,7 +1510,7 @@ public:
       // Set the new accumulator value
       SetAccumulator( accumulator );
     } else {
-      u8 const value = ReadByte( address );
+      u8 const value = ReadByte<Policy>( address );
       Tick(); // simulate dummy write
 
       // Set the carry flag if bit 0 is set
@@ -1441,11 +1522,11 @@ public:
       SetZeroAndNegativeFlags( result );
 
       // Write the result back to memory
-      WriteByte( address, result );
+      WriteByte<Policy>( address, result );
     }
   }
 
-  void ROL( u16 address )
+  template <class Policy> void ROL( u16 address )
   {
     /* @brief Rotate Left
      * N Z C I D V
@@ -1477,7 +1558,7 @@ public:
       // Set the new accumulator value
       SetAccumulator( accumulator );
     } else {
-      u8 const value = ReadByte( address );
+      u8 const value = ReadByte<Policy>( address );
       Tick(); // dummy write
 
       // Set the carry flag if bit 7 is set
@@ -1490,11 +1571,11 @@ public:
       SetZeroAndNegativeFlags( result );
 
       // Write the result back to memory
-      WriteByte( address, result );
+      WriteByte<Policy>( address, result );
     }
   }
 
-  void ROR( u16 address )
+  template <class Policy> void ROR( u16 address )
   {
     /* @brief Rotate Right
      * N Z C I D V
@@ -1527,7 +1608,7 @@ public:
       // Set the new accumulator value
       SetAccumulator( accumulator );
     } else { // Memory mode
-      u8 const value = ReadByte( address );
+      u8 const value = ReadByte<Policy>( address );
       Tick(); // simulate dummy write
 
       // Set the carry flag if bit 0 is set
@@ -1540,11 +1621,11 @@ public:
       SetZeroAndNegativeFlags( result );
 
       // Write the result back to memory
-      WriteByte( address, result );
+      WriteByte<Policy>( address, result );
     }
   }
 
-  void JMP( u16 address )
+  template <class Policy> void JMP( u16 address )
   {
     /* @brief Jump to New Location
      * N Z C I D V
@@ -1556,7 +1637,7 @@ public:
     pc = address;
   }
 
-  void JSR( u16 address )
+  template <class Policy> void JSR( u16 address )
   {
     /* @brief Jump to Sub Routine, Saving Return Address
      * N Z C I D V
@@ -1566,12 +1647,12 @@ public:
      */
     u16 const returnAddress = pc - 1;
     Tick(); // Additional read here, probably for timing purposes
-    StackPush( ( returnAddress >> 8 ) & 0xFF );
-    StackPush( returnAddress & 0xFF );
+    StackPush<Policy>( ( returnAddress >> 8 ) & 0xFF );
+    StackPush<Policy>( returnAddress & 0xFF );
     pc = address;
   }
 
-  void RTS( const u16 address )
+  template <class Policy> void RTS( const u16 address )
   {
     /* @brief Return from Subroutine
      * N Z C I D V
@@ -1580,15 +1661,15 @@ public:
      *   RTS: 60(6)
      */
     (void) address;
-    u16 const low = StackPop();
-    u16 const high = StackPop();
+    u16 const low = StackPop<Policy>();
+    u16 const high = StackPop<Policy>();
     pc = ( high << 8 ) | low;
     Tick(); // Account for reading the new address
     pc++;
     Tick(); // Account for reading the next pc value
   }
 
-  void RTI( const u16 address )
+  template <class Policy> void RTI( const u16 address )
   {
     /* @brief Return from Interrupt
      * N Z C I D V
@@ -1597,18 +1678,18 @@ public:
      *   RTI: 40(6)
      */
     (void) address;
-    u8 const status = StackPop();
+    u8 const status = StackPop<Policy>();
 
     // Ignore the break flag and ensure the unused flag (bit 5) is set
-    p = ( status & ~Break ) | Unused;
+    SetStatusRegister( ( status & ~Break ) | Unused );
 
-    u16 const low = StackPop();
-    u16 const high = StackPop();
+    u16 const low = StackPop<Policy>();
+    u16 const high = StackPop<Policy>();
     pc = ( high << 8 ) | low;
     Tick(); // Account for reading the new address
   }
 
-  void BRK( const u16 address )
+  template <class Policy> void BRK( const u16 address )
   {
     /* @brief Force Interrupt
      * N Z C I D V
@@ -1624,22 +1705,22 @@ public:
     pc++; // padding byte
 
     // Push pc to the stack
-    StackPush( pc >> 8 );     // 1 cycle
-    StackPush( pc & 0x00FF ); // 1 cycle
+    StackPush<Policy>( pc >> 8 );     // 1 cycle
+    StackPush<Policy>( pc & 0x00FF ); // 1 cycle
 
     // Push status with break and unused flag set (ignored when popped)
-    StackPush( p | Break | Unused );
+    StackPush<Policy>( GetStatusRegister() | Break | Unused );
 
     // Set PC to the value at the interrupt vector (0xFFFE)
-    u16 const low = ReadByte( 0xFFFE );
-    u16 const high = ReadByte( 0xFFFF );
+    u16 const low = ReadByte<Policy>( 0xFFFE );
+    u16 const high = ReadByte<Policy>( 0xFFFF );
     pc = ( high << 8 ) | low;
 
     // Set the interrupt disable flag
     SetFlags( InterruptDisable );
   }
 
-  void AND( u16 address )
+  template <class Policy> void AND( u16 address )
   {
     /* @brief XOR Memory with Accumulator
      * N Z C I D V
@@ -1654,12 +1735,12 @@ public:
      *   AND Indirect X: 21(6)
      *   AND Indirect Y: 31(5+)
      */
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     a &= value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void ORA( const u16 address )
+  template <class Policy> void ORA( const u16 address )
   {
     /* @brief OR Memory with Accumulator
      * N Z C I D V
@@ -1675,12 +1756,12 @@ public:
      *   ORA Indirect Y: 11(5+)
      */
 
-    u8 const value = ReadByte( address ); // 1 cycle
+    u8 const value = ReadByte<Policy>( address ); // 1 cycle
     a |= value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void EOR( const u16 address )
+  template <class Policy> void EOR( const u16 address )
   {
     /* @brief XOR Memory with Accumulator
      * N Z C I D V
@@ -1695,12 +1776,12 @@ public:
      *   EOR Indirect X: 41(6)
      *   EOR Indirect Y: 51(5+)
      */
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     a ^= value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void BIT( const u16 address )
+  template <class Policy> void BIT( const u16 address )
   {
     /* @brief Test Bits in Memory with Accumulator
      * Performs AND between accumulator and memory, but does not store the result
@@ -1711,7 +1792,7 @@ public:
      *   BIT Absolute: 2C(4)
      */
 
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     SetZeroAndNegativeFlags( a & value );
 
     // Set overflow flag to bit 6 of value
@@ -1721,7 +1802,7 @@ public:
     ( value & 0b10000000 ) != 0 ? SetFlags( Status::Negative ) : ClearFlags( Status::Negative );
   }
 
-  void TAX( const u16 address )
+  template <class Policy> void TAX( const u16 address )
   {
     /* @brief Transfer Accumulator to X Register
      * N Z C I D V
@@ -1734,7 +1815,7 @@ public:
     SetZeroAndNegativeFlags( GetXRegister() );
   }
 
-  void TXA( const u16 address )
+  template <class Policy> void TXA( const u16 address )
   {
     /* @brief Transfer X Register to Accumulator
      * N Z C I D V
@@ -1747,7 +1828,7 @@ public:
     SetZeroAndNegativeFlags( GetAccumulator() );
   }
 
-  void TAY( const u16 address )
+  template <class Policy> void TAY( const u16 address )
   {
     /* @brief Transfer Accumulator to Y Register
      * N Z C I D V
@@ -1760,7 +1841,7 @@ public:
     SetZeroAndNegativeFlags( GetYRegister() );
   }
 
-  void TYA( const u16 address )
+  template <class Policy> void TYA( const u16 address )
   {
     /* @brief Transfer Y Register to Accumulator
      * N Z C I D V
@@ -1781,7 +1862,7 @@ public:
   ################################################################
   */
 
-  void NOP2( u16 address ) // NOLINT
+  template <class Policy> void NOP2( u16 address ) // NOLINT
   {
     /*
      * @brief No operation, has an additional cycle
@@ -1813,7 +1894,7 @@ public:
     Tick();
     (void) address;
   }
-  void JAM( const u16 address ) // NOLINT
+  template <class Policy> void JAM( const u16 address ) // NOLINT
   {
     /* @brief Illegal Opcode
      * Freezes the hardware, usually never called
@@ -1825,7 +1906,7 @@ public:
     }
   }
 
-  void SLO( const u16 address )
+  template <class Policy> void SLO( const u16 address )
   {
     /* @brief Illegal opcode: combines ASL and ORA
      * N Z C I D V
@@ -1839,15 +1920,15 @@ public:
      *   SLO Indirect X: 03(8)
      *   SLO Indirect Y: 13(8)
      */
-    ASL( address );
+    ASL<Policy>( address );
 
     // ORA is side effect, no cycles are spent
-    u8 const value = Read( address ); // 0 cycle
+    u8 const value = BusRead<Policy>( address ); // 0 cycle
     a |= value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void SAX( const u16 address ) // NOLINT
+  template <class Policy> void SAX( const u16 address ) // NOLINT
   {
     /* @brief Illegal opcode: combines STX and AND
      * N Z C I D V
@@ -1858,10 +1939,10 @@ public:
      *   SAX Indirect X: 83(6)
      *   SAX Absolute: 8F(4)
      */
-    WriteByte( address, a & x );
+    WriteByte<Policy>( address, a & x );
   }
 
-  void LXA( const u16 address )
+  template <class Policy> void LXA( const u16 address )
   {
     /* @brief Illegal opcode: combines LDA and LDX
      * N Z C I D V
@@ -1871,7 +1952,7 @@ public:
      */
 
     u8 const magicConstant = 0xEE;
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
 
     u8 const result = ( ( a | magicConstant ) & value );
     a = result;
@@ -1879,16 +1960,16 @@ public:
     SetZeroAndNegativeFlags( a );
   }
 
-  void ATX( const u16 address )
+  template <class Policy> void ATX( const u16 address )
   {
     // LDA & TAX
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     x = value;
     a = value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void LAX( const u16 address )
+  template <class Policy> void LAX( const u16 address )
   {
     /* @brief Illegal opcode: combines LDA and LDX
      * N Z C I D V
@@ -1901,13 +1982,13 @@ public:
      *   LAX Indirect X: A3(6)
      *   LAX Indirect Y: B3(5+)
      */
-    u8 const value = ReadByte( address );
+    u8 const value = ReadByte<Policy>( address );
     SetAccumulator( value );
     SetXRegister( value );
     SetZeroAndNegativeFlags( value );
   }
 
-  void ARR( const u16 address )
+  template <class Policy> void ARR( const u16 address )
   {
     /* @brief Illegal opcode: combines AND and ROR
      * N Z C I D V
@@ -1917,7 +1998,7 @@ public:
      */
 
     // A & operand
-    u8 value = a & ReadByte( address );
+    u8 value = a & ReadByte<Policy>( address );
 
     // ROR
     u8 const carryIn = IsFlagSet( Status::Carry ) ? 0x80 : 0x00;
@@ -1937,7 +2018,7 @@ public:
     ( isOverflow ) ? SetFlags( Status::Overflow ) : ClearFlags( Status::Overflow );
   }
 
-  void ALR( const u16 address )
+  template <class Policy> void ALR( const u16 address )
   {
     /* @brief Illegal opcode: combines AND and LSR
      * N Z C I D V
@@ -1945,7 +2026,7 @@ public:
      *   Usage and cycles:
      *   ALR Immediate: 4B(2)
      */
-    AND( address );
+    AND<Policy>( address );
 
     u8 const value = GetAccumulator();
     ( value & 0b00000001 ) != 0 ? SetFlags( Status::Carry ) : ClearFlags( Status::Carry );
@@ -1954,7 +2035,7 @@ public:
     a = result;
   }
 
-  void RRA( const u16 address )
+  template <class Policy> void RRA( const u16 address )
   {
     /* @brief Illegal opcode: combines ROR and ADC
      * N Z C I D V
@@ -1968,11 +2049,11 @@ public:
      *   RRA Indirect X: 63(8)
      *   RRA Indirect Y: 73(8)
      */
-    ROR( address );
-    ADC( address );
+    ROR<Policy>( address );
+    ADC<Policy>( address );
   }
 
-  void SRE( const u16 address )
+  template <class Policy> void SRE( const u16 address )
   {
     /* @brief Illegal opcode: combines LSR and EOR
      * N Z C I D V
@@ -1986,15 +2067,15 @@ public:
      *   SRE Indirect X: 43(8)
      *   SRE Indirect Y: 53(8)
      */
-    LSR( address );
+    LSR<Policy>( address );
 
     // Free side effect
-    u8 const value = Read( address ); // 0 cycle
+    u8 const value = BusRead<Policy>( address ); // 0 cycle
     a ^= value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void RLA( const u16 address )
+  template <class Policy> void RLA( const u16 address )
   {
     /* @brief Illegal opcode: combines ROL and AND
      * N Z C I D V
@@ -2008,15 +2089,15 @@ public:
      *   RLA Indirect X: 23(8)
      *   RLA Indirect Y: 33(8)
      */
-    ROL( address );
+    ROL<Policy>( address );
 
     // Free side effect
-    u8 const value = Read( address ); // 0 cycle
+    u8 const value = BusRead<Policy>( address ); // 0 cycle
     a &= value;
     SetZeroAndNegativeFlags( a );
   }
 
-  void DCP( const u16 address )
+  template <class Policy> void DCP( const u16 address )
   {
     /* @brief Illegal opcode: combines DEC and CMP
      * N Z C I D V
@@ -2030,11 +2111,11 @@ public:
      *   DCP Indirect X: C3(8)
      *   DCP Indirect Y: D3(8)
      */
-    DEC( address );
-    CMP( address );
+    DEC<Policy>( address );
+    CMP<Policy>( address );
   }
 
-  void ISC( const u16 address )
+  template <class Policy> void ISC( const u16 address )
   {
     /* @brief Illegal opcode: combines INC and SBC
      * N Z C I D V
@@ -2048,11 +2129,11 @@ public:
      *   ISC Indirect X: E3(8)
      *   ISC Indirect Y: F3(8)
      */
-    INC( address );
-    SBC( address );
+    INC<Policy>( address );
+    SBC<Policy>( address );
   }
 
-  void ANC( const u16 address )
+  template <class Policy> void ANC( const u16 address )
   {
     /* @brief Illegal opcode: combines AND and Carry
      * N Z C I D V
@@ -2061,11 +2142,11 @@ public:
      *   ANC Immediate: 0B(2)
      *   ANC Immediate: 2B(2)
      */
-    AND( address );
+    AND<Policy>( address );
     ( IsFlagSet( Status::Negative ) ) ? SetFlags( Status::Carry ) : ClearFlags( Status::Carry );
   }
 
-  void SBX( const u16 address )
+  template <class Policy> void SBX( const u16 address )
   {
     /* @brief Illegal opcode: SBX (a.k.a. AXS) combines CMP and DEX
      *        (A & X) - immediate -> X
@@ -2076,7 +2157,7 @@ public:
      * Usage and cycles:
      *   SBX Immediate: CB (2 bytes, 2 cycles)
      */
-    u8 const  operand = ReadByte( address );
+    u8 const  operand = ReadByte<Policy>( address );
     u8 const  left = ( a & x );
     u16 const diff = static_cast<u16>( left ) - static_cast<u16>( operand );
     x = static_cast<u8>( diff & 0xFF );
@@ -2084,7 +2165,7 @@ public:
     SetZeroAndNegativeFlags( x );
   }
 
-  void LAS( const u16 address )
+  template <class Policy> void LAS( const u16 address )
   {
     /* @brief Illegal opcode: LAS(LAR), combines LDA/TSX
      * M AND SP -> A, X, SP
@@ -2094,7 +2175,7 @@ public:
      *   Usage and cycles:
      *   LAS Absolute Y: BB(4+)
      */
-    u8 const memVal = ReadByte( address );
+    u8 const memVal = ReadByte<Policy>( address );
     u8 const sp = GetStackPointer();
     u8 const result = memVal & sp;
 
@@ -2105,7 +2186,7 @@ public:
     SetZeroAndNegativeFlags( result );
   }
 
-  void ANE( const u16 address )
+  template <class Policy> void ANE( const u16 address )
   {
     /* @details Illegal opcode: ANE, combines AND and EOR
       * OR X + AND oper
@@ -2124,7 +2205,7 @@ public:
       Usage and cycles:
       * ANE Immediate: 8B(2)
     */
-    u8 const operand = ReadByte( address );
+    u8 const operand = ReadByte<Policy>( address );
     u8 const constant = 0xEE;
 
     // Compute: (A OR constant) AND X AND operand.
@@ -2134,11 +2215,11 @@ public:
     SetZeroAndNegativeFlags( a );
   }
 
-  void SyaSxaAxa( uint16_t baseAddr, uint8_t indexReg, uint8_t valueReg )
+  template <class Policy> void SyaSxaAxa( uint16_t baseAddr, uint8_t indexReg, uint8_t valueReg )
   {
     bool const pageCrossed = ( ( baseAddr & 0xFF00 ) != ( ( baseAddr + indexReg ) & 0xFF00 ) );
     auto       cyc = cycles;
-    ReadByte( baseAddr + indexReg - ( pageCrossed ? 0x100 : 0 ) );
+    ReadByte<Policy>( baseAddr + indexReg - ( pageCrossed ? 0x100 : 0 ) );
     bool const     hadDma = ( cycles - cyc ) > 1;
     uint16_t const operand = baseAddr + indexReg;
     uint8_t const  addrLow = uint8_t( operand & 0xFF );
@@ -2148,43 +2229,38 @@ public:
     }
     uint8_t const toStore = hadDma ? valueReg : uint8_t( valueReg & uint8_t( ( baseAddr >> 8 ) + 1 ) );
 
-    WriteByte( uint16_t( addrHigh ) << 8 | addrLow, toStore );
+    WriteByte<Policy>( uint16_t( addrHigh ) << 8 | addrLow, toStore );
   }
 
-  void SHY( u16 address )
+  template <class Policy> void SHY( u16 address )
   {
     u8 const  indexReg = x;
     u8 const  valueReg = y;
     u16 const baseAddr = address - indexReg;
-    SyaSxaAxa( baseAddr, indexReg, valueReg );
+    SyaSxaAxa<Policy>( baseAddr, indexReg, valueReg );
   }
 
-  void SHX( u16 address )
+  template <class Policy> void SHX( u16 address )
   {
     u8 const  indexReg = y;
     u8 const  valueReg = x;
     u16 const baseAddr = address - indexReg;
-    SyaSxaAxa( baseAddr, indexReg, valueReg );
+    SyaSxaAxa<Policy>( baseAddr, indexReg, valueReg );
   }
 
-  void SHA( const u16 address )
+  template <class Policy> void SHA( const u16 address )
   {
     u8 const  valueReg = x & a;
     u8 const  indexReg = y;
     u16 const baseAddr = address - indexReg;
-    SyaSxaAxa( baseAddr, indexReg, valueReg );
+    SyaSxaAxa<Policy>( baseAddr, indexReg, valueReg );
   }
 
-  void TAS( const u16 address )
+  template <class Policy> void TAS( const u16 address )
   {
-    SHA( address );
+    SHA<Policy>( address );
     SetStackPointer( a & x );
   }
 
-  void XXX( const u16 address ) // NOLINT
-  {
-    // unimplemented
-    (void) address;
-    fmt::print( "Unimplemented opcode: {:02X}\n", opcode );
-  }
+  void XXX( u16 address ); // NOLINT, unimplemented
 };
@@ -0,0 +1,341 @@
+#include "emulator-pool.h"
+#include "bus.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+EmulatorPool::EmulatorPool( std::size_t instances, std::size_t threads )
+{
+  if ( threads == 0 ) {
+    threads = std::max( 1U, std::thread::hardware_concurrency() );
+  }
+
+  _instances.reserve( instances );
+  for ( std::size_t i = 0; i < instances; ++i ) {
+    auto slot = std::make_unique<Slot>();
+    slot->bus = std::make_unique<Bus>();
+    slot->bus->apu.enable_synthesis( false );
+    slot->bus->cartridge.privateBatteryRam = true;
+
+    Slot *const owner = slot.get();
+    slot->bus->logSink = [owner]( const std::string &message ) {
+      std::lock_guard<std::mutex> const lock( owner->logMutex );
+      if ( owner->log.size() == maxLogLines ) {
+        owner->log.pop_front();
+      }
+      owner->log.push_back( message );
+    };
+    _instances.push_back( std::move( slot ) );
+  }
+
+  _workers.reserve( threads );
+  for ( std::size_t i = 0; i < threads; ++i ) {
+    _workers.push_back( std::make_unique<Worker>() );
+  }
+  // Started after every worker exists, since each one may steal from any other
+  for ( std::size_t i = 0; i < threads; ++i ) {
+    _workers[i]->thread = std::thread( &EmulatorPool::Run, this, i );
+  }
+}
+
+EmulatorPool::~EmulatorPool()
+{
+  Wait();
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for ( auto &worker : _workers ) {
+    worker->thread.join();
+  }
+}
+
+Bus &EmulatorPool::Instance( std::size_t index )
+{
+  return *_instances.at( index )->bus;
+}
+
+void EmulatorPool::LoadRom( const std::string &path )
+{
+  Wait();
+  for ( auto &slot : _instances ) {
+    slot->bus->cartridge.LoadRom( path );
+    slot->bus->DebugReset();
+  }
+}
+
+/*
+################################
+||          Stepping          ||
+################################
+*/
+void EmulatorPool::StepFrame( std::span<const Input> inputs )
+{
+  StepFrameAsync( inputs );
+  Wait();
+}
+
+void EmulatorPool::StepFrameAsync( std::span<const Input> inputs, std::function<void()> onComplete )
+{
+  if ( !inputs.empty() && inputs.size() != _instances.size() ) {
+    throw std::runtime_error( "EmulatorPool::StepFrame: expected " + std::to_string( _instances.size() ) +
+                              " inputs, got " + std::to_string( inputs.size() ) );
+  }
+  Wait();
+
+  if ( _instances.empty() ) {
+    if ( onComplete ) {
+      onComplete();
+    }
+    return;
+  }
+
+  for ( std::size_t i = 0; i < inputs.size(); ++i ) {
+    _instances[i]->input = inputs[i];
+  }
+
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _onComplete = std::move( onComplete );
+    _remaining.store( _instances.size(), std::memory_order_relaxed );
+    _busy = true;
+    _stepStart = Clock::now();
+  }
+
+  // Deal tasks out round robin. A worker still looking for work from the last step may pick
+  // these up before the wake-up, which is fine now that the step is set up.
+  std::size_t next = 0;
+  for ( std::size_t i = 0; i < _instances.size(); ++i ) {
+    int const                   affinity = _instances[i]->affinity;
+    Worker                     &worker = *_workers[affinity >= 0 ? static_cast<std::size_t>( affinity ) : next];
+    std::lock_guard<std::mutex> lock( worker.mutex );
+    if ( affinity >= 0 ) {
+      worker.pinned.push_back( i );
+    } else {
+      worker.tasks.push_back( i );
+      next = ( next + 1 ) % _workers.size();
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    ++_generation;
+  }
+  _wake.notify_all();
+}
+
+void EmulatorPool::Wait()
+{
+  std::unique_lock<std::mutex> lock( _mutex );
+  _done.wait( lock, [this] { return !_busy; } );
+}
+
+void EmulatorPool::SetFrameHook( FrameHook hook )
+{
+  Wait();
+  _frameHook = std::move( hook );
+}
+
+bool EmulatorPool::IsBusy() const
+{
+  std::lock_guard<std::mutex> const lock( _mutex );
+  return _busy;
+}
+
+void EmulatorPool::Run( std::size_t self )
+{
+  u64 seen = 0;
+  while ( true ) {
+    {
+      std::unique_lock<std::mutex> lock( _mutex );
+      _wake.wait( lock, [&] { return _stopping || _generation != seen; } );
+      if ( _stopping ) {
+        return;
+      }
+      seen = _generation;
+    }
+
+    std::size_t task = 0;
+    bool        stolen = false;
+    while ( NextTask( self, task, stolen ) ) {
+      if ( stolen ) {
+        ++_workers[self]->steals;
+      }
+      RunInstance( self, task );
+      if ( _remaining.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+        FinishStep();
+      }
+    }
+  }
+}
+
+bool EmulatorPool::NextTask( std::size_t self, std::size_t &task, bool &stolen )
+{
+  Worker &own = *_workers[self];
+  {
+    std::lock_guard<std::mutex> const lock( own.mutex );
+    for ( auto *queue : { &own.pinned, &own.tasks } ) {
+      if ( !queue->empty() ) {
+        task = queue->front();
+        queue->pop_front();
+        stolen = false;
+        return true;
+      }
+    }
+  }
+
+  // Steal from the back, the end furthest from where the owner is working
+  for ( std::size_t offset = 1; offset < _workers.size(); ++offset ) {
+    Worker                     &victim = *_workers[( self + offset ) % _workers.size()];
+    std::lock_guard<std::mutex> lock( victim.mutex );
+    if ( !victim.tasks.empty() ) {
+      task = victim.tasks.back();
+      victim.tasks.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void EmulatorPool::RunInstance( std::size_t self, std::size_t index )
+{
+  Slot   &slot = *_instances[index];
+  Worker &worker = *_workers[self];
+  Bus    &bus = *slot.bus;
+
+  auto const start = Clock::now();
+  u64 const  cycles = bus.cpu.GetCycles();
+
+  bus.controller[0] = slot.input[0];
+  bus.controller[1] = slot.input[1];
+  bus.RunFrame();
+  bus.apu.end_frame();
+  if ( _frameHook ) {
+    _frameHook( index, bus );
+  }
+
+  // Worker counters are only read while the pool is idle
+  ++worker.frames;
+  worker.cpuCycles += bus.cpu.GetCycles() - cycles;
+  worker.busySeconds += std::chrono::duration<double>( Clock::now() - start ).count();
+  slot.lastWorker.store( static_cast<int>( self ), std::memory_order_relaxed );
+}
+
+void EmulatorPool::FinishStep()
+{
+  std::function<void()> onComplete;
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _wallSeconds += std::chrono::duration<double>( Clock::now() - _stepStart ).count();
+    onComplete = std::move( _onComplete );
+    _onComplete = nullptr;
+  }
+  // Run before waking waiters, so Wait() returning means the callback has finished
+  if ( onComplete ) {
+    onComplete();
+  }
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _busy = false;
+  }
+  _done.notify_all();
+}
+
+/*
+################################
+||          Affinity          ||
+################################
+*/
+void EmulatorPool::SetAffinity( std::size_t instance, int worker )
+{
+  if ( worker >= static_cast<int>( _workers.size() ) ) {
+    throw std::runtime_error( "EmulatorPool::SetAffinity: no worker " + std::to_string( worker ) );
+  }
+  Wait();
+  _instances.at( instance )->affinity = std::max( worker, -1 );
+}
+
+int EmulatorPool::LastWorker( std::size_t instance ) const
+{
+  return _instances.at( instance )->lastWorker.load( std::memory_order_relaxed );
+}
+
+bool EmulatorPool::PinWorkersToCores()
+{
+#if defined( __linux__ )
+  unsigned const cores = std::max( 1U, std::thread::hardware_concurrency() );
+  bool           ok = true;
+  for ( std::size_t i = 0; i < _workers.size(); ++i ) {
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( i % cores, &set );
+    ok &= pthread_setaffinity_np( _workers[i]->thread.native_handle(), sizeof( set ), &set ) == 0;
+  }
+  return ok;
+#else
+  return true;
+#endif
+}
+
+/*
+################################
+||       Logs and Metrics     ||
+################################
+*/
+std::vector<std::string> EmulatorPool::TakeLog( std::size_t instance )
+{
+  Slot                       &slot = *_instances.at( instance );
+  std::lock_guard<std::mutex> lock( slot.logMutex );
+  std::vector<std::string>    lines( std::make_move_iterator( slot.log.begin() ),
+                                     std::make_move_iterator( slot.log.end() ) );
+  slot.log.clear();
+  return lines;
+}
+
+EmulatorPool::Metrics EmulatorPool::GetMetrics() const
+{
+  std::unique_lock<std::mutex> lock( _mutex );
+  _done.wait( lock, [this] { return !_busy; } );
+
+  Metrics metrics;
+  metrics.threads = _workers.size();
+  metrics.wallSeconds = _wallSeconds;
+  for ( auto const &worker : _workers ) {
+    metrics.frames += worker->frames;
+    metrics.cpuCycles += worker->cpuCycles;
+    metrics.steals += worker->steals;
+    metrics.busySeconds += worker->busySeconds;
+  }
+  return metrics;
+}
+
+void EmulatorPool::ResetMetrics()
+{
+  Wait();
+  std::lock_guard<std::mutex> const lock( _mutex );
+  _wallSeconds = 0.0;
+  for ( auto &worker : _workers ) {
+    worker->frames = 0;
+    worker->cpuCycles = 0;
+    worker->steals = 0;
+    worker->busySeconds = 0.0;
+  }
+}
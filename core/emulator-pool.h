@@ -0,0 +1,174 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Bus;
+
+/*
+################################
+||        Emulator Pool       ||
+################################
+  Owns a set of independent Bus instances and steps them in parallel, for test farms and agent
+  training where hundreds of emulators share a host.
+
+  Each StepFrame() call queues one task per instance, spread round robin over the workers'
+  deques. Workers run their own tasks from the front and, once out of work, steal from the back
+  of other workers' deques, so a few slow instances (heavy mappers, lag frames) don't leave
+  cores idle. Instances pinned to a worker with SetAffinity() go to a queue that only that
+  worker runs, keeping their state in one core's caches.
+
+  Instances share no mutable state: every Bus owns its memory, palette, APU and save writer,
+  and logs through its own sink (see Bus::logSink). The pool collects each instance's messages
+  separately instead of letting them interleave on stdout. Battery backed PRG RAM stays private
+  to each instance and the game's save file is never read or written (see
+  Cartridge::privateBatteryRam), so instances can't leak state into each other or the player's
+  save through it. Sound synthesis is off, since
+  nothing listens; CPU visible APU behavior is unaffected.
+*/
+
+class EmulatorPool
+{
+public:
+  // Controller bytes for ports 1 and 2
+  using Input = std::array<u8, 2>;
+
+  struct Metrics {
+    u64    frames = 0;
+    u64    cpuCycles = 0;
+    u64    steals = 0;            // tasks run by a worker other than the one they were queued on
+    double wallSeconds = 0.0;     // time from each step's start to its last instance finishing
+    double busySeconds = 0.0;     // time workers spent emulating, summed over workers
+    std::size_t threads = 0;
+
+    [[nodiscard]] double FramesPerSecond() const { return wallSeconds > 0 ? frames / wallSeconds : 0.0; }
+    [[nodiscard]] double CyclesPerSecond() const { return wallSeconds > 0 ? cpuCycles / wallSeconds : 0.0; }
+
+    // Fraction of the available worker time spent emulating
+    [[nodiscard]] double Utilization() const
+    {
+      return wallSeconds > 0 && threads > 0 ? busySeconds / ( wallSeconds * static_cast<double>( threads ) ) : 0.0;
+    }
+  };
+
+  // Zero threads uses one per hardware thread
+  explicit EmulatorPool( std::size_t instances, std::size_t threads = 0 );
+  ~EmulatorPool();
+
+  EmulatorPool( const EmulatorPool & ) = delete;
+  EmulatorPool &operator=( const EmulatorPool & ) = delete;
+  EmulatorPool( EmulatorPool && ) = delete;
+  EmulatorPool &operator=( EmulatorPool && ) = delete;
+
+  [[nodiscard]] std::size_t Size() const { return _instances.size(); }
+  [[nodiscard]] std::size_t ThreadCount() const { return _workers.size(); }
+
+  // Direct access, only while no step is running
+  Bus &Instance( std::size_t index );
+
+  // Loads the ROM into every instance and resets them. Throws like Cartridge::LoadRom().
+  void LoadRom( const std::string &path );
+
+  /*
+  ################################
+  ||          Stepping          ||
+  ################################
+  */
+  // Runs every instance for one frame with its input (one entry per instance, or none to keep
+  // the previous inputs) and blocks until all are done
+  void StepFrame( std::span<const Input> inputs = {} );
+
+  // Same, without blocking. onComplete runs on the worker that finishes the last instance and
+  // must not step the pool itself. A step already in flight is waited for first.
+  void StepFrameAsync( std::span<const Input> inputs = {}, std::function<void()> onComplete = {} );
+  void Wait();
+  [[nodiscard]] bool IsBusy() const;
+
+  // Runs on the worker right after each instance's frame, so per-frame work such as copying out
+  // observations happens in parallel too. Waits for a step in flight before replacing the hook.
+  using FrameHook = std::function<void( std::size_t instance, Bus &bus )>;
+  void SetFrameHook( FrameHook hook );
+
+  /*
+  ################################
+  ||          Affinity          ||
+  ################################
+  */
+  // Always run an instance on the given worker, or anywhere with -1
+  void SetAffinity( std::size_t instance, int worker );
+  // Worker that ran an instance's last frame, -1 before the first
+  [[nodiscard]] int LastWorker( std::size_t instance ) const;
+
+  // Pin worker threads to CPU cores, worker i to core i modulo the core count. Linux only, a
+  // no-op elsewhere. Returns false if the OS refused.
+  bool PinWorkersToCores();
+
+  /*
+  ################################
+  ||       Logs and Metrics     ||
+  ################################
+  */
+  // Messages an instance logged since the last call, oldest first. Kept to the last maxLogLines.
+  std::vector<std::string> TakeLog( std::size_t instance );
+  static constexpr std::size_t maxLogLines = 256;
+
+  // Totals since construction or ResetMetrics(), waiting for a step in flight
+  [[nodiscard]] Metrics GetMetrics() const;
+  void                  ResetMetrics();
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Slot {
+    std::unique_ptr<Bus>    bus;
+    Input                   input{};
+    int                     affinity = -1;
+    std::atomic<int>        lastWorker{ -1 };
+    std::mutex              logMutex;
+    std::deque<std::string> log;
+  };
+
+  struct alignas( 64 ) Worker {
+    std::thread             thread;
+    std::mutex              mutex;
+    std::deque<std::size_t> tasks;  // stealable
+    std::deque<std::size_t> pinned; // this worker only
+    u64                     frames = 0;
+    u64                     cpuCycles = 0;
+    u64                     steals = 0;
+    double                  busySeconds = 0.0;
+  };
+
+  void Run( std::size_t self );
+  bool NextTask( std::size_t self, std::size_t &task, bool &stolen );
+  void RunInstance( std::size_t self, std::size_t index );
+  void FinishStep();
+
+  std::vector<std::unique_ptr<Slot>>   _instances;
+  std::vector<std::unique_ptr<Worker>> _workers;
+
+  // Step hand-off. Workers wake when the generation changes.
+  mutable std::mutex              _mutex;
+  std::condition_variable         _wake;
+  mutable std::condition_variable _done;
+  u64                             _generation = 0;
+  bool                            _stopping = false;
+  bool                            _busy = false;
+  std::atomic<std::size_t>        _remaining{ 0 };
+  std::function<void()>           _onComplete;
+  FrameHook                       _frameHook;
+  Clock::time_point               _stepStart;
+  double                          _wallSeconds = 0.0;
+};
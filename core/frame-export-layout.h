@@ -0,0 +1,80 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/*
+################################
+||     Frame Export Layout    ||
+################################
+  Shared memory layout written by FrameExporter and read by FrameReader, so other processes
+  (agents, stream encoders) can follow a running emulator without copies or per-frame syscalls.
+
+  The object starts with a RingHeader, followed by slotCount slots of slotBytes each. Frame n
+  (counting from 0 since the exporter opened) goes to slot n % slotCount:
+
+    SlotHeader | 2KB CPU RAM | pixels (256x240 RGBA, or one palette index per pixel) | padding
+
+  Slots are seqlocks. The writer sets sequence to 2n + 1 before touching slot data and to
+  2n + 2 once frame n is complete, then bumps published. A reader checks the sequence before
+  and after using the data; a mismatch means the writer lapped it and the data is torn.
+
+  Waiting readers sleep on wakeWord (a futex on Linux). The writer only makes the wake syscall
+  when waiters is non-zero, so a producer nobody waits on never leaves user space.
+
+  Both sides must be built from the same layout; readers check magic and version.
+*/
+
+namespace frame_export
+{
+constexpr u32         magic = 0x4E455846; // "FXEN"
+constexpr u32         version = 1;
+constexpr std::size_t frameWidth = 256;
+constexpr std::size_t frameHeight = 240;
+constexpr std::size_t ramSize = 2048;
+
+enum class PixelFormat : u32 { Rgba = 0, PaletteIndex = 1 };
+
+constexpr std::size_t PixelBytes( PixelFormat format )
+{
+  return frameWidth * frameHeight * ( format == PixelFormat::Rgba ? 4 : 1 );
+}
+
+struct alignas( 64 ) RingHeader {
+  u32         magic;
+  u32         version;
+  u32         slotCount;
+  PixelFormat format;
+  u64         slotBytes; // stride between slots
+  u64         pixelBytes;
+
+  alignas( 64 ) std::atomic<u64> published; // frames completed so far
+  std::atomic<u32> wakeWord;                // bumped on every publish
+  std::atomic<u32> waiters;                 // readers sleeping on wakeWord
+};
+
+struct alignas( 64 ) SlotHeader {
+  std::atomic<u64> sequence; // 2n + 1 while frame n is written, 2n + 2 once it's complete
+  u64              frame;    // PPU frame counter
+  u64              stateHash;
+  std::array<u8, 2> input; // controller bytes for ports 1 and 2
+};
+
+static_assert( std::atomic<u64>::is_always_lock_free && std::atomic<u32>::is_always_lock_free,
+               "shared memory atomics must be lock free" );
+
+constexpr std::size_t ramOffset = sizeof( SlotHeader );
+constexpr std::size_t pixelOffset = ramOffset + ramSize;
+
+constexpr std::size_t SlotBytes( PixelFormat format )
+{
+  return ( pixelOffset + PixelBytes( format ) + 63 ) / 64 * 64;
+}
+
+constexpr std::size_t MappingBytes( PixelFormat format, u32 slotCount )
+{
+  return sizeof( RingHeader ) + ( slotCount * SlotBytes( format ) );
+}
+} // namespace frame_export
@@ -0,0 +1,189 @@
+#include "frame-exporter.h"
+#include "bus.h"
+#include "frame-export-layout.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <fmt/base.h>
+#include <fmt/format.h>
+#include <new>
+#include <string>
+
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined( __linux__ )
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace frame_export; // NOLINT
+
+FrameExporter::~FrameExporter()
+{
+  Close();
+}
+
+void FrameExporter::Log( const std::string &message ) const
+{
+  if ( logSink ) {
+    logSink( message );
+  } else {
+    fmt::print( "{}\n", message );
+  }
+}
+
+bool FrameExporter::Open( const std::string &name, PixelFormat format, u32 slots )
+{
+  Close();
+#if defined( _WIN32 )
+  (void) name;
+  (void) format;
+  (void) slots;
+  Log( "FrameExporter: shared memory export is POSIX only" );
+  return false;
+#else
+  if ( slots == 0 ) {
+    Log( "FrameExporter: need at least one slot" );
+    return false;
+  }
+  std::size_t const bytes = MappingBytes( format, slots );
+
+  // A previous run that crashed leaves its object behind, start from a fresh one
+  shm_unlink( name.c_str() );
+  int const fd = shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 ); // NOLINT
+  if ( fd < 0 ) {
+    Log( fmt::format( "FrameExporter: could not create {}", name ) );
+    return false;
+  }
+  if ( ftruncate( fd, static_cast<off_t>( bytes ) ) != 0 ) {
+    Log( fmt::format( "FrameExporter: could not size {}", name ) );
+    close( fd );
+    shm_unlink( name.c_str() );
+    return false;
+  }
+  void *mem = mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd ); // the mapping keeps its own reference
+  if ( mem == MAP_FAILED ) { // NOLINT
+    Log( fmt::format( "FrameExporter: could not map {}", name ) );
+    shm_unlink( name.c_str() );
+    return false;
+  }
+
+  // New objects are zero filled, which is every slot's "never written" sequence
+  _header = new ( mem ) RingHeader{};
+  _header->slotCount = slots;
+  _header->format = format;
+  _header->slotBytes = SlotBytes( format );
+  _header->pixelBytes = PixelBytes( format );
+  _header->version = version;
+  _slots = static_cast<u8 *>( mem ) + sizeof( RingHeader );
+  for ( u32 i = 0; i < slots; ++i ) {
+    new ( _slots + ( i * SlotBytes( format ) ) ) SlotHeader{};
+  }
+  // Readers treat the magic as "ready", it goes in last
+  std::atomic_ref<u32>( _header->magic ).store( magic, std::memory_order_release );
+
+  _mappingBytes = bytes;
+  _name = name;
+  _format = format;
+  _indices.assign( format == PixelFormat::PaletteIndex ? PixelBytes( format ) : 0, 0 );
+  _deadWaiters = 0;
+  _emptyWakes = 0;
+  return true;
+#endif
+}
+
+void FrameExporter::Close()
+{
+#if !defined( _WIN32 )
+  if ( _header != nullptr ) {
+    munmap( _header, _mappingBytes );
+    shm_unlink( _name.c_str() );
+  }
+#endif
+  _header = nullptr;
+  _slots = nullptr;
+  _mappingBytes = 0;
+  _name.clear();
+}
+
+u64 FrameExporter::Published() const
+{
+  return _header != nullptr ? _header->published.load( std::memory_order_relaxed ) : 0;
+}
+
+u32 FrameExporter::Waiters() const
+{
+  return _header != nullptr ? _header->waiters.load( std::memory_order_relaxed ) : 0;
+}
+
+void FrameExporter::Attach( Bus &bus )
+{
+  if ( _format == PixelFormat::PaletteIndex && !_indices.empty() ) {
+    bus.ppu.SetFrameOutput( nullptr, _indices.data() );
+  }
+}
+
+void FrameExporter::Publish( Bus &bus )
+{
+  if ( _header == nullptr ) {
+    return;
+  }
+  u64 const   n = _header->published.load( std::memory_order_relaxed );
+  u8 *const   slot = _slots + ( ( n % _header->slotCount ) * _header->slotBytes );
+  auto *const info = std::launder( reinterpret_cast<SlotHeader *>( slot ) ); // NOLINT
+
+  // Odd sequence first, so readers can tell the slot is being rewritten
+  info->sequence.store( ( 2 * n ) + 1, std::memory_order_relaxed );
+  std::atomic_thread_fence( std::memory_order_release );
+
+  info->frame = bus.ppu.frame;
+  info->stateHash = bus.StateHash();
+  info->input = { bus.controller[0], bus.controller[1] };
+  bus.GetRam().CopyTo( slot + ramOffset );
+  void const *pixels = _format == PixelFormat::Rgba ? static_cast<void const *>( bus.ppu.GetFrameOutput() )
+                                                    : static_cast<void const *>( _indices.data() );
+  std::memcpy( slot + pixelOffset, pixels, _header->pixelBytes );
+
+  info->sequence.store( ( 2 * n ) + 2, std::memory_order_release );
+  _header->published.store( n + 1, std::memory_order_release );
+  _header->wakeWord.fetch_add( 1, std::memory_order_seq_cst );
+  Wake();
+}
+
+void FrameExporter::Wake()
+{
+  /** @brief Wakes readers asleep in WaitFor(), skipping the syscall when nobody can be
+   * Readers count themselves in waiters around the futex wait, so a reader that dies there stays
+   * counted forever. A live reader that is counted is either asleep, and woken here, or about to
+   * see the changed wakeWord and not sleep. So after a run of wakes that find nobody, the fewest
+   * waiters seen over the run are dead, and only a count above that means someone may be asleep.
+   * Should the count drop below that, a live reader was taken for dead and the baseline follows.
+   */
+#if defined( __linux__ )
+  u32 const waiters = _header->waiters.load( std::memory_order_seq_cst );
+  _deadWaiters = std::min( _deadWaiters, waiters );
+  if ( waiters <= _deadWaiters ) {
+    return;
+  }
+  ++_wakeCalls;
+  long const woken = syscall( SYS_futex, &_header->wakeWord, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 ); // NOLINT
+  if ( woken > 0 ) {
+    _emptyWakes = 0;
+    return;
+  }
+  _emptyWakesMin = _emptyWakes == 0 ? waiters : std::min( _emptyWakesMin, waiters );
+  if ( ++_emptyWakes == staleAfterWakes ) {
+    _deadWaiters = _emptyWakesMin;
+    _emptyWakes = 0;
+  }
+#endif
+}
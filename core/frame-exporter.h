@@ -0,0 +1,94 @@
+#pragma once
+#include "frame-export-layout.h"
+#include "global-types.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Bus;
+
+/*
+################################
+||       Frame Exporter       ||
+################################
+  Publishes every completed frame of a Bus into a POSIX shared memory ring: the frame as RGBA or
+  palette indices, the 2KB of CPU RAM, and the frame number, controller input and state hash.
+  See frame-export-layout.h for the layout and frame-reader.h for the consumer side.
+
+    FrameExporter exporter;
+    exporter.Open( "/nes_frames", FrameExporter::PixelFormat::PaletteIndex );
+    exporter.Attach( bus );
+    while ( running ) {
+      bus.RunFrame();
+      exporter.Publish( bus );
+    }
+
+  Publishing copies about 250KB (RGBA) or 64KB (indices) into the ring and never blocks on
+  readers. Readers that fall more than a ring behind miss frames. POSIX only, Open() fails on
+  Windows.
+
+  A reader killed while asleep in FrameReader::WaitFor() is never taken off the ring's waiter
+  count. Once a run of wakes finds nobody asleep, Publish() treats the waiters it still sees as
+  dead and only wakes when more than that many are counted, so a crashed reader doesn't cost a
+  syscall per frame for the rest of the run.
+*/
+
+class FrameExporter
+{
+public:
+  using PixelFormat = frame_export::PixelFormat;
+
+  FrameExporter() = default;
+  ~FrameExporter();
+
+  FrameExporter( const FrameExporter & ) = delete;
+  FrameExporter &operator=( const FrameExporter & ) = delete;
+  FrameExporter( FrameExporter && ) = delete;
+  FrameExporter &operator=( FrameExporter && ) = delete;
+
+  // Where Open() reports errors, see Bus::logSink. Prints to stdout when empty.
+  std::function<void( const std::string & )> logSink;
+
+  // Create the shared memory object name ("/something"), replacing any stale one. Returns false,
+  // after logging why, if it can't be created.
+  bool Open( const std::string &name, PixelFormat format = PixelFormat::Rgba, u32 slots = 8 );
+  // Unmap and unlink, readers keep their mappings until they close
+  void Close();
+
+  [[nodiscard]] bool        IsOpen() const { return _header != nullptr; }
+  [[nodiscard]] PixelFormat Format() const { return _format; }
+  [[nodiscard]] u64         Published() const;
+
+  // Readers counted as asleep in WaitFor(), dead ones included, and the futex wakes made so far.
+  // For tests and diagnostics.
+  [[nodiscard]] u32 Waiters() const;
+  [[nodiscard]] u64 WakeCalls() const { return _wakeCalls; }
+
+  // For palette indices, has bus's PPU write them to a buffer owned by the exporter. Call once
+  // before running; a no-op for RGBA.
+  void Attach( Bus &bus );
+
+  // Publish bus's current frame. Hashes the state (incrementally), so call between frames.
+  void Publish( Bus &bus );
+
+private:
+  // Wakes in a row that find nobody asleep before the waiters still counted are taken as dead
+  static constexpr u32 staleAfterWakes = 64;
+
+  void Log( const std::string &message ) const;
+  void Wake();
+
+  frame_export::RingHeader *_header = nullptr;
+  u8                       *_slots = nullptr;
+  std::size_t               _mappingBytes = 0;
+  std::string               _name;
+  PixelFormat               _format = PixelFormat::Rgba;
+  std::vector<u8>           _indices; // PPU index output in PaletteIndex format
+
+  u32 _deadWaiters = 0; // waiters no wake has found asleep, see Wake()
+  u32 _emptyWakes = 0;
+  u32 _emptyWakesMin = 0; // fewest waiters seen over the current run of empty wakes
+  u64 _wakeCalls = 0;
+};
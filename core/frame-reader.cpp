@@ -0,0 +1,173 @@
+#include "frame-reader.h"
+#include "frame-export-layout.h"
+#include "global-types.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <new>
+#include <string>
+#include <thread>
+
+#if !defined( _WIN32 )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined( __linux__ )
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace frame_export; // NOLINT
+
+FrameReader::~FrameReader()
+{
+  Close();
+}
+
+bool FrameReader::Open( const std::string &name )
+{
+  Close();
+#if defined( _WIN32 )
+  (void) name;
+  return false;
+#else
+  // Read-write, waiting readers register in the header
+  int const fd = shm_open( name.c_str(), O_RDWR, 0 ); // NOLINT
+  if ( fd < 0 ) {
+    return false;
+  }
+  struct stat st {};
+  if ( fstat( fd, &st ) != 0 || static_cast<std::size_t>( st.st_size ) < sizeof( RingHeader ) ) {
+    close( fd );
+    return false;
+  }
+  auto const bytes = static_cast<std::size_t>( st.st_size );
+  void      *mem = mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd );
+  if ( mem == MAP_FAILED ) { // NOLINT
+    return false;
+  }
+
+  auto *header = std::launder( static_cast<RingHeader *>( mem ) );
+  bool  valid = std::atomic_ref<u32>( header->magic ).load( std::memory_order_acquire ) == magic &&
+               header->version == version && header->slotCount > 0 &&
+               header->slotBytes == SlotBytes( header->format ) &&
+               bytes >= MappingBytes( header->format, header->slotCount );
+  if ( !valid ) {
+    munmap( mem, bytes );
+    return false;
+  }
+  _header = header;
+  _slots = static_cast<const u8 *>( mem ) + sizeof( RingHeader );
+  _mappingBytes = bytes;
+  return true;
+#endif
+}
+
+void FrameReader::Close()
+{
+#if !defined( _WIN32 )
+  if ( _header != nullptr ) {
+    munmap( _header, _mappingBytes );
+  }
+#endif
+  _header = nullptr;
+  _slots = nullptr;
+  _mappingBytes = 0;
+}
+
+u32 FrameReader::SlotCount() const
+{
+  return _header != nullptr ? _header->slotCount : 0;
+}
+
+FrameReader::PixelFormat FrameReader::Format() const
+{
+  return _header != nullptr ? _header->format : PixelFormat::Rgba;
+}
+
+u64 FrameReader::Published() const
+{
+  return _header != nullptr ? _header->published.load( std::memory_order_acquire ) : 0;
+}
+
+const SlotHeader *FrameReader::Slot( u64 index ) const
+{
+  return std::launder(
+      reinterpret_cast<const SlotHeader *>( _slots + ( ( index % _header->slotCount ) * _header->slotBytes ) ) ); // NOLINT
+}
+
+bool FrameReader::Read( u64 index, Frame &out ) const
+{
+  if ( _header == nullptr || index >= Published() ) {
+    return false;
+  }
+  const SlotHeader *slot = Slot( index );
+  if ( slot->sequence.load( std::memory_order_acquire ) != ( 2 * index ) + 2 ) {
+    return false; // overwritten, or being overwritten
+  }
+
+  auto const *base = reinterpret_cast<const u8 *>( slot ); // NOLINT
+  out.index = index;
+  out.frame = slot->frame;
+  out.stateHash = slot->stateHash;
+  out.input = slot->input;
+  out.format = _header->format;
+  out.pixels = base + pixelOffset;
+  out.pixelBytes = _header->pixelBytes;
+  out.ram = base + ramOffset;
+
+  // The header fields were copied, make sure they weren't torn
+  return IsIntact( out );
+}
+
+bool FrameReader::Latest( Frame &out ) const
+{
+  u64 const published = Published();
+  return published > 0 && Read( published - 1, out );
+}
+
+bool FrameReader::IsIntact( const Frame &frame ) const
+{
+  if ( _header == nullptr ) {
+    return false;
+  }
+  std::atomic_thread_fence( std::memory_order_acquire );
+  return Slot( frame.index )->sequence.load( std::memory_order_relaxed ) == ( 2 * frame.index ) + 2;
+}
+
+bool FrameReader::WaitFor( u64 count, std::chrono::milliseconds timeout ) const
+{
+  if ( _header == nullptr ) {
+    return false;
+  }
+  auto const deadline = std::chrono::steady_clock::now() + timeout;
+  while ( Published() < count ) {
+    auto const left = deadline - std::chrono::steady_clock::now();
+    if ( left <= std::chrono::steady_clock::duration::zero() ) {
+      return false;
+    }
+#if defined( __linux__ )
+    // Registered before reading the word, so a publish in between either is seen below or
+    // sees us waiting and wakes the futex
+    _header->waiters.fetch_add( 1, std::memory_order_seq_cst );
+    u32 const word = _header->wakeWord.load( std::memory_order_seq_cst );
+    if ( Published() < count ) {
+      auto const     ns = std::chrono::duration_cast<std::chrono::nanoseconds>( left ).count();
+      struct timespec wait {};
+      wait.tv_sec = static_cast<time_t>( ns / 1'000'000'000 );
+      wait.tv_nsec = static_cast<long>( ns % 1'000'000'000 );
+      syscall( SYS_futex, &_header->wakeWord, FUTEX_WAIT, word, &wait, nullptr, 0 ); // NOLINT
+    }
+    _header->waiters.fetch_sub( 1, std::memory_order_seq_cst );
+#else
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+#endif
+  }
+  return true;
+}
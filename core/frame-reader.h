@@ -0,0 +1,85 @@
+#pragma once
+#include "frame-export-layout.h"
+#include "global-types.h"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/*
+################################
+||        Frame Reader        ||
+################################
+  Consumer side of FrameExporter, for other processes. Only depends on frame-export-layout.h and
+  is also built on its own as the emu_frame_reader library.
+
+    FrameReader reader;
+    reader.Open( "/nes_frames" );
+    u64 next = reader.Published();
+    FrameReader::Frame frame;
+    while ( reader.WaitFor( next + 1, std::chrono::seconds( 1 ) ) ) {
+      if ( reader.Read( next, frame ) ) {
+        Consume( frame.pixels, frame.ram );
+        if ( !reader.IsIntact( frame ) ) { ... the producer lapped us, drop what Consume() did }
+      }
+      ++next;
+    }
+
+  Frames point straight into the shared ring, nothing is copied. Reading and polling are plain
+  memory accesses; only WaitFor() sleeps in the kernel, and only when no frame is ready.
+*/
+
+class FrameReader
+{
+public:
+  using PixelFormat = frame_export::PixelFormat;
+
+  // View of one published frame, valid until the producer reuses its slot (see IsIntact())
+  struct Frame {
+    u64               index = 0; // publish order, counting from 0
+    u64               frame = 0; // PPU frame counter
+    u64               stateHash = 0;
+    std::array<u8, 2> input{};
+    PixelFormat       format = PixelFormat::Rgba;
+    const u8         *pixels = nullptr;
+    std::size_t       pixelBytes = 0;
+    const u8         *ram = nullptr; // frame_export::ramSize bytes
+  };
+
+  FrameReader() = default;
+  ~FrameReader();
+
+  FrameReader( const FrameReader & ) = delete;
+  FrameReader &operator=( const FrameReader & ) = delete;
+  FrameReader( FrameReader && ) = delete;
+  FrameReader &operator=( FrameReader && ) = delete;
+
+  // Map an exporter's ring. False if it doesn't exist (yet) or isn't a compatible ring.
+  bool Open( const std::string &name );
+  void Close();
+
+  [[nodiscard]] bool        IsOpen() const { return _header != nullptr; }
+  [[nodiscard]] u32         SlotCount() const;
+  [[nodiscard]] PixelFormat Format() const;
+
+  // Frames published so far. Frame i stays readable until frame i + SlotCount() is published.
+  [[nodiscard]] u64 Published() const;
+
+  // Frame index, if it's published and not yet overwritten
+  bool Read( u64 index, Frame &out ) const;
+  // Newest complete frame
+  bool Latest( Frame &out ) const;
+  // Whether frame's data is still what was published, check after using it
+  [[nodiscard]] bool IsIntact( const Frame &frame ) const;
+
+  // Block until at least count frames are published. False on timeout.
+  bool WaitFor( u64 count, std::chrono::milliseconds timeout ) const;
+
+private:
+  [[nodiscard]] const frame_export::SlotHeader *Slot( u64 index ) const;
+
+  frame_export::RingHeader *_header = nullptr;
+  const u8                 *_slots = nullptr;
+  std::size_t               _mappingBytes = 0;
+};
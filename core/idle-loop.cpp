@@ -0,0 +1,224 @@
+#include "idle-loop.h"
+#include "bus.h"
+#include "cpu-types.h"
+#include "cpu.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace
+{
+// Instructions an idle loop body may contain besides the jump back: they read one byte and only
+// change registers and flags
+constexpr std::array<std::string_view, 10> readOnlyOps = { "LDA", "LDX", "LDY", "BIT", "CMP",
+                                                           "CPX", "CPY", "AND", "ORA", "EOR" };
+
+// RAM, or PPUSTATUS through any of its mirrors
+bool IsPollable( u16 address )
+{
+  return address < 0x2000 || ( address < 0x4000 && ( address & 0x0007 ) == 0x0002 );
+}
+} // namespace
+
+void IdleLoop::Reset()
+{
+  _state = State::None;
+  _opCount = 0;
+  _nextOp = 0;
+  _rejectedHead = 0;
+  _rejectedTail = 0;
+}
+
+IdleLoop::Registers IdleLoop::CurrentRegisters() const
+{
+  CPU const &cpu = _bus->cpu;
+  return { .a = cpu.a, .x = cpu.x, .y = cpu.y, .p = cpu.GetStatusRegister() };
+}
+
+void IdleLoop::Observe( u16 fromPc )
+{
+  CPU const &cpu = _bus->cpu;
+  u16 const  pc = cpu.pc;
+
+  // Only short backward jumps (or a jump to itself) close a loop
+  if ( pc > fromPc || fromPc - pc > maxBodyBytes || !enabled ) {
+    return;
+  }
+  // Trace logs want every instruction
+  if ( !cpu.UsesProductionStep() ) {
+    return;
+  }
+
+  // Back at the head of the loop we decoded: idle if nothing changed over the iteration
+  if ( _state != State::None && pc == _head && fromPc == _tail ) {
+    Registers const registers = CurrentRegisters();
+    if ( registers == _entry ) {
+      _state = State::Idle;
+      _nextOp = 0;
+      _stats.loops++;
+    } else {
+      _entry = registers;
+    }
+    return;
+  }
+
+  // Delay loops and the like come back here thousands of times, don't decode them every time
+  if ( pc == _rejectedHead && fromPc == _rejectedTail ) {
+    return;
+  }
+  if ( !Decode( pc, fromPc ) ) {
+    _state = State::None;
+    _rejectedHead = pc;
+    _rejectedTail = fromPc;
+    return;
+  }
+  _state = State::Candidate;
+  _head = pc;
+  _tail = fromPc;
+  _entry = CurrentRegisters();
+}
+
+bool IdleLoop::Decode( u16 head, u16 tail )
+{
+  /** @brief Decodes head..tail into _ops, if it's a loop that can be idle
+   * Code has to be in PRG ROM, which only changes through mapper writes (those call Reset()).
+   */
+  if ( head < 0x8000 ) {
+    return false;
+  }
+  CPU const  &cpu = _bus->cpu;
+  auto const  read = [&]( u16 address ) { return cpu.Read( address, true ); };
+  auto const &table = CPU::OpcodeTable<ProductionStep>();
+  std::size_t count = 0;
+  u16         pc = head;
+
+  while ( count < maxOps ) {
+    u8 const           opcode = read( pc );
+    std::string const &name = gInstructionNames.at( opcode );
+    std::string const &mode = gAddressingModes.at( opcode );
+    Op                 op{ .pc = pc, .opcode = opcode, .handler = table.at( opcode ).handler };
+
+    if ( pc == tail ) {
+      // The jump back: a branch, or JMP absolute
+      if ( mode == "REL" ) {
+        op.next = pc + 2;
+        op.address = op.next + static_cast<s8>( read( pc + 1 ) );
+        op.fetchTicks = 2;
+      } else if ( opcode == 0x4C ) {
+        op.next = pc + 3;
+        op.address = read( pc + 1 ) | ( read( pc + 2 ) << 8 );
+        op.fetchTicks = 3;
+      } else {
+        return false;
+      }
+      if ( op.address != head ) {
+        return false;
+      }
+      _ops.at( count++ ) = op;
+      _opCount = count;
+      return true;
+    }
+
+    if ( opcode == 0xEA ) {
+      op.next = pc + 1;
+      op.fetchTicks = 2; // opcode and the implied dummy read
+    } else if ( std::ranges::find( readOnlyOps, name ) != readOnlyOps.end() ) {
+      if ( mode == "IMM" ) {
+        op.next = pc + 2;
+        op.address = pc + 1;
+        op.fetchTicks = 1;
+      } else if ( mode == "ZPG" ) {
+        op.next = pc + 2;
+        op.address = read( pc + 1 );
+        op.fetchTicks = 2;
+      } else if ( mode == "ABS" ) {
+        op.next = pc + 3;
+        op.address = read( pc + 1 ) | ( read( pc + 2 ) << 8 );
+        op.fetchTicks = 3;
+        if ( !IsPollable( op.address ) ) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    // Runs past the jump back, or straddles it
+    if ( op.next > tail ) {
+      return false;
+    }
+    _ops.at( count++ ) = op;
+    pc = op.next;
+  }
+  return false;
+}
+
+bool IdleLoop::EventDue( u64 frame ) const
+{
+  /** @brief Whether Bus::Clock() would do anything after the current instruction
+   * A pending APU IRQ is ignored while the I flag is set, CPU::IRQ() would do nothing with it.
+   */
+  Bus const &bus = *_bus;
+  return bus.ppu.nmiReady || bus.ppu.frame != frame || bus.cpu.cycles >= bus.apu.next_event() ||
+         ( bus.apu.irq_pending() && ( bus.cpu.p & CPU::InterruptDisable ) == 0 ) ||
+         bus.cartridge.GetMapper()->IsIrqRequested();
+}
+
+bool IdleLoop::Run( u64 frame )
+{
+  if ( _state != State::Idle ) {
+    return false;
+  }
+  CPU &cpu = _bus->cpu;
+
+  // Something else ran since (an interrupt handler, a state load), look for the loop again
+  if ( cpu.pc != _ops.at( _nextOp ).pc || !enabled || !cpu.UsesProductionStep() ) {
+    _state = State::None;
+    return false;
+  }
+
+  u64 const start = cpu.cycles;
+  Op const *last = nullptr;
+  while ( true ) {
+    Op const &op = _ops.at( _nextOp );
+    for ( u8 i = 0; i < op.fetchTicks; ++i ) {
+      cpu.Tick();
+    }
+    cpu.pc = op.next;
+    cpu.opcode = op.opcode;
+    ( cpu.*op.handler )( op.address );
+    last = &op;
+
+    if ( ++_nextOp == _opCount ) {
+      _nextOp = 0;
+      // Fell out of the loop, or the iteration changed something and it's no longer idle
+      if ( cpu.pc != _head ) {
+        _state = State::None;
+        break;
+      }
+      Registers const registers = CurrentRegisters();
+      if ( registers != _entry ) {
+        _state = State::Candidate;
+        _entry = registers;
+        break;
+      }
+    }
+    if ( EventDue( frame ) ) {
+      break;
+    }
+  }
+  _stats.replayedCycles += cpu.cycles - start;
+
+  // What DecodeExecute() leaves behind for the last instruction, it's part of the save state
+  cpu.instructionName = gInstructionNames.at( last->opcode );
+  cpu.addrMode = gAddressingModes.at( last->opcode );
+  cpu.pageCrossPenalty = isPageCrossPenalty( last->opcode );
+  cpu.writeModify = false;
+  cpu.didMesenTrace = false;
+  return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+
+class Bus;
+class CPU;
+
+/*
+################################
+||       Idle Loop Skip       ||
+################################
+  Most games spend a good part of every frame spinning on something like
+
+    wait: LDA $2002     or     wait: LDA nmiDone     or     wait: JMP wait
+          BPL wait                   BEQ wait
+
+  until the NMI arrives. Bus::Clock() reports every short backward branch or JMP here. If the
+  loop body is only loads, compares and bit tests of RAM, $2002 or immediates, ends in that jump
+  and an iteration leaves A, X, Y and P exactly as it found them, the loop is idle.
+
+  Bus::RunFrame() then hands an idle loop to Run(), which replays it from the decoded body: the
+  opcode and operand fetches become plain ticks (they read ROM, which has no side effects) and
+  only the data reads go through the instruction handlers, so the $2002 race and flag reads see
+  exactly what the interpreter would have. Run() stops at the first instruction boundary where
+  the bus has anything to do (NMI, mapper or APU IRQ, an APU event, a new frame) or when the loop
+  stops being idle, so cycle counts, interrupt timing and save states are unchanged. The PPU and
+  APU still run every cycle; what is skipped is decoding and dispatching each iteration.
+
+  Bus::Clock() never skips, so single stepping and run-to-PC stop on every instruction.
+*/
+
+struct IdleLoopStats {
+  u64 loops = 0;          // times an idle loop was entered
+  u64 replayedCycles = 0; // cycles Run() replayed rather than the interpreter decoding them
+  u64 startCycle = 0;     // CPU cycle the stats were reset at
+
+  // Share of CPU cycles since the reset that were replayed
+  [[nodiscard]] double ReplayedShare( u64 cpuCycles ) const
+  {
+    return cpuCycles > startCycle
+               ? static_cast<double>( replayedCycles ) / static_cast<double>( cpuCycles - startCycle )
+               : 0.0;
+  }
+};
+
+class IdleLoop
+{
+public:
+  explicit IdleLoop( Bus *bus ) : _bus( bus ) {}
+
+  bool enabled = true;
+
+  // Called by Bus::Clock() after the interpreter ran the instruction at fromPc
+  void Observe( u16 fromPc );
+
+  // Replays the idle loop the CPU is in, see above. False, without running anything, when the CPU
+  // isn't in one. After true, the caller handles interrupts and events like Bus::Clock() does.
+  bool Run( u64 frame );
+
+  // Forget the current loop. Anything that can change code or CPU state behind the interpreter's
+  // back (state loads, resets, mapper writes) calls this.
+  void Reset();
+
+  [[nodiscard]] bool                 IsActive() const { return _state == State::Idle; }
+  [[nodiscard]] const IdleLoopStats &Stats() const { return _stats; }
+  void                               ResetStats( u64 cpuCycles ) { _stats = IdleLoopStats{ .startCycle = cpuCycles }; }
+
+  static constexpr u16         maxBodyBytes = 16;
+  static constexpr std::size_t maxOps = 8;
+
+private:
+  enum class State : u8 { None, Candidate, Idle };
+
+  // One decoded instruction of the loop body
+  struct Op {
+    u16 pc = 0;
+    u16 next = 0;    // pc after the fetch, before the handler runs
+    u16 address = 0; // what the addressing mode would have returned
+    u8  opcode = 0;
+    u8  fetchTicks = 0; // cycles of the opcode fetch and addressing mode
+    void ( CPU::*handler )( u16 ){};
+  };
+
+  struct Registers {
+    u8   a = 0;
+    u8   x = 0;
+    u8   y = 0;
+    u8   p = 0;
+    bool operator==( const Registers & ) const = default;
+  };
+
+  bool                    Decode( u16 head, u16 tail );
+  [[nodiscard]] bool      EventDue( u64 frame ) const;
+  [[nodiscard]] Registers CurrentRegisters() const;
+
+  Bus                   *_bus;
+  State                  _state = State::None;
+  std::array<Op, maxOps> _ops{};
+  std::size_t            _opCount = 0;
+  std::size_t            _nextOp = 0; // where Run() resumes
+  u16                    _head = 0;
+  u16                    _tail = 0;
+  Registers              _entry; // registers at the head, one iteration ago
+  u16                    _rejectedHead = 0;
+  u16                    _rejectedTail = 0;
+  IdleLoopStats          _stats;
+};
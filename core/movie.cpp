@@ -0,0 +1,259 @@
+#include "movie.h"
+#include "bus.h"
+#include "global-types.h"
+#include "save-writer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fmt/base.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+constexpr std::array<u8, 4> movieMagic = { 'N', 'E', 'S', 'M' };
+constexpr u8                movieVersion = 1;
+constexpr u8                flagHashes = 0x01;
+constexpr u8                flagSaveState = 0x02;
+constexpr std::size_t       headerSize = 32;
+constexpr std::size_t       romHashSize = 16;
+
+void PutLe( std::vector<u8> &out, u64 value, int bytes )
+{
+  for ( int i = 0; i < bytes; ++i ) {
+    out.push_back( static_cast<u8>( value >> ( i * 8 ) ) );
+  }
+}
+
+void StoreLe( u8 *out, u64 value, int bytes )
+{
+  for ( int i = 0; i < bytes; ++i ) {
+    out[i] = static_cast<u8>( value >> ( i * 8 ) ); // NOLINT
+  }
+}
+
+u64 GetLe( const u8 *in, int bytes )
+{
+  u64 value = 0;
+  for ( int i = 0; i < bytes; ++i ) {
+    value |= static_cast<u64>( in[i] ) << ( i * 8 ); // NOLINT
+  }
+  return value;
+}
+} // namespace
+
+/*
+################################
+||          Recording         ||
+################################
+*/
+void Movie::StartRecording( Bus &bus, MovieStart start, bool withHashes )
+{
+  if ( start == MovieStart::PowerOn ) {
+    bus.PowerCycle();
+  }
+
+  std::vector<u8> raw;
+  bus.SaveStateToMemory( raw );
+  SaveWriter::Compress( raw, _snapshot );
+
+  _mode = MovieMode::Recording;
+  _start = start;
+  _withHashes = withHashes;
+  _romHash = bus.cartridge.GetRomHash();
+  _pendingEvent = MovieEvent::None;
+  _frames.clear();
+  _cursor = 0;
+  _desyncFrame = -1;
+}
+
+bool Movie::StopRecording( const std::string &path )
+{
+  if ( _mode != MovieMode::Recording ) {
+    return false;
+  }
+  _mode = MovieMode::Inactive;
+
+  // Fixed layout, see movie.h. Bytes 6-7 are reserved and stay zero.
+  std::array<u8, headerSize> header{};
+  std::memcpy( header.data(), movieMagic.data(), movieMagic.size() );
+  header[4] = movieVersion;
+  header[5] = static_cast<u8>( ( _withHashes ? flagHashes : 0 ) |
+                               ( _start == MovieStart::SaveState ? flagSaveState : 0 ) );
+  std::memcpy( &header[8], _romHash.data(), std::min( _romHash.size(), romHashSize ) );
+  StoreLe( &header[24], _frames.size(), 4 );
+  StoreLe( &header[28], _snapshot.size(), 4 );
+
+  std::vector<u8> out;
+  out.reserve( headerSize + _snapshot.size() + ( _frames.size() * ( _withHashes ? 11 : 3 ) ) );
+  out.resize( headerSize + _snapshot.size() );
+  std::memcpy( out.data(), header.data(), headerSize );
+  std::ranges::copy( _snapshot, out.begin() + headerSize );
+
+  for ( const auto &frame : _frames ) {
+    out.push_back( frame.controller[0] );
+    out.push_back( frame.controller[1] );
+    out.push_back( static_cast<u8>( frame.event ) );
+    if ( _withHashes ) {
+      PutLe( out, frame.hash, 8 );
+    }
+  }
+
+  std::string error;
+  if ( !SaveWriter::WriteFileAtomic( path, out, error ) ) {
+    fmt::print( "Movie: failed to write {}: {}\n", path, error );
+    return false;
+  }
+  return true;
+}
+
+/*
+################################
+||          Playback          ||
+################################
+*/
+bool Movie::Load( const std::string &path )
+{
+  std::ifstream in( path, std::ios::binary );
+  if ( !in ) {
+    fmt::print( "Movie: could not open {}\n", path );
+    return false;
+  }
+  std::vector<u8> const data( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+
+  if ( data.size() < headerSize || std::memcmp( data.data(), movieMagic.data(), movieMagic.size() ) != 0 ) {
+    fmt::print( "Movie: {} is not a movie file\n", path );
+    return false;
+  }
+  if ( data[4] != movieVersion ) {
+    fmt::print( "Movie: unsupported version {}\n", data[4] );
+    return false;
+  }
+
+  u8 const          flags = data[5];
+  bool const        withHashes = ( flags & flagHashes ) != 0;
+  std::size_t const frameCount = GetLe( &data[24], 4 );
+  std::size_t const snapshotSize = GetLe( &data[28], 4 );
+  std::size_t const frameSize = withHashes ? 11 : 3;
+
+  if ( data.size() != headerSize + snapshotSize + ( frameCount * frameSize ) ) {
+    fmt::print( "Movie: {} is truncated\n", path );
+    return false;
+  }
+
+  // Decode the frames first, so a bad file leaves the loaded movie as it was
+  std::vector<MovieFrame> frames( frameCount );
+  const u8               *cursor = &data[headerSize + snapshotSize];
+  for ( std::size_t i = 0; i < frameCount; ++i ) {
+    u8 const event = cursor[2]; // NOLINT
+    if ( event > static_cast<u8>( MovieEvent::Power ) ) {
+      fmt::print( "Movie: {} has an unknown event {} on frame {}\n", path, event, i );
+      return false;
+    }
+    frames[i].controller[0] = cursor[0];                      // NOLINT
+    frames[i].controller[1] = cursor[1];                      // NOLINT
+    frames[i].event = static_cast<MovieEvent>( event );
+    frames[i].hash = withHashes ? GetLe( cursor + 3, 8 ) : 0; // NOLINT
+    cursor += frameSize;                                      // NOLINT
+  }
+
+  _withHashes = withHashes;
+  _start = ( flags & flagSaveState ) != 0 ? MovieStart::SaveState : MovieStart::PowerOn;
+  _romHash.assign( reinterpret_cast<const char *>( &data[8] ), romHashSize ); // NOLINT
+  _romHash.erase( _romHash.find_last_not_of( '\0' ) + 1 );
+  _snapshot.assign( data.begin() + headerSize, data.begin() + static_cast<std::ptrdiff_t>( headerSize + snapshotSize ) );
+
+  _frames = std::move( frames );
+  _mode = MovieMode::Inactive;
+  _cursor = 0;
+  _desyncFrame = -1;
+  return true;
+}
+
+bool Movie::StartPlayback( Bus &bus )
+{
+  if ( _snapshot.empty() ) {
+    return false;
+  }
+  if ( _romHash != bus.cartridge.GetRomHash() ) {
+    fmt::print( "Movie: recorded with rom {}, but {} is loaded\n", _romHash, bus.cartridge.GetRomHash() );
+    return false;
+  }
+
+  std::vector<u8> raw;
+  if ( !SaveWriter::Decompress( _snapshot.data(), _snapshot.size(), raw ) ||
+       !bus.LoadStateFromMemory( raw.data(), raw.size() ) ) {
+    fmt::print( "Movie: corrupt start snapshot\n" );
+    return false;
+  }
+
+  _mode = MovieMode::Playing;
+  _cursor = 0;
+  _desyncFrame = -1;
+  return true;
+}
+
+/*
+################################
+||         Frame Loop         ||
+################################
+*/
+bool Movie::RunFrame( Bus &bus )
+{
+  switch ( _mode ) {
+    case MovieMode::Recording: {
+      MovieFrame frame;
+      frame.controller[0] = bus.controller[0];
+      frame.controller[1] = bus.controller[1];
+      frame.event = _pendingEvent;
+      _pendingEvent = MovieEvent::None;
+
+      ApplyEvent( bus, frame.event );
+      bus.RunFrame();
+      if ( _withHashes ) {
+        frame.hash = HashState( bus );
+      }
+      _frames.push_back( frame );
+      _cursor = _frames.size();
+      return true;
+    }
+    case MovieMode::Playing: {
+      if ( _cursor >= _frames.size() || Desynced() ) {
+        return false;
+      }
+      const MovieFrame &frame = _frames[_cursor];
+      bus.controller[0] = frame.controller[0];
+      bus.controller[1] = frame.controller[1];
+
+      ApplyEvent( bus, frame.event );
+      bus.RunFrame();
+      if ( _withHashes && HashState( bus ) != frame.hash ) {
+        _desyncFrame = static_cast<long>( _cursor );
+        fmt::print( "Movie: desync at frame {}\n", _cursor );
+      }
+      _cursor++;
+      return !Desynced();
+    }
+    case MovieMode::Inactive: bus.RunFrame(); return true;
+  }
+  return false;
+}
+
+void Movie::ApplyEvent( Bus &bus, MovieEvent event )
+{
+  switch ( event ) {
+    case MovieEvent::Reset: bus.DebugReset(); break;
+    case MovieEvent::Power: bus.PowerCycle(); break;
+    case MovieEvent::None : break;
+  }
+}
+
+u64 Movie::HashState( Bus &bus )
+{
+  return bus.StateHash();
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "global-types.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Bus;
+
+/*
+################################
+||           Movies           ||
+################################
+  Deterministic input recording and playback.
+
+  A movie is a start snapshot plus one record per frame: both controller bytes, an optional
+  reset / power event applied before the frame runs, and optionally a hash of the machine state
+  taken after the frame. Playback restores the snapshot and feeds the same inputs back in; when
+  hashes are present, the first frame whose state differs is reported as the desync frame.
+
+  Both start types embed a snapshot. A power-on movie power cycles the machine before taking
+  it, so playback doesn't depend on whatever state the emulator happened to be in.
+
+  File layout (little endian):
+    0   "NESM"
+    4   u8  version
+    5   u8  flags: bit 0 = per-frame hashes, bit 1 = started from a save state
+    6   u16 reserved
+    8   16  rom hash (ascii hex)
+    24  u32 frame count
+    28  u32 snapshot size
+    32  ... snapshot (compressed state, see SaveWriter::Compress)
+    ... frames: u8 controller1, u8 controller2, u8 event, [u64 hash]
+*/
+
+enum class MovieEvent : u8 { None = 0, Reset = 1, Power = 2 };
+enum class MovieStart : u8 { PowerOn = 0, SaveState = 1 };
+enum class MovieMode : u8 { Inactive, Recording, Playing };
+
+struct MovieFrame {
+  u8         controller[2]{};
+  MovieEvent event = MovieEvent::None;
+  u64        hash = 0;
+};
+
+class Movie
+{
+public:
+  /*
+  ################################
+  ||          Recording         ||
+  ################################
+  */
+  void StartRecording( Bus &bus, MovieStart start = MovieStart::PowerOn, bool withHashes = false );
+  bool StopRecording( const std::string &path ); // writes the movie file
+
+  // Reset / power events are applied at the start of the next recorded frame
+  void QueueEvent( MovieEvent event ) { _pendingEvent = event; }
+
+  /*
+  ################################
+  ||          Playback          ||
+  ################################
+  */
+  bool Load( const std::string &path );
+  bool StartPlayback( Bus &bus );
+  void Stop() { _mode = MovieMode::Inactive; }
+
+  /*
+  ################################
+  ||         Frame Loop         ||
+  ################################
+  */
+  // Runs one frame through the movie. While recording, input comes from bus.controller. While
+  // playing, bus.controller is overwritten from the movie. Returns false once playback is over
+  // or has desynced.
+  bool RunFrame( Bus &bus );
+
+  /*
+  ################################
+  ||           Status           ||
+  ################################
+  */
+  [[nodiscard]] MovieMode   Mode() const { return _mode; }
+  [[nodiscard]] std::size_t FrameCount() const { return _frames.size(); }
+  [[nodiscard]] std::size_t CurrentFrame() const { return _cursor; }
+  [[nodiscard]] bool        HasHashes() const { return _withHashes; }
+  [[nodiscard]] bool        Desynced() const { return _desyncFrame >= 0; }
+  [[nodiscard]] long        DesyncFrame() const { return _desyncFrame; }
+  [[nodiscard]] bool        Finished() const { return _mode == MovieMode::Playing && _cursor >= _frames.size(); }
+  [[nodiscard]] const std::string &RomHash() const { return _romHash; }
+
+  static u64 HashState( Bus &bus );
+
+private:
+  static void ApplyEvent( Bus &bus, MovieEvent event );
+
+  MovieMode               _mode = MovieMode::Inactive;
+  MovieStart              _start = MovieStart::PowerOn;
+  MovieEvent              _pendingEvent = MovieEvent::None;
+  bool                    _withHashes = false;
+  std::string             _romHash;
+  std::vector<u8>         _snapshot; // compressed
+  std::vector<MovieFrame> _frames;
+  std::size_t             _cursor = 0;
+  long                    _desyncFrame = -1;
+};
@@ -0,0 +1,182 @@
+#include "net-transport.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <fmt/base.h>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+/*
+################################
+||          Loopback          ||
+################################
+*/
+std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>> LoopbackTransport::CreatePair()
+{
+  auto aToB = std::make_shared<Channel>();
+  auto bToA = std::make_shared<Channel>();
+  return { std::unique_ptr<LoopbackTransport>( new LoopbackTransport( bToA, aToB ) ),
+           std::unique_ptr<LoopbackTransport>( new LoopbackTransport( aToB, bToA ) ) };
+}
+
+void LoopbackTransport::Send( const std::vector<u8> &packet )
+{
+  std::lock_guard<std::mutex> const lock( _out->mutex );
+  _out->packets.push_back( packet );
+}
+
+bool LoopbackTransport::Receive( std::vector<u8> &packet )
+{
+  std::lock_guard<std::mutex> const lock( _in->mutex );
+  if ( _in->packets.empty() ) {
+    return false;
+  }
+  packet = std::move( _in->packets.front() );
+  _in->packets.pop_front();
+  return true;
+}
+
+/*
+################################
+||             UDP            ||
+################################
+*/
+UdpTransport::~UdpTransport()
+{
+  Close();
+}
+
+bool UdpTransport::Open( u16 localPort, const std::string &remoteHost, u16 remotePort )
+{
+  Close();
+  SetRemote( remoteHost, remotePort );
+#if defined( _WIN32 )
+  (void) localPort;
+  fmt::print( "UdpTransport: not supported on this platform\n" );
+  return false;
+#else
+  _socket = socket( AF_INET, SOCK_DGRAM, 0 );
+  if ( _socket < 0 ) {
+    fmt::print( "UdpTransport: could not create socket\n" );
+    return false;
+  }
+
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons( localPort );
+  addr.sin_addr.s_addr = htonl( INADDR_ANY );
+  if ( bind( _socket, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) ) != 0 ) { // NOLINT
+    fmt::print( "UdpTransport: could not bind port {}\n", localPort );
+    Close();
+    return false;
+  }
+
+  socklen_t len = sizeof( addr );
+  getsockname( _socket, reinterpret_cast<sockaddr *>( &addr ), &len ); // NOLINT
+  _localPort = ntohs( addr.sin_port );
+
+  fcntl( _socket, F_SETFL, fcntl( _socket, F_GETFL, 0 ) | O_NONBLOCK ); // NOLINT
+  return true;
+#endif
+}
+
+void UdpTransport::SetRemote( const std::string &host, u16 port )
+{
+  _remoteHost = host;
+  _remotePort = port;
+}
+
+void UdpTransport::Close()
+{
+#if !defined( _WIN32 )
+  if ( _socket >= 0 ) {
+    close( _socket );
+  }
+#endif
+  _socket = -1;
+  _localPort = 0;
+}
+
+void UdpTransport::Send( const std::vector<u8> &packet )
+{
+#if !defined( _WIN32 )
+  if ( _socket < 0 || _remotePort == 0 ) {
+    return;
+  }
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons( _remotePort );
+  if ( inet_pton( AF_INET, _remoteHost.c_str(), &addr.sin_addr ) != 1 ) {
+    fmt::print( "UdpTransport: bad remote address {}\n", _remoteHost );
+    return;
+  }
+  // Datagrams are fire and forget, a full send buffer is the same as a lost packet
+  sendto( _socket, packet.data(), packet.size(), 0, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) ); // NOLINT
+#else
+  (void) packet;
+#endif
+}
+
+bool UdpTransport::Receive( std::vector<u8> &packet )
+{
+#if !defined( _WIN32 )
+  if ( _socket < 0 ) {
+    return false;
+  }
+  std::array<u8, 1500> buffer{};
+  ssize_t const        size = recv( _socket, buffer.data(), buffer.size(), 0 );
+  if ( size <= 0 ) {
+    return false;
+  }
+  packet.assign( buffer.begin(), buffer.begin() + size );
+  return true;
+#else
+  (void) packet;
+  return false;
+#endif
+}
+
+/*
+################################
+||      Latency Injection     ||
+################################
+*/
+bool LatencyTransport::Receive( std::vector<u8> &packet )
+{
+  // Stamp everything that arrived with the time it's allowed out
+  std::vector<u8> incoming;
+  while ( _inner.Receive( incoming ) ) {
+    auto delay = _latency;
+    if ( _jitter.count() > 0 ) {
+      std::uniform_int_distribution<long long> dist( 0, _jitter.count() );
+      delay += std::chrono::milliseconds( dist( _rng ) );
+    }
+    _held.push_back( { now() + delay, std::move( incoming ) } );
+  }
+
+  // Release the earliest due packet. Jitter can make that one that was sent later.
+  auto const current = now();
+  auto       due = std::ranges::min_element( _held, {}, &Delayed::release );
+  if ( due == _held.end() || due->release > current ) {
+    return false;
+  }
+  packet = std::move( due->packet );
+  _held.erase( due );
+  return true;
+}
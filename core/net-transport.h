@@ -0,0 +1,141 @@
+#pragma once
+#include "global-types.h"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+################################
+||       Net Transports       ||
+################################
+  Unreliable datagram transports for netplay. Packets may be delayed, reordered or dropped, the
+  rollback session only relies on every packet arriving intact if it arrives at all.
+
+  - LoopbackTransport: an in-process pair, for tests and local debugging
+  - UdpTransport:      UDP sockets, POSIX only for now
+  - LatencyTransport:  wraps another transport and delays incoming packets by a fixed latency
+                       plus random jitter, to exercise rollback on one machine
+*/
+
+class NetTransport
+{
+public:
+  NetTransport() = default;
+  virtual ~NetTransport() = default;
+
+  NetTransport( const NetTransport & ) = delete;
+  NetTransport &operator=( const NetTransport & ) = delete;
+  NetTransport( NetTransport && ) = delete;
+  NetTransport &operator=( NetTransport && ) = delete;
+
+  virtual void Send( const std::vector<u8> &packet ) = 0;
+  // Non-blocking, returns false when nothing is waiting
+  virtual bool Receive( std::vector<u8> &packet ) = 0;
+};
+
+/*
+################################
+||          Loopback          ||
+################################
+*/
+class LoopbackTransport : public NetTransport
+{
+public:
+  // Two connected ends. Thread safe, so each end may live on its own thread.
+  static std::pair<std::unique_ptr<LoopbackTransport>, std::unique_ptr<LoopbackTransport>> CreatePair();
+
+  void Send( const std::vector<u8> &packet ) override;
+  bool Receive( std::vector<u8> &packet ) override;
+
+private:
+  struct Channel {
+    std::mutex                  mutex;
+    std::deque<std::vector<u8>> packets;
+  };
+
+  LoopbackTransport( std::shared_ptr<Channel> in, std::shared_ptr<Channel> out )
+      : _in( std::move( in ) ), _out( std::move( out ) )
+  {
+  }
+
+  std::shared_ptr<Channel> _in;
+  std::shared_ptr<Channel> _out;
+};
+
+/*
+################################
+||             UDP            ||
+################################
+*/
+class UdpTransport : public NetTransport
+{
+public:
+  UdpTransport() = default;
+  ~UdpTransport() override;
+
+  UdpTransport( const UdpTransport & ) = delete;
+  UdpTransport &operator=( const UdpTransport & ) = delete;
+  UdpTransport( UdpTransport && ) = delete;
+  UdpTransport &operator=( UdpTransport && ) = delete;
+
+  // Binds localPort (0 picks a free one, see LocalPort) and sends to remoteHost:remotePort.
+  // The remote can also be set later, before the first Send.
+  bool Open( u16 localPort, const std::string &remoteHost = "127.0.0.1", u16 remotePort = 0 );
+  void SetRemote( const std::string &host, u16 port );
+  void Close();
+
+  [[nodiscard]] bool IsOpen() const { return _socket >= 0; }
+  [[nodiscard]] u16  LocalPort() const { return _localPort; }
+
+  void Send( const std::vector<u8> &packet ) override;
+  bool Receive( std::vector<u8> &packet ) override;
+
+private:
+  int         _socket = -1;
+  u16         _localPort = 0;
+  std::string _remoteHost;
+  u16         _remotePort = 0;
+};
+
+/*
+################################
+||      Latency Injection     ||
+################################
+*/
+class LatencyTransport : public NetTransport
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  LatencyTransport( NetTransport &inner, std::chrono::milliseconds latency, std::chrono::milliseconds jitter = {},
+                    u32 seed = 1 )
+      : _inner( inner ), _latency( latency ), _jitter( jitter ), _rng( seed )
+  {
+  }
+
+  // Overridable so tests can drive time frame by frame
+  std::function<Clock::time_point()> now = [] { return Clock::now(); };
+
+  void Send( const std::vector<u8> &packet ) override { _inner.Send( packet ); }
+  bool Receive( std::vector<u8> &packet ) override;
+
+private:
+  struct Delayed {
+    Clock::time_point release;
+    std::vector<u8>   packet;
+  };
+
+  NetTransport             &_inner;
+  std::chrono::milliseconds _latency;
+  std::chrono::milliseconds _jitter;
+  std::mt19937              _rng;
+  std::vector<Delayed>      _held;
+};
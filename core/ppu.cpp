@@ -5,16 +5,21 @@
 #include "mappers/mapper-base.h"
 #include <exception>
 #include <array>
-#include <iostream>
+#include <fmt/base.h>
+#include <string>
 
 PPU::PPU( Bus *bus ) : bus( bus )
 {
   try {
     LoadSystemPalette();
   } catch ( std::exception &e ) {
-    std::cerr << e.what() << '\n';
-    std::cerr << "Failed to load system palette from file.\n";
-    std::cerr << "Using default palette.\n";
+    std::string const message =
+        std::string( e.what() ) + "\nFailed to load system palette from file.\nUsing default palette.";
+    if ( bus != nullptr ) {
+      bus->Log( message );
+    } else {
+      fmt::print( "{}\n", message );
+    }
     failedPaletteRead = true;
     LoadDefaultSystemPalette();
   }
@@ -176,6 +181,7 @@ void PPU::CpuWrite( u16 address, u8 data )
         return;
       }
       oam.data.at( oamAddr & 0xFF ) = data;
+      bus->stateHasher.MarkDirty( StateRegion::Oam, oamAddr );
       oamAddr = ( oamAddr + 1 ) & 0xFF;
       break;
     }
@@ -263,8 +269,8 @@ void PPU::CpuWrite( u16 address, u8 data )
 
 //------------------------------------------------------------------------------
 // In your PPU class you still keep:
-//   std::array<std::array<u8,0x400>,4> nameTables;
-// but we will only ever use [0] and [1] in 2-table modes.
+//   CowMemory<4096> nameTables (four 0x400 tables);
+// but we will only ever use tables 0 and 1 in 2-table modes.
 //------------------------------------------------------------------------------
 
 u8 PPU::ReadVram( u16 address )
@@ -303,7 +309,7 @@ u8 PPU::ReadVram( u16 address )
         table = ( v / 0x400 ) & 0x03;
         break;
     }
-    return nameTables.at( table ).at( v & 0x03FF );
+    return nameTables.Read( ( table * 0x400 ) + ( v & 0x03FF ) );
   }
 
   // palettes
@@ -346,7 +352,8 @@ void PPU::WriteVram( u16 address, u8 data )
       case MirrorMode::SingleUpper: table = 1; break;
       case MirrorMode::FourScreen : table = ( v / 0x400 ) & 0x03; break;
     }
-    nameTables.at( table ).at( v & 0x03FF ) = data;
+    nameTables.Write( ( table * 0x400 ) + ( v & 0x03FF ), data );
+    bus->stateHasher.MarkDirty( StateRegion::Nametables, ( table * 0x400 ) + ( v & 0x03FF ) );
     return;
   }
 
@@ -359,6 +366,7 @@ void PPU::WriteVram( u16 address, u8 data )
     if (idx == 0x18) idx = 0x08;
     if (idx == 0x1C) idx = 0x0C;
     paletteMemory[idx] = data;
+    bus->stateHasher.MarkDirty( StateRegion::Palette, idx );
     return;
   }
   // clang-format on
@@ -454,7 +462,10 @@ void PPU::Tick()
 
   if ( scanline == 241 ) {
     VBlank();
-    RenderFrameBuffer();
+    // Hand the finished frame out once, not on every cycle of the vblank scanline
+    if ( cycle == 1 ) {
+      RenderFrameBuffer();
+    }
   }
 
   if ( scanline == 261 )
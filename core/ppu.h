@@ -1,18 +1,19 @@
 #pragma once
 #include "paths.h"
+#include "cow-memory.h"
 #include "cpu.h"
 #include "global-types.h"
 #include "ppu-types.h"
+#include "rom-cache.h"
 #include "mappers/mapper-base.h"
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
-#include <iostream>
 #include <stdexcept>
 #include <string>
-#include <fstream>
 
 class PPU
 {
@@ -22,8 +23,9 @@ public:
 
   template <class Archive> void serialize( Archive &ar ) // NOLINT
   {
-    ar( preventVBlank, nmiReady, systemPaletteIdx, scanline, cycle, frame, oamAddr, oamData, ppuScroll, ppuAddr,
-        ppuData, vramAddr, tempAddr, fineX, addrLatch, vramBuffer, nameTables, paletteMemory, oam, secondaryOam,
+    ar( preventVBlank, nmiReady, systemPaletteIdx, scanline, cycle, frame, ppuCtrl, ppuMask, ppuStatus, oamAddr,
+        oamData, ppuScroll, ppuAddr, ppuData, vramAddr, tempAddr, fineX, addrLatch, vramBuffer, nameTables,
+        paletteMemory, oam, secondaryOam, nametableByte, attributeByte, bgPattern0Byte, bgPattern1Byte,
         bgPatternShiftLow, bgPatternShiftHigh, bgAttributeShiftLow, bgAttributeShiftHigh, spriteShiftLow,
         spriteShiftHigh, spritePattern0Byte, spritePattern1Byte, bSpriteZeroHitPossible, bSprite0Appeared, spriteCount,
         nOamEntry, isDisabled );
@@ -34,9 +36,10 @@ public:
   ||      Helper Variables      ||
   ################################
   */
-  std::array<std::string, 3> systemPalettePaths = { std::string( paths::palettes() ) + "/palette1.pal",
-                                                    std::string( paths::palettes() ) + "/palette2.pal",
-                                                    std::string( paths::palettes() ) + "/palette3.pal" };
+  static std::string SystemPalettePath( int paletteIdx )
+  {
+    return std::string( paths::palettes() ) + "/palette" + std::to_string( paletteIdx + 1 ) + ".pal";
+  }
 
   std::array<u32, 64> nesPaletteRgbValues{};
   u32                 GetMasterPaletteColor( u8 index ) const { return nesPaletteRgbValues.at( index ); }
@@ -120,8 +123,8 @@ public:
 
   u8 vramBuffer = 0x00;
 
-  using nametable_t = std::array<u8, 1024>;
-  std::array<nametable_t, 4> nameTables{};
+  // Four 1KiB tables back to back, copy-on-write so forked instances share them (see cow-memory.h)
+  CowMemory<4096> nameTables;
 
   // u8 nametables[4][1024];
   std::array<u8, 32> defaultPalette = { 0x09, 0x01, 0x00, 0x01, 0x00, 0x02, 0x02, 0x0D, 0x08, 0x10, 0x08,
@@ -168,6 +171,10 @@ public:
   // SDL callbacks
   std::function<void( const u32 * )> onFrameReady = nullptr;
 
+  // Skips pixel output and onFrameReady, used for frames nobody will see (run-ahead).
+  // Sprite zero hits are still evaluated, so emulation is unaffected.
+  bool skipRender = false;
+
   /*
   ################################
   ||       Debug Variables      ||
@@ -186,7 +193,23 @@ public:
   std::array<u32, gBufferSize> frameBuffer{};
   std::array<u32, gBufferSize> GetFrameBuffer() const { return frameBuffer; }
 
-  void ClearFrameBuffer() { frameBuffer.fill( 0x00000000 ); }
+  void ClearFrameBuffer()
+  {
+    std::fill_n( _pixelOutput, gBufferSize, 0x00000000 );
+    if ( _indexOutput != nullptr ) {
+      std::fill_n( _indexOutput, gBufferSize, 0x00 );
+    }
+  }
+
+  // Render into caller owned buffers of gBufferSize pixels instead of frameBuffer, e.g. batched
+  // observation arrays. indices, if set, receives each pixel's system palette index. Pass null
+  // pixels to go back to frameBuffer. Not part of the state, forks and state loads keep their own.
+  void SetFrameOutput( u32 *pixels, u8 *indices = nullptr )
+  {
+    _pixelOutput = pixels != nullptr ? pixels : frameBuffer.data();
+    _indexOutput = indices;
+  }
+  [[nodiscard]] const u32 *GetFrameOutput() const { return _pixelOutput; }
 
   /*
   ################################
@@ -422,7 +445,10 @@ public:
     }
   }
 
-  u32 GetOutputPixel()
+  u32 GetOutputPixel() { return nesPaletteRgbValues.at( GetOutputPaletteIndex() ); }
+
+  // Index into the 64 color system palette of the pixel at the current dot
+  u8 GetOutputPaletteIndex()
   {
     u8 bgPixel = 0;
     u8 bgPalette = 0;
@@ -480,13 +506,9 @@ public:
       }
     }
 
-    // Write final color to framebuffer
+    // Final color, as a system palette index
     u16 const paletteAddr = 0x3F00 + ( outPalette << 2 ) + outPixel;
-    u8 const  paletteIdx = ReadVram( paletteAddr ) & 0x3F;
-    u32 const rgbColor = nesPaletteRgbValues.at( paletteIdx );
-    return rgbColor;
-
-    return 0;
+    return ReadVram( paletteAddr ) & 0x3F;
   }
 
   void FetchBackgroundPixel( u8 &pixel, u8 &palette ) const
@@ -604,18 +626,26 @@ public:
   {
     if ( InScanline( 0, 239 ) && InCycle( 1, 256 ) ) {
       u16 const bufferIdx = ( scanline * 256 ) + ( cycle - 1 );
-      if ( debugValue > -1 ) {
-        frameBuffer.at( bufferIdx ) = debugValue;
+      if ( skipRender ) {
+        if ( bSpriteZeroHitPossible && !ppuStatus.bit.spriteZeroHit ) {
+          GetOutputPaletteIndex();
+        }
+      } else if ( debugValue > -1 ) {
+        _pixelOutput[bufferIdx] = debugValue; // NOLINT
       } else {
-        frameBuffer.at( bufferIdx ) = GetOutputPixel();
+        u8 const paletteIdx = GetOutputPaletteIndex();
+        _pixelOutput[bufferIdx] = nesPaletteRgbValues.at( paletteIdx ); // NOLINT
+        if ( _indexOutput != nullptr ) {
+          _indexOutput[bufferIdx] = paletteIdx; // NOLINT
+        }
       }
     }
   }
 
   void RenderFrameBuffer()
   {
-    if ( onFrameReady ) {
-      onFrameReady( frameBuffer.data() );
+    if ( onFrameReady && !skipRender ) {
+      onFrameReady( _pixelOutput );
     }
   }
 
@@ -655,9 +685,7 @@ public:
     vramAddr.value = 0x0000;
     tempAddr.value = 0x0000;
     fineX = 0x00;
-    for ( auto &table : nameTables ) {
-      table.fill( 0x00 );
-    }
+    nameTables.Fill( 0x00 );
     paletteMemory = defaultPalette;
     ClearFrameBuffer();
   }
@@ -686,8 +714,8 @@ public:
 
   void LoadSystemPalette( int paletteIdx = 0 )
   {
-    std::string const palettePath = systemPalettePaths.at( paletteIdx );
-    nesPaletteRgbValues = ReadPalette( palettePath );
+    // Parsed once per process, later PPUs copy from the shared cache
+    nesPaletteRgbValues = rom_cache::AcquirePalette( SystemPalettePath( paletteIdx ) );
   }
 
   u8 GetPpuPaletteValue( u8 index ) { return paletteMemory.at( index ); }
@@ -872,38 +900,11 @@ public:
 
   static std::array<u32, 64> ReadPalette( const std::string &filename )
   {
-    std::array<u32, 64> nesPalette{};
-
-    std::ifstream file( filename, std::ios::binary );
-    if ( !file ) {
-      std::cerr << "PPU::ReadPalette: Failed to open palette file: " << filename << '\n';
-      throw std::runtime_error( "Failed to open palette file" );
-    }
-
-    file.seekg( 0, std::ios::end );
-    std::streamsize const fileSize = file.tellg();
-    if ( fileSize != 192 ) {
-      std::cerr << "Invalid palette file size: " << fileSize << '\n';
-      throw std::runtime_error( "Invalid palette file size" );
-    }
-
-    file.seekg( 0, std::ios::beg );
-
-    char buffer[192]; // NOLINT
-    if ( !file.read( buffer, 192 ) ) {
-      std::cerr << "Failed to read palette file: " << filename << '\n';
-      throw std::runtime_error( "Failed to read palette file" );
-    }
-
-    // Convert to 32-bit RGBA (SDL_PIXELFORMAT_RGBA32)
-    for ( int i = 0; i < 64; ++i ) {
-      u8 const red = buffer[( i * 3 ) + 0];
-      u8 const green = buffer[( i * 3 ) + 1];
-      u8 const blue = buffer[( i * 3 ) + 2];
-      u8 const alpha = 0xFF;
-      nesPalette[i] = ( alpha << 24 ) | ( blue << 16 ) | ( green << 8 ) | red;
-    }
-
-    return nesPalette;
+    return rom_cache::AcquirePalette( filename );
   }
+
+private:
+  // Where UpdateFrameBuffer() draws, see SetFrameOutput()
+  u32 *_pixelOutput = frameBuffer.data();
+  u8  *_indexOutput = nullptr;
 };
@@ -0,0 +1,54 @@
+#include "rate-control.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+double RateControl::RatioFor( std::size_t fill, std::size_t target )
+{
+  if ( target == 0 ) {
+    return 1.0;
+  }
+  // -1 when the queue is empty, 0 on target, clamped to +1 from twice the target up
+  double const error = std::clamp( ( static_cast<double>( fill ) - static_cast<double>( target ) ) / target, -1.0, 1.0 );
+  return 1.0 - ( maxAdjust * error );
+}
+
+std::size_t RateControl::Process( const s16 *in, std::size_t count, std::size_t fill, std::size_t target,
+                                  std::vector<s16> &out )
+{
+  if ( count == 0 ) {
+    return 0;
+  }
+  _ratio = RatioFor( fill, target );
+  double const step = 1.0 / _ratio;
+
+  // Input position p lies between sample floor(p) and the one after it, where index 0 is the
+  // previous call's last sample and index i is in[i - 1]
+  auto const sampleAt = [&]( std::size_t index ) -> double { return index == 0 ? _last : in[index - 1]; };
+
+  std::size_t const before = out.size();
+  double            position = _phase;
+  auto const        end = static_cast<double>( count );
+  while ( position < end ) {
+    auto const   index = static_cast<std::size_t>( position );
+    double const frac = position - static_cast<double>( index );
+    double const a = sampleAt( index );
+    double const b = sampleAt( index + 1 );
+    out.push_back( static_cast<s16>( std::lround( a + ( ( b - a ) * frac ) ) ) );
+    position += step;
+  }
+
+  _phase = position - end;
+  _last = in[count - 1];
+  return out.size() - before;
+}
+
+void RateControl::Reset()
+{
+  _ratio = 1.0;
+  _phase = 0.0;
+  _last = 0;
+}
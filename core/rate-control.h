@@ -0,0 +1,45 @@
+#pragma once
+#include "global-types.h"
+
+#include <cstddef>
+#include <vector>
+
+/*
+################################
+||     Dynamic Rate Control   ||
+################################
+  Keeps the audio queue at its target fill while the frame pacer and the sound card run on
+  different clocks.
+
+  Every frame of APU samples is resampled by a ratio just off 1.0, chosen from how far the
+  queue is from its target: a queue running low gets slightly more samples, one running high
+  slightly fewer. The ratio never moves more than maxAdjust (0.5%) from 1.0, a pitch change far
+  below what anyone can hear, and enough to absorb the drift between a display or timer clock
+  and a sound card clock.
+
+  Resampling is linear interpolation, carrying the fractional read position and the previous
+  input sample across calls so frames join without clicks.
+*/
+
+class RateControl
+{
+public:
+  static constexpr double maxAdjust = 0.005;
+
+  // Appends count input samples to out, resampled by the ratio for the given queue fill and
+  // target (both in samples). Returns the number of samples appended.
+  std::size_t Process( const s16 *in, std::size_t count, std::size_t fill, std::size_t target, std::vector<s16> &out );
+
+  // Output samples per input sample used by the last Process() call
+  [[nodiscard]] double Ratio() const { return _ratio; }
+
+  // Ratio for a queue fill, exposed for tests and the overlay
+  [[nodiscard]] static double RatioFor( std::size_t fill, std::size_t target );
+
+  void Reset();
+
+private:
+  double _ratio = 1.0;
+  double _phase = 0.0; // next output position, in input samples after _last
+  s16    _last = 0;    // last input sample of the previous call
+};
@@ -0,0 +1,196 @@
+#include "rollback.h"
+#include "bus.h"
+#include "global-types.h"
+#include "net-transport.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t headerSize = 10;
+constexpr u32         maxInputsPerPacket = 64;
+
+void PutU32( std::vector<u8> &out, u32 value )
+{
+  for ( int i = 0; i < 4; ++i ) {
+    out.push_back( static_cast<u8>( value >> ( i * 8 ) ) );
+  }
+}
+
+u32 GetU32( const u8 *in )
+{
+  return static_cast<u32>( in[0] ) | ( static_cast<u32>( in[1] ) << 8 ) | ( static_cast<u32>( in[2] ) << 16 ) | // NOLINT
+         ( static_cast<u32>( in[3] ) << 24 );                                                                     // NOLINT
+}
+} // namespace
+
+RollbackSession::RollbackSession( Bus &bus, NetTransport &transport, int localPlayer )
+    : _bus( bus ), _transport( transport ), _localPlayer( localPlayer & 1 )
+{
+  _bus.cartridge.BeginSpeculation();
+}
+
+RollbackSession::~RollbackSession()
+{
+  _bus.cartridge.EndSpeculation();
+}
+
+/*
+################################
+||         Frame Loop         ||
+################################
+*/
+bool RollbackSession::AdvanceFrame( u8 localInput )
+{
+  ReceiveInputs();
+
+  // Every unconfirmed frame needs its snapshot kept, and there are only so many. The peer can
+  // also be ahead of us, so compare without wrapping.
+  if ( _frame >= _remoteReceived + maxRollback ) {
+    SendInputs();
+    _stats.stalls++;
+    return false;
+  }
+
+  _localInputs[_frame % historySize] = localInput;
+  _localCount = _frame + 1;
+  SendInputs();
+  Rollback();
+  CommitConfirmed();
+
+  SimulateFrame( _frame, true );
+  _frame++;
+
+  _stats.frames++;
+  _stats.confirmedFrame = std::min( _remoteReceived, _frame );
+  if ( ++_windowFrames == framesPerSecond ) {
+    _stats.rollbacksPerSecond = static_cast<double>( _windowRollbacks );
+    _windowRollbacks = 0;
+    _windowFrames = 0;
+  }
+  return true;
+}
+
+void RollbackSession::Poll()
+{
+  ReceiveInputs();
+  SendInputs();
+  Rollback();
+  CommitConfirmed();
+  _stats.confirmedFrame = std::min( _remoteReceived, _frame );
+}
+
+void RollbackSession::Rollback()
+{
+  if ( !_needsRollback ) {
+    return;
+  }
+  std::vector<u8> const &snapshot = _snapshots[_rollbackFrom % snapshotCount];
+  _bus.LoadStateFromMemory( snapshot.data(), snapshot.size() );
+  for ( u32 frame = _rollbackFrom; frame < _frame; ++frame ) {
+    SimulateFrame( frame, false );
+  }
+  _stats.rollbacks++;
+  _stats.resimulatedFrames += _frame - _rollbackFrom;
+  _windowRollbacks++;
+  _needsRollback = false;
+}
+
+void RollbackSession::SimulateFrame( u32 frame, bool render )
+{
+  std::vector<u8> &snapshot = _snapshots[frame % snapshotCount];
+  snapshot.clear();
+  _bus.SaveStateToMemory( snapshot );
+
+  u8 const remote = RemoteInputFor( frame );
+  _predicted[frame % historySize] = remote;
+  _bus.controller[_localPlayer] = _localInputs[frame % historySize];
+  _bus.controller[_localPlayer ^ 1] = remote;
+
+  _bus.ppu.skipRender = !render;
+  _bus.apu.set_muted( !render );
+  _bus.RunFrame();
+  _bus.apu.end_frame();
+  _bus.apu.set_muted( false );
+  _bus.ppu.skipRender = false;
+}
+
+void RollbackSession::CommitConfirmed()
+{
+  // Nothing left to roll back, so PRG RAM as it is now can go into the save file
+  if ( _remoteReceived >= _frame && _bus.cartridge.IsSpeculating() ) {
+    _bus.cartridge.EndSpeculation();
+    _bus.cartridge.BeginSpeculation();
+  }
+}
+
+u8 RollbackSession::RemoteInputFor( u32 frame ) const
+{
+  if ( frame < _remoteReceived || _remoteKnown[frame % historySize] ) {
+    return _remoteInputs[frame % historySize];
+  }
+  // Prediction: the remote player keeps holding whatever they last sent
+  return _remoteReceived > 0 ? _remoteInputs[( _remoteReceived - 1 ) % historySize] : 0;
+}
+
+/*
+################################
+||           Packets          ||
+################################
+*/
+void RollbackSession::SendInputs()
+{
+  // Everything the peer hasn't acknowledged, up to and including the newest local input
+  u32 const end = _localCount;
+  u32 const first = std::max( _peerAck, end > maxInputsPerPacket ? end - maxInputsPerPacket : 0U );
+
+  _packet.clear();
+  _packet.push_back( packetMagic );
+  PutU32( _packet, first );
+  PutU32( _packet, _remoteReceived );
+  _packet.push_back( static_cast<u8>( end - first ) );
+  for ( u32 frame = first; frame < end; ++frame ) {
+    _packet.push_back( _localInputs[frame % historySize] );
+  }
+  _transport.Send( _packet );
+}
+
+void RollbackSession::ReceiveInputs()
+{
+  std::vector<u8> packet;
+  while ( _transport.Receive( packet ) ) {
+    if ( packet.size() < headerSize || packet[0] != packetMagic || packet.size() != headerSize + packet[9] ) {
+      continue;
+    }
+    u32 const first = GetU32( &packet[1] );
+    _peerAck = std::max( _peerAck, GetU32( &packet[5] ) );
+
+    for ( u32 i = 0; i < packet[9]; ++i ) {
+      u32 const frame = first + i;
+      // Already known, or too far ahead to fit the ring
+      if ( frame < _remoteReceived || frame >= _remoteReceived + historySize / 2 ) {
+        continue;
+      }
+      std::size_t const slot = frame % historySize;
+      if ( _remoteKnown[slot] ) {
+        continue;
+      }
+      _remoteInputs[slot] = packet[headerSize + i];
+      _remoteKnown[slot] = true;
+
+      // A frame we already simulated on a guess that turned out wrong
+      if ( frame < _frame && _predicted[slot] != _remoteInputs[slot] ) {
+        _rollbackFrom = _needsRollback ? std::min( _rollbackFrom, frame ) : frame;
+        _needsRollback = true;
+      }
+    }
+
+    // Advance the contiguous confirmed range, freeing ring slots for reuse
+    while ( _remoteKnown[_remoteReceived % historySize] ) {
+      _remoteKnown[_remoteReceived % historySize] = false;
+      _remoteReceived++;
+    }
+  }
+}
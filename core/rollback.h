@@ -0,0 +1,106 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+class Bus;
+class NetTransport;
+
+/*
+################################
+||      Rollback Netplay      ||
+################################
+  Two player netplay that hides latency by predicting the remote player's input.
+
+  Every frame the local input is applied immediately and sent to the peer. The remote input for
+  frames that haven't arrived yet is predicted by repeating the last one that did. A snapshot is
+  taken at the start of every unconfirmed frame; when a remote input shows up that doesn't match
+  its prediction, the session restores the snapshot of that frame and resimulates up to the
+  present, with video skipped and audio muted.
+
+  A battery save only ever gets confirmed frames: for the whole session PRG RAM writes go to a
+  private copy (Cartridge::BeginSpeculation()), written into the save file whenever every frame
+  simulated so far has both inputs known, and when the session ends.
+
+  Each packet carries the sender's inputs from the first frame the peer hasn't acknowledged, plus
+  an ack of the remote inputs received so far, so lost or reordered datagrams just get resent.
+
+  Packet layout (little endian):
+    0   u8  magic (0x4E)
+    1   u32 frame of the first input
+    5   u32 remote inputs received (ack)
+    9   u8  input count
+    10  ... inputs, one controller byte per frame
+*/
+
+struct RollbackStats {
+  u64    frames = 0;             // frames advanced
+  u64    rollbacks = 0;          // mispredictions that forced a restore
+  u64    resimulatedFrames = 0;  // frames run again during rollbacks
+  u64    stalls = 0;             // frames skipped waiting for the peer
+  double rollbacksPerSecond = 0; // over the last second of frames
+  u32    confirmedFrame = 0;     // frames with both inputs known
+};
+
+class RollbackSession
+{
+public:
+  static constexpr int maxRollback = 8;
+
+  // localPlayer is the controller port (0 or 1) driven by this side
+  RollbackSession( Bus &bus, NetTransport &transport, int localPlayer );
+  ~RollbackSession();
+  RollbackSession( const RollbackSession & ) = delete;
+  RollbackSession &operator=( const RollbackSession & ) = delete;
+  RollbackSession( RollbackSession && ) = delete;
+  RollbackSession &operator=( RollbackSession && ) = delete;
+
+  // Advances one frame with the given local input and ends its sound frame. Returns false,
+  // without advancing, while the peer is more than maxRollback frames behind.
+  bool AdvanceFrame( u8 localInput );
+
+  // Exchanges inputs and applies any pending rollback without advancing. For paused or
+  // stalled frontends, so the peer keeps getting acks.
+  void Poll();
+
+  [[nodiscard]] u32                  Frame() const { return _frame; }
+  [[nodiscard]] const RollbackStats &Stats() const { return _stats; }
+
+private:
+  static constexpr std::size_t historySize = 128; // input ring, must exceed the ack window
+  static constexpr std::size_t snapshotCount = maxRollback + 1;
+  static constexpr u8          packetMagic = 0x4E;
+  static constexpr int         framesPerSecond = 60;
+
+  void SendInputs();
+  void Rollback();
+  void ReceiveInputs();
+  void SimulateFrame( u32 frame, bool render );
+  void CommitConfirmed();
+  u8   RemoteInputFor( u32 frame ) const;
+
+  Bus          &_bus;
+  NetTransport &_transport;
+  int           _localPlayer;
+
+  u32  _frame = 0;          // next frame to simulate
+  u32  _localCount = 0;     // local inputs recorded, frames below this
+  u32  _remoteReceived = 0; // remote inputs known for every frame below this
+  u32  _peerAck = 0;        // local inputs the peer has confirmed
+  u32  _rollbackFrom = 0;   // earliest mispredicted frame
+  bool _needsRollback = false;
+
+  std::array<u8, historySize>   _localInputs{};
+  std::array<u8, historySize>   _remoteInputs{};
+  std::array<bool, historySize> _remoteKnown{};
+  std::array<u8, historySize>   _predicted{};
+
+  std::array<std::vector<u8>, snapshotCount> _snapshots;
+
+  RollbackStats   _stats;
+  u64             _windowRollbacks = 0;
+  u32             _windowFrames = 0;
+  std::vector<u8> _packet;
+};
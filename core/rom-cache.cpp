@@ -0,0 +1,196 @@
+#include "rom-cache.h"
+#include "cartridge-header.h"
+#include "global-types.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+namespace fs = std::filesystem;
+
+constexpr std::size_t headerSize = 16;
+constexpr std::size_t trainerSize = 512;
+
+struct Cache {
+  std::mutex                                               mutex;
+  std::unordered_map<std::string, std::weak_ptr<RomImage>> byFile; // file identity, see FileKey()
+  std::unordered_map<std::string, std::weak_ptr<RomImage>> byHash;
+  std::unordered_map<std::string, SystemPalette>           palettes;
+};
+
+Cache &GetCache()
+{
+  static Cache cache;
+  return cache;
+}
+
+// Changes whenever the file is replaced or rewritten
+std::string FileKey( const std::string &path )
+{
+  std::error_code ec;
+  fs::path const  canonical = fs::canonical( path, ec );
+  auto const      size = ec ? 0 : fs::file_size( path, ec );
+  auto const      modified = ec ? fs::file_time_type{} : fs::last_write_time( path, ec );
+  if ( ec ) {
+    throw std::runtime_error( "Failed to open ROM file: " + path );
+  }
+  return canonical.string() + '|' + std::to_string( size ) + '|' +
+         std::to_string( modified.time_since_epoch().count() );
+}
+
+// Drop expired entries, so the maps don't grow with every ROM ever loaded
+void Prune( std::unordered_map<std::string, std::weak_ptr<RomImage>> &map )
+{
+  std::erase_if( map, []( const auto &entry ) { return entry.second.expired(); } );
+}
+
+SystemPalette ParsePalette( const std::string &filename )
+{
+  std::ifstream file( filename, std::ios::binary );
+  if ( !file ) {
+    throw std::runtime_error( "PPU::ReadPalette: Failed to open palette file: " + filename );
+  }
+
+  file.seekg( 0, std::ios::end );
+  std::streamsize const fileSize = file.tellg();
+  if ( fileSize != 192 ) {
+    throw std::runtime_error( "Invalid palette file size: " + std::to_string( fileSize ) );
+  }
+
+  file.seekg( 0, std::ios::beg );
+
+  std::array<char, 192> buffer{};
+  if ( !file.read( buffer.data(), buffer.size() ) ) {
+    throw std::runtime_error( "Failed to read palette file: " + filename );
+  }
+
+  // Convert to 32-bit RGBA (SDL_PIXELFORMAT_RGBA32)
+  SystemPalette palette{};
+  for ( std::size_t i = 0; i < palette.size(); ++i ) {
+    u32 const red = static_cast<u8>( buffer.at( ( i * 3 ) + 0 ) );
+    u32 const green = static_cast<u8>( buffer.at( ( i * 3 ) + 1 ) );
+    u32 const blue = static_cast<u8>( buffer.at( ( i * 3 ) + 2 ) );
+    u32 const alpha = 0xFF;
+    palette.at( i ) = ( alpha << 24 ) | ( blue << 16 ) | ( green << 8 ) | red;
+  }
+  return palette;
+}
+} // namespace
+
+/*
+################################
+||          ROM Image         ||
+################################
+*/
+std::shared_ptr<RomImage> RomImage::Open( const std::string &path )
+{
+  std::shared_ptr<RomImage> image( new RomImage ); // NOLINT, private constructor
+
+  std::ifstream in( path, std::ios::binary );
+  if ( !in ) {
+    throw std::runtime_error( "Failed to open ROM file: " + path );
+  }
+  image->_data.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+  std::span<const u8> file = image->_data;
+
+  if ( file.size() < headerSize ) {
+    throw std::runtime_error( "Failed to read ROM header: Unexpected end of file." );
+  }
+  std::memcpy( image->_header.data(), file.data(), headerSize );
+
+  iNes2Instance iNes;
+  std::memcpy( iNes.header.value, image->_header.data(), headerSize );
+  if ( iNes.GetIdentification() != "NES\x1A" ) {
+    throw std::runtime_error( "Invalid ROM file" );
+  }
+  image->_hash = utils::FormatRomHash( utils::Fnv1a( file.data(), file.size() ) );
+
+  std::size_t const prgOffset = headerSize + ( iNes.GetTrainerMode() == 1 ? trainerSize : 0 );
+  auto const        prgSize = static_cast<std::size_t>( iNes.GetPrgRomSizeBytes() );
+  auto const        chrSize = static_cast<std::size_t>( iNes.GetChrRomSizeBytes() );
+  std::size_t const needed = prgOffset + prgSize + chrSize;
+
+  // Truncated dumps read as zeros past the end of the file. The hash above covers the file as is.
+  if ( file.size() < needed ) {
+    image->_data.resize( needed, 0 );
+    file = image->_data;
+  }
+
+  image->_prg = file.subspan( prgOffset, prgSize );
+  image->_chr = file.subspan( prgOffset + prgSize, chrSize );
+  return image;
+}
+
+/*
+################################
+||            Cache           ||
+################################
+*/
+namespace rom_cache
+{
+std::shared_ptr<const RomImage> Acquire( const std::string &path )
+{
+  std::string const key = FileKey( path );
+  Cache            &cache = GetCache();
+
+  // Loads are rare, holding the lock while reading keeps two threads from opening the same file
+  std::lock_guard<std::mutex> const lock( cache.mutex );
+  if ( auto image = cache.byFile[key].lock() ) {
+    return image;
+  }
+
+  std::shared_ptr<RomImage> image = RomImage::Open( path );
+  if ( auto same = cache.byHash[image->Hash()].lock() ) {
+    image = same;
+  } else {
+    cache.byHash[image->Hash()] = image;
+  }
+  cache.byFile[key] = image;
+
+  Prune( cache.byFile );
+  Prune( cache.byHash );
+  return image;
+}
+
+const SystemPalette &AcquirePalette( const std::string &path )
+{
+  Cache                            &cache = GetCache();
+  std::lock_guard<std::mutex> const lock( cache.mutex );
+  auto                              it = cache.palettes.find( path );
+  if ( it == cache.palettes.end() ) {
+    // Elements of an unordered_map never move, the reference outlives later inserts
+    it = cache.palettes.emplace( path, ParsePalette( path ) ).first;
+  }
+  return it->second;
+}
+
+std::size_t LoadedRoms()
+{
+  Cache                            &cache = GetCache();
+  std::lock_guard<std::mutex> const lock( cache.mutex );
+  return static_cast<std::size_t>( std::ranges::count_if(
+      cache.byHash, []( const auto &entry ) { return !entry.second.expired(); } ) );
+}
+
+std::size_t LoadedPalettes()
+{
+  Cache                            &cache = GetCache();
+  std::lock_guard<std::mutex> const lock( cache.mutex );
+  return cache.palettes.size();
+}
+} // namespace rom_cache
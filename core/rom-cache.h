@@ -0,0 +1,75 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+################################
+||          ROM Cache         ||
+################################
+  Process wide, read-only images of ROM and palette files, shared by every emulator instance
+  that loads the same file.
+
+  A ROM image is one heap copy of the file, split into its header, PRG and CHR. The file is read
+  rather than memory mapped: a mapping faults (SIGBUS) if the file is truncated while in use and
+  changes under an image that was already hashed if the file is rewritten in place. Games are
+  at most a few MiB and every instance shares the one copy, so the read costs little.
+
+  Images are found by file identity first (canonical path, size and modification time), so
+  loading a ROM that is already open costs a stat and no reads or hashing. A new file is hashed
+  once and matched against loaded images by content, so copies of a game under different names
+  share one image too.
+
+  ROM images are reference counted. The cache only holds weak references, so an image lives as
+  long as some cartridge uses it. Palettes are 192 byte files parsed once and kept for the life
+  of the process. Everything here is safe to call from any thread.
+*/
+
+class RomImage
+{
+public:
+  ~RomImage() = default;
+
+  RomImage( const RomImage & ) = delete;
+  RomImage &operator=( const RomImage & ) = delete;
+  RomImage( RomImage && ) = delete;
+  RomImage &operator=( RomImage && ) = delete;
+
+  [[nodiscard]] const std::array<u8, 16> &Header() const { return _header; }
+  [[nodiscard]] std::span<const u8>       Prg() const { return _prg; }
+  [[nodiscard]] std::span<const u8>       Chr() const { return _chr; }
+  [[nodiscard]] const std::string        &Hash() const { return _hash; } // same as utils::GetRomHash()
+
+  // Reads the file without going through the cache, use rom_cache::Acquire() instead
+  static std::shared_ptr<RomImage> Open( const std::string &path );
+
+private:
+  RomImage() = default;
+
+  std::array<u8, 16>  _header{};
+  std::span<const u8> _prg;
+  std::span<const u8> _chr;
+  std::string         _hash;
+  std::vector<u8>     _data; // the whole file, zero padded when truncated, the spans point into it
+};
+
+using SystemPalette = std::array<u32, 64>;
+
+namespace rom_cache
+{
+// Shared image of an iNES file. Throws std::runtime_error if it can't be read or isn't iNES.
+std::shared_ptr<const RomImage> Acquire( const std::string &path );
+
+// Parsed 64 color .pal file as RGBA. The reference stays valid for the life of the process.
+// Throws std::runtime_error if the file can't be read or isn't 192 bytes.
+const SystemPalette &AcquirePalette( const std::string &path );
+
+// ROM images alive and palettes parsed, for tests and diagnostics
+std::size_t LoadedRoms();
+std::size_t LoadedPalettes();
+} // namespace rom_cache
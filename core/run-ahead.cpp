@@ -0,0 +1,71 @@
+#include "run-ahead.h"
+#include "bus.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr double statSmoothing = 0.1;
+
+double ElapsedUs( Clock::time_point from, Clock::time_point to )
+{
+  return std::chrono::duration<double, std::micro>( to - from ).count();
+}
+
+void Smooth( double &average, double sample )
+{
+  average += ( sample - average ) * statSmoothing;
+}
+} // namespace
+
+void RunAhead::RunFrame( Bus &bus )
+{
+  int const speculative = std::clamp( frames, 0, maxFrames );
+  if ( speculative == 0 ) {
+    bus.RunFrame();
+    bus.apu.end_frame();
+    _stats = {};
+    return;
+  }
+
+  // Real frame. Its sound frame is closed before the snapshot, so the snapshot sits exactly on
+  // a sound frame boundary and the restore doesn't disturb the audio stream.
+  bus.ppu.skipRender = true;
+  bus.RunFrame();
+  bus.apu.end_frame();
+
+  auto const t0 = Clock::now();
+  _snapshot.clear();
+  bus.SaveStateToMemory( _snapshot );
+
+  // The speculative frames' PRG RAM writes stay out of a battery save, unless the caller is
+  // already speculating (rollback) and ends it itself
+  bool const speculate = !bus.cartridge.IsSpeculating();
+  if ( speculate ) {
+    bus.cartridge.BeginSpeculation();
+  }
+
+  auto const t1 = Clock::now();
+  bus.apu.set_muted( true );
+  for ( int i = 0; i < speculative; ++i ) {
+    bus.ppu.skipRender = i + 1 < speculative;
+    bus.RunFrame();
+    bus.apu.end_frame();
+  }
+  bus.apu.set_muted( false );
+  bus.ppu.skipRender = false;
+
+  auto const t2 = Clock::now();
+  bus.LoadStateFromMemory( _snapshot.data(), _snapshot.size() );
+  if ( speculate ) {
+    bus.cartridge.EndSpeculation();
+  }
+  auto const t3 = Clock::now();
+
+  Smooth( _stats.snapshotUs, ElapsedUs( t0, t1 ) );
+  Smooth( _stats.framesUs, ElapsedUs( t1, t2 ) );
+  Smooth( _stats.restoreUs, ElapsedUs( t2, t3 ) );
+}
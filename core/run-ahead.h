@@ -0,0 +1,51 @@
+#pragma once
+#include "global-types.h"
+
+#include <vector>
+
+class Bus;
+
+/*
+################################
+||          Run-Ahead         ||
+################################
+  Input latency reduction.
+
+  Most games read input during one frame and only show the result a frame or two later. With
+  run-ahead, every displayed frame is:
+
+    1. the real frame, with video skipped and audio kept
+    2. a snapshot of the machine
+    3. `frames` speculative frames using the same input, audio muted and video skipped for all
+       but the last one, which is what gets presented
+    4. a restore of the snapshot
+
+  so the picture shows where the game will be `frames` frames from now, hiding that many frames
+  of internal lag. Emulation state only ever advances through the real frame, and the speculative
+  frames' PRG RAM writes never reach a battery save (Cartridge::BeginSpeculation()).
+*/
+
+struct RunAheadStats {
+  double snapshotUs = 0.0; // save state into memory
+  double framesUs = 0.0;   // speculative frames
+  double restoreUs = 0.0;  // load state from memory
+  double TotalUs() const { return snapshotUs + framesUs + restoreUs; }
+};
+
+class RunAhead
+{
+public:
+  static constexpr int maxFrames = 4;
+
+  int frames = 0; // speculative frames per real frame, 0 disables run-ahead
+
+  // Runs one real frame, plus the speculative ones when enabled, and ends its sound frame
+  void RunFrame( Bus &bus );
+
+  // Exponential moving averages over recent frames, zero while disabled
+  [[nodiscard]] const RunAheadStats &Stats() const { return _stats; }
+
+private:
+  std::vector<u8> _snapshot; // reused between frames, so steady state doesn't allocate
+  RunAheadStats   _stats;
+};
@@ -0,0 +1,250 @@
+#include "save-writer.h"
+#include "global-types.h"
+
+#include <array>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fmt/base.h>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// "NESZ" + uncompressed size (u32, little endian)
+constexpr std::array<u8, 4> compressedMagic = { 'N', 'E', 'S', 'Z' };
+constexpr std::size_t       compressedHeaderSize = 8;
+} // namespace
+
+SaveWriter::~SaveWriter()
+{
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _stop = true;
+  }
+  _cv.notify_all();
+  if ( _worker.joinable() ) {
+    _worker.join();
+  }
+}
+
+/*
+################################
+||          Job Queue         ||
+################################
+*/
+std::vector<u8> SaveWriter::AcquireBuffer()
+{
+  std::lock_guard<std::mutex> const lock( _mutex );
+  if ( _pool.empty() ) {
+    return {};
+  }
+  std::vector<u8> buffer = std::move( _pool.back() );
+  _pool.pop_back();
+  buffer.clear();
+  return buffer;
+}
+
+void SaveWriter::ReleaseBuffer( std::vector<u8> &&buffer )
+{
+  std::lock_guard<std::mutex> const lock( _mutex );
+  if ( _pool.size() < maxPooledBuffers ) {
+    _pool.push_back( std::move( buffer ) );
+  }
+}
+
+void SaveWriter::Submit( const std::string &path, std::vector<u8> &&data, bool compress, const std::string &message )
+{
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _jobs.push_back( Job{ .path = path, .data = std::move( data ), .message = message, .compress = compress } );
+    _inFlight++;
+    if ( !_worker.joinable() ) {
+      _worker = std::thread( &SaveWriter::Run, this );
+    }
+  }
+  _cv.notify_one();
+}
+
+void SaveWriter::Flush()
+{
+  std::unique_lock<std::mutex> lock( _mutex );
+  _idleCv.wait( lock, [this] { return _inFlight == 0; } );
+}
+
+std::vector<SaveWriter::Result> SaveWriter::TakeResults()
+{
+  std::lock_guard<std::mutex> const lock( _mutex );
+  std::vector<Result>               results;
+  results.swap( _results );
+  return results;
+}
+
+std::size_t SaveWriter::PendingCount()
+{
+  std::lock_guard<std::mutex> const lock( _mutex );
+  return _inFlight;
+}
+
+void SaveWriter::Run()
+{
+  std::vector<u8> compressed;
+  while ( true ) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock( _mutex );
+      _cv.wait( lock, [this] { return _stop || !_jobs.empty(); } );
+      // Drain the queue before honoring a stop request, pending saves must not be lost
+      if ( _jobs.empty() ) {
+        return;
+      }
+      job = std::move( _jobs.front() );
+      _jobs.pop_front();
+    }
+
+    std::string error;
+    bool        ok = false;
+    if ( job.compress ) {
+      Compress( job.data, compressed );
+      ok = WriteFileAtomic( job.path, compressed, error );
+    } else {
+      ok = WriteFileAtomic( job.path, job.data, error );
+    }
+
+    if ( !ok ) {
+      fmt::print( "SaveWriter: failed to write {}: {}\n", job.path, error );
+    }
+    ReleaseBuffer( std::move( job.data ) );
+
+    {
+      std::lock_guard<std::mutex> const lock( _mutex );
+      if ( !job.message.empty() || !ok ) {
+        _results.push_back( Result{
+            .path = job.path, .message = ok ? job.message : "Failed to write " + job.path + ": " + error, .ok = ok } );
+      }
+      _inFlight--;
+    }
+    _idleCv.notify_all();
+  }
+}
+
+bool SaveWriter::WriteFileAtomic( const std::string &path, const std::vector<u8> &data, std::string &error )
+{
+  namespace fs = std::filesystem;
+  try {
+    fs::path const target( path );
+    if ( target.has_parent_path() && !fs::exists( target.parent_path() ) ) {
+      fs::create_directories( target.parent_path() );
+    }
+
+    fs::path tmp = target;
+    tmp += ".tmp";
+    {
+      std::ofstream out( tmp, std::ios::out | std::ios::binary | std::ios::trunc );
+      if ( !out ) {
+        error = "could not open temp file";
+        return false;
+      }
+      out.write( reinterpret_cast<const char *>( data.data() ), static_cast<std::streamsize>( data.size() ) ); // NOLINT
+      out.flush();
+      if ( !out ) {
+        error = "write failed";
+        std::error_code ec;
+        fs::remove( tmp, ec );
+        return false;
+      }
+    }
+    fs::rename( tmp, target );
+  } catch ( const std::exception &e ) {
+    error = e.what();
+    return false;
+  }
+  return true;
+}
+
+/*
+################################
+||         Compression        ||
+################################
+  PackBits: a control byte n in [0, 127] is followed by n + 1 literal bytes, n in [129, 255]
+  repeats the next byte 257 - n times. 128 is unused.
+*/
+bool SaveWriter::IsCompressed( const u8 *data, std::size_t size )
+{
+  return size >= compressedHeaderSize && std::memcmp( data, compressedMagic.data(), compressedMagic.size() ) == 0;
+}
+
+void SaveWriter::Compress( const std::vector<u8> &in, std::vector<u8> &out )
+{
+  out.clear();
+  out.reserve( ( in.size() / 8 ) + compressedHeaderSize );
+  out.insert( out.end(), compressedMagic.begin(), compressedMagic.end() );
+  auto const rawSize = static_cast<u32>( in.size() );
+  for ( int i = 0; i < 4; ++i ) {
+    out.push_back( static_cast<u8>( rawSize >> ( i * 8 ) ) );
+  }
+
+  std::size_t i = 0;
+  std::size_t const n = in.size();
+  while ( i < n ) {
+    // Measure the run starting here
+    std::size_t run = 1;
+    while ( i + run < n && run < 128 && in[i + run] == in[i] ) {
+      run++;
+    }
+
+    if ( run >= 3 ) {
+      out.push_back( static_cast<u8>( 257 - run ) );
+      out.push_back( in[i] );
+      i += run;
+      continue;
+    }
+
+    // Literal stretch: extend until the next run of 3 or more
+    std::size_t const start = i;
+    while ( i < n && i - start < 128 ) {
+      if ( i + 2 < n && in[i] == in[i + 1] && in[i] == in[i + 2] ) {
+        break;
+      }
+      i++;
+    }
+    out.push_back( static_cast<u8>( i - start - 1 ) );
+    out.insert( out.end(), in.begin() + static_cast<std::ptrdiff_t>( start ),
+                in.begin() + static_cast<std::ptrdiff_t>( i ) );
+  }
+}
+
+bool SaveWriter::Decompress( const u8 *data, std::size_t size, std::vector<u8> &out )
+{
+  if ( !IsCompressed( data, size ) ) {
+    return false;
+  }
+  u32 rawSize = 0;
+  for ( int i = 0; i < 4; ++i ) {
+    rawSize |= static_cast<u32>( data[4 + i] ) << ( i * 8 ); // NOLINT
+  }
+
+  out.clear();
+  out.reserve( rawSize );
+  std::size_t i = compressedHeaderSize;
+  while ( i < size ) {
+    u8 const control = data[i++]; // NOLINT
+    if ( control < 128 ) {
+      std::size_t const count = control + 1;
+      if ( i + count > size ) {
+        return false;
+      }
+      out.insert( out.end(), data + i, data + i + count ); // NOLINT
+      i += count;
+    } else if ( control > 128 ) {
+      if ( i >= size ) {
+        return false;
+      }
+      out.insert( out.end(), 257 - control, data[i++] ); // NOLINT
+    }
+  }
+  return out.size() == rawSize;
+}
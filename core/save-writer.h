@@ -0,0 +1,97 @@
+#pragma once
+#include "global-types.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+################################
+||         Save Writer        ||
+################################
+  Background I/O worker for save states and battery RAM.
+
+  The emulation thread only serializes into a pooled buffer and hands it off with Submit().
+  The worker thread (started lazily on the first submit) optionally compresses the buffer,
+  writes it to "<path>.tmp" and renames it over the destination, so a crash mid-write never
+  leaves a half written file behind. Completed jobs are queued up as results, which the
+  frontend drains once per frame to drive the notification UI.
+*/
+
+class SaveWriter
+{
+public:
+  struct Result {
+    std::string path;
+    std::string message; // user facing message, empty for silent jobs (e.g. battery saves)
+    bool        ok = false;
+  };
+
+  SaveWriter() = default;
+  ~SaveWriter();
+
+  SaveWriter( const SaveWriter & ) = delete;
+  SaveWriter &operator=( const SaveWriter & ) = delete;
+  SaveWriter( SaveWriter && ) = delete;
+  SaveWriter &operator=( SaveWriter && ) = delete;
+
+  /*
+  ################################
+  ||          Job Queue         ||
+  ################################
+  */
+  // Returns an empty buffer, reusing the capacity of a previously written one when possible
+  std::vector<u8> AcquireBuffer();
+
+  // Queue a buffer to be written to path. Ownership of the buffer moves to the worker.
+  void Submit( const std::string &path, std::vector<u8> &&data, bool compress, const std::string &message = "" );
+
+  // Block until every submitted job has hit the disk
+  void Flush();
+
+  // Drain results of finished jobs, oldest first
+  std::vector<Result> TakeResults();
+
+  [[nodiscard]] std::size_t PendingCount();
+
+  /*
+  ################################
+  ||         Compression        ||
+  ################################
+  */
+  // PackBits style RLE behind a small header. States are dominated by long runs of zeros
+  // (flat memory, CHR RAM, unused PRG RAM) so this alone shrinks them by an order of magnitude.
+  static void Compress( const std::vector<u8> &in, std::vector<u8> &out );
+  static bool Decompress( const u8 *data, std::size_t size, std::vector<u8> &out );
+  static bool IsCompressed( const u8 *data, std::size_t size );
+
+  // Synchronous atomic write, used by the worker
+  static bool WriteFileAtomic( const std::string &path, const std::vector<u8> &data, std::string &error );
+
+private:
+  struct Job {
+    std::string     path;
+    std::vector<u8> data;
+    std::string     message;
+    bool            compress = false;
+  };
+
+  void Run();
+  void ReleaseBuffer( std::vector<u8> &&buffer );
+
+  std::mutex                   _mutex;
+  std::condition_variable      _cv;
+  std::condition_variable      _idleCv;
+  std::deque<Job>              _jobs;
+  std::vector<Result>          _results;
+  std::vector<std::vector<u8>> _pool;
+  std::size_t                  _inFlight = 0;
+  bool                         _stop = false;
+  std::thread                  _worker;
+
+  static constexpr std::size_t maxPooledBuffers = 4;
+};
@@ -0,0 +1,107 @@
+#include "state-hash.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+constexpr u64 prime1 = 0x9E3779B185EBCA87ULL;
+constexpr u64 prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr u64 prime3 = 0x165667B19E3779F9ULL;
+
+constexpr std::size_t stripeSize = 64;
+constexpr std::size_t lanes = stripeSize / sizeof( u64 );
+
+// Per-lane keys, the first 64 bytes of the XXH3 default secret
+constexpr std::array<u64, lanes> stripeKeys = { 0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL, 0xdb979083e96dd4deULL,
+                                                0x1f67b3b7a4a44072ULL, 0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL,
+                                                0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL };
+
+u64 Load64( const u8 *p )
+{
+  u64 value = 0;
+  std::memcpy( &value, p, sizeof( value ) );
+  if constexpr ( std::endian::native == std::endian::big ) {
+    value = std::byteswap( value );
+  }
+  return value;
+}
+
+// Independent lanes with no cross-iteration dependency, written so the loop vectorizes
+void Accumulate( std::array<u64, lanes> &acc, const u8 *stripe, u64 seed )
+{
+  std::array<u64, lanes> data{};
+  for ( std::size_t i = 0; i < lanes; ++i ) {
+    data[i] = Load64( stripe + ( i * sizeof( u64 ) ) ); // NOLINT
+  }
+  for ( std::size_t i = 0; i < lanes; ++i ) {
+    u64 const key = data[i] ^ ( stripeKeys[i] + seed );
+    acc[i ^ 1] += data[i];
+    acc[i] += ( key & 0xFFFFFFFFULL ) * ( key >> 32 );
+  }
+}
+
+u64 Avalanche( u64 h )
+{
+  h ^= h >> 37;
+  h *= 0x165667919E3779F9ULL;
+  h ^= h >> 32;
+  return h;
+}
+} // namespace
+
+u64 statehash::HashBytes( const u8 *data, std::size_t size, u64 seed )
+{
+  std::array<u64, lanes> acc = { prime3, prime1, prime2, prime1 ^ seed, prime2 ^ seed, prime3 ^ seed, prime1, prime2 };
+
+  std::size_t offset = 0;
+  for ( ; offset + stripeSize <= size; offset += stripeSize ) {
+    Accumulate( acc, data + offset, seed ); // NOLINT
+  }
+  if ( offset < size ) {
+    std::array<u8, stripeSize> tail{};
+    std::memcpy( tail.data(), data + offset, size - offset ); // NOLINT
+    Accumulate( acc, tail.data(), seed );
+  }
+
+  u64 result = ( static_cast<u64>( size ) * prime1 ) ^ seed;
+  for ( std::size_t i = 0; i < lanes; i += 2 ) {
+    result += Avalanche( acc[i] ^ std::rotl( acc[i + 1], 31 ) ) * prime2;
+    result = std::rotl( result, 27 ) * prime1;
+  }
+  return Avalanche( result );
+}
+
+u64 StateHasher::Region( StateRegion region, const u8 *data, std::size_t size )
+{
+  std::array<const u8 *, maxPages> pages{};
+  for ( std::size_t page = 0; page * pageSize < size && page < maxPages; ++page ) {
+    pages.at( page ) = data + ( page * pageSize ); // NOLINT
+  }
+  return Region( region, pages.data(), size );
+}
+
+u64 StateHasher::Region( StateRegion region, const u8 *const *pages, std::size_t size )
+{
+  auto const  idx = static_cast<std::size_t>( region );
+  auto       &hashes = _pageHashes[idx];
+  std::size_t pageCount = std::min( ( size + pageSize - 1 ) / pageSize, maxPages );
+
+  u64 dirty = _dirty[idx];
+  while ( dirty != 0 ) {
+    auto const page = static_cast<std::size_t>( std::countr_zero( dirty ) );
+    dirty &= dirty - 1;
+    if ( page >= pageCount ) {
+      break;
+    }
+    std::size_t const begin = page * pageSize;
+    hashes[page] = statehash::HashBytes( pages[page], std::min( pageSize, size - begin ), page ); // NOLINT
+  }
+  _dirty[idx] = 0;
+
+  return statehash::HashBytes( reinterpret_cast<const u8 *>( hashes.data() ), pageCount * sizeof( u64 ), idx ); // NOLINT
+}
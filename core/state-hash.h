@@ -0,0 +1,88 @@
+#pragma once
+#include "cow-memory.h"
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/*
+################################
+||         State Hash         ||
+################################
+  Fast, non-cryptographic hashing of machine state, used to detect desyncs between runs, builds
+  and machines.
+
+  HashBytes is an xxh3-style hash: 64-byte stripes are folded into eight independent 64-bit
+  accumulators with a 32x32->64 multiply per lane, which compilers turn into SIMD on every
+  target we build for. It is not bit compatible with the reference XXH3.
+
+  StateHasher keeps a hash per 256-byte page of every large memory region and a dirty bit per
+  page. Writes only set the dirty bit, so a per-frame hash only rehashes the pages the game
+  actually touched. Anything that replaces memory wholesale (state loads, resets, rom loads)
+  must call MarkAllDirty().
+*/
+
+namespace statehash
+{
+u64 HashBytes( const u8 *data, std::size_t size, u64 seed = 0 );
+
+// Collects small scalar state (registers, latches) into a byte buffer for hashing. Mirrors
+// the cereal archive call syntax so existing field lists can be reused.
+class ScalarArchive
+{
+public:
+  template <class... Ts> void operator()( const Ts &...values ) { ( Append( values ), ... ); }
+
+  [[nodiscard]] const std::vector<u8> &Bytes() const { return _bytes; }
+  void                                 Clear() { _bytes.clear(); }
+
+private:
+  template <class T> void Append( const T &value )
+  {
+    static_assert( std::is_trivially_copyable_v<T>, "only plain values can be hashed" );
+    std::size_t const at = _bytes.size();
+    _bytes.resize( at + sizeof( T ) );
+    std::memcpy( &_bytes[at], &value, sizeof( T ) );
+  }
+
+  std::vector<u8> _bytes;
+};
+} // namespace statehash
+
+enum class StateRegion : u8 { Ram, Nametables, Palette, Oam, PrgRam, ChrRam, Count };
+
+class StateHasher
+{
+public:
+  static constexpr std::size_t pageSize = 256;
+  static constexpr std::size_t maxPages = 64; // one u64 dirty mask per region
+
+  StateHasher() { MarkAllDirty(); }
+
+  // Hot path, called on every tracked memory write
+  void MarkDirty( StateRegion region, std::size_t offset )
+  {
+    _dirty[static_cast<std::size_t>( region )] |= u64{ 1 } << ( ( offset / pageSize ) & ( maxPages - 1 ) );
+  }
+  void MarkAllDirty() { _dirty.fill( ~u64{ 0 } ); }
+
+  // Rehashes the dirty pages of region (size bytes at data), returns the hash of the region
+  u64 Region( StateRegion region, const u8 *data, std::size_t size );
+
+  // Same for paged memory, pages[i] holds bytes i * pageSize and on
+  u64 Region( StateRegion region, const u8 *const *pages, std::size_t size );
+  template <std::size_t Size> u64 Region( StateRegion region, const CowMemory<Size> &memory )
+  {
+    static_assert( CowMemory<Size>::pageSize == pageSize );
+    return Region( region, memory.Pages().data(), Size );
+  }
+
+private:
+  static constexpr std::size_t regionCount = static_cast<std::size_t>( StateRegion::Count );
+
+  std::array<u64, regionCount>                       _dirty{};
+  std::array<std::array<u64, maxPages>, regionCount> _pageHashes{};
+};
@@ -0,0 +1,103 @@
+#include "trace-file.h"
+#include "global-types.h"
+#include "trace-ring.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fmt/base.h>
+#include <ios>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t chunkRecords = 64 * 1024; // compared per memcmp by FindFirstDivergence
+} // namespace
+
+bool TraceFileReader::Open( const std::string &path )
+{
+  _file.close();
+  _count = 0;
+  _file.open( path, std::ios::in | std::ios::binary );
+  if ( !_file ) {
+    fmt::print( "TraceFileReader: could not open {}\n", path );
+    return false;
+  }
+  _file.read( reinterpret_cast<char *>( &_header ), sizeof( _header ) ); // NOLINT
+  if ( !_file || _header.magic != trace_file::magic ) {
+    fmt::print( "TraceFileReader: {} is not a trace file\n", path );
+    return false;
+  }
+  if ( _header.version != trace_file::version || _header.recordSize != sizeof( TraceRecord ) ) {
+    fmt::print( "TraceFileReader: {} is trace version {} with {}-byte records, expected version {} with {}\n", path,
+                _header.version, _header.recordSize, trace_file::version, sizeof( TraceRecord ) );
+    return false;
+  }
+
+  // A writer that didn't get to close leaves a partial last record, which is ignored
+  std::error_code ec;
+  auto const      bytes = std::filesystem::file_size( path, ec );
+  if ( ec ) {
+    fmt::print( "TraceFileReader: could not size {}: {}\n", path, ec.message() );
+    return false;
+  }
+  _count = ( bytes - sizeof( _header ) ) / sizeof( TraceRecord );
+  return true;
+}
+
+bool TraceFileReader::Read( u64 first, std::size_t count, std::vector<TraceRecord> &out )
+{
+  out.clear();
+  if ( first >= _count ) {
+    return true;
+  }
+  out.resize( static_cast<std::size_t>( std::min<u64>( count, _count - first ) ) );
+  _file.clear();
+  _file.seekg( static_cast<std::streamoff>( sizeof( _header ) + ( first * sizeof( TraceRecord ) ) ) );
+  _file.read( reinterpret_cast<char *>( out.data() ), // NOLINT
+              static_cast<std::streamsize>( out.size() * sizeof( TraceRecord ) ) );
+  if ( !_file ) {
+    out.clear();
+    return false;
+  }
+  return true;
+}
+
+bool FindFirstDivergence( TraceFileReader &a, TraceFileReader &b, u64 &index )
+{
+  /** @brief Compares chunks of records with one memcmp each, then bisects the first chunk that
+   * differs over record offsets. Once a prefix of the chunk differs every longer one does too, so
+   * halving the candidate range finds the first differing record in log2 steps.
+   */
+  u64 const                count = std::min( a.RecordCount(), b.RecordCount() );
+  std::vector<TraceRecord> left;
+  std::vector<TraceRecord> right;
+  for ( u64 first = 0; first < count; first += chunkRecords ) {
+    auto const size = static_cast<std::size_t>( std::min<u64>( chunkRecords, count - first ) );
+    if ( !a.Read( first, size, left ) || !b.Read( first, size, right ) ) {
+      return false;
+    }
+    if ( std::memcmp( left.data(), right.data(), size * sizeof( TraceRecord ) ) == 0 ) {
+      continue;
+    }
+
+    // The first lo records match, the first hi don't
+    std::size_t lo = 0;
+    std::size_t hi = size;
+    while ( hi - lo > 1 ) {
+      std::size_t const mid = lo + ( ( hi - lo ) / 2 );
+      if ( std::memcmp( left.data(), right.data(), mid * sizeof( TraceRecord ) ) == 0 ) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    index = first + lo;
+    return true;
+  }
+  index = count;
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "global-types.h"
+#include "trace-ring.h"
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+################################
+||         Trace File         ||
+################################
+  On-disk CPU traces, written by TraceWriter and read back by TraceFileReader (the emu_trace
+  decoder and diff tool, tests). A 16-byte Header followed by the TraceRecords exactly as they sit
+  in memory, so record n is at sizeof( Header ) + n * recordSize and readers can seek straight to
+  it. Files are little-endian, like every host the emulator builds on.
+
+  timing says which log the records came from: the instruction-start trace (one record per
+  instruction, before its opcode fetch) or the Mesen-timed one (captured on the opcode fetch
+  cycle). Both hold the same fields, but their PPU positions and cycles differ, so the diff tool
+  refuses to compare files of different timing.
+*/
+
+namespace trace_file
+{
+constexpr u32 magic = 0x4352544E; // "NTRC"
+constexpr u32 version = 1;
+
+enum class Timing : u32 { InstructionStart = 0, MesenFetch = 1 };
+
+struct Header {
+  u32    magic = trace_file::magic;
+  u32    version = trace_file::version;
+  u32    recordSize = sizeof( TraceRecord );
+  Timing timing = Timing::InstructionStart;
+};
+static_assert( sizeof( Header ) == 16 );
+} // namespace trace_file
+
+class TraceFileReader
+{
+public:
+  // False, with the reason printed, if the file can't be read or isn't a trace of this version
+  bool Open( const std::string &path );
+
+  [[nodiscard]] u64                RecordCount() const { return _count; }
+  [[nodiscard]] trace_file::Timing TraceTiming() const { return _header.timing; }
+
+  // Replaces out with up to count records starting at first. False on a read error.
+  bool Read( u64 first, std::size_t count, std::vector<TraceRecord> &out );
+
+private:
+  std::ifstream      _file;
+  trace_file::Header _header;
+  u64                _count = 0;
+};
+
+// Index of the first record that differs between the two traces. When one trace is a prefix of the
+// other that's the shorter one's RecordCount(), so equal traces give a.RecordCount().
+// False if either file can't be read.
+bool FindFirstDivergence( TraceFileReader &a, TraceFileReader &b, u64 &index );
@@ -0,0 +1,211 @@
+#include "trace-ring.h"
+#include "cpu-types.h"
+#include "global-types.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+void TraceRing::SetCapacity( std::size_t capacity )
+{
+  capacity = std::max<std::size_t>( capacity, 1 );
+  std::size_t const keep = std::min( Size(), capacity );
+  std::vector<TraceRecord> records;
+  records.reserve( keep );
+  for ( std::size_t i = Size() - keep; i < Size(); ++i ) {
+    records.push_back( ( *this )[i] );
+  }
+  _records = std::move( records );
+  _next = 0;
+  _capacity = capacity;
+}
+
+std::string FormatTraceLine( const TraceRecord &record, bool verbose ) // NOLINT
+{
+  std::string output;
+
+  u16 const          pc = record.pc;
+  u8 const           opcode = record.bytes[0];
+  std::string const &name = gInstructionNames.at( opcode );
+  std::string const &addrMode = gAddressingModes.at( opcode );
+
+  // Program counter address
+  // i.e. FFFF
+  output += utils::toHex( pc, 4 ) + " ";
+
+  if ( verbose ) {
+    output += "  ";
+    // Hex instruction
+    // i.e. 4C F5 C5, this is the hex instruction
+    u8 const    bytes = gInstructionBytes.at( opcode );
+    std::string hexInstruction;
+    for ( u8 i = 0; i < bytes; i++ ) {
+      hexInstruction += utils::toHex( record.bytes.at( i ), 2 ) + ' ';
+    }
+
+    // formatting, the instruction hex_instruction will be 9 characters long, with space padding to
+    // the right. This makes sure the hex line is the same length for all instructions
+    hexInstruction += std::string( 9 - ( bytes * 3 ), ' ' );
+    output += hexInstruction;
+  }
+
+  // If name starts with a "*", it is an illegal opcode
+  ( name[0] == '*' ) ? output += "*" + name.substr( 1 ) + " " : output += name + " ";
+
+  // Addressing mode and operand
+
+  std::string assemblyStr;
+  u8          value = 0x00;
+  u8          low = 0x00;
+  u8          high = 0x00;
+  if ( addrMode == "IMP" ) {
+    // Nothing to prefix
+  } else if ( addrMode == "IMM" ) {
+    value = record.bytes[1];
+    assemblyStr += "#$" + utils::toHex( value, 2 );
+  } else if ( addrMode == "ZPG" || addrMode == "ZPGX" || addrMode == "ZPGY" ) {
+    value = record.bytes[1];
+    assemblyStr += "$" + utils::toHex( value, 2 );
+
+    ( addrMode == "ZPGX" ) ? assemblyStr += ", X" : ( addrMode == "ZPGY" ) ? assemblyStr += ", Y" : assemblyStr += "";
+  } else if ( addrMode == "ABS" || addrMode == "ABSX" || addrMode == "ABSY" ) {
+    low = record.bytes[1];
+    high = record.bytes[2];
+    u16 const address = ( high << 8 ) | low;
+
+    assemblyStr += "$" + utils::toHex( address, 4 );
+    ( addrMode == "ABSX" ) ? assemblyStr += ", X" : ( addrMode == "ABSY" ) ? assemblyStr += ", Y" : assemblyStr += "";
+  } else if ( addrMode == "IND" ) {
+    low = record.bytes[1];
+    high = record.bytes[2];
+    u16 const address = ( high << 8 ) | low;
+    assemblyStr += "($" + utils::toHex( address, 4 ) + ")";
+  } else if ( addrMode == "INDX" || addrMode == "INDY" ) {
+    value = record.bytes[1];
+    ( addrMode == "INDX" ) ? assemblyStr += "($" + utils::toHex( value, 2 ) + ", X)"
+                           : assemblyStr += "($" + utils::toHex( value, 2 ) + "), Y";
+  } else if ( addrMode == "REL" ) {
+    value = record.bytes[1];
+    s8 const  offset = static_cast<s8>( value );
+    u16 const address = pc + 2 + offset;
+
+    assemblyStr += "$" + utils::toHex( value, 2 ) + " [$" + utils::toHex( address, 4 ) + "]";
+  } else {
+    // Houston.. yet again
+    throw std::runtime_error( "Unknown addressing mode: " + addrMode );
+  }
+
+  // Pad the assembly string with spaces, for fixed length
+  if ( verbose ) {
+    output += assemblyStr + std::string( 15 - assemblyStr.size(), ' ' );
+  }
+
+  // Add more log info
+  std::string registersStr;
+  // Format
+  // a: 00 x: 00 y: 00 s: FD
+  registersStr += "a: " + utils::toHex( record.a, 2 ) + " ";
+  registersStr += "x: " + utils::toHex( record.x, 2 ) + " ";
+  registersStr += "y: " + utils::toHex( record.y, 2 ) + " ";
+  registersStr += "s: " + utils::toHex( record.s, 2 ) + " ";
+
+  // status register
+  // Will return a formatted status string
+  // p: hex value, status string (NV-BDIZC). Letter present is flag set, dash is flag unset
+  std::string statusStr;
+  u8 const   status = record.p;
+  statusStr += "p: " + utils::toHex( status, 2 ) + " ";
+
+  std::string statusFlags = "NV-BDIZC";
+  std::string statusFlagsLower = "nv--dizc";
+  std::string statusFlagsStr;
+  for ( int i = 7; i >= 0; i-- ) {
+    statusFlagsStr += ( status & ( 1 << i ) ) != 0 ? statusFlags[7 - i] : statusFlagsLower[7 - i];
+  }
+  statusStr += statusFlagsStr;
+
+  // Combine to the output string
+  output += registersStr + statusStr;
+
+  // Scanline num (V)
+  if ( verbose ) {
+    std::string const scanlineStr = std::to_string( record.scanline );
+    // std::string scanlinestradjusted = std::string( 4 - scanlinestr.size(), ' ' );
+    output += "  V: " + scanlineStr;
+
+    // PPU cycles (H), pad for 3 characters + space
+    u16 const   ppuCycles = record.dot;
+    std::string ppuCyclesStr = std::to_string( ppuCycles );
+    ppuCyclesStr += std::string( 4 - ppuCyclesStr.size(), ' ' );
+    output += "  H: " + ppuCyclesStr; // PPU cycle
+
+    // cycle count
+    output += "  Cycle: " + std::to_string( record.cycle );
+  }
+
+  return output;
+}
+
+std::string FormatNestestLine( const TraceRecord &record )
+{
+  // C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+  u8 const           opcode = record.bytes[0];
+  std::string const &name = gInstructionNames.at( opcode );
+  std::string const &addrMode = gAddressingModes.at( opcode );
+  u8 const           bytes = gInstructionBytes.at( opcode );
+  u8 const           value = record.bytes[1];
+  u16 const          address = ( record.bytes[2] << 8 ) | record.bytes[1];
+
+  std::string output = utils::toHex( record.pc, 4 ) + "  ";
+  for ( u8 i = 0; i < bytes; i++ ) {
+    output += utils::toHex( record.bytes.at( i ), 2 ) + ' ';
+  }
+  output += std::string( 9 - ( bytes * 3 ), ' ' );
+
+  // Illegal opcodes take the separator space for their "*". nestest.log calls ISC ISB.
+  std::string disassembly = name[0] == '*' ? name : " " + name;
+  if ( disassembly == "*ISC" ) {
+    disassembly = "*ISB";
+  }
+  if ( addrMode == "IMP" ) {
+    // ASL A and friends, the other implied instructions have no operand
+    bool const accumulator = opcode == 0x0A || opcode == 0x2A || opcode == 0x4A || opcode == 0x6A;
+    disassembly += accumulator ? " A" : "";
+  } else if ( addrMode == "IMM" ) {
+    disassembly += " #$" + utils::toHex( value, 2 );
+  } else if ( addrMode == "ZPG" ) {
+    disassembly += " $" + utils::toHex( value, 2 );
+  } else if ( addrMode == "ZPGX" || addrMode == "ZPGY" ) {
+    disassembly += " $" + utils::toHex( value, 2 ) + ( addrMode == "ZPGX" ? ",X" : ",Y" );
+  } else if ( addrMode == "ABS" ) {
+    disassembly += " $" + utils::toHex( address, 4 );
+  } else if ( addrMode == "ABSX" || addrMode == "ABSY" ) {
+    disassembly += " $" + utils::toHex( address, 4 ) + ( addrMode == "ABSX" ? ",X" : ",Y" );
+  } else if ( addrMode == "IND" ) {
+    disassembly += " ($" + utils::toHex( address, 4 ) + ")";
+  } else if ( addrMode == "INDX" ) {
+    disassembly += " ($" + utils::toHex( value, 2 ) + ",X)";
+  } else if ( addrMode == "INDY" ) {
+    disassembly += " ($" + utils::toHex( value, 2 ) + "),Y";
+  } else if ( addrMode == "REL" ) {
+    disassembly += " $" + utils::toHex( static_cast<u16>( record.pc + 2 + static_cast<s8>( value ) ), 4 );
+  } else {
+    throw std::runtime_error( "Unknown addressing mode: " + addrMode );
+  }
+  output += disassembly + std::string( disassembly.size() < 33 ? 33 - disassembly.size() : 1, ' ' );
+
+  output += "A:" + utils::toHex( record.a, 2 ) + " X:" + utils::toHex( record.x, 2 ) +
+            " Y:" + utils::toHex( record.y, 2 ) + " P:" + utils::toHex( record.p, 2 ) +
+            " SP:" + utils::toHex( record.s, 2 );
+
+  std::string scanline = std::to_string( record.scanline );
+  std::string dot = std::to_string( record.dot );
+  scanline.insert( 0, scanline.size() < 3 ? 3 - scanline.size() : 0, ' ' );
+  dot.insert( 0, dot.size() < 3 ? 3 - dot.size() : 0, ' ' );
+  output += " PPU:" + scanline + "," + dot + " CYC:" + std::to_string( record.cycle );
+  return output;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+################################
+||         Trace Ring         ||
+################################
+  The CPU trace logs keep one TraceRecord per line: the registers, the instruction bytes and the
+  PPU position at the moment the line was due, 24 bytes and no allocations. Text only exists when
+  a line is shown or exported, through FormatTraceLine(), which gives exactly what
+  CPU::LogLineAtPC() would have at that moment.
+
+  TraceRing keeps the newest capacity records. Readers index it in place (0 is the oldest), so the
+  debugger only formats the rows it draws and a million-line trace costs 24MB and no copies.
+*/
+
+struct TraceRecord {
+  u64               cycle = 0;
+  u16               pc = 0;
+  u16               scanline = 0;
+  u16               dot = 0;
+  std::array<u8, 3> bytes{}; // opcode and operands, gInstructionBytes of them are valid
+  u8                a = 0;
+  u8                x = 0;
+  u8                y = 0;
+  u8                s = 0;
+  u8                p = 0;
+  std::array<u8, 2> reserved{}; // zero, so records have no padding and compare bytewise on disk
+
+  bool operator==( const TraceRecord & ) const = default;
+};
+static_assert( sizeof( TraceRecord ) == 24 && std::has_unique_object_representations_v<TraceRecord> );
+
+// The trace line for a record. Verbose adds the instruction bytes and the PPU position and cycle.
+std::string FormatTraceLine( const TraceRecord &record, bool verbose = true );
+
+// The same record laid out like nestest.log. Records don't keep the memory nestest.log annotates
+// operands with (the "= 00" and "@ 0300" parts), so those are left out and the columns after stay put.
+std::string FormatNestestLine( const TraceRecord &record );
+
+class TraceRing
+{
+public:
+  explicit TraceRing( std::size_t capacity = 100 ) : _capacity( capacity ) {}
+
+  void Push( const TraceRecord &record )
+  {
+    if ( _records.size() < _capacity ) {
+      _records.push_back( record );
+      return;
+    }
+    _records[_next] = record;
+    _next = _next + 1 == _capacity ? 0 : _next + 1;
+  }
+
+  // Keeps the newest records that still fit
+  void SetCapacity( std::size_t capacity );
+  void Clear()
+  {
+    _records.clear();
+    _next = 0;
+  }
+
+  [[nodiscard]] std::size_t Size() const { return _records.size(); }
+  [[nodiscard]] std::size_t Capacity() const { return _capacity; }
+  [[nodiscard]] bool        Empty() const { return _records.empty(); }
+
+  // 0 is the oldest record, Size() - 1 the newest
+  [[nodiscard]] const TraceRecord &operator[]( std::size_t index ) const
+  {
+    std::size_t const at = _next + index;
+    return _records[at < _records.size() ? at : at - _records.size()];
+  }
+
+  bool operator==( const TraceRing & ) const = default;
+
+private:
+  std::vector<TraceRecord> _records;
+  std::size_t              _next = 0; // oldest record, and where the next one goes once full
+  std::size_t              _capacity;
+};
@@ -0,0 +1,128 @@
+#include "trace-writer.h"
+#include "global-types.h"
+#include "trace-file.h"
+#include "trace-ring.h"
+
+#include <filesystem>
+#include <fmt/base.h>
+#include <ios>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+TraceWriter::~TraceWriter()
+{
+  if ( IsOpen() ) {
+    Close();
+  }
+}
+
+bool TraceWriter::Open( const std::string &path, trace_file::Timing timing )
+{
+  if ( IsOpen() ) {
+    Close();
+  }
+
+  std::filesystem::path const target( path );
+  std::error_code             ec;
+  if ( target.has_parent_path() ) {
+    std::filesystem::create_directories( target.parent_path(), ec );
+  }
+  _file.open( path, std::ios::out | std::ios::binary | std::ios::trunc );
+  if ( !_file ) {
+    fmt::print( "TraceWriter: could not open {}\n", path );
+    return false;
+  }
+
+  trace_file::Header const header{ .timing = timing };
+  _file.write( reinterpret_cast<const char *>( &header ), sizeof( header ) ); // NOLINT
+  if ( !_file ) {
+    fmt::print( "TraceWriter: failed writing {}\n", path );
+    _file.close();
+    return false;
+  }
+
+  _path = path;
+  _open = true;
+  _records = 0;
+  _stop = false;
+  _failed = false;
+  _buffer.clear();
+  _buffer.reserve( bufferRecords );
+  _worker = std::thread( [this]() { Run(); } );
+  return true;
+}
+
+void TraceWriter::Submit()
+{
+  std::vector<TraceRecord> next;
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _records += _buffer.size();
+    _full.push_back( std::move( _buffer ) );
+    if ( !_pool.empty() ) {
+      next = std::move( _pool.back() );
+      _pool.pop_back();
+    }
+  }
+  _cv.notify_one();
+
+  if ( next.capacity() == 0 ) {
+    next.reserve( bufferRecords );
+  }
+  _buffer = std::move( next );
+}
+
+bool TraceWriter::Close()
+{
+  if ( !IsOpen() ) {
+    return false;
+  }
+  if ( !_buffer.empty() ) {
+    Submit();
+  }
+  {
+    std::lock_guard<std::mutex> const lock( _mutex );
+    _stop = true;
+  }
+  _cv.notify_one();
+  _worker.join();
+
+  _file.close();
+  _open = false;
+  bool const ok = !_failed && !_file.fail();
+  if ( !ok ) {
+    fmt::print( "TraceWriter: failed writing {}\n", _path );
+  }
+  _pool.clear();
+  _buffer = {};
+  return ok;
+}
+
+void TraceWriter::Run()
+{
+  std::unique_lock<std::mutex> lock( _mutex );
+  while ( true ) {
+    _cv.wait( lock, [this]() { return _stop || !_full.empty(); } );
+    if ( _full.empty() ) {
+      return; // stopped, and everything is written
+    }
+    std::vector<TraceRecord> buffer = std::move( _full.front() );
+    _full.pop_front();
+    lock.unlock();
+
+    _file.write( reinterpret_cast<const char *>( buffer.data() ), // NOLINT
+                 static_cast<std::streamsize>( buffer.size() * sizeof( TraceRecord ) ) );
+    bool const ok = static_cast<bool>( _file );
+    buffer.clear();
+
+    lock.lock();
+    _failed = _failed || !ok;
+    if ( _pool.size() < maxPooledBuffers ) {
+      _pool.push_back( std::move( buffer ) );
+    }
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "global-types.h"
+#include "trace-file.h"
+#include "trace-ring.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+################################
+||        Trace Writer        ||
+################################
+  Streams CPU trace records to a trace file (see trace-file.h) for runs far longer than any
+  in-memory log, e.g. hundreds of millions of instructions to diff against another build.
+
+  Append() only copies the record into the current buffer. A full buffer (bufferRecords
+  records, 1.5MB) is handed to a worker thread that writes it in one call, and the emulation
+  thread carries on with an empty one from the pool, or a newly allocated one if the worker is
+  still busy with all of them. Emulation never waits for the disk; a disk slower than the
+  trace only costs memory until Close().
+*/
+
+class TraceWriter
+{
+public:
+  TraceWriter() = default;
+  ~TraceWriter();
+
+  TraceWriter( const TraceWriter & ) = delete;
+  TraceWriter &operator=( const TraceWriter & ) = delete;
+  TraceWriter( TraceWriter && ) = delete;
+  TraceWriter &operator=( TraceWriter && ) = delete;
+
+  // Creates the file, writes the header and starts the worker
+  bool Open( const std::string &path, trace_file::Timing timing );
+
+  void Append( const TraceRecord &record )
+  {
+    _buffer.push_back( record );
+    if ( _buffer.size() == bufferRecords ) {
+      Submit();
+    }
+  }
+
+  // Writes what's left and waits for the worker. Returns false if any write failed.
+  bool Close();
+
+  [[nodiscard]] bool IsOpen() const { return _open; }
+  [[nodiscard]] u64  RecordsWritten() const { return _records + _buffer.size(); }
+
+  static constexpr std::size_t bufferRecords = 64 * 1024;
+
+private:
+  void Submit();
+  void Run();
+
+  std::ofstream                         _file; // the worker's once open
+  std::string                           _path;
+  bool                                  _open = false;
+  std::vector<TraceRecord>              _buffer;
+  u64                                   _records = 0; // in submitted buffers
+  std::mutex                            _mutex;
+  std::condition_variable               _cv;
+  std::deque<std::vector<TraceRecord>>  _full;
+  std::vector<std::vector<TraceRecord>> _pool;
+  bool                                  _stop = false;
+  bool                                  _failed = false;
+  std::thread                           _worker;
+
+  static constexpr std::size_t maxPooledBuffers = 4;
+};
@@ -45,29 +45,38 @@ inline bool between( int value, int min, int max )
  * A hash can be used to identify a file, which is used for save / load states.
  * 2^64 possible values is enough to avoid collisions for every possible ROM.
  */
-inline std::string GetRomHash( const std::string &path ) // NOLINT
+constexpr u64 fnvOffsetBasis = 0xcbf29ce484222325ULL;
+
+inline u64 Fnv1a( const u8 *data, std::size_t size, u64 hash = fnvOffsetBasis ) // NOLINT
 {
-  constexpr u64 fnvOffsetBasis = 0xcbf29ce484222325ULL;
   constexpr u64 fnvPrime = 0x00000100000001B3ULL;
+  for ( std::size_t i = 0; i < size; ++i ) {
+    hash ^= data[i];
+    hash *= fnvPrime;
+  }
+  return hash;
+}
+
+inline std::string FormatRomHash( u64 hash )
+{
+  std::ostringstream oss;
+  oss << std::hex << std::setw( 16 ) << std::setfill( '0' ) << hash;
+  return oss.str();
+}
 
+inline std::string GetRomHash( const std::string &path ) // NOLINT
+{
   std::ifstream in( path, std::ios::binary );
   if ( !in ) {
     return {};
   }
 
-  uint64_t hash = fnvOffsetBasis;
-  char     buf[4096];
+  u64  hash = fnvOffsetBasis;
+  char buf[4096];
   while ( in.read( buf, sizeof( buf ) ) || in.gcount() ) {
-    std::streamsize const n = in.gcount();
-    for ( std::streamsize i = 0; i < n; ++i ) {
-      hash ^= static_cast<u8>( buf[i] );
-      hash *= fnvPrime;
-    }
+    hash = Fnv1a( reinterpret_cast<const u8 *>( buf ), static_cast<std::size_t>( in.gcount() ), hash );
   }
-
-  std::ostringstream oss;
-  oss << std::hex << std::setw( 16 ) << std::setfill( '0' ) << hash;
-  return oss.str();
+  return FormatRomHash( hash );
 }
 
 } // namespace utils
@@ -0,0 +1,132 @@
+#include "wav-writer.h"
+#include "Simple_Apu.h"
+#include "global-types.h"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fmt/base.h>
+#include <fstream>
+#include <ios>
+#include <string>
+
+namespace
+{
+constexpr std::size_t headerSize = 44;
+
+void PutU16( std::array<char, headerSize> &header, std::size_t offset, u16 value )
+{
+  header.at( offset ) = static_cast<char>( value & 0xFF );
+  header.at( offset + 1 ) = static_cast<char>( value >> 8 );
+}
+
+void PutU32( std::array<char, headerSize> &header, std::size_t offset, u32 value )
+{
+  PutU16( header, offset, static_cast<u16>( value & 0xFFFF ) );
+  PutU16( header, offset + 2, static_cast<u16>( value >> 16 ) );
+}
+
+// Canonical 44 byte PCM header, 16 bits per sample
+std::array<char, headerSize> MakeHeader( long sampleRate, int channels, u64 samples )
+{
+  u32 const dataBytes = static_cast<u32>( samples * 2 );
+  u16 const blockAlign = static_cast<u16>( channels * 2 );
+
+  std::array<char, headerSize> header{};
+  std::memcpy( &header.at( 0 ), "RIFF", 4 );
+  std::memcpy( &header.at( 8 ), "WAVEfmt ", 8 );
+  std::memcpy( &header.at( 36 ), "data", 4 );
+  PutU32( header, 4, 36 + dataBytes );
+  PutU32( header, 16, 16 ); // fmt chunk size
+  PutU16( header, 20, 1 );  // PCM
+  PutU16( header, 22, static_cast<u16>( channels ) );
+  PutU32( header, 24, static_cast<u32>( sampleRate ) );
+  PutU32( header, 28, static_cast<u32>( sampleRate ) * blockAlign );
+  PutU16( header, 32, blockAlign );
+  PutU16( header, 34, 16 );
+  PutU32( header, 40, dataBytes );
+  return header;
+}
+} // namespace
+
+WavWriter::~WavWriter()
+{
+  Close();
+}
+
+bool WavWriter::Open( const std::string &path, long sampleRate, int channels )
+{
+  Close();
+  _file.open( path, std::ios::binary | std::ios::trunc );
+  if ( !_file ) {
+    fmt::print( "WavWriter: could not open {}\n", path );
+    return false;
+  }
+  _path = path;
+  _sampleRate = sampleRate;
+  _channels = channels;
+  _samples = 0;
+  _buffer.clear();
+  _buffer.reserve( bufferSamples );
+
+  // Placeholder sizes until Close()
+  auto const header = MakeHeader( _sampleRate, _channels, 0 );
+  _file.write( header.data(), header.size() );
+  return true;
+}
+
+void WavWriter::Write( const s16 *samples, std::size_t count )
+{
+  if ( !_file.is_open() ) {
+    return;
+  }
+  _buffer.insert( _buffer.end(), samples, samples + count ); // NOLINT
+  _samples += count;
+  if ( _buffer.size() >= bufferSamples ) {
+    Flush();
+  }
+}
+
+void WavWriter::WriteFrom( Simple_Apu &apu )
+{
+  // Read straight into the tail of the buffer, no intermediate copy
+  while ( apu.samples_avail() > 0 ) {
+    std::size_t const used = _buffer.size();
+    auto const        chunk = static_cast<std::size_t>( apu.samples_avail() );
+    _buffer.resize( used + chunk );
+    long const read = apu.read_samples( &_buffer[used], static_cast<long>( chunk ) );
+    _buffer.resize( used + static_cast<std::size_t>( read ) );
+    _samples += static_cast<u64>( read );
+    if ( read <= 0 ) {
+      break;
+    }
+  }
+  if ( _buffer.size() >= bufferSamples ) {
+    Flush();
+  }
+}
+
+void WavWriter::Flush()
+{
+  // Samples are stored little endian, which is what every platform we build for uses in memory
+  _file.write( reinterpret_cast<const char *>( _buffer.data() ), // NOLINT
+               static_cast<std::streamsize>( _buffer.size() * sizeof( s16 ) ) );
+  _buffer.clear();
+}
+
+bool WavWriter::Close()
+{
+  if ( !_file.is_open() ) {
+    return true;
+  }
+  Flush();
+  auto const header = MakeHeader( _sampleRate, _channels, _samples );
+  _file.seekp( 0 );
+  _file.write( header.data(), header.size() );
+  bool const ok = static_cast<bool>( _file );
+  _file.close();
+  if ( !ok ) {
+    fmt::print( "WavWriter: failed writing {}\n", _path );
+  }
+  return ok;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "global-types.h"
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class Simple_Apu;
+
+/*
+################################
+||         WAV Writer         ||
+################################
+  Streams 16-bit PCM samples to a .wav file. Samples collect in a memory buffer and go to disk
+  in large blocks, and the RIFF sizes are patched in on Close(), so a render of any length
+  costs one header rewrite and a handful of writes.
+*/
+
+class WavWriter
+{
+public:
+  WavWriter() = default;
+  ~WavWriter();
+
+  WavWriter( const WavWriter & ) = delete;
+  WavWriter &operator=( const WavWriter & ) = delete;
+  WavWriter( WavWriter && ) = delete;
+  WavWriter &operator=( WavWriter && ) = delete;
+
+  bool Open( const std::string &path, long sampleRate, int channels = 1 );
+  void Write( const s16 *samples, std::size_t count );
+
+  // Moves everything in the APU's sample buffer to the file. Call after each end_frame().
+  void WriteFrom( Simple_Apu &apu );
+
+  // Flushes and fixes up the header. Returns false if any write failed.
+  bool Close();
+
+  [[nodiscard]] bool IsOpen() const { return _file.is_open(); }
+  [[nodiscard]] u64  SamplesWritten() const { return _samples; }
+  [[nodiscard]] long SampleRate() const { return _sampleRate; }
+
+private:
+  static constexpr std::size_t bufferSamples = 64 * 1024;
+
+  void Flush();
+
+  std::ofstream    _file;
+  std::string      _path;
+  std::vector<s16> _buffer;
+  u64              _samples = 0;
+  long             _sampleRate = 0;
+  int              _channels = 1;
+};
@@ -26,6 +26,7 @@
 #include <filesystem>
 #include <fstream>
 #include <chrono>
+#include <fmt/format.h>
 #include "tinyfiledialogs.h"
 
 // Ours
@@ -35,6 +36,8 @@
 #include "ui-component.h"
 #include "ui-manager.h"
 #include "paths.h"
+#include "rate-control.h"
+#include "run-ahead.h"
 #include "Sound_Queue.h"
 
 using u32 = uint32_t;
@@ -132,8 +135,16 @@ public:
   ################################
   */
   std::unique_ptr<Sound_Queue> soundQueue;
+  int                          audioLatencyMs = 50; // target queued audio, see Sound_Queue::init
   static int const             audioBufferSize = 2048;
   blip_sample_t                audioBuffer[audioBufferSize]{};
+  RateControl                  rateControl;
+  std::vector<blip_sample_t>   resampledAudio;
+
+  // Queue fill after each frame, as a fraction of its capacity, for the overlay chart
+  static constexpr std::size_t            audioFillHistorySize = 240;
+  std::array<float, audioFillHistorySize> audioFillHistory{};
+  std::size_t                             audioFillIndex = 0;
 
   /*
   ################################
@@ -193,6 +204,7 @@ public:
   CPU        &cpu = bus.cpu;
   PPU        &ppu = bus.ppu;
   Simple_Apu &apu = bus.apu;
+  RunAhead    runAhead;
 
   Renderer() : ui( this ) { InitEmulator(); }
 
@@ -230,10 +242,9 @@ public:
     if ( !soundQueue )
       exit( EXIT_FAILURE );
 
-    if ( soundQueue->init( bus.sampleRate ) )
+    if ( soundQueue->init( bus.sampleRate, 1, audioLatencyMs ) )
       exit( EXIT_FAILURE );
 #endif
-    apu.dmc_reader( Bus::ReadDmc, &bus );
 
     // Directories
     recentRoms = LoadRecentROMs();
@@ -847,7 +858,49 @@ public:
     return true;
   }
 
-  void PlaySamples( const blip_sample_t *samples, long count ) const { soundQueue->write( samples, count ); }
+  void PlaySamples( const blip_sample_t *samples, long count )
+  {
+    if ( !soundQueue ) {
+      return;
+    }
+    // Stretch or squeeze the frame slightly to steer the queue toward its target fill
+    auto const fill = static_cast<std::size_t>( soundQueue->sample_count() );
+    auto const target = static_cast<std::size_t>( soundQueue->target_count() );
+    resampledAudio.clear();
+    rateControl.Process( samples, static_cast<std::size_t>( count ), fill, target, resampledAudio );
+    soundQueue->write( resampledAudio.data(), static_cast<int>( resampledAudio.size() ) );
+
+    audioFillHistory.at( audioFillIndex % audioFillHistorySize ) = static_cast<float>( soundQueue->ring().FillRatio() );
+    audioFillIndex++;
+  }
+
+  // Time the sound card needs to drain the queue down to one frame over its target. Non-zero
+  // only when the frame timer has run ahead of the audio clock by more than rate control can
+  // absorb, e.g. after a stall.
+  std::chrono::duration<double> AudioBacklog() const
+  {
+    if ( !soundQueue || paused ) {
+      return std::chrono::duration<double>( 0.0 );
+    }
+    long const frameSamples = bus.sampleRate / 60;
+    long const excess = soundQueue->sample_count() - soundQueue->target_count() - frameSamples;
+    return std::chrono::duration<double>( excess > 0 ? static_cast<double>( excess ) / bus.sampleRate : 0.0 );
+  }
+
+  void SetAudioLatency( int latencyMs )
+  {
+    audioLatencyMs = latencyMs;
+#ifdef SDL_INIT_AUDIO
+    // The device period depends on the latency, so reopen it
+    soundQueue.reset();
+    soundQueue = std::make_unique<Sound_Queue>();
+    if ( const char *error = soundQueue->init( bus.sampleRate, 1, audioLatencyMs ) ) {
+      std::cerr << "Failed to reopen audio: " << error << '\n';
+      soundQueue.reset();
+    }
+    rateControl.Reset();
+#endif
+  }
 
   /*
   ################################
@@ -868,6 +921,7 @@ public:
       // Emulation and updates
       ExecuteFrame();
       PollEvents();
+      PollSaveResults();
       RenderFrame();
       UpdatePatternTableTextures();
       UpdateOamTextures();
@@ -876,8 +930,9 @@ public:
       // Sleep until the next frame
       std::this_thread::sleep_until( nextFrame );
 
-      // Adjust the next frame time
-      nextFrame += frameInterval;
+      // Adjust the next frame time. Rate control keeps audio in step with this timer, but if the
+      // queue still backs up, wait for the sound card: the audio clock has the final say.
+      nextFrame += frameInterval + AudioBacklog();
 
       // Catch up if behind
       auto now = Clock::now();
@@ -897,6 +952,14 @@ public:
     }
   }
 
+  void PollSaveResults()
+  {
+    // Saves are written on a background thread, report them once they're done
+    for ( const auto &result : bus.saveWriter.TakeResults() ) {
+      NotifyStart( result.message );
+    }
+  }
+
   void SampleMetrics()
   {
     auto now = Clock::now();
@@ -981,8 +1044,9 @@ public:
   */
   void Teardown()
   {
-    // save battery ram (if applicable)
+    // save battery ram (if applicable), and wait for every queued save to land on disk
     bus.cartridge.SaveBatteryRam();
+    bus.saveWriter.Flush();
 
     // Cleanup ImGui
     ImGui_ImplOpenGL3_Shutdown();
@@ -1151,7 +1215,6 @@ public:
             case SDL_SCANCODE_S:
               fmt::print( "Save state\n" );
               bus.QuickSaveState();
-              NotifyStart( "State saved to slot 0." );
               break;
             case SDL_SCANCODE_L:
               fmt::print( "Load state\n" );
@@ -1195,15 +1258,12 @@ public:
             // num keypad 1, 2, 3 save state to slot 1, 2, 3
             case SDL_SCANCODE_KP_1:
               bus.QuickSaveState( 1 );
-              NotifyStart( "State saved to slot 1." );
               break;
             case SDL_SCANCODE_KP_2:
               bus.QuickSaveState( 2 );
-              NotifyStart( "State saved to slot 2." );
               break;
             case SDL_SCANCODE_KP_3:
               bus.QuickSaveState( 3 );
-              NotifyStart( "State saved to slot 3." );
               break;
             default: break;
           }
@@ -1384,20 +1444,28 @@ public:
 
   void ExecuteFrame()
   {
-    while ( currentFrame == ppu.frame ) {
-      if ( paused ) {
-        break;
+    // Sound frames follow the CPU clock, so a paused frame adds no samples
+    if ( paused ) {
+      apu.end_frame();
+    } else if ( bus.breakpoints.Armed() ) {
+      // Debugging runs the real frame only, so it can stop where a breakpoint hits
+      if ( !bus.RunFrameUntilBreak() ) {
+        BreakHit const &hit = bus.breakpoints.LastHit();
+        paused = true;
+        NotifyStart( fmt::format( "Breakpoint {} ({}) at ${:04X}", hit.id, BreakKindName( hit.kind ), hit.pc ), 4 );
       }
-      bus.Clock();
+      apu.end_frame();
+    } else {
+      runAhead.RunFrame( bus );
     }
     // End of frame, set the current frame to the next one.
     currentFrame = ppu.frame;
 
-    // generate 1/60th second of sound into APU's sample buffer
-    apu.end_frame();
-
-    long count = apu.read_samples( audioBuffer, audioBufferSize );
-    PlaySamples( audioBuffer, count );
+    // With sound off the APU makes no samples, and the queue drains to silence
+    if ( apu.synthesis_enabled() ) {
+      long count = apu.read_samples( audioBuffer, audioBufferSize );
+      PlaySamples( audioBuffer, count );
+    }
   }
 
   void UpdateUiWindows() {}
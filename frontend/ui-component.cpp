@@ -11,6 +11,7 @@ void UIComponent::DebugControls( const std::string &parentLabel )
   ImGui::BeginDisabled( !isPaused );
   ImGui::PushItemWidth( 140 );
   if ( ImGui::Button( "Continue" ) ) {
+    renderer->bus.breakpoints.Resume();
     renderer->paused = false;
     debuggerStatus = NORMAL;
   }
@@ -2,8 +2,13 @@
 #include "ui-component.h"
 #include "renderer.h"
 #include "log.h"
+#include "breakpoints.h"
 #include <imgui.h>
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstdio>
+#include <string>
 
 class DebuggerWindow : public UIComponent
 {
@@ -32,12 +37,146 @@ public:
     if ( ImGui::Begin( "Debugger", &visible, windowFlags ) ) {
       RenderMenuBar();
       DebugControls( "Debugger debugger controls" ); // Defined in ui-component.cpp
+      RenderBreakpoints();
     }
     ImGui::End();
     ImGui::PopStyleVar();
   }
 
 private:
+  // Add breakpoint form
+  int                   _newKind = 0;
+  u16                   _newFirst = 0;
+  u16                   _newLast = 0;
+  u16                   _newScanline = 0;
+  u16                   _newDot = 0;
+  u64                   _newCycle = 0;
+  std::array<char, 128> _newCondition{};
+  std::string           _conditionError;
+
+  /*
+  ################################
+  ||         Breakpoints        ||
+  ################################
+  */
+  void RenderBreakpoints()
+  {
+    Breakpoints &breakpoints = renderer->bus.breakpoints;
+    ImGui::SeparatorText( "Breakpoints" );
+
+    if ( breakpoints.Hit() ) {
+      BreakHit const &hit = breakpoints.LastHit();
+      ImGui::Text( "Hit #%d (%s) at $%04X", hit.id, BreakKindName( hit.kind ), hit.pc );
+      if ( hit.kind != BreakKind::Execute && hit.kind != BreakKind::Scanline && hit.kind != BreakKind::Cycle ) {
+        ImGui::SameLine();
+        ImGui::Text( "[$%04X] = $%02X", hit.address, hit.value );
+      }
+    }
+
+    int removeId = -1;
+    if ( ImGui::BeginTable( "BreakpointTable", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg ) ) {
+      ImGui::TableSetupColumn( "On", ImGuiTableColumnFlags_WidthFixed, 30 );
+      ImGui::TableSetupColumn( "Kind", ImGuiTableColumnFlags_WidthFixed, 80 );
+      ImGui::TableSetupColumn( "Where", ImGuiTableColumnFlags_WidthStretch );
+      ImGui::TableSetupColumn( "##remove", ImGuiTableColumnFlags_WidthFixed, 20 );
+      ImGui::TableHeadersRow();
+
+      for ( const Breakpoint &breakpoint : breakpoints.List() ) {
+        ImGui::PushID( breakpoint.id );
+        ImGui::TableNextRow();
+
+        ImGui::TableSetColumnIndex( 0 );
+        bool enabled = breakpoint.enabled;
+        if ( ImGui::Checkbox( "##enabled", &enabled ) ) {
+          breakpoints.SetEnabled( breakpoint.id, enabled );
+        }
+
+        ImGui::TableSetColumnIndex( 1 );
+        ImGui::TextUnformatted( BreakKindName( breakpoint.kind ) );
+
+        ImGui::TableSetColumnIndex( 2 );
+        ImGui::PushFont( renderer->fontMono );
+        ImGui::TextUnformatted( Describe( breakpoint ).c_str() );
+        ImGui::PopFont();
+
+        ImGui::TableSetColumnIndex( 3 );
+        if ( ImGui::SmallButton( "x" ) ) {
+          removeId = breakpoint.id; // not while iterating the list
+        }
+        ImGui::PopID();
+      }
+      ImGui::EndTable();
+    }
+    if ( removeId != -1 ) {
+      breakpoints.Remove( removeId );
+    }
+
+    RenderAddBreakpoint();
+  }
+
+  void RenderAddBreakpoint()
+  {
+    ImGui::PushItemWidth( 120 );
+    ImGui::Combo( "Kind", &_newKind, breakKindNames.data(), static_cast<int>( breakKindNames.size() ) );
+    auto const kind = static_cast<BreakKind>( _newKind );
+
+    ImGuiInputTextFlags const hex = ImGuiInputTextFlags_CharsHexadecimal;
+    if ( kind == BreakKind::Scanline ) {
+      ImGui::InputScalar( "Scanline", ImGuiDataType_U16, &_newScanline );
+      ImGui::SameLine();
+      ImGui::InputScalar( "Dot", ImGuiDataType_U16, &_newDot );
+    } else if ( kind == BreakKind::Cycle ) {
+      ImGui::InputScalar( "CPU cycle", ImGuiDataType_U64, &_newCycle );
+    } else {
+      ImGui::InputScalar( "From", ImGuiDataType_U16, &_newFirst, nullptr, nullptr, "%04X", hex );
+      ImGui::SameLine();
+      ImGui::InputScalar( "To", ImGuiDataType_U16, &_newLast, nullptr, nullptr, "%04X", hex );
+    }
+    ImGui::PopItemWidth();
+
+    ImGui::InputTextWithHint( "Condition", "e.g. A == $20 && [$0300] > 5", _newCondition.data(), _newCondition.size() );
+    ImGui::SameLine();
+    HelpMarker( "Checked only when the breakpoint is reached. Values: numbers (10, 0x1F, $1F), A X Y S P PC, "
+                "Scanline Dot Cycle, Value Address (the accessed byte and its address, for watchpoints), "
+                "[expr] (a byte of CPU memory). Operators: ! ~ - + == != < <= > >= & ^ | && || ( )" );
+
+    if ( ImGui::Button( "Add" ) ) {
+      Breakpoint breakpoint{ .kind = kind,
+                             .first = _newFirst,
+                             .last = std::max( _newFirst, _newLast ),
+                             .scanline = _newScanline,
+                             .dot = _newDot,
+                             .cycle = _newCycle,
+                             .condition = {} };
+      _conditionError.clear();
+      renderer->bus.breakpoints.Add( breakpoint, _newCondition.data(), _conditionError );
+    }
+    if ( !_conditionError.empty() ) {
+      ImGui::SameLine();
+      ImGui::TextColored( ImVec4( 1.0f, 0.4f, 0.4f, 1.0f ), "%s", _conditionError.c_str() );
+    }
+  }
+
+  static std::string Describe( const Breakpoint &breakpoint )
+  {
+    std::array<char, 48> where{};
+    if ( breakpoint.kind == BreakKind::Scanline ) {
+      snprintf( where.data(), where.size(), "scanline %u, dot %u", breakpoint.scanline, breakpoint.dot );
+    } else if ( breakpoint.kind == BreakKind::Cycle ) {
+      snprintf( where.data(), where.size(), "cycle %llu", static_cast<unsigned long long>( breakpoint.cycle ) );
+    } else if ( breakpoint.first == breakpoint.last ) {
+      snprintf( where.data(), where.size(), "$%04X", breakpoint.first );
+    } else {
+      snprintf( where.data(), where.size(), "$%04X-$%04X", breakpoint.first, breakpoint.last );
+    }
+
+    std::string description = where.data();
+    if ( !breakpoint.condition.Empty() ) {
+      description += " if " + breakpoint.condition.Source();
+    }
+    return description;
+  }
+
   void RenderMenuBar()
   {
     if ( ImGui::BeginMenuBar() ) {
@@ -1,17 +1,18 @@
 #pragma once
 #include "ui-component.h"
 #include "renderer.h"
-#include <cstdint>
+#include "trace-ring.h"
 #include <imgui.h>
 
 #include <algorithm>
+#include <cstddef>
+#include <string>
 
 struct ExampleAppLog;
 
 class LogWindow : public UIComponent // NOLINT
 {
 public:
-  uint64_t lastCpuCycleLogged = 0;
   LogWindow( Renderer *renderer ) : UIComponent( renderer ) { visible = false; }
 
   void OnVisible() override
@@ -65,24 +66,9 @@ public:
                   "3 of each instruction." );
       ImGui::Dummy( ImVec2( 0, 10 ) );
 
-      // Grab the trace log as long as not on the same cycle.
-      // We can debounce this more if necessary.
-      uint64_t const currentCycle = renderer->bus.cpu.GetCycles();
-      if ( currentCycle != lastCpuCycleLogged ) {
-        _buf.clear();
-        _lineOffsets.clear();
-        _lineOffsets.push_back( 0 );
-        lastCpuCycleLogged = currentCycle;
-        if ( usingLogType == NORMAL ) {
-          for ( const auto &line : renderer->bus.cpu.GetTracelog() ) {
-            AddLog( line.c_str() );
-          }
-        } else {
-          for ( const auto &line : renderer->bus.cpu.GetMesenFormatTracelog() ) {
-            AddLog( line.c_str() );
-          }
-        }
-      }
+      // The log is read in place, only the lines on screen (or passing the filter) get formatted
+      TraceRing const &traceLog =
+          usingLogType == NORMAL ? renderer->bus.cpu.GetTracelog() : renderer->bus.cpu.GetMesenFormatTracelog();
 
       // Options menu
       if ( ImGui::BeginPopup( "Options" ) ) {
@@ -100,11 +86,12 @@ public:
       bool const copy = ImGui::Button( "Copy" );
       ImGui::SameLine();
       ImGui::PushItemWidth( 120 );
-      static int inputSize = renderer->bus.cpu.traceSize;
+      static int inputSize = static_cast<int>( renderer->bus.cpu.GetTracelog().Capacity() );
       if ( ImGui::InputInt( "Max Lines", &inputSize ) ) {
         inputSize = std::max( inputSize, 1 );
-        inputSize = std::min( inputSize, 10000 );
-        renderer->bus.cpu.traceSize = inputSize;
+        inputSize = std::min( inputSize, 10000000 );
+        renderer->bus.cpu.SetTraceSize( inputSize );
+        renderer->bus.cpu.SetMesenTraceSize( inputSize );
       }
       ImGui::PopItemWidth();
 
@@ -125,29 +112,20 @@ public:
         ImGui::PushStyleVar( ImGuiStyleVar_ItemSpacing, ImVec2( 0, 0 ) );
         ImGui::PushFont( renderer->fontMono );
 
-        const char *buf = nullptr;
-        const char *bufEnd = nullptr;
-        buf = _buf.begin();
-        bufEnd = _buf.end();
-
-        // filter code pulled from imgui_demo, I have no idea how it works
         if ( _filter.IsActive() ) {
-          for ( int lineNo = 0; lineNo < _lineOffsets.Size; lineNo++ ) {
-            const char *lineStart = buf + _lineOffsets[lineNo];
-            const char *lineEnd = ( lineNo + 1 < _lineOffsets.Size ) ? ( buf + _lineOffsets[lineNo + 1] - 1 ) : bufEnd;
-            if ( _filter.PassFilter( lineStart, lineEnd ) ) {
-              ImGui::TextUnformatted( lineStart, lineEnd );
+          for ( std::size_t lineNo = 0; lineNo < traceLog.Size(); lineNo++ ) {
+            std::string const line = FormatTraceLine( traceLog[lineNo] );
+            if ( _filter.PassFilter( line.data(), line.data() + line.size() ) ) {
+              ImGui::TextUnformatted( line.data(), line.data() + line.size() );
             }
           }
         } else {
           ImGuiListClipper clipper;
-          clipper.Begin( _lineOffsets.Size );
+          clipper.Begin( static_cast<int>( traceLog.Size() ) );
           while ( clipper.Step() ) {
             for ( int lineNo = clipper.DisplayStart; lineNo < clipper.DisplayEnd; lineNo++ ) {
-              const char *lineStart = buf + _lineOffsets[lineNo];
-              const char *lineEnd =
-                  ( lineNo + 1 < _lineOffsets.Size ) ? ( buf + _lineOffsets[lineNo + 1] - 1 ) : bufEnd;
-              ImGui::TextUnformatted( lineStart, lineEnd );
+              std::string const line = FormatTraceLine( traceLog[lineNo] );
+              ImGui::TextUnformatted( line.data(), line.data() + line.size() );
             }
           }
           clipper.End();
@@ -172,17 +150,12 @@ public:
 
   void Clear()
   {
-    _buf.clear();
-    _lineOffsets.clear();
-    _lineOffsets.push_back( 0 );
     renderer->bus.cpu.ClearTraceLog();
     renderer->bus.cpu.ClearMesenTraceLog();
   }
 
 private:
-  ImGuiTextBuffer _buf;
   ImGuiTextFilter _filter;
-  ImVector<int>   _lineOffsets;
   bool            _autoScroll{ true };
 
   void RenderMenuBar()
@@ -198,27 +171,4 @@ private:
 
     ImGui::EndMenuBar();
   }
-
-  void AddLog( const char *str )
-  {
-    int oldSize = _buf.size();
-    _buf.append( str );
-    // Process new lines or any additional logic
-    for ( int const newSize = _buf.size(); oldSize < newSize; oldSize++ ) {
-      if ( _buf[oldSize] == '\n' ) {
-        _lineOffsets.push_back( oldSize + 1 );
-      }
-    }
-  }
-
-  void AddLogMesen( const char *str )
-  {
-    int oldSize = _buf.size();
-    _buf.append( str );
-    for ( int const newSize = _buf.size(); oldSize < newSize; oldSize++ ) {
-      if ( _buf[oldSize] == '\n' ) {
-        _lineOffsets.push_back( oldSize + 1 );
-      }
-    }
-  }
 };
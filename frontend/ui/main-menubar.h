@@ -90,6 +90,32 @@ public:
           renderer->bus.PowerCycle();
           renderer->NotifyStart( "Hardware Reset" );
         }
+        ImGui::Separator();
+        if ( ImGui::BeginMenu( "Run-Ahead" ) ) {
+          for ( int n = 0; n <= RunAhead::maxFrames; n++ ) {
+            std::string const label = n == 0 ? "Off" : std::to_string( n ) + ( n == 1 ? " frame" : " frames" );
+            if ( ImGui::MenuItem( label.c_str(), nullptr, renderer->runAhead.frames == n ) ) {
+              renderer->runAhead.frames = n;
+              renderer->NotifyStart( "Run-ahead: " + label );
+            }
+          }
+          ImGui::EndMenu();
+        }
+        if ( ImGui::MenuItem( "Sound", nullptr, renderer->bus.apu.synthesis_enabled() ) ) {
+          bool const enable = !renderer->bus.apu.synthesis_enabled();
+          renderer->bus.apu.enable_synthesis( enable );
+          renderer->NotifyStart( enable ? "Sound on" : "Sound off" );
+        }
+        if ( ImGui::BeginMenu( "Audio Latency" ) ) {
+          for ( int const ms : { 20, 35, 50, 80, 120 } ) {
+            std::string const label = std::to_string( ms ) + " ms";
+            if ( ImGui::MenuItem( label.c_str(), nullptr, renderer->audioLatencyMs == ms ) ) {
+              renderer->SetAudioLatency( ms );
+              renderer->NotifyStart( "Audio latency: " + label );
+            }
+          }
+          ImGui::EndMenu();
+        }
 
         ImGui::EndMenu();
       }
@@ -98,19 +124,15 @@ public:
       if ( ImGui::BeginMenu( "State" ) ) {
         if ( ImGui::MenuItem( "Save Slot 0", CMD "+S" ) ) {
           renderer->bus.QuickSaveState( 0 );
-          renderer->NotifyStart( "Saved to slot 0." );
         }
         if ( ImGui::MenuItem( "Save Slot 1", "Numpad 1" ) ) {
           renderer->bus.QuickSaveState( 1 );
-          renderer->NotifyStart( "Saved to slot 1." );
         }
         if ( ImGui::MenuItem( "Save Slot 2", "Numpad 2" ) ) {
           renderer->bus.QuickSaveState( 2 );
-          renderer->NotifyStart( "Saved to slot 2." );
         }
         if ( ImGui::MenuItem( "Save Slot 3", "Numpad 3" ) ) {
-          renderer->bus.QuickSaveState( 2 );
-          renderer->NotifyStart( "Saved to slot 3." );
+          renderer->bus.QuickSaveState( 3 );
         }
 
         auto exists = [&]( int idx ) { return renderer->bus.DoesSaveSlotExist( idx ); };
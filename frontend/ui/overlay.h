@@ -34,6 +34,30 @@ public:
       ImGui::Text( "CyclePS: %.1f", renderer->GetCyclesPerSecond() );
       ImGui::Text( "FPS: %.1f", renderer->GetAvgFps() );
       ImGui::Text( "Frame Count: " U64_FORMAT_SPECIFIER, renderer->bus.ppu.frame );
+      if ( renderer->runAhead.frames > 0 ) {
+        RunAheadStats const &stats = renderer->runAhead.Stats();
+        ImGui::Separator();
+        ImGui::Text( "Run-Ahead: %d", renderer->runAhead.frames );
+        ImGui::Text( "  Overhead: %.2f ms/frame", stats.TotalUs() / 1000.0 );
+        ImGui::Text( "  Save: %.0f us", stats.snapshotUs );
+        ImGui::Text( "  Frames: %.0f us", stats.framesUs );
+        ImGui::Text( "  Load: %.0f us", stats.restoreUs );
+      }
+      if ( renderer->soundQueue ) {
+        AudioRing const &ring = renderer->soundQueue->ring();
+        ImGui::Separator();
+        ImGui::Text( "Audio: %d / %d samples", renderer->soundQueue->sample_count(),
+                     renderer->soundQueue->target_count() );
+        ImGui::Text( "  Rate: %+.3f%%", ( renderer->rateControl.Ratio() - 1.0 ) * 100.0 );
+        ImGui::Text( "  Under/Overruns: " U64_FORMAT_SPECIFIER " / " U64_FORMAT_SPECIFIER, ring.Underruns(),
+                     ring.Overruns() );
+
+        // Queue fill over the last few seconds. The target sits at the middle of the chart.
+        int const count = static_cast<int>( Renderer::audioFillHistorySize );
+        int const offset = static_cast<int>( renderer->audioFillIndex % Renderer::audioFillHistorySize );
+        ImGui::PlotLines( "##AudioFill", renderer->audioFillHistory.data(), count, offset, "fill", 0.0f, 1.0f,
+                          ImVec2( 200.0f, 40.0f ) );
+      }
       ImGui::PopFont();
     }
     ImGui::End();
@@ -3,6 +3,7 @@
 // Blip_Buffer 0.3.3. http://www.slack.net/~ant/libs/
 
 #include "Blip_Buffer.h"
+#include "Blip_Kernels.h"
 
 #include <string.h>
 #include <math.h>
@@ -340,7 +341,23 @@ long Blip_Buffer::read_samples( blip_sample_t *out, long max_samples, bool stere
   buf_t_ *buf = buffer_;
   long    accum = reader_accum;
 
-  if ( !stereo ) {
+  if ( bass_shift <= max_block_bass_shift ) {
+    // The integrator is a serial recurrence and stays scalar. Its output is clamped and stored
+    // a block at a time by the vector kernels.
+    void ( *write_samples )( const int32_t *, blip_sample_t *, long, bool ) = blip_kernels().write_samples;
+    int32_t block[blip_read_block];
+    for ( long remain = count; remain; ) {
+      long n = remain < blip_read_block ? remain : blip_read_block;
+      for ( long i = 0; i < n; i++ ) {
+        block[i] = (int32_t) ( accum >> accum_fract );
+        accum -= accum >> bass_shift;
+        accum += ( long( *buf++ ) - sample_offset ) << accum_fract;
+      }
+      write_samples( block, out, n, stereo );
+      out += stereo ? n * 2 : n;
+      remain -= n;
+    }
+  } else if ( !stereo ) {
     for ( long n = count; n--; ) {
       long s = accum >> accum_fract;
       accum -= accum >> bass_shift;
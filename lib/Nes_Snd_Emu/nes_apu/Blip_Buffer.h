@@ -120,6 +120,9 @@ private:
   int  length_;
 
   enum { accum_fract = 15 };       // less than 16 to give extra sample range
+  // Input is just over 2^30 per sample after the shift, so with a leak of 1 / 2^bass_shift the
+  // integrated samples fit in 32 bits up to this shift and can be read out a block at a time
+  enum { max_block_bass_shift = 15 };
   enum { sample_offset = 0x7F7F }; // repeated byte allows memset to clear buffer
 
   friend class Blip_Reader;
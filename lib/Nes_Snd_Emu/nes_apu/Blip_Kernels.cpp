@@ -0,0 +1,204 @@
+// NOLINTBEGIN
+
+// Not part of Blip_Buffer 0.3.3. Same license (GNU LGPL).
+
+#include "Blip_Kernels.h"
+
+#include <atomic>
+#include <stddef.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define BLIP_SSE2 1
+#if defined( __GNUC__ ) || defined( __clang__ )
+#include <immintrin.h>
+#define BLIP_AVX2 1
+#endif
+#endif
+
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define BLIP_NEON 1
+#endif
+
+// Scalar
+
+static inline blip_sample_t clamp_sample( int32_t s )
+{
+  if ( (int16_t) s != s )
+    return blip_sample_t( 0x7FFF - ( s >> 24 ) );
+  return (blip_sample_t) s;
+}
+
+static void write_samples_scalar( const int32_t *in, blip_sample_t *out, long count, bool stereo )
+{
+  int const step = stereo ? 2 : 1;
+  for ( long n = count; n--; out += step )
+    *out = clamp_sample( *in++ );
+}
+
+// SSE2, 8 samples per step
+
+#if BLIP_SSE2
+// Clamped sample, sign extended to 32 bits
+static inline __m128i clamp_sse2( __m128i s )
+{
+  __m128i const wide = _mm_srai_epi32( _mm_slli_epi32( s, 16 ), 16 );
+  __m128i const fits = _mm_cmpeq_epi32( s, wide );
+  __m128i       limit = _mm_sub_epi32( _mm_set1_epi32( 0x7FFF ), _mm_srai_epi32( s, 24 ) );
+  limit = _mm_srai_epi32( _mm_slli_epi32( limit, 16 ), 16 );
+  return _mm_or_si128( _mm_and_si128( fits, wide ), _mm_andnot_si128( fits, limit ) );
+}
+
+static void write_samples_sse2( const int32_t *in, blip_sample_t *out, long count, bool stereo )
+{
+  long i = 0;
+  if ( !stereo ) {
+    for ( ; i + 8 <= count; i += 8 ) {
+      __m128i const a = clamp_sse2( _mm_loadu_si128( (const __m128i *) ( in + i ) ) );
+      __m128i const b = clamp_sse2( _mm_loadu_si128( (const __m128i *) ( in + i + 4 ) ) );
+      _mm_storeu_si128( (__m128i *) ( out + i ), _mm_packs_epi32( a, b ) );
+    }
+  } else {
+    // replace the low half of each left/right pair, keep the other channel
+    __m128i const keep = _mm_set1_epi32( (int) 0xFFFF0000 );
+    for ( ; i + 4 <= count; i += 4 ) {
+      __m128i const s = clamp_sse2( _mm_loadu_si128( (const __m128i *) ( in + i ) ) );
+      __m128i      *dest = (__m128i *) ( out + i * 2 );
+      __m128i const other = _mm_and_si128( _mm_loadu_si128( dest ), keep );
+      _mm_storeu_si128( dest, _mm_or_si128( other, _mm_andnot_si128( keep, s ) ) );
+    }
+  }
+  write_samples_scalar( in + i, out + ( stereo ? i * 2 : i ), count - i, stereo );
+}
+#endif
+
+// AVX2, 16 samples per step
+
+#if BLIP_AVX2
+__attribute__( ( target( "avx2" ) ) ) static inline __m256i clamp_avx2( __m256i s )
+{
+  __m256i const wide = _mm256_srai_epi32( _mm256_slli_epi32( s, 16 ), 16 );
+  __m256i const fits = _mm256_cmpeq_epi32( s, wide );
+  __m256i       limit = _mm256_sub_epi32( _mm256_set1_epi32( 0x7FFF ), _mm256_srai_epi32( s, 24 ) );
+  limit = _mm256_srai_epi32( _mm256_slli_epi32( limit, 16 ), 16 );
+  return _mm256_blendv_epi8( limit, wide, fits );
+}
+
+__attribute__( ( target( "avx2" ) ) ) static void write_samples_avx2( const int32_t *in, blip_sample_t *out, long count,
+                                                                      bool stereo )
+{
+  long i = 0;
+  if ( !stereo ) {
+    for ( ; i + 16 <= count; i += 16 ) {
+      __m256i const a = clamp_avx2( _mm256_loadu_si256( (const __m256i *) ( in + i ) ) );
+      __m256i const b = clamp_avx2( _mm256_loadu_si256( (const __m256i *) ( in + i + 8 ) ) );
+      // packs works within 128-bit lanes, put the quarters back in order
+      __m256i const packed = _mm256_permute4x64_epi64( _mm256_packs_epi32( a, b ), 0xD8 );
+      _mm256_storeu_si256( (__m256i *) ( out + i ), packed );
+    }
+  } else {
+    __m256i const keep = _mm256_set1_epi32( (int) 0xFFFF0000 );
+    for ( ; i + 8 <= count; i += 8 ) {
+      __m256i const s = clamp_avx2( _mm256_loadu_si256( (const __m256i *) ( in + i ) ) );
+      __m256i      *dest = (__m256i *) ( out + i * 2 );
+      __m256i const other = _mm256_and_si256( _mm256_loadu_si256( dest ), keep );
+      _mm256_storeu_si256( dest, _mm256_or_si256( other, _mm256_andnot_si256( keep, s ) ) );
+    }
+  }
+  write_samples_scalar( in + i, out + ( stereo ? i * 2 : i ), count - i, stereo );
+}
+#endif
+
+// NEON, 8 samples per step
+
+#if BLIP_NEON
+// Clamped sample, low 16 bits are the result
+static inline int32x4_t clamp_neon( int32x4_t s )
+{
+  int32x4_t const wide = vmovl_s16( vmovn_s32( s ) );
+  uint32x4_t const fits = vceqq_s32( s, wide );
+  int32x4_t const limit = vsubq_s32( vdupq_n_s32( 0x7FFF ), vshrq_n_s32( s, 24 ) );
+  return vbslq_s32( fits, s, limit );
+}
+
+static void write_samples_neon( const int32_t *in, blip_sample_t *out, long count, bool stereo )
+{
+  long i = 0;
+  if ( !stereo ) {
+    for ( ; i + 8 <= count; i += 8 ) {
+      int16x4_t const a = vmovn_s32( clamp_neon( vld1q_s32( in + i ) ) );
+      int16x4_t const b = vmovn_s32( clamp_neon( vld1q_s32( in + i + 4 ) ) );
+      vst1q_s16( out + i, vcombine_s16( a, b ) );
+    }
+  } else {
+    for ( ; i + 8 <= count; i += 8 ) {
+      int16x8x2_t pairs = vld2q_s16( out + i * 2 );
+      pairs.val[0] = vcombine_s16( vmovn_s32( clamp_neon( vld1q_s32( in + i ) ) ),
+                                   vmovn_s32( clamp_neon( vld1q_s32( in + i + 4 ) ) ) );
+      vst2q_s16( out + i * 2, pairs );
+    }
+  }
+  write_samples_scalar( in + i, out + ( stereo ? i * 2 : i ), count - i, stereo );
+}
+#endif
+
+// Selection
+
+static const blip_kernels_t all_kernels[] = {
+    { "scalar", write_samples_scalar },
+#if BLIP_SSE2
+    { "sse2", write_samples_sse2 },
+#endif
+#if BLIP_AVX2
+    { "avx2", write_samples_avx2 },
+#endif
+#if BLIP_NEON
+    { "neon", write_samples_neon },
+#endif
+};
+
+static bool cpu_supports( const blip_kernels_t &k )
+{
+#if BLIP_AVX2
+  if ( k.write_samples == write_samples_avx2 )
+    return __builtin_cpu_supports( "avx2" );
+#endif
+  (void) k;
+  return true; // SSE2 and NEON are part of the base instruction sets they're built for
+}
+
+static std::atomic<const blip_kernels_t *> kernels_override( NULL );
+
+const blip_kernels_t &blip_kernels()
+{
+  if ( const blip_kernels_t *k = kernels_override.load( std::memory_order_relaxed ) )
+    return *k;
+  static const blip_kernels_t &best = blip_kernel( blip_kernel_count() - 1 );
+  return best;
+}
+
+int blip_kernel_count()
+{
+  int count = 0;
+  for ( size_t i = 0; i < sizeof all_kernels / sizeof all_kernels[0]; i++ )
+    count += cpu_supports( all_kernels[i] );
+  return count;
+}
+
+const blip_kernels_t &blip_kernel( int index )
+{
+  // supported sets, in table order (slowest first)
+  for ( size_t i = 0; i < sizeof all_kernels / sizeof all_kernels[0]; i++ ) {
+    if ( cpu_supports( all_kernels[i] ) && index-- == 0 )
+      return all_kernels[i];
+  }
+  return all_kernels[0];
+}
+
+void blip_use_kernels( const blip_kernels_t *k )
+{
+  kernels_override.store( k, std::memory_order_relaxed );
+}
+
+// NOLINTEND
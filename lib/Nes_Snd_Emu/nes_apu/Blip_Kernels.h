@@ -0,0 +1,44 @@
+// NOLINTBEGIN
+
+// Vector kernels for Blip_Buffer sample readout, selected at runtime.
+
+// Not part of Blip_Buffer 0.3.3. Same license (GNU LGPL).
+
+#ifndef BLIP_KERNELS_H
+#define BLIP_KERNELS_H
+
+#include <cstdint>
+
+// Type of sample produced, as in Blip_Buffer.h
+typedef int16_t blip_sample_t;
+
+// Blip_Buffer::read_samples() runs its integrator / high-pass filter a block at a time. That
+// filter is a serial recurrence with a rounding shift, so it stays scalar; what follows it, the
+// clamp to 16 bits and the (optionally interleaved) store, is done by these kernels. Every
+// variant gives the same samples as the scalar one, bit for bit, for any 32-bit input: values
+// in 16-bit range are stored as is, others as 0x7FFF - (s >> 24) truncated to 16 bits.
+struct blip_kernels_t {
+  const char *name;
+
+  // Clamp 'count' integrated samples from 'in' and store them to 'out', to every other
+  // element if 'stereo' is true
+  void ( *write_samples )( const int32_t *in, blip_sample_t *out, long count, bool stereo );
+};
+
+// Samples Blip_Buffer integrates per write_samples() call
+const int blip_read_block = 256;
+
+// Kernels in use. The fastest set this CPU supports is picked on first call (AVX2, then SSE2
+// on x86, NEON on ARM, scalar otherwise).
+const blip_kernels_t &blip_kernels();
+
+// Every kernel set this CPU can run, scalar first. For tests and benchmarks.
+int                   blip_kernel_count();
+const blip_kernels_t &blip_kernel( int index );
+
+// Use a specific kernel set, or NULL to go back to the automatic choice
+void blip_use_kernels( const blip_kernels_t * );
+
+#endif
+
+// NOLINTEND
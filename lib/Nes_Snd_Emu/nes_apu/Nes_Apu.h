@@ -93,6 +93,9 @@ public:
   // 'count_dmc_reads( time )' would result in the same result.
   int count_dmc_reads( cpu_time_t t, cpu_time_t *last_read = NULL ) const;
 
+  // Time of the next DMC memory read, or no_irq if the DMC isn't reading.
+  cpu_time_t next_dmc_read() const;
+
   // Run APU until specified time, so that any DMC memory reads can be
   // accounted for (i.e. inserting CPU wait states).
   void run_until( cpu_time_t );
@@ -156,6 +159,11 @@ inline void Nes_Apu::irq_notifier( void ( *func )( void *user_data ), void *user
   irq_data = user_data;
 }
 
+inline cpu_time_t Nes_Apu::next_dmc_read() const
+{
+  return dmc.next_read_time();
+}
+
 inline int Nes_Apu::count_dmc_reads( cpu_time_t time, cpu_time_t *last_read ) const
 {
   return dmc.count_reads( time, last_read );
@@ -264,6 +264,15 @@ int Nes_Dmc::count_reads( cpu_time_t time, cpu_time_t *last_read ) const
   return count;
 }
 
+cpu_time_t Nes_Dmc::next_read_time() const
+{
+  if ( length_counter == 0 )
+    return Nes_Apu::no_irq; // not reading
+
+  // earliest time for which count_reads() returns 1
+  return apu->last_time + delay + long( bits_remain - 1 ) * period + 1;
+}
+
 static const short dmc_period_table[2][16] = {
     0x1ac, 0x17c, 0x154, 0x140, 0x11e, 0x0fe, 0x0e2, 0x0d6, // NTSC
     0x0be, 0x0a0, 0x08e, 0x080, 0x06a, 0x054, 0x048, 0x036,
@@ -335,11 +344,10 @@ void Nes_Dmc::fill_buffer()
 
 void Nes_Dmc::run( cpu_time_t time, cpu_time_t end_time )
 {
-  if ( !output )
-    return;
-
+  // Unlike the other channels, the DMC keeps running without an output buffer: its sample
+  // fetches and IRQ are visible to the CPU, so muting must not change them.
   int delta = update_amp( dac );
-  if ( delta )
+  if ( delta && output )
     synth.offset( time, delta, output );
 
   time += delay;
@@ -361,7 +369,8 @@ void Nes_Dmc::run( cpu_time_t time, cpu_time_t end_time )
           bits >>= 1;
           if ( unsigned( dac + step ) <= 0x7F ) {
             dac += step;
-            synth.offset_inline( time, step, output );
+            if ( output )
+              synth.offset_inline( time, step, output );
           }
         }
 
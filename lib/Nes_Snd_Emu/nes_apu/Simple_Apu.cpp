@@ -4,6 +4,8 @@
 
 #include "Simple_Apu.h"
 
+#include <climits>
+
 /* Copyright (C) 2003-2005 Shay Green. This module is free software; you
 can redistribute it and/or modify it under the terms of the GNU Lesser
 General Public License as published by the Free Software Foundation; either
@@ -24,6 +26,16 @@ Simple_Apu::Simple_Apu()
 {
   time = 0;
   frame_length = 29780;
+  frame_offset = 0;
+  muted = false;
+  synthesis = true;
+  output_ready = false;
+  cpu_clock_ = NULL;
+  cpu_clock_data = NULL;
+  frame_start = 0;
+  next_event_ = ULLONG_MAX;
+  irq_line = false;
+  last_access = 0;
   apu.dmc_reader( null_dmc_reader, NULL );
 }
 
@@ -37,39 +49,153 @@ void Simple_Apu::dmc_reader( int ( *f )( void *user_data, cpu_addr_t ), void *p
   apu.dmc_reader( f, p );
 }
 
+void Simple_Apu::cpu_clock( cpu_clock_t ( *f )( void *user_data ), void *p )
+{
+  cpu_clock_ = f;
+  cpu_clock_data = p;
+  if ( f )
+    frame_start = f( p ) - time; // keep the current time frame going from here
+  update_events();
+}
+
 blargg_err_t Simple_Apu::sample_rate( long rate )
 {
-  apu.output( &buf );
   buf.clock_rate( 1789773 );
-  return buf.sample_rate( rate );
+  blargg_err_t err = buf.sample_rate( rate );
+  output_ready = !err;
+  attach_output();
+  return err;
+}
+
+void Simple_Apu::detach_output()
+{
+  if ( !output_ready )
+    return;
+  output_ready = false;
+  buf.clear();
+  apu.buffer_cleared();
+  attach_output();
+}
+
+blip_time_t Simple_Apu::clock()
+{
+  if ( !cpu_clock_ )
+    return time += 4;
+
+  long long const elapsed = (long long) ( cpu_clock_( cpu_clock_data ) - frame_start );
+  if ( elapsed >= time ) {
+    time = (blip_time_t) elapsed;
+  } else if ( time - elapsed > 16 ) {
+    // CPU cycle count went backwards (reset), carry on from here. Smaller steps back come
+    // from same-cycle accesses nudged forward below, and just wait for the CPU to catch up.
+    frame_start -= time - elapsed;
+  }
+  return time;
+}
+
+void Simple_Apu::update_events()
+{
+  // Nes_Apu raises its IRQ flags while running without recalculating earliest_irq(), so the
+  // line is up once the APU has run past that time
+  irq_line = apu.earliest_irq() <= last_access;
+  if ( !cpu_clock_ ) {
+    next_event_ = ULLONG_MAX;
+    return;
+  }
+  cpu_time_t next = apu.next_dmc_read();
+  if ( !irq_line && apu.earliest_irq() < next )
+    next = apu.earliest_irq();
+  next_event_ = next >= Nes_Apu::no_irq ? ULLONG_MAX : frame_start + next;
 }
 
 void Simple_Apu::write_register( cpu_addr_t addr, int data )
 {
-  apu.write_register( clock(), addr, data );
+  last_access = clock();
+  apu.write_register( last_access, addr, data );
+  update_events();
 }
 
 int Simple_Apu::read_status()
 {
-  return apu.read_status( clock() );
+  blip_time_t t = clock();
+  // Nes_Apu reads status one cycle into the access, which has to be after the APU was last
+  // run. Zero cycle dummy reads can land on the same CPU cycle, nudge those forward.
+  if ( t <= last_access )
+    t = time = last_access + 1;
+  last_access = t;
+  int const result = apu.read_status( t );
+  update_events();
+  return result;
+}
+
+int Simple_Apu::run()
+{
+  blip_time_t const t = clock();
+  int const         fetches = apu.count_dmc_reads( t );
+  apu.run_until( t );
+  last_access = t;
+  update_events();
+  return fetches;
 }
 
 void Simple_Apu::end_frame()
 {
+  blip_time_t length;
+  if ( cpu_clock_ ) {
+    length = clock();
+    frame_start += length;
+  } else {
+    frame_length ^= 1;
+    length = frame_length - frame_offset;
+  }
   time = 0;
-  frame_length ^= 1;
-  apu.end_frame( frame_length );
-  buf.end_frame( frame_length );
+  frame_offset = 0;
+  last_access = 0;
+  apu.end_frame( length );
+  if ( synthesizing() )
+    buf.end_frame( length );
+  update_events();
+}
+
+void Simple_Apu::reset()
+{
+  apu.reset();
+  update_events();
+}
+
+void Simple_Apu::set_muted( bool m )
+{
+  muted = m;
+  attach_output();
+}
+
+void Simple_Apu::enable_synthesis( bool enabled )
+{
+  if ( enabled == synthesis )
+    return;
+  synthesis = enabled;
+  if ( output_ready ) {
+    // drop what was left unread, and start the oscillators again from silence
+    buf.clear();
+    apu.buffer_cleared();
+  }
+  attach_output();
+}
+
+void Simple_Apu::attach_output()
+{
+  // output stays detached until a sample rate has been set
+  apu.output( synthesizing() ? &buf : NULL );
 }
 
 long Simple_Apu::samples_avail() const
 {
-  return buf.samples_avail();
+  return synthesis ? buf.samples_avail() : 0;
 }
 
 long Simple_Apu::read_samples( sample_t *p, long s )
 {
-  return buf.read_samples( p, s );
+  return synthesis ? buf.read_samples( p, s ) : 0;
 }
 
 void Simple_Apu::save_snapshot( apu_snapshot_t *out ) const
@@ -9,6 +9,10 @@
 
 #include "Blip_Buffer.h"
 #include "Nes_Apu.h"
+#include "apu_snapshot.h"
+
+#include <array>
+#include <cstring>
 
 class Simple_Apu
 {
@@ -16,11 +20,65 @@ public:
   Simple_Apu();
   ~Simple_Apu();
 
-  template <class Archive> void serialize( Archive & /*ar*/ ) {} // NOLINT
+  // Save states carry the full oscillator / frame counter state, so $4015 reads and frame IRQs
+  // replay identically after a load. Nes_Apu snapshots are taken at the start of a time frame,
+  // so the APU is run up to the current time first, and the cycles already spent in the current
+  // sound frame are carried over. With a CPU clock the restored CPU cycle count marks the start
+  // of the new time frame instead.
+  template <class Archive> void save( Archive &ar ) const
+  {
+    Simple_Apu &self = const_cast<Simple_Apu &>( *this );
+    self.apu.run_until( cpu_clock_ ? self.clock() : time );
+    self.last_access = time;
+    apu_snapshot_t snapshot = {}; // not every field is reflected, keep the padding deterministic
+    save_snapshot( &snapshot );
+    std::array<unsigned char, sizeof( apu_snapshot_t )> bytes;
+    std::memcpy( bytes.data(), &snapshot, sizeof( snapshot ) );
+    blip_time_t const consumed = frame_offset + time;
+    ar( bytes, frame_length, consumed );
+  }
+  template <class Archive> void load( Archive &ar )
+  {
+    std::array<unsigned char, sizeof( apu_snapshot_t )> bytes;
+    blip_time_t                                         consumed = 0;
+    ar( bytes, frame_length, consumed );
+    apu_snapshot_t snapshot;
+    std::memcpy( &snapshot, bytes.data(), sizeof( snapshot ) );
+    load_snapshot( snapshot );
+    time = 0;
+    last_access = 0;
+    frame_offset = consumed;
+    if ( cpu_clock_ ) {
+      // the CPU is restored first, its cycle count is where the snapshot was taken
+      frame_start = cpu_clock_( cpu_clock_data );
+      frame_offset = 0;
+    }
+    update_events();
+  }
 
   // This simpler interface works well for most games. Some benefit from
   // the higher precision of the full Nes_Apu interface, which provides
   // clock-cycle accurate register read/write and IRQ timing functions.
+  // Setting a CPU clock gives this interface the same precision.
+
+  // Set function for APU to call for the CPU's running cycle count. Register accesses and
+  // end_frame() then happen at the real CPU time instead of fixed 4 cycle steps, so DMC
+  // fetches, $4015 reads and the frame IRQ line up with the CPU, and each sound frame is
+  // exactly as long as the CPU frame it was run for. end_frame() must then be called at
+  // least once per video frame, or the sample buffer overflows.
+  typedef unsigned long long cpu_clock_t;
+  void cpu_clock( cpu_clock_t ( *callback )( void *user_data ), void *user_data = NULL );
+
+  // CPU cycle at which the next DMC fetch or frame / DMC IRQ is due, as far as the APU
+  // currently knows. Cheap to poll once per instruction.
+  cpu_clock_t next_event() const { return next_event_; }
+
+  // Run the APU up to the current CPU cycle and return the number of DMC fetches made,
+  // each of which should stall the CPU
+  int run();
+
+  // True while the frame counter or DMC IRQ is asserted
+  bool irq_pending() const { return irq_line; }
 
   // Set function for APU to call when it needs to read memory (DMC samples)
   void dmc_reader( int ( *callback )( void *user_data, cpu_addr_t ), void *user_data = NULL );
@@ -28,13 +86,18 @@ public:
   // Set output sample rate
   blargg_err_t sample_rate( long rate );
 
+  // Undo sample_rate(): nothing is synthesized into the sample buffer until it's set again.
+  // For callers that only want samples for a while and won't read them afterwards.
+  void detach_output();
+  bool has_output() const { return output_ready; }
+
   // Write to register (0x4000-0x4017, except 0x4014 and 0x4016)
   void write_register( cpu_addr_t, int data );
 
   // Read from status register at 0x4015
   int read_status();
 
-  // End a 1/60 sound frame
+  // End a sound frame, 1/60 second long, or up to the current CPU cycle with a CPU clock
   void end_frame();
 
   // Number of samples in buffer
@@ -49,14 +112,43 @@ public:
   void load_snapshot( apu_snapshot_t const & );
 
   // reset
-  void reset() { apu.reset(); }
+  void reset();
+
+  // While muted, oscillators aren't synthesized and end_frame() leaves the sample buffer
+  // alone. Used for frames whose audio is thrown away (run-ahead, rollback). The DMC still
+  // fetches samples and raises its IRQ, so CPU visible behavior is unchanged.
+  void set_muted( bool muted );
+  bool is_muted() const { return muted; }
+
+  // With synthesis disabled the APU only keeps the state the CPU can see: length counters,
+  // $4015 status, the frame IRQ, and DMC fetches and IRQ. The square, triangle and noise
+  // oscillators aren't run, nothing reaches Blip_Synth, and end_frame() and read_samples()
+  // leave the sample buffer alone. Unlike muting this stays in effect until re-enabled, for
+  // batch and training runs that never listen. Enabled by default.
+  void enable_synthesis( bool enabled = true );
+  bool synthesis_enabled() const { return synthesis; }
 
 private:
   Nes_Apu     apu;
   Blip_Buffer buf;
   blip_time_t time;
   blip_time_t frame_length;
-  blip_time_t clock() { return time += 4; }
+  blip_time_t frame_offset; // cycles of the current sound frame that ran before a state load
+  bool        muted;
+  bool        synthesis;
+  bool        output_ready; // sample buffer has been sized by sample_rate()
+
+  cpu_clock_t ( *cpu_clock_ )( void *user_data );
+  void       *cpu_clock_data;
+  cpu_clock_t frame_start; // CPU cycle at time 0 of the current time frame
+  cpu_clock_t next_event_;
+  bool        irq_line;
+  blip_time_t last_access; // time the APU was last run to by a register access or run()
+
+  blip_time_t clock();
+  void        update_events();
+  bool        synthesizing() const { return output_ready && synthesis && !muted; }
+  void        attach_output();
 };
 
 #endif
@@ -6,8 +6,7 @@
 
 #include <SDL_audio.h>
 #include <assert.h>
-#include <iostream>
-#include <string.h>
+#include <stddef.h>
 
 /* Copyright (C) 2005 by Shay Green. Permission is hereby granted, free of
 charge, to any person obtaining a copy of this software module and associated
@@ -35,11 +34,7 @@ static const char *sdl_error( const char *str )
 
 Sound_Queue::Sound_Queue()
 {
-  bufs = NULL;
-  free_sem = NULL;
-  write_buf = 0;
-  write_pos = 0;
-  read_buf = 0;
+  target_samples = 0;
   sound_open = false;
   device_id = 0;
 }
@@ -50,84 +45,55 @@ Sound_Queue::~Sound_Queue()
     SDL_PauseAudioDevice( device_id, 1 );
     SDL_CloseAudioDevice( device_id );
   }
-
-  if ( free_sem )
-    SDL_DestroySemaphore( free_sem );
-
-  delete[] bufs;
 }
 
 int Sound_Queue::sample_count() const
 {
-  int buf_free = SDL_SemValue( free_sem ) * buf_size + ( buf_size - write_pos );
-  return buf_size * buf_count - buf_free;
+  return ring_ ? (int) ring_->Fill() : 0;
 }
 
-const char *Sound_Queue::init( long sample_rate, int chan_count )
+const char *Sound_Queue::init( long sample_rate, int chan_count, int latency_ms )
 {
-  assert( !bufs ); // can only be initialized once
+  assert( !ring_ ); // can only be initialized once
 
-  bufs = new sample_t[(long) buf_size * buf_count];
-  if ( !bufs )
-    return "Out of memory";
+  target_samples = (int) ( sample_rate * chan_count * latency_ms / 1000 );
+  ring_ = std::make_unique<AudioRing>( (size_t) target_samples * 2 );
 
-  free_sem = SDL_CreateSemaphore( buf_count - 1 );
-  if ( !free_sem )
-    return sdl_error( "Couldn't create semaphore" );
+  // Device period of about a quarter of the latency, so the ring never needs to hold more
+  // than a few callbacks' worth
+  Uint16 period = 64;
+  while ( period * 2 <= target_samples / 4 / chan_count && period < 4096 )
+    period *= 2;
 
   SDL_AudioSpec desired;
   SDL_zero( desired );
   desired.freq = sample_rate;
   desired.format = AUDIO_S16SYS;
   desired.channels = (Uint8) chan_count;
-  desired.samples = buf_size;
+  desired.samples = period;
   desired.callback = fill_buffer_;
   desired.userdata = this;
 
   SDL_AudioSpec obtained;
-  device_id = SDL_OpenAudioDevice( NULL, 0, &desired, &obtained, SDL_AUDIO_ALLOW_ANY_CHANGE );
+  device_id = SDL_OpenAudioDevice( NULL, 0, &desired, &obtained, 0 );
   if ( device_id == 0 ) {
     return sdl_error( "Couldn't open SDL audio" );
   }
+  sound_open = true;
   SDL_PauseAudioDevice( device_id, 0 );
   return NULL;
 }
 
-inline Sound_Queue::sample_t *Sound_Queue::buf( int index )
-{
-  assert( (unsigned) index < buf_count );
-  return bufs + (long) index * buf_size;
-}
-
 void Sound_Queue::write( const sample_t *in, int count )
 {
-  while ( count ) {
-    int n = buf_size - write_pos;
-    if ( n > count )
-      n = count;
-
-    memcpy( buf( write_buf ) + write_pos, in, n * sizeof( sample_t ) );
-    in += n;
-    write_pos += n;
-    count -= n;
-
-    if ( write_pos >= buf_size ) {
-      write_pos = 0;
-      write_buf = ( write_buf + 1 ) % buf_count;
-      SDL_SemWait( free_sem );
-    }
-  }
+  if ( ring_ && count > 0 )
+    ring_->Write( in, (size_t) count );
 }
 
 void Sound_Queue::fill_buffer( Uint8 *out, int count )
 {
-  if ( SDL_SemValue( free_sem ) < buf_count - 1 ) {
-    memcpy( out, buf( read_buf ), count );
-    read_buf = ( read_buf + 1 ) % buf_count;
-    SDL_SemPost( free_sem );
-  } else {
-    memset( out, 0, count );
-  }
+  // Runs on SDL's audio thread, the only reader of the ring
+  ring_->Read( (sample_t *) out, (size_t) count / sizeof( sample_t ) );
 }
 
 void Sound_Queue::fill_buffer_( void *user_data, Uint8 *out, int count )
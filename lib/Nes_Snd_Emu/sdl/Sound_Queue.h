@@ -1,6 +1,6 @@
 // NOLINTBEGIN
 
-// Simple sound queue for synchronous sound handling in SDL
+// Simple sound queue for SDL, fed from the emulation thread
 
 // Copyright (C) 2005 Shay Green. MIT license.
 
@@ -8,39 +8,44 @@
 #define SOUND_QUEUE_H
 
 #include "SDL2/SDL.h"
+#include "audio-ring.h"
 
-// Simple SDL sound wrapper that has a synchronous interface
+#include <memory>
+
+// SDL sound wrapper over a lock-free ring. write() never blocks: samples that don't fit are
+// dropped and the audio callback plays silence when it runs dry, both of which are counted.
 class Sound_Queue
 {
 public:
   Sound_Queue();
   ~Sound_Queue();
 
-  // Initialize with specified sample rate and channel count.
-  // Returns NULL on success, otherwise error string.
-  const char *init( long sample_rate, int chan_count = 1 );
+  // Initialize with specified sample rate and channel count. latency_ms sets the target
+  // amount of queued audio, the ring holds twice that. Returns NULL on success, otherwise
+  // error string.
+  const char *init( long sample_rate, int chan_count = 1, int latency_ms = 50 );
 
   // Number of samples in buffer waiting to be played
   int sample_count() const;
 
-  // Write samples to buffer and block until enough space is available
+  // Target number of queued samples, from the latency passed to init()
+  int target_count() const { return target_samples; }
+
+  // Write samples to buffer, dropping whatever doesn't fit
   typedef short sample_t;
   void          write( const sample_t *, int count );
 
+  // Ring fill level and under/overrun counters
+  const AudioRing &ring() const { return *ring_; }
+
 private:
-  static constexpr int buf_size = 2048;
-  static constexpr int buf_count = 3;
-  sample_t *volatile bufs;
-  SDL_sem *volatile free_sem;
-  int volatile read_buf;
-  int  write_buf;
-  int  write_pos;
-  bool sound_open;
+  std::unique_ptr<AudioRing> ring_;
+  int                        target_samples;
+  bool                       sound_open;
 
   // SDL2 audio device handle
   SDL_AudioDeviceID device_id;
 
-  sample_t   *buf( int index );
   void        fill_buffer( Uint8 *, int );
   static void fill_buffer_( void *, Uint8 *, int );
 };
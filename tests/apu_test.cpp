@@ -1,8 +1,14 @@
 #include "bus.h"
 #include "cartridge.h"
+#include "global-types.h"
+#include "paths.h"
 // #include "apu.h"
 #include <gtest/gtest.h>
 
+#include <cstddef>
+#include <string>
+#include <vector>
+
 // Test fixture for APU tests
 class ApuTest : public ::testing::Test
 {
@@ -99,6 +105,226 @@ TEST_F( ApuTest, OutputBufferReceivesSamples )
   SUCCEED();
 }
 
+/*
+################################
+||       Cycle Accuracy       ||
+################################
+*/
+// Blargg's APU on the real CPU clock
+class ApuTimingTest : public ::testing::Test
+{
+protected:
+  Bus  bus;
+  CPU &cpu = bus.cpu;
+
+  ApuTimingTest()
+  {
+    bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+    cpu.Reset();
+  }
+
+  void TickUntil( u64 cycle )
+  {
+    while ( cpu.GetCycles() < cycle ) {
+      cpu.Tick();
+    }
+  }
+};
+
+TEST_F( ApuTimingTest, FrameIrqFollowsCpuClock )
+{
+  bus.Write( 0x4017, 0x00 ); // 4-step sequence, IRQ enabled
+  u64 const start = cpu.GetCycles();
+
+  // The frame IRQ is raised 29830 cycles after the write, give or take the write's alignment
+  u64 const due = bus.apu.next_event();
+  EXPECT_GT( due, start + 29820 );
+  EXPECT_LT( due, start + 29840 );
+
+  TickUntil( due - 100 );
+  bus.apu.run();
+  EXPECT_FALSE( bus.apu.irq_pending() );
+
+  TickUntil( due + 1 );
+  bus.apu.run();
+  EXPECT_TRUE( bus.apu.irq_pending() );
+
+  // Reading $4015 reports and acknowledges it
+  EXPECT_EQ( bus.Read( 0x4015 ) & 0x40, 0x40 );
+  EXPECT_FALSE( bus.apu.irq_pending() );
+  EXPECT_EQ( bus.Read( 0x4015 ) & 0x40, 0x00 );
+}
+
+TEST_F( ApuTimingTest, FrameIrqInterruptsCpu )
+{
+  // A field of NOPs in RAM, with interrupts enabled
+  for ( u16 addr = 0x0000; addr < 0x0800; ++addr ) {
+    bus.Write( addr, 0xEA );
+  }
+  cpu.SetProgramCounter( 0x0000 );
+  cpu.SetInterruptDisableFlag( false );
+  bus.Write( 0x4017, 0x00 );
+
+  u16 const irqVector = bus.Read( 0xFFFE ) | ( bus.Read( 0xFFFF ) << 8 );
+  u64 const due = bus.apu.next_event();
+  while ( cpu.GetProgramCounter() < 0x0800 && cpu.GetCycles() < due + 100 ) {
+    if ( cpu.GetProgramCounter() >= 0x0700 ) {
+      cpu.SetProgramCounter( 0x0000 );
+    }
+    bus.Clock();
+  }
+  EXPECT_EQ( cpu.GetProgramCounter(), irqVector );
+  EXPECT_GE( cpu.GetCycles(), due );
+  EXPECT_EQ( cpu.GetInterruptDisableFlag(), 1 );
+}
+
+TEST_F( ApuTimingTest, DmcFetchesStallCpu )
+{
+  bus.Write( 0x4017, 0x40 ); // frame IRQ off
+  bus.Write( 0x4010, 0x0F ); // fastest rate, no loop, no IRQ
+  bus.Write( 0x4012, 0x00 ); // sample at $C000
+  bus.Write( 0x4013, 0x01 ); // 17 bytes
+  bus.Write( 0x4015, 0x10 ); // start the DMC
+
+  // The first byte is fetched as the channel starts, the rest on the DMC's own clock
+  int fetches = 0;
+  for ( int i = 0; i < 16; ++i ) {
+    u64 const due = bus.apu.next_event();
+    ASSERT_NE( due, ~0ULL ) << "DMC stopped after " << fetches << " fetches";
+    TickUntil( due );
+    fetches += bus.apu.run();
+  }
+  EXPECT_EQ( fetches, 16 );
+
+  // Sample finished, nothing left to fetch
+  TickUntil( cpu.GetCycles() + 1000 );
+  EXPECT_EQ( bus.apu.run(), 0 );
+  EXPECT_EQ( bus.apu.next_event(), ~0ULL );
+  EXPECT_EQ( bus.Read( 0x4015 ) & 0x10, 0x00 );
+}
+
+TEST_F( ApuTimingTest, SoundFrameLengthMatchesCpuFrame )
+{
+  ASSERT_EQ( bus.apu.sample_rate( bus.sampleRate ), nullptr );
+  std::vector<Simple_Apu::sample_t> buffer( 4096 );
+
+  long samples = 0;
+  for ( int frame = 0; frame < 120; ++frame ) {
+    bus.RunFrame();
+    bus.apu.end_frame();
+    samples += bus.apu.read_samples( buffer.data(), static_cast<long>( buffer.size() ) );
+  }
+  // Two seconds of CPU time is two seconds of samples, within a frame
+  double const seconds = static_cast<double>( cpu.GetCycles() ) / 1789773.0;
+  EXPECT_NEAR( samples, seconds * bus.sampleRate, bus.sampleRate / 60 );
+}
+
+/*
+################################
+||     Synthesis Disabled     ||
+################################
+*/
+namespace
+{
+struct ApuObservation {
+  u64  cycle;
+  u8   status;
+  bool irq;
+  u64  hash;
+
+  bool operator==( const ApuObservation & ) const = default;
+};
+
+// Drives every CPU visible part of the APU: length counters on all channels, the frame IRQ,
+// and a looping then an IRQ raising DMC sample, with $4015 polled along the way
+std::vector<ApuObservation> ObserveApu( bool synthesis )
+{
+  Bus bus;
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  EXPECT_EQ( bus.apu.sample_rate( bus.sampleRate ), nullptr );
+  bus.apu.enable_synthesis( synthesis );
+
+  std::vector<Simple_Apu::sample_t> samples( 4096 );
+  std::vector<ApuObservation>       seen;
+  long                              samplesRead = 0;
+  for ( int frame = 0; frame < 30; ++frame ) {
+    if ( frame % 10 == 0 ) {
+      bus.Write( 0x4017, frame == 10 ? 0x80 : 0x00 ); // 4-step with IRQ, then 5-step
+      bus.Write( 0x4015, 0x1F );
+      bus.Write( 0x4000, 0x9F );
+      bus.Write( 0x4002, 0x40 );
+      bus.Write( 0x4003, static_cast<u8>( 0x08 + ( frame * 8 ) ) );
+      bus.Write( 0x4008, 0x20 );
+      bus.Write( 0x400A, 0x80 );
+      bus.Write( 0x400B, 0x18 );
+      bus.Write( 0x400C, 0x1F );
+      bus.Write( 0x400E, 0x03 );
+      bus.Write( 0x400F, 0x28 );
+      bus.Write( 0x4010, frame == 20 ? 0x8E : 0x4F ); // looping, then one-shot with IRQ
+      bus.Write( 0x4012, 0x00 );
+      bus.Write( 0x4013, 0x04 );
+    }
+    u64 const end = bus.cpu.GetCycles() + 29781;
+    while ( bus.cpu.GetCycles() < end ) {
+      bus.Clock();
+      if ( bus.cpu.GetCycles() % 997 == 0 ) {
+        u8 const status = bus.Read( 0x4015 );
+        seen.push_back( { bus.cpu.GetCycles(), status, bus.apu.irq_pending(), 0 } );
+      }
+    }
+    bus.apu.end_frame();
+    samplesRead += bus.apu.read_samples( samples.data(), static_cast<long>( samples.size() ) );
+    seen.push_back( { bus.cpu.GetCycles(), 0, bus.apu.irq_pending(), bus.StateHash() } );
+  }
+  EXPECT_EQ( samplesRead > 0, synthesis );
+  return seen;
+}
+} // namespace
+
+TEST( ApuSynthesisTest, CpuSeesTheSameApuWithSynthesisOff )
+{
+  std::vector<ApuObservation> const on = ObserveApu( true );
+  std::vector<ApuObservation> const off = ObserveApu( false );
+  ASSERT_EQ( on.size(), off.size() );
+  for ( std::size_t i = 0; i < on.size(); ++i ) {
+    ASSERT_EQ( on[i], off[i] ) << "first difference at cycle " << on[i].cycle;
+  }
+
+  // The script has to have exercised something: channels playing, and both IRQ sources seen
+  bool sawChannels = false;
+  bool sawFrameIrq = false;
+  bool sawDmcIrq = false;
+  for ( ApuObservation const &o : on ) {
+    sawChannels |= ( o.status & 0x0F ) != 0;
+    sawFrameIrq |= ( o.status & 0x40 ) != 0;
+    sawDmcIrq |= ( o.status & 0x80 ) != 0;
+  }
+  EXPECT_TRUE( sawChannels );
+  EXPECT_TRUE( sawFrameIrq );
+  EXPECT_TRUE( sawDmcIrq );
+}
+
+TEST( ApuSynthesisTest, ReenablingResumesOutput )
+{
+  Bus bus;
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  ASSERT_EQ( bus.apu.sample_rate( bus.sampleRate ), nullptr );
+  std::vector<Simple_Apu::sample_t> buffer( 4096 );
+
+  bus.apu.enable_synthesis( false );
+  bus.RunFrame();
+  bus.apu.end_frame();
+  EXPECT_EQ( bus.apu.samples_avail(), 0 );
+  EXPECT_EQ( bus.apu.read_samples( buffer.data(), static_cast<long>( buffer.size() ) ), 0 );
+
+  bus.apu.enable_synthesis();
+  bus.RunFrame();
+  bus.apu.end_frame();
+  EXPECT_NEAR( bus.apu.samples_avail(), bus.sampleRate / 60, 2 );
+}
+
 int main( int argc, char **argv )
 {
   ::testing::InitGoogleTest( &argc, argv );
@@ -0,0 +1,390 @@
+#include "Blip_Buffer.h"
+#include "Blip_Kernels.h"
+#include "audio-ring.h"
+#include "bus.h"
+#include "global-types.h"
+#include "paths.h"
+#include "rate-control.h"
+#include "wav-writer.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Sample = AudioRing::Sample;
+
+TEST( AudioRingTest, CapacityRoundsUpToPowerOfTwo )
+{
+  AudioRing const ring( 1000 );
+  EXPECT_EQ( ring.Capacity(), 1024 );
+  EXPECT_EQ( ring.Fill(), 0 );
+}
+
+TEST( AudioRingTest, PreservesOrderAcrossTheWrap )
+{
+  AudioRing ring( 16 );
+  Sample    next = 0;
+  Sample    expected = 0;
+
+  // Odd sized chunks so reads and writes straddle the end of the buffer
+  for ( int round = 0; round < 50; ++round ) {
+    std::vector<Sample> in( 11 );
+    for ( Sample &sample : in ) {
+      sample = next++;
+    }
+    ASSERT_EQ( ring.Write( in.data(), in.size() ), in.size() );
+    EXPECT_EQ( ring.Fill(), 11 );
+
+    std::vector<Sample> out( 11 );
+    ASSERT_EQ( ring.Read( out.data(), out.size() ), out.size() );
+    for ( Sample const sample : out ) {
+      EXPECT_EQ( sample, expected++ );
+    }
+  }
+  EXPECT_EQ( ring.Overruns(), 0 );
+  EXPECT_EQ( ring.Underruns(), 0 );
+}
+
+TEST( AudioRingTest, OverrunDropsInsteadOfBlocking )
+{
+  AudioRing           ring( 64 );
+  std::vector<Sample> in( 100 );
+  std::iota( in.begin(), in.end(), Sample( 1 ) );
+
+  EXPECT_EQ( ring.Write( in.data(), in.size() ), 64 );
+  EXPECT_EQ( ring.Fill(), 64 );
+  EXPECT_EQ( ring.Write( in.data(), 1 ), 0 );
+  EXPECT_EQ( ring.Overruns(), 2 );
+  EXPECT_EQ( ring.DroppedSamples(), 37 );
+
+  // What made it in is the oldest part of the write
+  std::vector<Sample> out( 64 );
+  ring.Read( out.data(), out.size() );
+  EXPECT_EQ( out.front(), 1 );
+  EXPECT_EQ( out.back(), 64 );
+}
+
+TEST( AudioRingTest, UnderrunPadsWithSilence )
+{
+  AudioRing                 ring( 64 );
+  std::vector<Sample> const in = { 5, 6, 7 };
+  ring.Write( in.data(), in.size() );
+
+  std::vector<Sample> out( 8, -1 );
+  EXPECT_EQ( ring.Read( out.data(), out.size() ), 3 );
+  EXPECT_EQ( out, ( std::vector<Sample>{ 5, 6, 7, 0, 0, 0, 0, 0 } ) );
+  EXPECT_EQ( ring.Underruns(), 1 );
+  EXPECT_EQ( ring.MissingSamples(), 5 );
+
+  ring.ResetStats();
+  EXPECT_EQ( ring.Underruns(), 0 );
+  EXPECT_EQ( ring.MissingSamples(), 0 );
+}
+
+// The emulation thread writes a frame of samples at a time while a simulated audio callback
+// drains fixed size periods on another thread. Every sample has to come out once, in order.
+TEST( AudioRingTest, ConcurrentProducerAndConsumer )
+{
+  constexpr std::size_t totalSamples = 2'000'000;
+  constexpr std::size_t frameSamples = 735; // 44100 Hz / 60 fps
+  constexpr std::size_t periodSamples = 512;
+
+  AudioRing         ring( 4096 );
+  std::atomic<bool> failed{ false };
+
+  std::thread consumer( [&] {
+    std::vector<Sample> period( periodSamples );
+    std::size_t         received = 0;
+    while ( received < totalSamples && !failed ) {
+      std::size_t const n = ring.Read( period.data(), period.size() );
+      for ( std::size_t i = 0; i < n; ++i ) {
+        if ( period[i] != static_cast<Sample>( received + i ) ) {
+          failed = true;
+          break;
+        }
+      }
+      received += n;
+      if ( n == 0 ) {
+        std::this_thread::yield();
+      }
+    }
+  } );
+
+  std::vector<Sample> frame( frameSamples );
+  std::size_t         sent = 0;
+  while ( sent < totalSamples && !failed ) {
+    std::size_t const n = std::min( frameSamples, totalSamples - sent );
+    for ( std::size_t i = 0; i < n; ++i ) {
+      frame[i] = static_cast<Sample>( sent + i );
+    }
+    // Only write what fits, so nothing is dropped and the sequence stays checkable
+    if ( ring.Capacity() - ring.Fill() < n ) {
+      std::this_thread::yield();
+      continue;
+    }
+    if ( ring.Write( frame.data(), n ) != n ) {
+      failed = true;
+    }
+    sent += n;
+  }
+  consumer.join();
+
+  EXPECT_FALSE( failed );
+  EXPECT_EQ( ring.Overruns(), 0 );
+  EXPECT_EQ( ring.Fill(), 0 );
+}
+
+/*
+################################
+||     Dynamic Rate Control   ||
+################################
+*/
+TEST( RateControlTest, RatioStaysWithinHalfPercent )
+{
+  EXPECT_DOUBLE_EQ( RateControl::RatioFor( 1000, 1000 ), 1.0 );
+  EXPECT_DOUBLE_EQ( RateControl::RatioFor( 0, 1000 ), 1.0 + RateControl::maxAdjust );
+  EXPECT_DOUBLE_EQ( RateControl::RatioFor( 2000, 1000 ), 1.0 - RateControl::maxAdjust );
+  EXPECT_DOUBLE_EQ( RateControl::RatioFor( 100000, 1000 ), 1.0 - RateControl::maxAdjust );
+  EXPECT_NEAR( RateControl::RatioFor( 500, 1000 ), 1.0025, 1e-12 );
+}
+
+TEST( RateControlTest, ResamplingKeepsTheSignal )
+{
+  RateControl         rate;
+  std::vector<Sample> in( 735 );
+  std::vector<Sample> out;
+
+  // A steady level comes out as the same level, a sample or two longer or shorter per frame
+  std::fill( in.begin(), in.end(), Sample( 1234 ) );
+  rate.Process( in.data(), in.size(), 1000, 1000, out ); // first frame fades in from the previous sample (0)
+  out.clear();
+  std::size_t const n = rate.Process( in.data(), in.size(), 0, 1000, out );
+  EXPECT_NEAR( static_cast<double>( n ), 735 * 1.005, 1.0 );
+  for ( Sample const sample : out ) {
+    EXPECT_EQ( sample, 1234 );
+  }
+  EXPECT_DOUBLE_EQ( rate.Ratio(), 1.005 );
+
+  // A ramp picking up from that level stays a ramp
+  std::iota( in.begin(), in.end(), Sample( 1234 ) );
+  out.clear();
+  rate.Process( in.data(), in.size(), 2000, 1000, out );
+  for ( std::size_t i = 1; i < out.size(); ++i ) {
+    EXPECT_GE( out[i], out[i - 1] );
+  }
+}
+
+// A sound card clock 0.3% faster than the frame timer drains about 2 samples a frame more than
+// the APU makes. Without rate control the queue runs dry within a minute, with it the queue
+// settles where the ratio makes up the difference.
+TEST( RateControlTest, HoldsQueueAgainstClockDrift )
+{
+  constexpr std::size_t target = 2205; // 50 ms at 44100 Hz
+  constexpr double      cardSpeed = 1.003;
+  constexpr int         frames = 60 * 60;
+
+  AudioRing           ring( target * 2 );
+  RateControl         rate;
+  std::vector<Sample> frame( 735, 100 );
+  std::vector<Sample> resampled;
+  std::vector<Sample> period( 1024 );
+
+  std::vector<Sample> const prefill( target, 100 );
+  ring.Write( prefill.data(), prefill.size() );
+
+  double owed = 0.0;
+  for ( int i = 0; i < frames; ++i ) {
+    resampled.clear();
+    rate.Process( frame.data(), frame.size(), ring.Fill(), target, resampled );
+    ring.Write( resampled.data(), resampled.size() );
+
+    owed += 735.0 * cardSpeed;
+    auto const drain = static_cast<std::size_t>( owed );
+    owed -= static_cast<double>( drain );
+    ring.Read( period.data(), drain );
+  }
+
+  EXPECT_EQ( ring.Underruns(), 0 );
+  EXPECT_EQ( ring.Overruns(), 0 );
+  EXPECT_NEAR( rate.Ratio(), cardSpeed, 0.0005 );
+  EXPECT_GT( ring.Fill(), target / 4 );
+}
+
+/*
+################################
+||       Offline Render       ||
+################################
+*/
+TEST( WavWriterTest, RendersOneSecondOfAudio )
+{
+  Bus bus;
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  ASSERT_EQ( bus.apu.sample_rate( bus.sampleRate ), nullptr );
+
+  auto const path = std::filesystem::temp_directory_path() / "audio_test_render.wav";
+  WavWriter  wav;
+  ASSERT_TRUE( wav.Open( path.string(), bus.sampleRate ) );
+  for ( int frame = 0; frame < 60; ++frame ) {
+    bus.RunFrame();
+    bus.apu.end_frame();
+    wav.WriteFrom( bus.apu );
+  }
+  u64 const samples = wav.SamplesWritten();
+  ASSERT_TRUE( wav.Close() );
+
+  // As much audio as CPU time ran, about a second. Blip_Buffer's fixed point resampling factor
+  // is accurate to about 1e-4.
+  double const expected = static_cast<double>( bus.cpu.GetCycles() ) / 1789773.0 * bus.sampleRate;
+  EXPECT_NEAR( static_cast<double>( samples ), expected, expected * 2e-4 );
+
+  std::ifstream           file( path, std::ios::binary );
+  std::vector<char> const bytes( ( std::istreambuf_iterator<char>( file ) ), std::istreambuf_iterator<char>() );
+  ASSERT_EQ( bytes.size(), 44 + ( samples * 2 ) );
+
+  auto const u32At = [&]( std::size_t offset ) {
+    u32 value = 0;
+    std::memcpy( &value, &bytes.at( offset ), sizeof( value ) );
+    return value;
+  };
+  EXPECT_EQ( std::string( bytes.data(), 4 ), "RIFF" );
+  EXPECT_EQ( std::string( &bytes.at( 8 ), 8 ), "WAVEfmt " );
+  EXPECT_EQ( u32At( 4 ), bytes.size() - 8 );
+  EXPECT_EQ( u32At( 24 ), static_cast<u32>( bus.sampleRate ) );
+  EXPECT_EQ( u32At( 40 ), samples * 2 );
+
+  std::filesystem::remove( path );
+}
+
+// After a render nothing reads samples, a detached output leaves the sample buffer alone
+TEST( WavWriterTest, DetachedOutputStopsFillingTheBuffer )
+{
+  Bus bus;
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  ASSERT_EQ( bus.apu.sample_rate( bus.sampleRate ), nullptr );
+  bus.RunFrame();
+  bus.apu.end_frame();
+  EXPECT_GT( bus.apu.samples_avail(), 0 );
+
+  bus.apu.detach_output();
+  EXPECT_FALSE( bus.apu.has_output() );
+  EXPECT_EQ( bus.apu.samples_avail(), 0 );
+  for ( int frame = 0; frame < 300; ++frame ) { // longer than the sample buffer holds
+    bus.RunFrame();
+    bus.apu.end_frame();
+  }
+  EXPECT_EQ( bus.apu.samples_avail(), 0 );
+
+  // And attaches again like it never left
+  ASSERT_EQ( bus.apu.sample_rate( bus.sampleRate ), nullptr );
+  bus.RunFrame();
+  bus.apu.end_frame();
+  EXPECT_GT( bus.apu.samples_avail(), 0 );
+}
+
+/*
+################################
+||      Blip Vector Kernels   ||
+################################
+*/
+TEST( BlipKernelsTest, EveryKernelMatchesScalar )
+{
+  // In range, at the edges of 16 bits, past them into the odd clamp region, and 32-bit extremes
+  std::vector<int32_t> in = { 0,       1,         -1,        32767,    -32768,      32768,          -32769,
+                              65535,   -65536,    1 << 24,   -16777216, ( 1 << 24 ) - 1, 123456789, INT32_MAX,
+                              INT32_MIN };
+
+  std::mt19937                           rng( 1 );
+  std::uniform_int_distribution<int32_t> small( -40000, 40000 );
+  std::uniform_int_distribution<int32_t> any( INT32_MIN, INT32_MAX );
+  while ( in.size() < 1000 ) {
+    in.push_back( in.size() % 3 == 0 ? any( rng ) : small( rng ) );
+  }
+
+  blip_kernels_t const &scalar = blip_kernel( 0 );
+  ASSERT_STREQ( scalar.name, "scalar" );
+  for ( int k = 1; k < blip_kernel_count(); ++k ) {
+    blip_kernels_t const &kernel = blip_kernel( k );
+    // Every length up to a few vectors, so each tail path runs
+    for ( long count = 0; count <= 40; ++count ) {
+      for ( bool const stereo : { false, true } ) {
+        std::size_t const         size = static_cast<std::size_t>( count ) * 2 + 1;
+        std::vector<blip_sample_t> expected( size, 0x5A5A );
+        std::vector<blip_sample_t> actual( size, 0x5A5A );
+        scalar.write_samples( in.data() + count, expected.data(), count, stereo );
+        kernel.write_samples( in.data() + count, actual.data(), count, stereo );
+        ASSERT_EQ( expected, actual ) << kernel.name << " count " << count << ( stereo ? " stereo" : " mono" );
+      }
+    }
+    std::vector<blip_sample_t> expected( in.size() );
+    std::vector<blip_sample_t> actual( in.size() );
+    scalar.write_samples( in.data(), expected.data(), static_cast<long>( in.size() ), false );
+    kernel.write_samples( in.data(), actual.data(), static_cast<long>( in.size() ), false );
+    EXPECT_EQ( expected, actual ) << kernel.name;
+  }
+}
+
+// Loud enough to clip, read out in uneven chunks, mono and stereo
+TEST( BlipKernelsTest, ReadSamplesIsSampleExact )
+{
+  auto const render = []( bool stereo ) {
+    Blip_Buffer buf;
+    EXPECT_EQ( buf.sample_rate( 44100 ), nullptr );
+    buf.clock_rate( 1789773 );
+    Blip_Synth<blip_good_quality, 20> synth;
+    synth.volume( 3.0 );
+    synth.output( &buf );
+
+    std::mt19937                        rng( 7 );
+    std::uniform_int_distribution<int>  step( 1, 400 );
+    std::uniform_int_distribution<int>  delta( -20, 20 );
+    std::uniform_int_distribution<long> chunk( 1, 700 );
+    std::vector<blip_sample_t>          out;
+    std::vector<blip_sample_t>          scratch;
+    for ( int frame = 0; frame < 60; ++frame ) {
+      for ( blip_time_t t = step( rng ); t < 29780; t += step( rng ) ) {
+        synth.offset( t, delta( rng ) );
+      }
+      buf.end_frame( 29780 );
+      while ( buf.samples_avail() > 0 ) {
+        long const want = chunk( rng );
+        scratch.assign( static_cast<std::size_t>( want ) * 2, 0x1234 );
+        long const got = buf.read_samples( scratch.data(), want, stereo );
+        out.insert( out.end(), scratch.begin(), scratch.begin() + ( stereo ? got * 2 : got ) );
+      }
+    }
+    return out;
+  };
+
+  for ( bool const stereo : { false, true } ) {
+    blip_use_kernels( &blip_kernel( 0 ) );
+    std::vector<blip_sample_t> const expected = render( stereo );
+    ASSERT_TRUE( std::ranges::any_of( expected, []( blip_sample_t s ) { return s == 32767 || s == -32768; } ) )
+        << "signal never clips, the clamp isn't exercised";
+    for ( int k = 1; k < blip_kernel_count(); ++k ) {
+      blip_use_kernels( &blip_kernel( k ) );
+      EXPECT_EQ( render( stereo ), expected ) << blip_kernel( k ).name << ( stereo ? " stereo" : " mono" );
+    }
+  }
+  blip_use_kernels( nullptr );
+  EXPECT_STREQ( blip_kernels().name, blip_kernel( blip_kernel_count() - 1 ).name );
+}
+
+int main( int argc, char **argv )
+{
+  ::testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
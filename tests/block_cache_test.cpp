@@ -0,0 +1,161 @@
+#include "bus.h"
+#include "global-types.h"
+#include "paths.h"
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::unique_ptr<Bus> MakeBus( const std::string &rom, bool blockCache, bool idleSkip = true )
+{
+  auto bus = std::make_unique<Bus>();
+  bus->apu.enable_synthesis( false );
+  bus->blockCache.enabled = blockCache;
+  bus->idleLoop.enabled = idleSkip;
+  bus->cartridge.LoadRom( std::string( paths::roms() ) + "/" + rom );
+  bus->DebugReset();
+  return bus;
+}
+
+void RunFrame( Bus &bus, int frame )
+{
+  bus.controller[0] = ( frame % 90 ) < 4 ? 0x10 : 0x00;
+  bus.RunFrame();
+  bus.apu.end_frame();
+}
+
+void ExpectSameRun( const std::string &rom, int frames, bool idleSkip )
+{
+  auto cached = MakeBus( rom, true, idleSkip );
+  auto interpreting = MakeBus( rom, false, idleSkip );
+
+  for ( int frame = 0; frame < frames; ++frame ) {
+    RunFrame( *cached, frame );
+    RunFrame( *interpreting, frame );
+    ASSERT_EQ( cached->cpu.GetCycles(), interpreting->cpu.GetCycles() ) << "frame " << frame;
+    ASSERT_EQ( cached->StateHash(), interpreting->StateHash() ) << "frame " << frame;
+  }
+
+  std::vector<u8> cachedState;
+  std::vector<u8> interpretingState;
+  cached->SaveStateToMemory( cachedState );
+  interpreting->SaveStateToMemory( interpretingState );
+  EXPECT_EQ( cachedState, interpretingState );
+  EXPECT_GT( cached->blockCache.BlockCount(), 0U );
+  EXPECT_EQ( interpreting->blockCache.BlockCount(), 0U );
+}
+} // namespace
+
+// Running from cached blocks must not change anything the interpreter would have done
+TEST( BlockCacheTest, MatchesInterpreter )
+{
+  for ( std::string const rom : { "nestest.nes", "custom.nes", "palette.nes", "color_test.nes", "scanline.nes" } ) {
+    SCOPED_TRACE( rom );
+    ExpectSameRun( rom, 240, true );
+    ExpectSameRun( rom, 60, false );
+  }
+}
+
+// instr_test-v5 is MMC1: bank switches, PRG RAM and code copied into RAM
+TEST( BlockCacheTest, MatchesInterpreterAcrossBankSwitches )
+{
+  ExpectSameRun( "instr_test-v5.nes", 600, true );
+}
+
+// Code in RAM that rewrites its own operand picks up every new version
+TEST( BlockCacheTest, SelfModifyingCodeInRam )
+{
+  auto cached = MakeBus( "nestest.nes", true );
+  auto interpreting = MakeBus( "nestest.nes", false );
+
+  // loop: INC $0304    ; next iteration loads from the next zero page address
+  //       LDA $20
+  //       STA $10
+  //       JMP loop
+  std::vector<u8> const program = { 0xEE, 0x04, 0x03, 0xA5, 0x20, 0x85, 0x10, 0x4C, 0x00, 0x03 };
+  for ( Bus *bus : { cached.get(), interpreting.get() } ) {
+    for ( u16 i = 0; i < program.size(); ++i ) {
+      bus->Write( 0x0300 + i, program[i] );
+    }
+    for ( u16 i = 0; i < 16; ++i ) {
+      bus->Write( 0x21 + i, 0x80 + i );
+    }
+    bus->cpu.pc = 0x0300;
+  }
+
+  for ( u8 iteration = 0; iteration < 16; ++iteration ) {
+    for ( int instruction = 0; instruction < 4; ++instruction ) {
+      cached->Clock();
+      interpreting->Clock();
+      ASSERT_EQ( cached->cpu.GetCycles(), interpreting->cpu.GetCycles() );
+      ASSERT_EQ( cached->cpu.GetProgramCounter(), interpreting->cpu.GetProgramCounter() );
+    }
+    ASSERT_EQ( cached->Read( 0x10, true ), 0x80 + iteration ) << "iteration " << int( iteration );
+    ASSERT_EQ( interpreting->Read( 0x10, true ), 0x80 + iteration ) << "iteration " << int( iteration );
+  }
+  EXPECT_EQ( cached->StateHash(), interpreting->StateHash() );
+}
+
+// Run-ahead and rollback load a state every frame, the ROM blocks survive it
+TEST( BlockCacheTest, StateLoadsKeepTheBlocks )
+{
+  auto bus = MakeBus( "nestest.nes", true );
+  for ( int frame = 0; frame < 60; ++frame ) {
+    RunFrame( *bus, frame );
+  }
+  std::vector<u8> state;
+  bus->SaveStateToMemory( state );
+  std::size_t const blocks = bus->blockCache.BlockCount();
+  ASSERT_GT( blocks, 0U );
+
+  for ( int frame = 60; frame < 70; ++frame ) {
+    RunFrame( *bus, frame );
+    ASSERT_TRUE( bus->LoadStateFromMemory( state.data(), state.size() ) );
+    EXPECT_GE( bus->blockCache.BlockCount(), blocks ) << "frame " << frame;
+  }
+}
+
+// ...but code in RAM the load changed is translated again
+TEST( BlockCacheTest, StateLoadsDropChangedRamCode )
+{
+  auto bus = MakeBus( "nestest.nes", true );
+
+  // loop: LDA from    ; the zero page address is part of the micro-op, an immediate isn't
+  //       STA $10
+  //       JMP loop
+  bus->Write( 0x20, 0x11 );
+  bus->Write( 0x21, 0x22 );
+  auto const load = [&]( u8 from ) {
+    std::vector<u8> const program = { 0xA5, from, 0x85, 0x10, 0x4C, 0x00, 0x03 };
+    for ( u16 i = 0; i < program.size(); ++i ) {
+      bus->Write( 0x0300 + i, program[i] );
+    }
+    bus->cpu.pc = 0x0300;
+  };
+  auto const run = [&]() {
+    for ( int instruction = 0; instruction < 6; ++instruction ) {
+      bus->Clock();
+    }
+    return bus->Read( 0x10, true );
+  };
+
+  load( 0x20 );
+  std::vector<u8> state;
+  bus->SaveStateToMemory( state );
+  EXPECT_EQ( run(), 0x11 );
+
+  load( 0x21 );
+  EXPECT_EQ( run(), 0x22 );
+
+  ASSERT_TRUE( bus->LoadStateFromMemory( state.data(), state.size() ) );
+  EXPECT_EQ( run(), 0x11 );
+}
+
+int main( int argc, char **argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,283 @@
+#include "breakpoints.h"
+#include "bus.h"
+#include "movie.h"
+#include "global-types.h"
+#include "paths.h"
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::unique_ptr<Bus> MakeBus()
+{
+  auto bus = std::make_unique<Bus>();
+  bus->apu.enable_synthesis( false );
+  bus->cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus->DebugReset();
+  return bus;
+}
+
+// Copies program to $0300 and runs it from there
+void LoadProgram( Bus &bus, const std::vector<u8> &program )
+{
+  for ( u16 i = 0; i < program.size(); ++i ) {
+    bus.Write( 0x0300 + i, program[i] );
+  }
+  bus.cpu.pc = 0x0300;
+}
+
+// $0300: LDX #$00
+// $0302: INX
+// $0303: STX $10
+// $0305: LDA $10
+// $0307: JMP $0302
+std::vector<u8> const countingLoop = { 0xA2, 0x00, 0xE8, 0x86, 0x10, 0xA5, 0x10, 0x4C, 0x02, 0x03 };
+
+bool Holds( Bus &bus, const std::string &source, u16 address = 0, u8 value = 0 )
+{
+  BreakCondition condition;
+  std::string    error;
+  EXPECT_TRUE( condition.Compile( source, error ) ) << source << ": " << error;
+  return condition.Holds( bus, address, value );
+}
+
+bool Compiles( const std::string &source )
+{
+  BreakCondition condition;
+  std::string    error;
+  return condition.Compile( source, error );
+}
+
+Breakpoint At( BreakKind kind, u16 address )
+{
+  return Breakpoint{ .kind = kind, .first = address, .last = address, .condition = {} };
+}
+} // namespace
+
+TEST( BreakConditionTest, Evaluates )
+{
+  auto bus = MakeBus();
+  bus->cpu.a = 0x20;
+  bus->cpu.x = 3;
+  bus->Write( 0x0300, 6 );
+
+  EXPECT_TRUE( Holds( *bus, "" ) );
+  EXPECT_TRUE( Holds( *bus, "A == 0x20 && [0x0300] > 5" ) );
+  EXPECT_TRUE( Holds( *bus, "a == $20 && [$300] == 6 && x == 3" ) );
+  EXPECT_FALSE( Holds( *bus, "A == 0x20 && [0x0300] > 6" ) );
+  EXPECT_TRUE( Holds( *bus, "A != 0x20 || [0x0200 + 0x100] >= 6" ) );
+  EXPECT_TRUE( Holds( *bus, "[0x2FF + X - 2] == 6" ) );
+
+  // C precedence: comparisons bind tighter than bitwise operators, which bind tighter than && and ||
+  EXPECT_TRUE( Holds( *bus, "1 + 2 == 3" ) );
+  EXPECT_TRUE( Holds( *bus, "(A & 0x0F) == 0" ) );
+  EXPECT_FALSE( Holds( *bus, "A & 0x0F == 0" ) );
+  EXPECT_TRUE( Holds( *bus, "0 && 0 || 1" ) );
+  EXPECT_TRUE( Holds( *bus, "!(X == 4) && -1 < 0 && ~0 == -1" ) );
+
+  // Watchpoints see the access
+  EXPECT_TRUE( Holds( *bus, "Value == 0x80 && Address == 0x2007", 0x2007, 0x80 ) );
+  EXPECT_FALSE( Holds( *bus, "Value == 0x80", 0x2007, 0x7F ) );
+}
+
+TEST( BreakConditionTest, RejectsBadSource )
+{
+  EXPECT_FALSE( Compiles( "A ==" ) );
+  EXPECT_FALSE( Compiles( "(A == 1" ) );
+  EXPECT_FALSE( Compiles( "[0x300" ) );
+  EXPECT_FALSE( Compiles( "A == 1)" ) );
+  EXPECT_FALSE( Compiles( "B == 1" ) );
+  EXPECT_FALSE( Compiles( "$ == 1" ) );
+  EXPECT_FALSE( Compiles( "A = 1" ) );
+
+  std::string nested = "1";
+  for ( int i = 0; i < 20; ++i ) {
+    nested = "1 + (" + nested + ")";
+  }
+  EXPECT_FALSE( Compiles( nested ) );
+}
+
+TEST( BreakpointTest, ExecuteStopsBeforeTheInstruction )
+{
+  auto bus = MakeBus();
+  LoadProgram( *bus, countingLoop );
+  std::string error;
+  int const   id = bus->breakpoints.Add( At( BreakKind::Execute, 0x0303 ), "X == 3", error );
+  ASSERT_GT( id, 0 ) << error;
+
+  bus->RunFrameUntilBreak();
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  EXPECT_EQ( bus->breakpoints.LastHit().id, id );
+  EXPECT_EQ( bus->breakpoints.LastHit().pc, 0x0303 );
+  EXPECT_EQ( bus->cpu.pc, 0x0303 );
+  EXPECT_EQ( bus->cpu.x, 3 );
+  EXPECT_EQ( bus->Read( 0x10, true ), 2 ); // STX $10 hasn't run yet
+
+  // Carries on from there, until X wraps around to 3 again
+  bus->breakpoints.Resume();
+  EXPECT_FALSE( bus->breakpoints.Hit() );
+  u64 const cycles = bus->cpu.GetCycles();
+  bus->RunFrameUntilBreak();
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  EXPECT_EQ( bus->cpu.pc, 0x0303 );
+  EXPECT_EQ( bus->cpu.x, 3 );
+  EXPECT_EQ( bus->Read( 0x10, true ), 2 );
+  EXPECT_EQ( bus->cpu.GetCycles() - cycles, 256 * 11 ); // STX, LDA, JMP, INX per iteration
+
+  // Disabled, the frame runs through
+  ASSERT_TRUE( bus->breakpoints.SetEnabled( id, false ) );
+  EXPECT_FALSE( bus->breakpoints.Armed() );
+  u64 const frame = bus->ppu.frame;
+  bus->RunFrame();
+  EXPECT_FALSE( bus->breakpoints.Hit() );
+  EXPECT_EQ( bus->ppu.frame, frame + 1 );
+}
+
+TEST( BreakpointTest, WatchpointsLetTheAccessFinish )
+{
+  auto        bus = MakeBus();
+  std::string error;
+  LoadProgram( *bus, countingLoop );
+  ASSERT_GT( bus->breakpoints.Add( At( BreakKind::CpuWrite, 0x0010 ), "Value == 5", error ), 0 ) << error;
+
+  bus->RunFrameUntilBreak();
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  BreakHit const write = bus->breakpoints.LastHit();
+  EXPECT_EQ( write.kind, BreakKind::CpuWrite );
+  EXPECT_EQ( write.pc, 0x0303 );
+  EXPECT_EQ( write.address, 0x0010 );
+  EXPECT_EQ( write.value, 5 );
+  EXPECT_EQ( bus->cpu.pc, 0x0305 );
+  EXPECT_EQ( bus->Read( 0x10, true ), 5 );
+
+  bus->breakpoints.Clear();
+  bus->breakpoints.Resume();
+  ASSERT_GT( bus->breakpoints.Add( At( BreakKind::CpuRead, 0x0010 ), "Value == 7", error ), 0 ) << error;
+  bus->RunFrameUntilBreak();
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  BreakHit const read = bus->breakpoints.LastHit();
+  EXPECT_EQ( read.kind, BreakKind::CpuRead );
+  EXPECT_EQ( read.pc, 0x0305 );
+  EXPECT_EQ( read.value, 7 );
+  EXPECT_EQ( bus->cpu.a, 7 );
+  EXPECT_EQ( bus->cpu.pc, 0x0307 );
+}
+
+TEST( BreakpointTest, PpuWatchpointsFollowPpuData )
+{
+  auto        bus = MakeBus();
+  std::string error;
+
+  // loop: LDA #$21, STA $2006, LDA #$08, STA $2006, LDA #$AB, STA $2007, JMP loop
+  // $2006 writes only land once the PPU has warmed up, so the first hit comes about a frame in
+  LoadProgram( *bus, { 0xA9, 0x21, 0x8D, 0x06, 0x20, 0xA9, 0x08, 0x8D, 0x06, 0x20, 0xA9, 0xAB, 0x8D, 0x07, 0x20, 0x4C,
+                       0x00, 0x03 } );
+  ASSERT_GT( bus->breakpoints.Add( At( BreakKind::PpuWrite, 0x2108 ), "", error ), 0 ) << error;
+  for ( int frame = 0; frame < 3 && !bus->breakpoints.Hit(); ++frame ) {
+    bus->RunFrameUntilBreak();
+  }
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  EXPECT_EQ( bus->breakpoints.LastHit().kind, BreakKind::PpuWrite );
+  EXPECT_EQ( bus->breakpoints.LastHit().address, 0x2108 );
+  EXPECT_EQ( bus->breakpoints.LastHit().value, 0xAB );
+  EXPECT_EQ( bus->breakpoints.LastHit().pc, 0x030C );
+  EXPECT_GE( bus->cpu.GetCycles(), CPU::ppuWarmupEnd );
+}
+
+TEST( BreakpointTest, BreaksOnScanlineAndCycle )
+{
+  auto        bus = MakeBus();
+  std::string error;
+  bus->RunFrame();
+
+  Breakpoint const position{ .kind = BreakKind::Scanline, .scanline = 100, .dot = 200, .condition = {} };
+  ASSERT_GT( bus->breakpoints.Add( position, "", error ), 0 );
+  bus->RunFrameUntilBreak();
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  EXPECT_EQ( bus->ppu.scanline, 100 );
+  EXPECT_GE( bus->ppu.cycle, 200 );
+  EXPECT_LT( bus->ppu.cycle, 200 + ( 3 * 8 ) ); // the first instruction at or past it
+
+  bus->breakpoints.Clear();
+  bus->breakpoints.Resume();
+  u64 const target = bus->cpu.GetCycles() + 5000;
+  Breakpoint const cycle{ .kind = BreakKind::Cycle, .cycle = target, .condition = {} };
+  ASSERT_GT( bus->breakpoints.Add( cycle, "", error ), 0 );
+  bus->RunFrameUntilBreak();
+  ASSERT_TRUE( bus->breakpoints.Hit() );
+  EXPECT_GE( bus->cpu.GetCycles(), target );
+  EXPECT_LT( bus->cpu.GetCycles(), target + 8 );
+}
+
+// Only the debugger's frame step stops, a plain RunFrame() runs the whole frame so movies stay in sync
+TEST( BreakpointTest, RunFrameRunsWholeFrames )
+{
+  auto        bus = MakeBus();
+  std::string error;
+  LoadProgram( *bus, countingLoop );
+  ASSERT_GT( bus->breakpoints.Add( At( BreakKind::Execute, 0x0303 ), "", error ), 0 );
+  ASSERT_GT( bus->breakpoints.Add( At( BreakKind::CpuWrite, 0x0010 ), "", error ), 0 );
+  Breakpoint const soon{ .kind = BreakKind::Cycle, .cycle = bus->cpu.GetCycles() + 1000, .condition = {} };
+  ASSERT_GT( bus->breakpoints.Add( soon, "", error ), 0 );
+
+  Movie movie;
+  movie.StartRecording( *bus, MovieStart::SaveState );
+  for ( int frame = 0; frame < 3; ++frame ) {
+    u64 const before = bus->ppu.frame;
+    ASSERT_TRUE( movie.RunFrame( *bus ) );
+    EXPECT_EQ( bus->ppu.frame, before + 1 );
+    EXPECT_FALSE( bus->breakpoints.Hit() );
+  }
+  EXPECT_EQ( movie.FrameCount(), 3U );
+  movie.Stop();
+
+  // The cycle break the plain frames ran past doesn't fire late
+  LoadProgram( *bus, countingLoop );
+  EXPECT_FALSE( bus->RunFrameUntilBreak() );
+  EXPECT_EQ( bus->breakpoints.LastHit().kind, BreakKind::Execute );
+  EXPECT_EQ( bus->cpu.pc, 0x0303 );
+}
+
+// Breakpoints that never hit change nothing, and with none left the fast paths come back
+TEST( BreakpointTest, NeverHittingBreakpointsChangeNothing )
+{
+  auto plain = MakeBus();
+  auto watched = MakeBus();
+  EXPECT_TRUE( watched->cpu.UsesProductionStep() );
+
+  std::string error;
+  ASSERT_GT( watched->breakpoints.Add( At( BreakKind::Execute, 0x0000 ), "", error ), 0 );
+  Breakpoint const everyWrite{ .kind = BreakKind::CpuWrite, .first = 0, .last = 0xFFFF, .condition = {} };
+  ASSERT_GT( watched->breakpoints.Add( everyWrite, "0", error ), 0 );
+  Breakpoint const everyRead{ .kind = BreakKind::CpuRead, .first = 0, .last = 0xFFFF, .condition = {} };
+  ASSERT_GT( watched->breakpoints.Add( everyRead, "Value == 0x100", error ), 0 );
+  EXPECT_FALSE( watched->cpu.UsesProductionStep() );
+  EXPECT_TRUE( watched->cpu.busRead == &Bus::WatchedRead );
+  EXPECT_TRUE( watched->cpu.busWrite == &Bus::WatchedWrite );
+
+  for ( int frame = 0; frame < 120; ++frame ) {
+    for ( Bus *bus : { plain.get(), watched.get() } ) {
+      bus->controller[0] = ( frame % 30 ) < 4 ? 0x10 : 0x00;
+      bus->RunFrameUntilBreak();
+      bus->apu.end_frame();
+    }
+    ASSERT_FALSE( watched->breakpoints.Hit() );
+    ASSERT_EQ( plain->cpu.GetCycles(), watched->cpu.GetCycles() ) << "frame " << frame;
+  }
+  EXPECT_EQ( plain->StateHash(), watched->StateHash() );
+
+  watched->breakpoints.Clear();
+  EXPECT_FALSE( watched->breakpoints.Armed() );
+  EXPECT_TRUE( watched->cpu.UsesProductionStep() );
+  EXPECT_TRUE( watched->cpu.busRead == &Bus::Read );
+  EXPECT_TRUE( watched->cpu.busWrite == &Bus::Write );
+}
+
+int main( int argc, char **argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
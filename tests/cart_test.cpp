@@ -1,9 +1,21 @@
 #include "bus.h"
 #include "cartridge.h"
+#include "net-transport.h"
 #include "paths.h"
+#include "rollback.h"
+#include "rom-cache.h"
+#include "run-ahead.h"
+#include "utils.h"
 #include <fmt/base.h>
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
 class CartTest : public ::testing::Test
 // This class is a test fixture that provides shared setup and teardown for all tests
 {
@@ -21,6 +33,33 @@ protected:
   }
 };
 
+namespace
+{
+// palette.nes with the battery bit set, written out as its own rom. tweak flips bits of the last
+// byte so every test gets a hash of its own, apart from any real save.
+std::filesystem::path WriteBatteryRom( const std::string &name, u8 tweak )
+{
+  std::ifstream   in( std::string( paths::roms() ) + "/palette.nes", std::ios::binary );
+  std::vector<u8> rom( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+  if ( rom.size() <= 16 ) {
+    return {};
+  }
+  rom[6] |= 0x02;
+  rom.back() ^= tweak;
+  std::filesystem::path const romPath = std::filesystem::temp_directory_path() / name;
+  std::ofstream               out( romPath, std::ios::binary | std::ios::trunc );
+  out.write( reinterpret_cast<const char *>( rom.data() ), static_cast<std::streamsize>( rom.size() ) );
+  return romPath;
+}
+
+u8 SaveFileByte( const std::filesystem::path &savePath, std::size_t offset )
+{
+  std::ifstream   save( savePath, std::ios::binary );
+  std::vector<u8> contents( ( std::istreambuf_iterator<char>( save ) ), std::istreambuf_iterator<char>() );
+  return offset < contents.size() ? contents[offset] : 0;
+}
+} // namespace
+
 TEST_F( CartTest, iNes )
 {
   // palette.nes
@@ -90,6 +129,225 @@ TEST_F( CartTest, iNes )
   EXPECT_EQ( ines.GetChrRamSizeBytes(), 0 );
 }
 
+TEST_F( CartTest, BatteryRamIsFileBacked )
+{
+  namespace fs = std::filesystem;
+
+  fs::path const romPath = WriteBatteryRom( "battery_test.nes", 0xA5 );
+  ASSERT_FALSE( romPath.empty() );
+
+  bus.cartridge.LoadRom( romPath.string() );
+  fs::path const savePath = fs::path( paths::saves() ) / bus.cartridge.GetRomHash();
+  if ( !bus.cartridge.IsBatteryRamMapped() ) {
+    GTEST_SKIP() << "Memory mapped battery RAM not supported on this platform";
+  }
+
+  bus.Write( 0x6000, 0x42 );
+  bus.Write( 0x7FFF, 0x24 );
+  EXPECT_EQ( bus.Read( 0x6000 ), 0x42 );
+
+  // The save file sees the write without any explicit save
+  {
+    std::ifstream   save( savePath, std::ios::binary );
+    std::vector<u8> contents( ( std::istreambuf_iterator<char>( save ) ), std::istreambuf_iterator<char>() );
+    ASSERT_EQ( contents.size(), 8192 );
+    EXPECT_EQ( contents.front(), 0x42 );
+    EXPECT_EQ( contents.back(), 0x24 );
+  }
+
+  // And it's picked back up on the next load
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/palette.nes" );
+  bus.cartridge.LoadRom( romPath.string() );
+  EXPECT_EQ( bus.Read( 0x6000 ), 0x42 );
+
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/palette.nes" );
+  std::error_code ec;
+  fs::remove( savePath, ec );
+  fs::remove( romPath, ec );
+}
+
+TEST_F( CartTest, ForkingKeepsTheSaveFileMapped )
+{
+  namespace fs = std::filesystem;
+
+  fs::path const romPath = WriteBatteryRom( "battery_fork_test.nes", 0x5A );
+  ASSERT_FALSE( romPath.empty() );
+
+  bus.cartridge.LoadRom( romPath.string() );
+  fs::path const savePath = fs::path( paths::saves() ) / bus.cartridge.GetRomHash();
+  if ( !bus.cartridge.IsBatteryRamMapped() ) {
+    GTEST_SKIP() << "Memory mapped battery RAM not supported on this platform";
+  }
+
+  // The copy writes its own PRG RAM, never the save file
+  auto node = bus.Clone();
+  EXPECT_FALSE( node->cartridge.IsBatteryRamMapped() );
+  node->Write( 0x6000, 0x37 );
+  EXPECT_EQ( bus.Read( 0x6000 ), 0x00 );
+
+  // Forking back into the bus keeps its mapping, with the copy's PRG RAM in the file
+  bus.ForkFrom( *node );
+  EXPECT_TRUE( bus.cartridge.IsBatteryRamMapped() );
+  EXPECT_EQ( bus.Read( 0x6000 ), 0x37 );
+  bus.Write( 0x7FFF, 0x73 );
+  EXPECT_EQ( SaveFileByte( savePath, 0 ), 0x37 );
+  EXPECT_EQ( SaveFileByte( savePath, 0x1FFF ), 0x73 );
+
+  node.reset();
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/palette.nes" );
+  std::error_code ec;
+  fs::remove( savePath, ec );
+  fs::remove( romPath, ec );
+}
+
+TEST_F( CartTest, SpeculativeWritesStayOutOfTheSaveFile )
+{
+  namespace fs = std::filesystem;
+
+  fs::path const romPath = WriteBatteryRom( "battery_speculation_test.nes", 0x3C );
+  ASSERT_FALSE( romPath.empty() );
+  bus.cartridge.LoadRom( romPath.string() );
+  fs::path const savePath = fs::path( paths::saves() ) / bus.cartridge.GetRomHash();
+  if ( !bus.cartridge.IsBatteryRamMapped() ) {
+    GTEST_SKIP() << "Memory mapped battery RAM not supported on this platform";
+  }
+  bus.Write( 0x6000, 0x11 );
+
+  // Dropped: the snapshot is loaded before speculation ends
+  std::vector<u8> snapshot;
+  bus.SaveStateToMemory( snapshot );
+  bus.cartridge.BeginSpeculation();
+  EXPECT_TRUE( bus.cartridge.IsSpeculating() );
+  bus.Write( 0x6000, 0x22 );
+  EXPECT_EQ( bus.Read( 0x6000 ), 0x22 );
+  EXPECT_EQ( SaveFileByte( savePath, 0 ), 0x11 );
+  ASSERT_TRUE( bus.LoadStateFromMemory( snapshot.data(), snapshot.size() ) );
+  bus.cartridge.EndSpeculation();
+  EXPECT_FALSE( bus.cartridge.IsSpeculating() );
+  EXPECT_EQ( bus.Read( 0x6000 ), 0x11 );
+  EXPECT_EQ( SaveFileByte( savePath, 0 ), 0x11 );
+
+  // Kept: ending writes PRG RAM as it is into the file
+  bus.cartridge.BeginSpeculation();
+  bus.Write( 0x6001, 0x33 );
+  EXPECT_EQ( SaveFileByte( savePath, 1 ), 0x00 );
+  bus.cartridge.EndSpeculation();
+  EXPECT_EQ( SaveFileByte( savePath, 1 ), 0x33 );
+  bus.Write( 0x6002, 0x44 );
+  EXPECT_EQ( SaveFileByte( savePath, 2 ), 0x44 );
+
+  // Run-ahead speculates around its extra frames only
+  RunAhead runAhead;
+  runAhead.frames = 2;
+  runAhead.RunFrame( bus );
+  EXPECT_TRUE( bus.cartridge.IsBatteryRamMapped() );
+  EXPECT_FALSE( bus.cartridge.IsSpeculating() );
+
+  // Rollback speculates for the whole session and only commits confirmed frames
+  {
+    auto [end0, end1] = LoopbackTransport::CreatePair();
+    RollbackSession session( bus, *end0, 0 );
+    EXPECT_TRUE( bus.cartridge.IsSpeculating() );
+    ASSERT_TRUE( session.AdvanceFrame( 0 ) ); // the peer hasn't sent anything, frame 0 is a guess
+    bus.Write( 0x6003, 0x55 );
+    session.Poll();
+    EXPECT_EQ( SaveFileByte( savePath, 3 ), 0x00 );
+  }
+  EXPECT_FALSE( bus.cartridge.IsSpeculating() );
+  EXPECT_EQ( SaveFileByte( savePath, 3 ), 0x55 );
+
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/palette.nes" );
+  std::error_code ec;
+  fs::remove( savePath, ec );
+  fs::remove( romPath, ec );
+}
+
+TEST( RomCacheTest, CartridgesShareOneImage )
+{
+  namespace fs = std::filesystem;
+  std::string const path = std::string( paths::roms() ) + "/nestest.nes";
+  std::size_t const loadedBefore = rom_cache::LoadedRoms();
+
+  {
+    auto first = std::make_unique<Bus>();
+    auto second = std::make_unique<Bus>();
+    first->cartridge.LoadRom( path );
+    second->cartridge.LoadRom( path );
+
+    auto const image = first->cartridge.GetRomImage();
+    ASSERT_NE( image, nullptr );
+    EXPECT_EQ( image, second->cartridge.GetRomImage() );
+    EXPECT_EQ( rom_cache::LoadedRoms(), loadedBefore + 1 );
+    EXPECT_EQ( first->cartridge.GetRomHash(), utils::GetRomHash( path ) );
+
+    // The image holds the file's PRG and CHR as they are on disk
+    std::ifstream   in( path, std::ios::binary );
+    std::vector<u8> rom( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+    ASSERT_EQ( rom.size(), 16 + image->Prg().size() + image->Chr().size() );
+    EXPECT_TRUE( std::equal( image->Prg().begin(), image->Prg().end(), rom.begin() + 16 ) );
+    EXPECT_EQ( first->cartridge.Read( 0xC000 ), rom[16] );
+
+    // A copy under another name is the same content, so the same image
+    fs::path const copyPath = fs::temp_directory_path() / "rom_cache_copy.nes";
+    fs::copy_file( path, copyPath, fs::copy_options::overwrite_existing );
+    Bus copy;
+    copy.cartridge.LoadRom( copyPath.string() );
+    EXPECT_EQ( copy.cartridge.GetRomImage(), image );
+    std::error_code ec;
+    fs::remove( copyPath, ec );
+
+    // Debug writes to CHR ROM stay private to the cartridge making them
+    u8 const original = second->cartridge.ReadChrROM( 0x0010 );
+    first->cartridge.SetChrROM( 0x0010, original ^ 0xFF );
+    EXPECT_EQ( first->cartridge.ReadChrROM( 0x0010 ), original ^ 0xFF );
+    EXPECT_EQ( second->cartridge.ReadChrROM( 0x0010 ), original );
+    EXPECT_EQ( image->Chr()[0x0010], original );
+  }
+
+  // Released with the last cartridge using it
+  EXPECT_EQ( rom_cache::LoadedRoms(), loadedBefore );
+}
+
+// A loaded image is a copy, truncating or rewriting the file in place can't change or break it
+TEST( RomCacheTest, ImageOutlivesChangesToTheFile )
+{
+  namespace fs = std::filesystem;
+  fs::path const romPath = fs::temp_directory_path() / "rom_cache_rewrite.nes";
+  fs::copy_file( std::string( paths::roms() ) + "/nestest.nes", romPath, fs::copy_options::overwrite_existing );
+
+  Bus bus;
+  bus.cartridge.LoadRom( romPath.string() );
+  auto const            image = bus.cartridge.GetRomImage();
+  std::vector<u8> const prg( image->Prg().begin(), image->Prg().end() );
+  std::string const     hash = image->Hash();
+  u8 const              resetLow = bus.cartridge.Read( 0xFFFC );
+
+  {
+    std::ofstream out( romPath, std::ios::binary | std::ios::trunc );
+    out.write( reinterpret_cast<const char *>( prg.data() ), 8 );
+  }
+  EXPECT_TRUE( std::equal( prg.begin(), prg.end(), image->Prg().begin(), image->Prg().end() ) );
+  EXPECT_EQ( image->Hash(), hash );
+  EXPECT_EQ( bus.cartridge.Read( 0xFFFC ), resetLow );
+
+  std::error_code ec;
+  fs::remove( romPath, ec );
+}
+
+TEST( RomCacheTest, PalettesAreParsedOnce )
+{
+  Bus first;
+  if ( first.ppu.failedPaletteRead ) {
+    GTEST_SKIP() << "Palette files not found";
+  }
+  std::size_t const parsed = rom_cache::LoadedPalettes();
+  Bus               second;
+  EXPECT_EQ( rom_cache::LoadedPalettes(), parsed );
+  EXPECT_EQ( first.ppu.nesPaletteRgbValues, second.ppu.nesPaletteRgbValues );
+  EXPECT_EQ( &rom_cache::AcquirePalette( PPU::SystemPalettePath( 0 ) ),
+             &rom_cache::AcquirePalette( PPU::SystemPalettePath( 0 ) ) );
+}
+
 int main( int argc, char **argv )
 {
   ::testing::InitGoogleTest( &argc, argv );
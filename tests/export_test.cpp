@@ -0,0 +1,253 @@
+#include "bus.h"
+#include "frame-export-layout.h"
+#include "frame-exporter.h"
+#include "frame-reader.h"
+#include "global-types.h"
+#include "paths.h"
+#include <gtest/gtest.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined( _WIN32 )
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+std::string Rom()
+{
+  return std::string( paths::roms() ) + "/nestest.nes";
+}
+
+std::unique_ptr<Bus> MakeBus()
+{
+  auto bus = std::make_unique<Bus>();
+  bus->apu.enable_synthesis( false );
+  bus->cartridge.LoadRom( Rom() );
+  bus->DebugReset();
+  return bus;
+}
+
+std::array<u8, 2> InputFor( u64 frame )
+{
+  return { static_cast<u8>( frame * 37 ), static_cast<u8>( frame * 11 ) };
+}
+
+void RunFrame( Bus &bus, u64 frame )
+{
+  auto const input = InputFor( frame );
+  bus.controller[0] = input[0];
+  bus.controller[1] = input[1];
+  bus.RunFrame();
+  bus.apu.end_frame();
+}
+} // namespace
+
+#if !defined( _WIN32 )
+
+// A producer process publishes frames while this one follows along through the reader and checks
+// every frame against its own emulator
+TEST( FrameExportTest, ReaderInAnotherProcessSeesEveryFrame )
+{
+  constexpr u64 frames = 30;
+  std::string const name = "/nes_export_test_" + std::to_string( getpid() );
+
+  // The producer keeps the ring alive until the consumer says it's done
+  int done[2];
+  ASSERT_EQ( pipe( done ), 0 );
+
+  pid_t const child = fork();
+  ASSERT_GE( child, 0 );
+  if ( child == 0 ) {
+    close( done[1] );
+    auto          bus = MakeBus();
+    FrameExporter exporter;
+    if ( !exporter.Open( name, FrameExporter::PixelFormat::PaletteIndex, 32 ) ) {
+      _exit( 1 );
+    }
+    exporter.Attach( *bus );
+    for ( u64 i = 0; i < frames; ++i ) {
+      RunFrame( *bus, i );
+      exporter.Publish( *bus );
+      // Give the consumer a chance to go to sleep on the futex
+      std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+    }
+    char byte = 0;
+    bool const acked = read( done[0], &byte, 1 ) == 1;
+    exporter.Close();
+    _exit( acked ? 0 : 2 );
+  }
+  close( done[0] );
+
+  FrameReader reader;
+  auto const  deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+  while ( !reader.Open( name ) && std::chrono::steady_clock::now() < deadline ) {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  ASSERT_TRUE( reader.IsOpen() );
+  EXPECT_EQ( reader.Format(), FrameReader::PixelFormat::PaletteIndex );
+  EXPECT_EQ( reader.SlotCount(), 32U );
+
+  auto            bus = MakeBus();
+  std::vector<u8> indices( frame_export::PixelBytes( FrameReader::PixelFormat::PaletteIndex ) );
+  bus->ppu.SetFrameOutput( nullptr, indices.data() );
+
+  FrameReader::Frame frame;
+  for ( u64 i = 0; i < frames; ++i ) {
+    ASSERT_TRUE( reader.WaitFor( i + 1, std::chrono::seconds( 10 ) ) ) << "frame " << i;
+    ASSERT_TRUE( reader.Read( i, frame ) ) << "frame " << i;
+    RunFrame( *bus, i );
+
+    EXPECT_EQ( frame.index, i );
+    EXPECT_EQ( frame.frame, bus->ppu.frame );
+    EXPECT_EQ( frame.input, InputFor( i ) );
+    EXPECT_EQ( frame.stateHash, bus->StateHash() ) << "frame " << i;
+    ASSERT_EQ( frame.pixelBytes, indices.size() );
+    EXPECT_EQ( std::memcmp( frame.pixels, indices.data(), indices.size() ), 0 ) << "frame " << i;
+
+    std::array<u8, frame_export::ramSize> ram{};
+    bus->GetRam().CopyTo( ram.data() );
+    EXPECT_EQ( std::memcmp( frame.ram, ram.data(), ram.size() ), 0 ) << "frame " << i;
+    EXPECT_TRUE( reader.IsIntact( frame ) );
+  }
+  EXPECT_TRUE( reader.Latest( frame ) );
+  EXPECT_EQ( frame.index, frames - 1 );
+
+  char const byte = 1;
+  EXPECT_EQ( write( done[1], &byte, 1 ), 1 );
+  close( done[1] );
+  int status = 0;
+  ASSERT_EQ( waitpid( child, &status, 0 ), child );
+  EXPECT_TRUE( WIFEXITED( status ) );
+  EXPECT_EQ( WEXITSTATUS( status ), 0 );
+
+  // Unlinked by the producer, the mapping stays readable until closed
+  EXPECT_TRUE( reader.Read( frames - 1, frame ) );
+  FrameReader late;
+  EXPECT_FALSE( late.Open( name ) );
+}
+
+// Frames the writer has lapped are refused instead of returning a newer frame's data
+TEST( FrameExportTest, OverwrittenFramesAreRejected )
+{
+  std::string const name = "/nes_export_test_lap_" + std::to_string( getpid() );
+  auto              bus = MakeBus();
+  FrameExporter     exporter;
+  ASSERT_TRUE( exporter.Open( name, FrameExporter::PixelFormat::Rgba, 4 ) );
+  exporter.Attach( *bus );
+
+  FrameReader reader;
+  ASSERT_TRUE( reader.Open( name ) );
+  FrameReader::Frame frame;
+  EXPECT_FALSE( reader.Latest( frame ) );
+  EXPECT_FALSE( reader.WaitFor( 1, std::chrono::milliseconds( 5 ) ) );
+
+  for ( u64 i = 0; i < 10; ++i ) {
+    RunFrame( *bus, i );
+    exporter.Publish( *bus );
+  }
+  EXPECT_EQ( reader.Published(), 10U );
+  EXPECT_FALSE( reader.Read( 5, frame ) );
+  EXPECT_FALSE( reader.Read( 10, frame ) );
+  ASSERT_TRUE( reader.Read( 6, frame ) );
+  EXPECT_EQ( frame.input, InputFor( 6 ) );
+  ASSERT_TRUE( reader.Read( 9, frame ) );
+  EXPECT_EQ( frame.pixelBytes, frame_export::PixelBytes( FrameReader::PixelFormat::Rgba ) );
+  EXPECT_EQ( std::memcmp( frame.pixels, bus->ppu.GetFrameOutput(), frame.pixelBytes ), 0 );
+
+  // Once slot 9 % 4 is reused, a view taken earlier reports itself torn
+  RunFrame( *bus, 10 );
+  exporter.Publish( *bus );
+  RunFrame( *bus, 11 );
+  exporter.Publish( *bus );
+  RunFrame( *bus, 12 );
+  exporter.Publish( *bus );
+  RunFrame( *bus, 13 );
+  exporter.Publish( *bus );
+  EXPECT_FALSE( reader.IsIntact( frame ) );
+}
+
+// A reader killed while asleep in WaitFor() stays counted as a waiter forever. The writer stops
+// paying a wake per frame for it, and still wakes readers that are alive.
+TEST( FrameExportTest, DeadWaiterStopsCostingWakes )
+{
+  std::string const        name = "/nes_export_test_dead_" + std::to_string( getpid() );
+  auto                     bus = MakeBus();
+  FrameExporter            exporter;
+  std::vector<std::string> log;
+  exporter.logSink = [&log]( const std::string &message ) { log.push_back( message ); };
+  ASSERT_TRUE( exporter.Open( name, FrameExporter::PixelFormat::PaletteIndex, 4 ) );
+  exporter.Attach( *bus );
+
+  pid_t const child = fork();
+  ASSERT_GE( child, 0 );
+  if ( child == 0 ) {
+    FrameReader reader;
+    if ( reader.Open( name ) ) {
+      (void) reader.WaitFor( 1000, std::chrono::seconds( 30 ) );
+    }
+    _exit( 0 );
+  }
+  auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+  while ( exporter.Waiters() == 0 && std::chrono::steady_clock::now() < deadline ) {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  ASSERT_EQ( exporter.Waiters(), 1U );
+  kill( child, SIGKILL );
+  int status = 0;
+  waitpid( child, &status, 0 );
+
+  u64 frame = 0;
+  for ( ; frame < 200; ++frame ) {
+    RunFrame( *bus, frame );
+    exporter.Publish( *bus );
+  }
+  EXPECT_EQ( exporter.Waiters(), 1U );
+  u64 const wakes = exporter.WakeCalls();
+  EXPECT_GT( wakes, 0U );
+  EXPECT_LT( wakes, 200U );
+  for ( ; frame < 300; ++frame ) {
+    RunFrame( *bus, frame );
+    exporter.Publish( *bus );
+  }
+  EXPECT_EQ( exporter.WakeCalls(), wakes );
+
+  // A live reader asleep on top of the dead one is woken by the next publish, not its timeout
+  FrameReader reader;
+  ASSERT_TRUE( reader.Open( name ) );
+  bool       woken = false;
+  auto const begin = std::chrono::steady_clock::now();
+  std::thread waiter( [&] { woken = reader.WaitFor( frame + 1, std::chrono::seconds( 20 ) ); } );
+  while ( exporter.Waiters() < 2 && std::chrono::steady_clock::now() < begin + std::chrono::seconds( 10 ) ) {
+    std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+  }
+  RunFrame( *bus, frame );
+  exporter.Publish( *bus );
+  waiter.join();
+  EXPECT_TRUE( woken );
+  EXPECT_LT( std::chrono::steady_clock::now() - begin, std::chrono::seconds( 10 ) );
+  EXPECT_EQ( exporter.WakeCalls(), wakes + 1 );
+  EXPECT_TRUE( log.empty() );
+
+  // Errors go to the sink instead of stdout
+  EXPECT_FALSE( exporter.Open( name, FrameExporter::PixelFormat::Rgba, 0 ) );
+  ASSERT_EQ( log.size(), 1U );
+  EXPECT_EQ( log[0], "FrameExporter: need at least one slot" );
+}
+
+#endif
+
+int main( int argc, char **argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
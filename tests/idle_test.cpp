@@ -0,0 +1,91 @@
+#include "bus.h"
+#include "global-types.h"
+#include "paths.h"
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::unique_ptr<Bus> MakeBus( const std::string &rom, bool idleSkip )
+{
+  auto bus = std::make_unique<Bus>();
+  bus->apu.enable_synthesis( false );
+  bus->idleLoop.enabled = idleSkip;
+  bus->cartridge.LoadRom( std::string( paths::roms() ) + "/" + rom );
+  bus->DebugReset();
+  return bus;
+}
+
+void RunFrame( Bus &bus, int frame )
+{
+  // Start pressed now and then, so the menus move on from their wait loops
+  bus.controller[0] = ( frame % 90 ) < 4 ? 0x10 : 0x00;
+  bus.RunFrame();
+  bus.apu.end_frame();
+}
+} // namespace
+
+// Fast-forwarding idle loops must not change anything the interpreter would have done
+TEST( IdleLoopTest, SkippingMatchesInterpreter )
+{
+  for ( std::string const rom : { "nestest.nes", "custom.nes", "palette.nes", "color_test.nes", "scanline.nes" } ) {
+    SCOPED_TRACE( rom );
+    auto skipping = MakeBus( rom, true );
+    auto interpreting = MakeBus( rom, false );
+
+    for ( int frame = 0; frame < 240; ++frame ) {
+      RunFrame( *skipping, frame );
+      RunFrame( *interpreting, frame );
+      ASSERT_EQ( skipping->cpu.GetCycles(), interpreting->cpu.GetCycles() ) << "frame " << frame;
+      ASSERT_EQ( skipping->StateHash(), interpreting->StateHash() ) << "frame " << frame;
+    }
+
+    std::vector<u8> skippingState;
+    std::vector<u8> interpretingState;
+    skipping->SaveStateToMemory( skippingState );
+    interpreting->SaveStateToMemory( interpretingState );
+    EXPECT_EQ( skippingState, interpretingState );
+    EXPECT_EQ( interpreting->idleLoop.Stats().replayedCycles, 0U );
+  }
+}
+
+// nestest's menu waits for the NMI in a loop that polls RAM
+TEST( IdleLoopTest, FindsIdleLoops )
+{
+  auto bus = MakeBus( "nestest.nes", true );
+  for ( int frame = 0; frame < 120; ++frame ) {
+    RunFrame( *bus, frame );
+  }
+  IdleLoopStats const &stats = bus->idleLoop.Stats();
+  EXPECT_GT( stats.loops, 0U );
+  EXPECT_GT( stats.ReplayedShare( bus->cpu.GetCycles() ), 0.1 );
+  EXPECT_LT( stats.ReplayedShare( bus->cpu.GetCycles() ), 1.0 );
+}
+
+// A state loaded in the middle of an idle loop carries on exactly like the bus it came from
+TEST( IdleLoopTest, StateLoadsInsideLoops )
+{
+  auto source = MakeBus( "nestest.nes", true );
+  for ( int frame = 0; frame < 60; ++frame ) {
+    RunFrame( *source, frame );
+  }
+  std::vector<u8> state;
+  source->SaveStateToMemory( state );
+  auto loaded = MakeBus( "nestest.nes", true );
+  ASSERT_TRUE( loaded->LoadStateFromMemory( state.data(), state.size() ) );
+
+  for ( int frame = 60; frame < 120; ++frame ) {
+    RunFrame( *source, frame );
+    RunFrame( *loaded, frame );
+    ASSERT_EQ( source->StateHash(), loaded->StateHash() ) << "frame " << frame;
+  }
+}
+
+int main( int argc, char **argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
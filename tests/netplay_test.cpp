@@ -0,0 +1,158 @@
+#include "bus.h"
+#include "net-transport.h"
+#include "paths.h"
+#include "rollback.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+class NetplayTest : public ::testing::Test
+{
+protected:
+  static constexpr u32 frameCount = 120;
+
+  Bus peer0;
+  Bus peer1;
+  Bus reference; // runs the same inputs without netplay
+
+  NetplayTest()
+  {
+    std::string romFile = std::string( paths::roms() ) + "/nestest.nes";
+    for ( Bus *bus : { &peer0, &peer1, &reference } ) {
+      bus->cartridge.LoadRom( romFile );
+      bus->cpu.Reset();
+    }
+  }
+
+  // Scripted input that changes every few frames, different per player
+  static u8 InputFor( int player, u32 frame ) { return static_cast<u8>( ( ( frame / 7 ) + ( player * 3 ) ) * 37 ); }
+
+  u64 ReferenceHash( u32 frames )
+  {
+    for ( u32 frame = 0; frame < frames; ++frame ) {
+      reference.controller[0] = InputFor( 0, frame );
+      reference.controller[1] = InputFor( 1, frame );
+      reference.RunFrame();
+      reference.apu.end_frame();
+    }
+    return reference.StateHash();
+  }
+
+  // Runs both sessions to frameCount, then polls until every input is confirmed.
+  // tick is called once per round, to advance fake clocks or give sockets time.
+  template <class Tick> void RunSessions( RollbackSession &a, RollbackSession &b, Tick tick )
+  {
+    for ( int round = 0; round < 5000; ++round ) {
+      bool const done = a.Frame() >= frameCount && b.Frame() >= frameCount &&
+                        a.Stats().confirmedFrame == frameCount && b.Stats().confirmedFrame == frameCount;
+      if ( done ) {
+        return;
+      }
+      for ( auto [session, player] : { std::pair{ &a, 0 }, std::pair{ &b, 1 } } ) {
+        if ( session->Frame() < frameCount ) {
+          session->AdvanceFrame( InputFor( player, session->Frame() ) );
+        } else {
+          session->Poll();
+        }
+      }
+      tick();
+    }
+    FAIL() << "sessions never converged";
+  }
+};
+
+TEST_F( NetplayTest, LoopbackNoLatency )
+{
+  auto [end0, end1] = LoopbackTransport::CreatePair();
+  RollbackSession a( peer0, *end0, 0 );
+  RollbackSession b( peer1, *end1, 1 );
+  RunSessions( a, b, [] {} );
+
+  u64 const expected = ReferenceHash( frameCount );
+  EXPECT_EQ( peer0.StateHash(), expected );
+  EXPECT_EQ( peer1.StateHash(), expected );
+}
+
+TEST_F( NetplayTest, LoopbackWithLatencyAndJitter )
+{
+  auto [end0, end1] = LoopbackTransport::CreatePair();
+  LatencyTransport lag0( *end0, 50ms, 30ms, 1 );
+  LatencyTransport lag1( *end1, 50ms, 30ms, 2 );
+
+  // One fake clock, advanced a frame per round
+  auto now = LatencyTransport::Clock::now();
+  lag0.now = [&] { return now; };
+  lag1.now = [&] { return now; };
+
+  RollbackSession a( peer0, lag0, 0 );
+  RollbackSession b( peer1, lag1, 1 );
+  RunSessions( a, b, [&] { now += 16ms; } );
+
+  // Mispredictions were corrected, and both sides ended up where a local game would be
+  u64 const expected = ReferenceHash( frameCount );
+  EXPECT_EQ( peer0.StateHash(), expected );
+  EXPECT_EQ( peer1.StateHash(), expected );
+
+  EXPECT_GT( a.Stats().rollbacks, 0 );
+  EXPECT_GT( b.Stats().rollbacks, 0 );
+  EXPECT_GE( a.Stats().resimulatedFrames, a.Stats().rollbacks );
+  EXPECT_EQ( a.Stats().frames, frameCount );
+  EXPECT_GT( a.Stats().rollbacksPerSecond, 0.0 );
+}
+
+TEST_F( NetplayTest, UdpLocalhost )
+{
+  UdpTransport udp0;
+  UdpTransport udp1;
+  if ( !udp0.Open( 0 ) || !udp1.Open( 0 ) ) {
+    GTEST_SKIP() << "UDP sockets not available";
+  }
+  udp0.SetRemote( "127.0.0.1", udp1.LocalPort() );
+  udp1.SetRemote( "127.0.0.1", udp0.LocalPort() );
+
+  RollbackSession a( peer0, udp0, 0 );
+  RollbackSession b( peer1, udp1, 1 );
+  RunSessions( a, b, [] { std::this_thread::sleep_for( 100us ); } );
+
+  u64 const expected = ReferenceHash( frameCount );
+  EXPECT_EQ( peer0.StateHash(), expected );
+  EXPECT_EQ( peer1.StateHash(), expected );
+}
+
+TEST( LatencyTransportTest, DelaysAndReorders )
+{
+  auto [end0, end1] = LoopbackTransport::CreatePair();
+  LatencyTransport lagged( *end1, 40ms, 20ms, 7 );
+  auto             now = LatencyTransport::Clock::now();
+  lagged.now = [&] { return now; };
+
+  for ( u8 i = 0; i < 20; ++i ) {
+    end0->Send( { i } );
+  }
+
+  std::vector<u8> packet;
+  EXPECT_FALSE( lagged.Receive( packet ) ); // nothing before the base latency
+  now += 39ms;
+  EXPECT_FALSE( lagged.Receive( packet ) );
+
+  now += 30ms; // past latency + jitter, everything is due
+  std::vector<u8> order;
+  while ( lagged.Receive( packet ) ) {
+    order.push_back( packet[0] );
+  }
+  ASSERT_EQ( order.size(), 20 );
+  EXPECT_FALSE( std::ranges::is_sorted( order ) ); // jitter shuffled them
+}
+
+int main( int argc, char **argv )
+{
+  ::testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,244 @@
+#include "bus.h"
+#include "emulator-pool.h"
+#include "global-types.h"
+#include "paths.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+std::string Rom()
+{
+  return std::string( paths::roms() ) + "/nestest.nes";
+}
+
+// Random pad bytes per frame and instance, the same for the pool and the serial reference
+std::vector<std::vector<EmulatorPool::Input>> MakeInputs( std::size_t frames, std::size_t instances )
+{
+  std::mt19937                                  rng( 1234 );
+  std::vector<std::vector<EmulatorPool::Input>> inputs( frames );
+  for ( auto &frame : inputs ) {
+    frame.resize( instances );
+    for ( auto &pads : frame ) {
+      pads = { static_cast<u8>( rng() ), static_cast<u8>( rng() ) };
+    }
+  }
+  return inputs;
+}
+
+// palette.nes with the battery bit set, so it would normally get a save file
+std::filesystem::path WriteBatteryRom( const std::string &name )
+{
+  std::ifstream   in( std::string( paths::roms() ) + "/palette.nes", std::ios::binary );
+  std::vector<u8> rom( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+  if ( rom.size() <= 16 ) {
+    return {};
+  }
+  rom[6] |= 0x02;
+  rom.back() ^= 0xC3; // a game, and save file, no other test uses
+  std::filesystem::path const romPath = std::filesystem::temp_directory_path() / name;
+  std::ofstream               out( romPath, std::ios::binary | std::ios::trunc );
+  out.write( reinterpret_cast<const char *>( rom.data() ), static_cast<std::streamsize>( rom.size() ) );
+  return romPath;
+}
+} // namespace
+
+// Each instance ends up exactly where a Bus stepped alone on this thread would
+TEST( EmulatorPoolTest, ParallelMatchesSerial )
+{
+  constexpr std::size_t instances = 8;
+  constexpr std::size_t frames = 30;
+  auto const            inputs = MakeInputs( frames, instances );
+
+  EmulatorPool pool( instances, 4 );
+  pool.LoadRom( Rom() );
+  for ( auto const &frame : inputs ) {
+    pool.StepFrame( frame );
+  }
+
+  for ( std::size_t i = 0; i < instances; ++i ) {
+    auto bus = std::make_unique<Bus>();
+    bus->apu.enable_synthesis( false );
+    bus->cartridge.LoadRom( Rom() );
+    bus->DebugReset();
+    for ( auto const &frame : inputs ) {
+      bus->controller[0] = frame[i][0];
+      bus->controller[1] = frame[i][1];
+      bus->RunFrame();
+      bus->apu.end_frame();
+    }
+    EXPECT_EQ( pool.Instance( i ).StateHash(), bus->StateHash() ) << "instance " << i;
+    EXPECT_EQ( pool.Instance( i ).ppu.frame, bus->ppu.frame ) << "instance " << i;
+  }
+}
+
+TEST( EmulatorPoolTest, AffinityKeepsInstanceOnItsWorker )
+{
+  EmulatorPool pool( 6, 3 );
+  pool.LoadRom( Rom() );
+  pool.SetAffinity( 0, 2 );
+  pool.SetAffinity( 5, 1 );
+  EXPECT_EQ( pool.LastWorker( 0 ), -1 );
+
+  for ( int step = 0; step < 10; ++step ) {
+    pool.StepFrame();
+    EXPECT_EQ( pool.LastWorker( 0 ), 2 );
+    EXPECT_EQ( pool.LastWorker( 5 ), 1 );
+  }
+  EXPECT_THROW( pool.SetAffinity( 1, 3 ), std::runtime_error );
+}
+
+TEST( EmulatorPoolTest, AsyncStepCompletesAndCounts )
+{
+  constexpr std::size_t instances = 5;
+  EmulatorPool          pool( instances, 2 );
+  pool.LoadRom( Rom() );
+
+  std::atomic<int> completions{ 0 };
+  for ( int step = 0; step < 4; ++step ) {
+    pool.StepFrameAsync( {}, [&] { ++completions; } );
+  }
+  pool.Wait();
+  EXPECT_FALSE( pool.IsBusy() );
+  EXPECT_EQ( completions.load(), 4 );
+
+  auto const metrics = pool.GetMetrics();
+  EXPECT_EQ( metrics.frames, instances * 4 );
+  EXPECT_EQ( metrics.threads, 2U );
+  EXPECT_GT( metrics.cpuCycles, 0U );
+  EXPECT_GT( metrics.FramesPerSecond(), 0.0 );
+  EXPECT_LE( metrics.Utilization(), 1.01 );
+
+  pool.ResetMetrics();
+  EXPECT_EQ( pool.GetMetrics().frames, 0U );
+
+  std::vector<EmulatorPool::Input> const wrongSize( instances + 1 );
+  EXPECT_THROW( pool.StepFrame( wrongSize ), std::runtime_error );
+}
+
+// Battery backed PRG RAM belongs to each instance alone, and the game's save file is left alone
+TEST( EmulatorPoolTest, BatteryRamIsPrivate )
+{
+  namespace fs = std::filesystem;
+  fs::path const romPath = WriteBatteryRom( "pool_battery_test.nes" );
+  ASSERT_FALSE( romPath.empty() );
+
+  constexpr std::size_t instances = 4;
+  fs::path              savePath;
+  {
+    EmulatorPool pool( instances, 2 );
+    pool.LoadRom( romPath.string() );
+    savePath = fs::path( paths::saves() ) / pool.Instance( 0 ).cartridge.GetRomHash();
+    fs::remove( savePath );
+
+    for ( std::size_t i = 0; i < instances; ++i ) {
+      EXPECT_FALSE( pool.Instance( i ).cartridge.IsBatteryRamMapped() ) << "instance " << i;
+      pool.Instance( i ).Write( 0x6000, static_cast<u8>( 0x10 + i ) );
+    }
+    pool.StepFrame();
+    pool.Instance( 0 ).PowerCycle();
+    pool.Instance( 2 ).Write( 0x6000, 0x99 );
+    for ( std::size_t i = 0; i < instances; ++i ) {
+      u8 const expected = i == 2 ? 0x99 : static_cast<u8>( 0x10 + i );
+      EXPECT_EQ( pool.Instance( i ).Read( 0x6000 ), expected ) << "instance " << i;
+    }
+  }
+  EXPECT_FALSE( fs::exists( savePath ) );
+
+  // An existing save is neither loaded nor written
+  std::vector<u8> const save( 8192, 0x5A );
+  {
+    std::ofstream out( savePath, std::ios::binary | std::ios::trunc );
+    out.write( reinterpret_cast<const char *>( save.data() ), static_cast<std::streamsize>( save.size() ) );
+  }
+  auto const saveTime = fs::last_write_time( savePath );
+  {
+    EmulatorPool pool( 2, 1 );
+    pool.LoadRom( romPath.string() );
+    EXPECT_NE( pool.Instance( 0 ).Read( 0x6000 ), 0x5A );
+    pool.Instance( 0 ).Write( 0x6000, 0x01 );
+    pool.Instance( 1 ).PowerCycle();
+    pool.StepFrame();
+  }
+  std::ifstream   in( savePath, std::ios::binary );
+  std::vector<u8> contents( ( std::istreambuf_iterator<char>( in ) ), std::istreambuf_iterator<char>() );
+  EXPECT_EQ( contents, save );
+  EXPECT_EQ( fs::last_write_time( savePath ), saveTime );
+
+  fs::remove( savePath );
+  fs::remove( romPath );
+}
+
+// Messages go to the instance that logged them, not to stdout or a neighbour
+TEST( EmulatorPoolTest, LogsArePerInstance )
+{
+  EmulatorPool pool( 4, 2 );
+  pool.LoadRom( Rom() );
+  pool.StepFrame();
+  for ( std::size_t i = 0; i < pool.Size(); ++i ) {
+    pool.TakeLog( i );
+  }
+
+  (void) pool.Instance( 3 ).Read( 0x4018 );
+  for ( std::size_t i = 0; i < 3; ++i ) {
+    EXPECT_TRUE( pool.TakeLog( i ).empty() ) << "instance " << i;
+  }
+  auto const log = pool.TakeLog( 3 );
+  ASSERT_EQ( log.size(), 1U );
+  EXPECT_EQ( log[0], "Unhandled read from address: 4018" );
+  EXPECT_TRUE( pool.TakeLog( 3 ).empty() );
+
+  for ( std::size_t i = 0; i < EmulatorPool::maxLogLines + 10; ++i ) {
+    (void) pool.Instance( 0 ).Read( 0x4018 );
+  }
+  EXPECT_EQ( pool.TakeLog( 0 ).size(), EmulatorPool::maxLogLines );
+}
+
+// Instances can render into caller owned buffers, and the hook sees every instance each step
+TEST( EmulatorPoolTest, FrameHookAndExternalOutput )
+{
+  constexpr std::size_t instances = 3;
+  constexpr std::size_t pixels = PPU::gBufferSize;
+  EmulatorPool          pool( instances, 2 );
+  std::vector<u32>      frames( instances * pixels );
+  std::vector<u8>       indices( instances * pixels );
+  for ( std::size_t i = 0; i < instances; ++i ) {
+    pool.Instance( i ).ppu.SetFrameOutput( &frames[i * pixels], &indices[i * pixels] );
+  }
+  std::vector<std::atomic<int>> hooked( instances );
+  pool.SetFrameHook( [&]( std::size_t instance, Bus & ) { ++hooked[instance]; } );
+
+  pool.LoadRom( Rom() );
+  for ( int step = 0; step < 5; ++step ) {
+    pool.StepFrame();
+  }
+
+  for ( std::size_t i = 0; i < instances; ++i ) {
+    EXPECT_EQ( hooked[i].load(), 5 ) << "instance " << i;
+    PPU const &ppu = pool.Instance( i ).ppu;
+    EXPECT_EQ( ppu.GetFrameOutput(), &frames[i * pixels] );
+    for ( std::size_t p = i * pixels; p < ( i + 1 ) * pixels; ++p ) {
+      ASSERT_EQ( frames[p], ppu.GetMasterPaletteColor( indices[p] ) ) << "pixel " << p;
+    }
+    // The internal buffer isn't drawn to while redirected
+    EXPECT_EQ( ppu.frameBuffer[( 120 * 256 ) + 128], 0U );
+  }
+  EXPECT_NE( std::ranges::count( indices, indices[0] ), static_cast<long>( indices.size() ) );
+}
+
+int main( int argc, char **argv )
+{
+  ::testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
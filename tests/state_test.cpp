@@ -1,9 +1,18 @@
 #include "bus.h"
 #include "cartridge.h"
+#include "movie.h"
 #include "paths.h"
+#include "run-ahead.h"
 #include <fmt/base.h>
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include <cereal/cereal.hpp>
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/string.hpp>
@@ -17,17 +26,32 @@ protected:
   CPU       &cpu = bus.cpu;
   Cartridge &cartridge = bus.cartridge;
 
+  // Quick save slots go here instead of the user's own states directory. One directory per test,
+  // ctest runs the tests in parallel and each removes its directory when done.
+  std::filesystem::path statesDir =
+      std::filesystem::temp_directory_path() /
+      ( std::string( "state_test_states_" ) + ::testing::UnitTest::GetInstance()->current_test_info()->name() );
+
   StateTest()
   {
     std::string romFile = std::string( paths::roms() ) + "/palette.nes";
     cartridge.LoadRom( romFile );
     bus.cpu.Reset();
+    bus.statesDir = statesDir.string();
+  }
+
+  ~StateTest() override
+  {
+    bus.saveWriter.Flush();
+    std::error_code ec;
+    std::filesystem::remove_all( statesDir, ec );
   }
 };
 
 TEST_F( StateTest, CpuState )
 {
   // ─── Run a few clock cycles ───────────────────────────────────────────────
+  cpu.EnableTracelog();
   for ( int i = 0; i < 10; ++i )
     bus.Clock();
 
@@ -50,8 +74,6 @@ TEST_F( StateTest, CpuState )
   auto traceEnabled = cpu.traceEnabled;
   auto mesenFormatTraceEnabled = cpu.mesenFormatTraceEnabled;
   auto didMesenTrace = cpu.didMesenTrace;
-  auto traceLog = cpu.traceLog;
-  auto mesenFormatTraceLog = cpu.mesenFormatTraceLog;
 
   // ─── Serialize to an in‐memory buffer ──────────────────────────────────────
   std::stringstream ss( std::ios::binary | std::ios::in | std::ios::out );
@@ -64,6 +86,8 @@ TEST_F( StateTest, CpuState )
   for ( int i = 0; i < 10; ++i )
     bus.Clock();
 
+  TraceRing const traceLog = cpu.GetTracelog();
+
   // rewind & clear before reading
   ss.clear();
   ss.seekg( 0 );
@@ -92,9 +116,7 @@ TEST_F( StateTest, CpuState )
   X( isTestMode )                                                                                                      \
   X( traceEnabled )                                                                                                    \
   X( mesenFormatTraceEnabled )                                                                                         \
-  X( didMesenTrace )                                                                                                   \
-  X( traceLog )                                                                                                        \
-  X( mesenFormatTraceLog )
+  X( didMesenTrace )
 
 #define X( field ) EXPECT_EQ( field, cpu.field );
   CPU_FIELDS
@@ -118,6 +140,12 @@ TEST_F( StateTest, CpuState )
   CPU_FIELDS
 #undef X
 #undef CPU_FIELDS
+
+  // The trace logs are the debugger's history, not machine state, and stay out of the archive
+  EXPECT_FALSE( traceLog.Empty() );
+  EXPECT_EQ( cpu.GetTracelog(), traceLog );
+  EXPECT_TRUE( cpu2.GetTracelog().Empty() );
+  EXPECT_TRUE( cpu2.GetMesenFormatTracelog().Empty() );
 }
 
 TEST_F( StateTest, BusState )
@@ -151,6 +179,319 @@ TEST_F( StateTest, BusState )
   EXPECT_EQ( oamFirstEntryY, ppu.oam.entries.at( 0 ).y );
 }
 
+TEST_F( StateTest, CompressionRoundTrip )
+{
+  std::vector<u8> raw;
+  bus.SaveStateToMemory( raw );
+  ASSERT_FALSE( raw.empty() );
+
+  std::vector<u8> packed;
+  SaveWriter::Compress( raw, packed );
+  EXPECT_TRUE( SaveWriter::IsCompressed( packed.data(), packed.size() ) );
+  EXPECT_LT( packed.size(), raw.size() );
+
+  std::vector<u8> unpacked;
+  ASSERT_TRUE( SaveWriter::Decompress( packed.data(), packed.size(), unpacked ) );
+  EXPECT_EQ( raw, unpacked );
+
+  // Literal heavy input, no runs at all
+  std::vector<u8> noise( 1000 );
+  for ( std::size_t i = 0; i < noise.size(); ++i )
+    noise[i] = static_cast<u8>( ( i * 37 ) ^ ( i >> 3 ) );
+  SaveWriter::Compress( noise, packed );
+  ASSERT_TRUE( SaveWriter::Decompress( packed.data(), packed.size(), unpacked ) );
+  EXPECT_EQ( noise, unpacked );
+}
+
+TEST_F( StateTest, StateFormatVersionIsChecked )
+{
+  for ( int i = 0; i < 1000; ++i )
+    bus.Clock();
+  std::vector<u8> state;
+  bus.SaveStateToMemory( state );
+  ASSERT_GT( state.size(), 8 );
+  for ( int i = 0; i < 1000; ++i )
+    bus.Clock();
+  u64 const hash = bus.StateHash( false );
+
+  std::vector<std::string> messages;
+  bus.logSink = [&]( const std::string &message ) { messages.push_back( message ); };
+
+  // Laid out like the states from before the format version: no header
+  std::vector<u8> const unversioned( state.begin() + 8, state.end() );
+  EXPECT_FALSE( bus.LoadStateFromMemory( unversioned.data(), unversioned.size() ) );
+  ASSERT_EQ( messages.size(), 1 );
+  EXPECT_NE( messages.back().find( "before states had a format version" ), std::string::npos ) << messages.back();
+
+  // A format this build doesn't know
+  std::vector<u8> newer = state;
+  newer[4] = static_cast<u8>( Bus::stateVersion + 1 );
+  EXPECT_FALSE( bus.LoadStateFromMemory( newer.data(), newer.size() ) );
+  ASSERT_EQ( messages.size(), 2 );
+  EXPECT_NE( messages.back().find( "format version " + std::to_string( Bus::stateVersion + 1 ) ), std::string::npos )
+      << messages.back();
+
+  // Neither touched the machine
+  EXPECT_EQ( bus.StateHash( false ), hash );
+  EXPECT_TRUE( bus.LoadStateFromMemory( state.data(), state.size() ) );
+  EXPECT_NE( bus.StateHash( false ), hash );
+  bus.logSink = nullptr;
+}
+
+TEST_F( StateTest, AsyncQuickSave )
+{
+  namespace fs = std::filesystem;
+
+  for ( int i = 0; i < 1000; ++i )
+    bus.Clock();
+  auto cpuCycle = cpu.cycles;
+  auto pc = cpu.pc;
+
+  bus.QuickSaveState( 9 );
+  bus.saveWriter.Flush();
+  EXPECT_EQ( bus.saveWriter.PendingCount(), 0 );
+  EXPECT_TRUE( bus.DoesSaveSlotExist( 9 ) );
+
+  auto results = bus.saveWriter.TakeResults();
+  ASSERT_EQ( results.size(), 1 );
+  EXPECT_TRUE( results[0].ok );
+  EXPECT_EQ( results[0].message, "State saved to slot 9." );
+
+  for ( int i = 0; i < 1000; ++i )
+    bus.Clock();
+  bus.QuickLoadState( 9 );
+  EXPECT_EQ( cpuCycle, cpu.cycles );
+  EXPECT_EQ( pc, cpu.pc );
+  EXPECT_TRUE( fs::exists( statesDir / bus.cartridge.GetRomHash() / ( "save_slot9" + bus.statefileExt ) ) );
+}
+
+TEST_F( StateTest, MovieRoundTrip )
+{
+  namespace fs = std::filesystem;
+  fs::path const moviePath = fs::temp_directory_path() / "state_test.nesmovie";
+
+  Movie recorder;
+  recorder.StartRecording( bus, MovieStart::PowerOn, true );
+  for ( int i = 0; i < 120; ++i ) {
+    bus.controller[0] = static_cast<u8>( i * 7 );
+    bus.controller[1] = static_cast<u8>( i >> 2 );
+    if ( i == 60 ) {
+      recorder.QueueEvent( MovieEvent::Reset );
+    }
+    recorder.RunFrame( bus );
+  }
+  u64 const finalHash = Movie::HashState( bus );
+  ASSERT_TRUE( recorder.StopRecording( moviePath.string() ) );
+
+  // Play back on a machine that has been running something else in the meantime
+  for ( int i = 0; i < 10; ++i )
+    bus.RunFrame();
+
+  Movie player;
+  ASSERT_TRUE( player.Load( moviePath.string() ) );
+  ASSERT_TRUE( player.StartPlayback( bus ) );
+  EXPECT_EQ( player.FrameCount(), 120 );
+  while ( player.RunFrame( bus ) ) {
+  }
+  EXPECT_FALSE( player.Desynced() );
+  EXPECT_TRUE( player.Finished() );
+  EXPECT_EQ( Movie::HashState( bus ), finalHash );
+
+  // Tampering with the recorded hash of a frame is caught on that exact frame
+  std::vector<u8> file;
+  {
+    std::ifstream in( moviePath, std::ios::binary );
+    file.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+  }
+  file[file.size() - ( 11 * 20 ) + 3] ^= 0xFF; // hash of frame 100
+  {
+    std::ofstream out( moviePath, std::ios::binary | std::ios::trunc );
+    out.write( reinterpret_cast<const char *>( file.data() ), static_cast<std::streamsize>( file.size() ) );
+  }
+  ASSERT_TRUE( player.Load( moviePath.string() ) );
+  ASSERT_TRUE( player.StartPlayback( bus ) );
+  while ( player.RunFrame( bus ) ) {
+  }
+  EXPECT_EQ( player.DesyncFrame(), 100 );
+
+  // An event byte that isn't a MovieEvent fails the load, and the loaded movie stays as it was
+  file[file.size() - ( 11 * 70 ) + 2] = 0x07; // event of frame 50
+  {
+    std::ofstream out( moviePath, std::ios::binary | std::ios::trunc );
+    out.write( reinterpret_cast<const char *>( file.data() ), static_cast<std::streamsize>( file.size() ) );
+  }
+  EXPECT_FALSE( player.Load( moviePath.string() ) );
+  EXPECT_EQ( player.FrameCount(), 120 );
+
+  std::error_code ec;
+  fs::remove( moviePath, ec );
+}
+
+TEST_F( StateTest, StateHash )
+{
+  // The incremental hash must always agree with a full rehash
+  for ( int i = 0; i < 30; ++i ) {
+    bus.RunFrame();
+    u64 const incremental = bus.StateHash();
+    EXPECT_EQ( incremental, bus.StateHash( false ) ) << "frame " << i;
+  }
+
+  // Tracked writes change the hash, and restoring the byte restores it
+  u64 const before = bus.StateHash();
+  u8 const  old = bus.Read( 0x0123 );
+  bus.Write( 0x0123, old ^ 0x5A );
+  EXPECT_NE( bus.StateHash(), before );
+  bus.Write( 0x0123, old );
+  EXPECT_EQ( bus.StateHash(), before );
+
+  // Loading a state brings back the same hash
+  std::vector<u8> snapshot;
+  bus.SaveStateToMemory( snapshot );
+  for ( int i = 0; i < 5; ++i )
+    bus.RunFrame();
+  EXPECT_NE( bus.StateHash(), before );
+  ASSERT_TRUE( bus.LoadStateFromMemory( snapshot.data(), snapshot.size() ) );
+  EXPECT_EQ( bus.StateHash(), before );
+
+  // Single bit flips in a hashed page are caught
+  u64 const base = statehash::HashBytes( snapshot.data(), 256 );
+  snapshot[200] ^= 0x01;
+  EXPECT_NE( statehash::HashBytes( snapshot.data(), 256 ), base );
+}
+
+TEST_F( StateTest, RunAheadMatchesPlainRun )
+{
+  // A second machine runs the same rom without run-ahead
+  Bus plain;
+  plain.cartridge.LoadRom( std::string( paths::roms() ) + "/palette.nes" );
+  plain.cpu.Reset();
+
+  std::vector<std::vector<u32>> plainFrames;
+  plain.ppu.onFrameReady = [&]( const u32 *fb ) { plainFrames.emplace_back( fb, fb + PPU::gBufferSize ); };
+  std::vector<std::vector<u32>> presented;
+  bus.ppu.onFrameReady = [&]( const u32 *fb ) { presented.emplace_back( fb, fb + PPU::gBufferSize ); };
+
+  RunAhead runAhead;
+  runAhead.frames = 2;
+  for ( int i = 0; i < 20; ++i ) {
+    runAhead.RunFrame( bus );
+    plain.RunFrame();
+    // Speculative frames never leak into the real machine state
+    ASSERT_EQ( bus.StateHash(), plain.StateHash() ) << "frame " << i;
+  }
+  plain.RunFrame();
+  plain.RunFrame();
+
+  // Each presented frame is the one the plain machine shows two frames later
+  ASSERT_EQ( presented.size(), 20 );
+  ASSERT_EQ( plainFrames.size(), 22 );
+  for ( std::size_t i = 0; i < presented.size(); ++i ) {
+    EXPECT_EQ( presented[i], plainFrames[i + 2] ) << "frame " << i;
+  }
+  EXPECT_GE( runAhead.Stats().TotalUs(), 0.0 );
+}
+
+TEST_F( StateTest, ForkMatchesSourceAndDiverges )
+{
+  for ( int i = 0; i < 20; ++i )
+    bus.RunFrame();
+
+  // A fork starts out identical, including its cached page hashes
+  auto fork = bus.Clone();
+  EXPECT_EQ( fork->StateHash(), bus.StateHash() );
+  EXPECT_EQ( fork->StateHash( false ), bus.StateHash( false ) );
+  EXPECT_EQ( fork->cpu.GetCycles(), bus.cpu.GetCycles() );
+  EXPECT_EQ( fork->ppu.frame, bus.ppu.frame );
+
+  // and stays in lockstep with the source given the same inputs. The frame buffer isn't state, so
+  // the first frame misses the pixels the source drew before the fork.
+  std::vector<u32> sourceFrame;
+  std::vector<u32> forkFrame;
+  bus.ppu.onFrameReady = [&]( const u32 *fb ) { sourceFrame.assign( fb, fb + PPU::gBufferSize ); };
+  fork->ppu.onFrameReady = [&]( const u32 *fb ) { forkFrame.assign( fb, fb + PPU::gBufferSize ); };
+  for ( int i = 0; i < 10; ++i ) {
+    bus.controller[0] = fork->controller[0] = static_cast<u8>( i * 37 );
+    bus.RunFrame();
+    fork->RunFrame();
+    ASSERT_EQ( fork->StateHash(), bus.StateHash() ) << "frame " << i;
+    if ( i > 0 ) {
+      ASSERT_EQ( forkFrame, sourceFrame ) << "frame " << i;
+    }
+  }
+
+  // Writes on either side stay on that side
+  u8 const ram = bus.Read( 0x0456 );
+  u8 const nametable = bus.ppu.ReadVram( 0x2123 );
+  fork->Write( 0x0456, ram ^ 0xFF );
+  fork->ppu.WriteVram( 0x2123, nametable ^ 0xFF );
+  bus.Write( 0x0789, 0x42 );
+  EXPECT_EQ( bus.Read( 0x0456 ), ram );
+  EXPECT_EQ( bus.ppu.ReadVram( 0x2123 ), nametable );
+  EXPECT_EQ( fork->Read( 0x0456 ), ram ^ 0xFF );
+  EXPECT_EQ( fork->ppu.ReadVram( 0x2123 ), nametable ^ 0xFF );
+  EXPECT_NE( fork->Read( 0x0789 ), 0x42 );
+  EXPECT_NE( fork->StateHash(), bus.StateHash() );
+
+  // Forking again, from either side, picks up the latest writes
+  Bus second;
+  second.ForkFrom( *fork );
+  EXPECT_EQ( second.Read( 0x0456 ), ram ^ 0xFF );
+  EXPECT_EQ( second.StateHash( false ), fork->StateHash( false ) );
+  second.ForkFrom( bus );
+  EXPECT_EQ( second.Read( 0x0789 ), 0x42 );
+  EXPECT_EQ( second.StateHash( false ), bus.StateHash( false ) );
+
+  // Forking is loading the source's save state, without the serializing
+  std::vector<u8> sourceState;
+  bus.SaveStateToMemory( sourceState );
+  Bus loaded;
+  loaded.cartridge.LoadRom( std::string( paths::roms() ) + "/palette.nes" );
+  ASSERT_TRUE( loaded.LoadStateFromMemory( sourceState.data(), sourceState.size() ) );
+  second.ForkFrom( bus );
+
+  std::vector<u8> forkState;
+  std::vector<u8> loadedState;
+  second.SaveStateToMemory( forkState );
+  loaded.SaveStateToMemory( loadedState );
+  EXPECT_EQ( forkState, loadedState );
+}
+
+// Tree search forks every branch from the same root, on several threads
+TEST_F( StateTest, ForksFromManyThreads )
+{
+  for ( int i = 0; i < 20; ++i )
+    bus.RunFrame();
+  auto const fork = bus.Clone(); // holds the base block, freezing has to make a new one
+
+  // Pages written since the last fork, so the first forks below all want to freeze them
+  bus.Write( 0x0123, 0x45 );
+  bus.ppu.WriteVram( 0x2345, 0x67 );
+  u64 const expected = bus.StateHash( false );
+  u8 const  ram = bus.Read( 0x0456, true );
+
+  std::vector<std::thread> threads;
+  std::vector<int>         mismatches( 8, 0 );
+  for ( std::size_t t = 0; t < mismatches.size(); ++t ) {
+    threads.emplace_back( [&, t]() {
+      for ( int i = 0; i < 20; ++i ) {
+        Bus branch;
+        branch.ForkFrom( bus );
+        branch.Write( 0x0123, static_cast<u8>( t ) ); // and write into the shared pages
+        mismatches[t] += branch.Read( 0x0456, true ) != ram ? 1 : 0;
+        branch.Write( 0x0123, 0x45 );
+        mismatches[t] += branch.StateHash( false ) != expected ? 1 : 0;
+      }
+    } );
+  }
+  for ( auto &thread : threads ) {
+    thread.join();
+  }
+  for ( std::size_t t = 0; t < mismatches.size(); ++t ) {
+    EXPECT_EQ( mismatches[t], 0 ) << "thread " << t;
+  }
+  EXPECT_EQ( bus.StateHash( false ), expected );
+}
+
 int main( int argc, char **argv )
 {
   ::testing::InitGoogleTest( &argc, argv );
@@ -0,0 +1,205 @@
+#include "bus.h"
+#include "global-types.h"
+#include "paths.h"
+#include "trace-file.h"
+#include "trace-ring.h"
+#include "trace-writer.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+TraceRecord RecordAt( u16 pc )
+{
+  return TraceRecord{ .cycle = pc, .pc = pc, .bytes = { 0xEA, 0x00, 0x00 } };
+}
+
+void WriteTrace( const std::filesystem::path &path, const std::vector<TraceRecord> &records )
+{
+  TraceWriter writer;
+  ASSERT_TRUE( writer.Open( path.string(), trace_file::Timing::InstructionStart ) );
+  for ( const TraceRecord &record : records ) {
+    writer.Append( record );
+  }
+  ASSERT_TRUE( writer.Close() );
+}
+
+// nestest.log's line without the memory annotations ("= 00", "@ 0300 = 89") in its disassembly
+std::string WithoutAnnotations( const std::string &line )
+{
+  std::string disassembly = line.substr( 15, 33 );
+  disassembly = disassembly.substr( 0, std::min( disassembly.find( " = " ), disassembly.find( " @ " ) ) );
+  disassembly.erase( disassembly.find_last_not_of( ' ' ) + 1 );
+  return line.substr( 0, 15 ) + disassembly + std::string( 33 - disassembly.size(), ' ' ) + line.substr( 48 );
+}
+} // namespace
+
+TEST( TraceRingTest, KeepsTheNewestRecords )
+{
+  TraceRing ring( 4 );
+  EXPECT_TRUE( ring.Empty() );
+  for ( u16 pc = 0; pc < 10; ++pc ) {
+    ring.Push( RecordAt( pc ) );
+  }
+  ASSERT_EQ( ring.Size(), 4U );
+  for ( std::size_t i = 0; i < ring.Size(); ++i ) {
+    EXPECT_EQ( ring[i].pc, 6 + i );
+  }
+
+  // Shrinking keeps the newest, growing keeps everything and fills up before wrapping again
+  ring.SetCapacity( 2 );
+  ASSERT_EQ( ring.Size(), 2U );
+  EXPECT_EQ( ring[0].pc, 8 );
+  EXPECT_EQ( ring[1].pc, 9 );
+  ring.SetCapacity( 3 );
+  ring.Push( RecordAt( 10 ) );
+  ring.Push( RecordAt( 11 ) );
+  ASSERT_EQ( ring.Size(), 3U );
+  EXPECT_EQ( ring[0].pc, 9 );
+  EXPECT_EQ( ring[2].pc, 11 );
+
+  ring.Clear();
+  EXPECT_TRUE( ring.Empty() );
+  EXPECT_EQ( ring.Capacity(), 3U );
+}
+
+// Formatting a record later gives the line LogLineAtPC() gave when it was captured
+TEST( TraceRingTest, FormatsLikeLogLineAtPC )
+{
+  Bus bus;
+  bus.apu.enable_synthesis( false );
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  bus.cpu.SetTraceSize( 5000 );
+  bus.cpu.EnableTracelog();
+
+  std::vector<std::string> expected;
+  std::vector<std::string> expectedShort;
+  while ( expected.size() < 5000 ) {
+    if ( !bus.dmaInProgress ) {
+      expected.push_back( bus.cpu.LogLineAtPC() );
+      expectedShort.push_back( bus.cpu.LogLineAtPC( false ) );
+    }
+    bus.Clock();
+  }
+
+  TraceRing const &log = bus.cpu.GetTracelog();
+  ASSERT_EQ( log.Size(), expected.size() );
+  for ( std::size_t i = 0; i < log.Size(); ++i ) {
+    ASSERT_EQ( FormatTraceLine( log[i] ), expected[i] ) << "line " << i;
+    ASSERT_EQ( FormatTraceLine( log[i], false ), expectedShort[i] ) << "line " << i;
+  }
+}
+
+// nestest runs its automated tests from $C000, where nestest.log starts
+TEST( TraceRingTest, FormatsNestestLines )
+{
+  std::ifstream log( "tests/logs/nestest-log.txt" );
+  ASSERT_TRUE( log.is_open() );
+  std::vector<std::string> expected;
+  for ( std::string line; std::getline( log, line ); ) {
+    line.erase( line.find_last_not_of( "\r " ) + 1 );
+    expected.push_back( WithoutAnnotations( line ) );
+  }
+
+  Bus bus;
+  bus.apu.enable_synthesis( false );
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  bus.cpu.SetProgramCounter( 0xC000 );
+  bus.cpu.SetStatusRegister( 0x24 );
+  bus.ppu.cycle = 21; // 3 dots per CPU cycle, 7 cycles into the frame
+  for ( std::size_t i = 0; i < expected.size(); ++i ) {
+    ASSERT_EQ( FormatNestestLine( bus.cpu.CaptureTrace( bus.cpu.GetProgramCounter() ) ), expected[i] ) << "line " << i;
+    bus.Clock();
+  }
+}
+
+// Everything the trace log sees reaches the file, in order, across many write buffers
+TEST( TraceFileTest, StreamsTheTraceLog )
+{
+  auto const path = std::filesystem::temp_directory_path() / "trace_test.trace";
+  std::size_t const instructions = ( TraceWriter::bufferRecords * 2 ) + 1000;
+
+  Bus bus;
+  bus.apu.enable_synthesis( false );
+  bus.cartridge.LoadRom( std::string( paths::roms() ) + "/nestest.nes" );
+  bus.DebugReset();
+  bus.cpu.SetTraceSize( instructions );
+  bus.cpu.EnableTracelog();
+  TraceWriter writer;
+  ASSERT_TRUE( writer.Open( path.string(), trace_file::Timing::InstructionStart ) );
+  bus.cpu.traceWriter = &writer;
+  while ( bus.cpu.GetTracelog().Size() < instructions ) {
+    bus.Clock();
+  }
+  bus.cpu.traceWriter = nullptr;
+  EXPECT_EQ( writer.RecordsWritten(), instructions );
+  ASSERT_TRUE( writer.Close() );
+
+  TraceFileReader          reader;
+  std::vector<TraceRecord> records;
+  ASSERT_TRUE( reader.Open( path.string() ) );
+  EXPECT_EQ( reader.TraceTiming(), trace_file::Timing::InstructionStart );
+  ASSERT_EQ( reader.RecordCount(), instructions );
+  ASSERT_TRUE( reader.Read( 0, instructions, records ) );
+  for ( std::size_t i = 0; i < instructions; ++i ) {
+    ASSERT_EQ( records[i], bus.cpu.GetTracelog()[i] ) << "record " << i;
+  }
+  std::filesystem::remove( path );
+}
+
+TEST( TraceFileTest, FindsTheFirstDivergence )
+{
+  auto const               pathA = std::filesystem::temp_directory_path() / "trace_test_a.trace";
+  auto const               pathB = std::filesystem::temp_directory_path() / "trace_test_b.trace";
+  std::vector<TraceRecord> records;
+  for ( u32 i = 0; i < 200000; ++i ) {
+    records.push_back( RecordAt( static_cast<u16>( i ) ) );
+    records.back().cycle = i;
+  }
+
+  auto const divergence = [&]( const std::vector<TraceRecord> &a, const std::vector<TraceRecord> &b ) {
+    WriteTrace( pathA, a );
+    WriteTrace( pathB, b );
+    TraceFileReader readerA;
+    TraceFileReader readerB;
+    u64             index = 0;
+    EXPECT_TRUE( readerA.Open( pathA.string() ) && readerB.Open( pathB.string() ) );
+    EXPECT_TRUE( FindFirstDivergence( readerA, readerB, index ) );
+    return index;
+  };
+
+  EXPECT_EQ( divergence( records, records ), records.size() );
+
+  // A single flag, deep into the second chunk, and the rest of the run after it
+  std::vector<TraceRecord> changed = records;
+  changed[150001].p ^= 0x01;
+  EXPECT_EQ( divergence( records, changed ), 150001U );
+  for ( std::size_t i = 150002; i < changed.size(); ++i ) {
+    changed[i].cycle += 3;
+  }
+  EXPECT_EQ( divergence( changed, records ), 150001U );
+  changed = records;
+  changed[0].a = 1;
+  EXPECT_EQ( divergence( records, changed ), 0U );
+
+  // One trace stopping early is where they part
+  std::vector<TraceRecord> const prefix( records.begin(), records.begin() + 70000 );
+  EXPECT_EQ( divergence( records, prefix ), 70000U );
+
+  std::filesystem::remove( pathA );
+  std::filesystem::remove( pathB );
+}
+
+int main( int argc, char **argv )
+{
+  testing::InitGoogleTest( &argc, argv );
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,297 @@
+#include "bus.h"
+#include "frame-exporter.h"
+#include "movie.h"
+#include "run-ahead.h"
+#include "trace-file.h"
+#include "trace-writer.h"
+#include "wav-writer.h"
+#include "global-types.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fmt/base.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+################################
+||       Headless Runner      ||
+################################
+  Runs a ROM without any frontend, as fast as the core allows. Used for benchmarking,
+  regression runs and reproducing bugs from recorded movies.
+*/
+
+namespace
+{
+struct Options {
+  std::string rom;
+  long        frames = -1; // -1: 600, or the movie length when playing back
+  std::string recordPath;
+  std::string playPath;
+  bool        movieHashes = false;
+  bool        printHash = false;
+  int         runAhead = 0;
+  bool        checkHash = false;
+  u64         expectHash = 0;
+  std::string wavPath;
+  std::string exportName;
+  bool        exportIndices = false;
+  bool        idleSkip = true;
+  bool        blockCache = true;
+  std::string tracePath;
+  bool        traceMesen = false;
+};
+
+void PrintUsage()
+{
+  fmt::print( "Usage: emu_headless <rom> [options]\n"
+              "  --frames N        frames to run (default 600, or the movie length with --play)\n"
+              "  --record FILE     record a movie from power-on while running\n"
+              "  --movie-hashes    store a state hash with every recorded frame\n"
+              "  --play FILE       play back a movie, reports the first desynced frame\n"
+              "  --run-ahead N     run N speculative frames per frame and report the overhead\n"
+              "  --hash            print the machine state hash after the last frame\n"
+              "  --expect-hash HEX fail unless the final state hash matches (golden runs)\n"
+              "  --wav FILE        render the audio to a 16-bit mono WAV file\n"
+              "  --export NAME     publish every frame to the shared memory ring NAME (e.g. /nes_frames)\n"
+              "  --export-format F rgba (default) or index, the pixel format of exported frames\n"
+              "  --no-idle-skip    interpret idle loops instead of fast-forwarding them (same results)\n"
+              "  --no-block-cache  decode every instruction instead of running cached blocks (same results)\n"
+              "  --trace FILE      stream a binary CPU trace to FILE, see emu_trace to read it\n"
+              "  --trace-timing T  instruction (default) or mesen, when each trace record is taken\n" );
+}
+
+bool ParseArgs( int argc, char **argv, Options &opts )
+{
+  std::vector<std::string_view> const args( argv + 1, argv + argc ); // NOLINT
+  for ( std::size_t i = 0; i < args.size(); ++i ) {
+    auto const arg = args[i];
+    auto       next = [&]() -> std::string {
+      if ( i + 1 >= args.size() ) {
+        throw std::runtime_error( "Missing value for " + std::string( arg ) );
+      }
+      return std::string( args[++i] );
+    };
+
+    if ( arg == "--frames" ) {
+      opts.frames = std::stol( next() );
+    } else if ( arg == "--record" ) {
+      opts.recordPath = next();
+    } else if ( arg == "--movie-hashes" ) {
+      opts.movieHashes = true;
+    } else if ( arg == "--play" ) {
+      opts.playPath = next();
+    } else if ( arg == "--run-ahead" ) {
+      opts.runAhead = std::stoi( next() );
+    } else if ( arg == "--hash" ) {
+      opts.printHash = true;
+    } else if ( arg == "--expect-hash" ) {
+      opts.checkHash = true;
+      opts.expectHash = std::stoull( next(), nullptr, 16 );
+    } else if ( arg == "--wav" ) {
+      opts.wavPath = next();
+    } else if ( arg == "--export" ) {
+      opts.exportName = next();
+    } else if ( arg == "--export-format" ) {
+      auto const format = next();
+      if ( format != "rgba" && format != "index" ) {
+        throw std::runtime_error( "Unknown export format: " + format );
+      }
+      opts.exportIndices = format == "index";
+    } else if ( arg == "--no-idle-skip" ) {
+      opts.idleSkip = false;
+    } else if ( arg == "--no-block-cache" ) {
+      opts.blockCache = false;
+    } else if ( arg == "--trace" ) {
+      opts.tracePath = next();
+    } else if ( arg == "--trace-timing" ) {
+      auto const timing = next();
+      if ( timing != "instruction" && timing != "mesen" ) {
+        throw std::runtime_error( "Unknown trace timing: " + timing );
+      }
+      opts.traceMesen = timing == "mesen";
+    } else if ( arg == "-h" || arg == "--help" ) {
+      return false;
+    } else if ( opts.rom.empty() && !arg.starts_with( "--" ) ) {
+      opts.rom = arg;
+    } else {
+      throw std::runtime_error( "Unknown option: " + std::string( arg ) );
+    }
+  }
+  // Speculative frames run on the same machine and would end up in the trace
+  if ( !opts.tracePath.empty() && opts.runAhead > 0 ) {
+    throw std::runtime_error( "--trace can't be combined with --run-ahead" );
+  }
+  return !opts.rom.empty();
+}
+} // namespace
+
+int main( int argc, char **argv )
+{
+  Options opts;
+  try {
+    if ( !ParseArgs( argc, argv, opts ) ) {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  } catch ( const std::exception &e ) {
+    fmt::print( "{}\n", e.what() );
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+
+  Bus      bus;
+  Movie    movie;
+  bus.idleLoop.enabled = opts.idleSkip;
+  bus.blockCache.enabled = opts.blockCache;
+  RunAhead runAhead;
+  runAhead.frames = opts.runAhead;
+  try {
+    bus.cartridge.LoadRom( opts.rom );
+    bus.DebugReset();
+  } catch ( const std::exception &e ) {
+    fmt::print( "Failed to load {}: {}\n", opts.rom, e.what() );
+    return EXIT_FAILURE;
+  }
+
+  if ( !opts.playPath.empty() ) {
+    if ( !movie.Load( opts.playPath ) || !movie.StartPlayback( bus ) ) {
+      return EXIT_FAILURE;
+    }
+    if ( opts.frames < 0 ) {
+      opts.frames = static_cast<long>( movie.FrameCount() );
+    }
+  } else if ( !opts.recordPath.empty() ) {
+    movie.StartRecording( bus, MovieStart::PowerOn, opts.movieHashes );
+  }
+  if ( opts.frames < 0 ) {
+    opts.frames = 600;
+  }
+
+  // The file gets every record, the in-memory log only needs to hold the latest
+  TraceWriter trace;
+  if ( !opts.tracePath.empty() ) {
+    using Timing = trace_file::Timing;
+    if ( !trace.Open( opts.tracePath, opts.traceMesen ? Timing::MesenFetch : Timing::InstructionStart ) ) {
+      return EXIT_FAILURE;
+    }
+    if ( opts.traceMesen ) {
+      bus.cpu.SetMesenTraceSize( 1 );
+      bus.cpu.EnableMesenFormatTraceLog();
+    } else {
+      bus.cpu.SetTraceSize( 1 );
+      bus.cpu.EnableTracelog();
+    }
+    bus.cpu.traceWriter = &trace;
+  }
+
+  // Nothing listens without --wav, so the APU only keeps the state the CPU can see
+  WavWriter wav;
+  bus.apu.enable_synthesis( !opts.wavPath.empty() );
+  if ( !opts.wavPath.empty() ) {
+    if ( bus.apu.sample_rate( bus.sampleRate ) != nullptr || !wav.Open( opts.wavPath, bus.sampleRate ) ) {
+      fmt::print( "Failed to set up audio output\n" );
+      return EXIT_FAILURE;
+    }
+  }
+
+  FrameExporter exporter;
+  exporter.logSink = [&bus]( const std::string &message ) { bus.Log( message ); };
+  if ( !opts.exportName.empty() ) {
+    using Format = FrameExporter::PixelFormat;
+    auto const format = opts.exportIndices ? Format::PaletteIndex : Format::Rgba;
+    if ( !exporter.Open( opts.exportName, format ) ) {
+      return EXIT_FAILURE;
+    }
+    exporter.Attach( bus );
+  }
+
+  auto const startCycles = bus.cpu.GetCycles();
+  auto const start = std::chrono::steady_clock::now();
+
+  long framesRun = 0;
+  while ( framesRun < opts.frames ) {
+    if ( movie.Mode() == MovieMode::Inactive && runAhead.frames > 0 ) {
+      runAhead.RunFrame( bus );
+    } else if ( movie.RunFrame( bus ) ) {
+      bus.apu.end_frame();
+    } else {
+      break;
+    }
+    if ( wav.IsOpen() ) {
+      wav.WriteFrom( bus.apu );
+    }
+    if ( exporter.IsOpen() ) {
+      exporter.Publish( bus );
+    }
+    framesRun++;
+  }
+
+  auto const   elapsed = std::chrono::steady_clock::now() - start;
+  double const seconds = std::chrono::duration<double>( elapsed ).count();
+  double const fps = seconds > 0 ? framesRun / seconds : 0.0;
+  fmt::print( "Ran {} frames ({} cpu cycles) in {:.3f}s: {:.1f} fps, {:.1f}x realtime\n", framesRun,
+              bus.cpu.GetCycles() - startCycles, seconds, fps, fps / 60.0988 );
+
+  if ( opts.idleSkip ) {
+    IdleLoopStats const &idle = bus.idleLoop.Stats();
+    fmt::print( "Idle loops: entered {} times, {:.1f}% of cpu cycles replayed\n", idle.loops,
+                100.0 * idle.ReplayedShare( bus.cpu.GetCycles() ) );
+  }
+
+  if ( wav.IsOpen() ) {
+    u64 const    samples = wav.SamplesWritten();
+    double const audioSeconds = static_cast<double>( samples ) / bus.sampleRate;
+    if ( !wav.Close() ) {
+      return EXIT_FAILURE;
+    }
+    fmt::print( "Wrote {} samples ({:.2f}s of audio) to {}: {:.1f}x realtime\n", samples, audioSeconds, opts.wavPath,
+                seconds > 0 ? audioSeconds / seconds : 0.0 );
+  }
+
+  if ( trace.IsOpen() ) {
+    u64 const records = trace.RecordsWritten();
+    bus.cpu.traceWriter = nullptr;
+    if ( !trace.Close() ) {
+      return EXIT_FAILURE;
+    }
+    fmt::print( "Traced {} instructions to {}\n", records, opts.tracePath );
+  }
+
+  if ( runAhead.frames > 0 ) {
+    RunAheadStats const &stats = runAhead.Stats();
+    fmt::print( "Run-ahead {}: {:.0f}us/frame (save {:.0f}us, frames {:.0f}us, load {:.0f}us)\n", runAhead.frames,
+                stats.TotalUs(), stats.snapshotUs, stats.framesUs, stats.restoreUs );
+  }
+
+  if ( opts.printHash || opts.checkHash ) {
+    auto const hashStart = std::chrono::steady_clock::now();
+    u64 const  hash = bus.StateHash();
+    auto const hashTime = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - hashStart );
+    fmt::print( "State hash {:016x} ({:.1f}us)\n", hash, hashTime.count() );
+    if ( opts.checkHash && hash != opts.expectHash ) {
+      fmt::print( "State hash mismatch, expected {:016x}\n", opts.expectHash );
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ( movie.Mode() == MovieMode::Recording ) {
+    if ( !movie.StopRecording( opts.recordPath ) ) {
+      return EXIT_FAILURE;
+    }
+    fmt::print( "Recorded {} frames to {}\n", movie.FrameCount(), opts.recordPath );
+  }
+
+  if ( movie.Mode() == MovieMode::Playing ) {
+    if ( movie.Desynced() ) {
+      fmt::print( "Playback desynced at frame {}\n", movie.DesyncFrame() );
+      return EXIT_FAILURE;
+    }
+    fmt::print( "Playback {} ({} of {} frames{})\n", movie.Finished() ? "complete" : "stopped", movie.CurrentFrame(),
+                movie.FrameCount(), movie.HasHashes() ? ", hashes verified" : "" );
+  }
+  return EXIT_SUCCESS;
+}
@@ -1,10 +1,77 @@
 #include "bus.h"
+#include "emulator-pool.h"
+#include "movie.h"
+#include "trace-ring.h"
+#include "wav-writer.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include <fmt/base.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "paths.h"
 
 namespace py = pybind11;
 
+namespace
+{
+using Pads = std::array<u8, 2>; // controller bytes for ports 1 and 2
+
+// Reads count controller inputs from a 1D array (port 1 only) or a (count, 2) array. Throws
+// std::runtime_error naming the caller otherwise.
+std::vector<Pads> ToPads( const py::handle &object, std::size_t count, const std::string &caller )
+{
+  auto const array = py::array_t<u8, py::array::c_style | py::array::forcecast>::ensure( object );
+  bool const bothPorts = array && array.ndim() == 2 && array.shape( 1 ) == 2;
+  bool const valid =
+      array && ( array.ndim() == 1 || bothPorts ) && static_cast<std::size_t>( array.shape( 0 ) ) == count;
+  if ( !valid ) {
+    throw std::runtime_error( caller + ": expected " + std::to_string( count ) +
+                              " inputs, as a 1D array or a (count, 2) array" );
+  }
+  std::vector<Pads> pads( count );
+  u8 const         *data = array.data();
+  for ( std::size_t i = 0; i < count; ++i ) {
+    pads[i] = bothPorts ? Pads{ data[i * 2], data[( i * 2 ) + 1] } : Pads{ data[i], 0 }; // NOLINT
+  }
+  return pads;
+}
+
+// Puts the APU's audio setup back the way it was. Nothing reads samples outside render_wav(), so
+// output left attached would fill the sample buffer until it overflows.
+class AudioRestore
+{
+public:
+  explicit AudioRestore( Simple_Apu &apu )
+      : _apu( apu ), _synthesis( apu.synthesis_enabled() ), _output( apu.has_output() )
+  {
+  }
+  ~AudioRestore()
+  {
+    if ( !_output ) {
+      _apu.detach_output();
+    }
+    _apu.enable_synthesis( _synthesis );
+  }
+
+  AudioRestore( const AudioRestore & ) = delete;
+  AudioRestore &operator=( const AudioRestore & ) = delete;
+  AudioRestore( AudioRestore && ) = delete;
+  AudioRestore &operator=( AudioRestore && ) = delete;
+
+private:
+  Simple_Apu &_apu;
+  bool        _synthesis;
+  bool        _output;
+};
+} // namespace
+
 class Emulator
 {
 public:
@@ -12,6 +79,7 @@ public:
   PPU       &ppu = bus.ppu;
   CPU       &cpu = bus.cpu;
   Cartridge &cart = bus.cartridge;
+  Movie      movie;
 
   Emulator() = default;
 
@@ -106,16 +174,166 @@ public:
     fmt::print( "{}\n", out );
   }
 
+  // Runs n instructions
   void Step( int n = 1 )
   {
+    py::gil_scoped_release const release;
     for ( int i = 0; i < n; i++ ) {
       bus.Clock();
     }
   }
 
+  /*
+  #######################################
+  ||          Input and Movies         ||
+  #######################################
+  */
+  void SetController( int port, u8 value ) { bus.controller[port & 1] = value; }
+
+  // Runs one frame, through the movie when one is recording or playing
+  bool RunFrame()
+  {
+    bool const ok = movie.RunFrame( bus );
+    bus.apu.end_frame();
+    return ok;
+  }
+
+  // Runs n frames, through the movie like RunFrame(). inputs, if given, holds one controller
+  // byte per frame (or an (n, 2) array for both ports). Returns the frames run, fewer than n if
+  // movie playback ended.
+  long RunFrames( long n, const py::object &inputs )
+  {
+    std::vector<Pads> pads;
+    if ( !inputs.is_none() ) {
+      pads = ToPads( inputs, static_cast<std::size_t>( std::max( n, 0L ) ), "run_frames" );
+    }
+    py::gil_scoped_release const release;
+    long                         ran = 0;
+    for ( ; ran < n; ++ran ) {
+      if ( !pads.empty() ) {
+        bus.controller[0] = pads[ran][0];
+        bus.controller[1] = pads[ran][1];
+      }
+      if ( !RunFrame() ) {
+        break;
+      }
+    }
+    return ran;
+  }
+
+  // Runs instructions until the PC reaches pc or the PPU reaches frame, whichever is given and
+  // comes first, giving up after maxFrames frames. Returns whether a target was reached.
+  bool RunUntil( const std::optional<u16> &pc, const std::optional<u64> &frame, u64 maxFrames )
+  {
+    if ( !pc && !frame ) {
+      throw std::runtime_error( "run_until: give a pc, a frame or both" );
+    }
+    py::gil_scoped_release const release;
+    u64 const                    limit = ppu.frame + maxFrames;
+    while ( ppu.frame < limit ) {
+      bus.Clock();
+      if ( ( pc && cpu.GetProgramCounter() == *pc ) || ( frame && ppu.frame >= *frame ) ) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Sound off skips all synthesis, the APU state the CPU can see is unchanged
+  void SetAudio( bool enabled ) { bus.apu.enable_synthesis( enabled ); }
+  bool Audio() const { return bus.apu.synthesis_enabled(); }
+
+  // Runs up to `frames` frames (through the active movie, if any) as fast as possible, writing
+  // the audio to a WAV file. Returns the speed as a multiple of realtime. Sound is set back the
+  // way it was afterwards.
+  double RenderWav( const std::string &path, long frames )
+  {
+    py::gil_scoped_release const release;
+    AudioRestore const           restore( bus.apu );
+    WavWriter                    wav;
+    bus.apu.enable_synthesis();
+    if ( bus.apu.sample_rate( bus.sampleRate ) != nullptr || !wav.Open( path, bus.sampleRate ) ) {
+      throw std::runtime_error( "Could not set up audio output to " + path );
+    }
+    auto const start = std::chrono::steady_clock::now();
+    for ( long i = 0; i < frames && RunFrame(); ++i ) {
+      wav.WriteFrom( bus.apu );
+    }
+    double const seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    double const audioSeconds = static_cast<double>( wav.SamplesWritten() ) / bus.sampleRate;
+    if ( !wav.Close() ) {
+      throw std::runtime_error( "Failed writing " + path );
+    }
+    return seconds > 0 ? audioSeconds / seconds : 0.0;
+  }
+
+  void RecordMovie( bool hashes, bool fromPowerOn )
+  {
+    movie.StartRecording( bus, fromPowerOn ? MovieStart::PowerOn : MovieStart::SaveState, hashes );
+  }
+  bool SaveMovie( const std::string &path ) { return movie.StopRecording( path ); }
+  bool PlayMovie( const std::string &path ) { return movie.Load( path ) && movie.StartPlayback( bus ); }
+  void StopMovie() { movie.Stop(); }
+  void QueueReset() { movie.QueueEvent( MovieEvent::Reset ); }
+  void QueuePower() { movie.QueueEvent( MovieEvent::Power ); }
+  bool MovieFinished() const { return movie.Finished(); }
+  long MovieDesyncFrame() const { return movie.DesyncFrame(); }
+
+  u64 StateHash( bool incremental = true ) { return bus.StateHash( incremental ); }
+
   u8 Read( u16 addr ) const { return bus.cpu.Read( addr ); }
   u8 PpuRead( u16 addr ) { return bus.ppu.ReadVram( addr ); }
 
+  /*
+  #######################################
+  ||      Bulk Memory and States       ||
+  #######################################
+  */
+  // length bytes of CPU memory from start, wrapping at $FFFF, with the side effects of Read()
+  py::bytes ReadRange( u16 start, std::size_t length ) const
+  {
+    std::string out( length, '\0' );
+    for ( std::size_t i = 0; i < length; ++i ) {
+      out[i] = static_cast<char>( bus.cpu.Read( static_cast<u16>( start + i ) ) );
+    }
+    return py::bytes( out );
+  }
+
+  // Snapshots of CPU RAM, the four nametables and OAM. Copies, since RAM and nametables are
+  // copy-on-write pages rather than one block (see cow-memory.h).
+  py::memoryview Ram() const { return Snapshot( bus.GetRam() ); }
+  py::memoryview Vram() const { return Snapshot( ppu.nameTables ); }
+  py::memoryview Oam() const
+  {
+    return py::memoryview( py::bytes( reinterpret_cast<const char *>( ppu.oam.data.data() ), // NOLINT
+                                      ppu.oam.data.size() ) );
+  }
+
+  // The frame being drawn, as a live (240, 256, 4) RGBA view. Keeps this emulator alive.
+  py::array Frame( const py::handle &owner ) const
+  {
+    return py::array( py::dtype::of<u8>(), { std::size_t{ 240 }, std::size_t{ 256 }, std::size_t{ 4 } },
+                      reinterpret_cast<const u8 *>( ppu.GetFrameOutput() ), owner ); // NOLINT
+  }
+
+  // Whole machine state, in the save state format
+  py::bytes SaveState()
+  {
+    std::vector<u8> buffer;
+    {
+      py::gil_scoped_release const release;
+      bus.SaveStateToMemory( buffer );
+    }
+    return { reinterpret_cast<const char *>( buffer.data() ), buffer.size() }; // NOLINT
+  }
+  bool LoadState( const py::buffer &state )
+  {
+    py::buffer_info const        info = state.request();
+    py::gil_scoped_release const release;
+    return bus.LoadStateFromMemory( static_cast<const u8 *>( info.ptr ),
+                                    static_cast<std::size_t>( info.size * info.itemsize ) );
+  }
+
   void EnableMesenTrace( int n = 100 )
   {
     cpu.EnableMesenFormatTraceLog();
@@ -124,10 +342,116 @@ public:
   void DisableMesenTrace() { cpu.DisableMesenFormatTraceLog(); }
   void PrintMesenTrace() const
   {
-    for ( const auto &line : cpu.GetMesenFormatTracelog() ) {
-      fmt::print( "{}", line );
+    TraceRing const &log = cpu.GetMesenFormatTracelog();
+    for ( std::size_t i = 0; i < log.Size(); ++i ) {
+      fmt::print( "{}\n", FormatTraceLine( log[i] ) );
+    }
+  }
+
+private:
+  template <std::size_t Size> static py::memoryview Snapshot( const CowMemory<Size> &memory )
+  {
+    std::string bytes( Size, '\0' );
+    memory.CopyTo( reinterpret_cast<u8 *>( bytes.data() ) ); // NOLINT
+    return py::memoryview( py::bytes( bytes ) );
+  }
+};
+
+/*
+#######################################
+||          Batch Emulator           ||
+#######################################
+  Many emulators stepped a frame at a time from C++, for reinforcement learning. Stepping runs
+  on an EmulatorPool with the GIL released.
+
+  Observations live in three contiguous arrays, one slice per environment: RGBA frames, system
+  palette indices and CPU RAM. Each PPU renders straight into its slice and RAM is copied out
+  by the worker that ran the frame, so a step allocates nothing and Python never copies. The
+  frames, palette_indices and ram properties are NumPy views of these arrays; they always show
+  the latest step and stay valid while the BatchEmulator is alive.
+*/
+class BatchEmulator
+{
+public:
+  static constexpr std::size_t frameWidth = 256;
+  static constexpr std::size_t frameHeight = 240;
+  static constexpr std::size_t framePixels = PPU::gBufferSize;
+  static constexpr std::size_t ramSize = 2048;
+
+  explicit BatchEmulator( std::size_t numEnvs, std::size_t threads = 0 )
+      : _pool( numEnvs, threads ), _frames( numEnvs * framePixels ), _indices( numEnvs * framePixels ),
+        _ram( numEnvs * ramSize ), _inputs( numEnvs )
+  {
+    for ( std::size_t i = 0; i < numEnvs; ++i ) {
+      _pool.Instance( i ).ppu.SetFrameOutput( &_frames[i * framePixels], &_indices[i * framePixels] );
+    }
+    _pool.SetFrameHook( [this]( std::size_t env, Bus &bus ) { bus.GetRam().CopyTo( &_ram[env * ramSize] ); } );
+  }
+
+  [[nodiscard]] std::size_t NumEnvs() const { return _pool.Size(); }
+  [[nodiscard]] std::size_t Threads() const { return _pool.ThreadCount(); }
+
+  void Load( const std::string &path )
+  {
+    _pool.LoadRom( path );
+    CopyRam();
+  }
+
+  void Reset()
+  {
+    for ( std::size_t i = 0; i < _pool.Size(); ++i ) {
+      _pool.Instance( i ).DebugReset();
     }
+    CopyRam();
+  }
+
+  // actions: one controller byte per environment (port 1), or an (envs, 2) array for both ports.
+  // None repeats the previous actions.
+  void Step( const py::object &actions )
+  {
+    if ( !actions.is_none() ) {
+      _inputs = ToPads( actions, NumEnvs(), "BatchEmulator.step" );
+    }
+    py::gil_scoped_release const release;
+    _pool.StepFrame( _inputs );
+  }
+
+  // Zero-copy views. owner is the BatchEmulator's Python object, which the arrays keep alive.
+  py::array Frames( const py::handle &owner )
+  {
+    return py::array( py::dtype::of<u8>(), { NumEnvs(), frameHeight, frameWidth, std::size_t{ 4 } },
+                      reinterpret_cast<u8 *>( _frames.data() ), owner ); // NOLINT
   }
+  py::array PaletteIndices( const py::handle &owner )
+  {
+    return py::array( py::dtype::of<u8>(), { NumEnvs(), frameHeight, frameWidth }, _indices.data(), owner );
+  }
+  py::array Ram( const py::handle &owner )
+  {
+    return py::array( py::dtype::of<u8>(), { NumEnvs(), ramSize }, _ram.data(), owner );
+  }
+
+  // One environment's CPU memory. Battery backed PRG RAM ($6000-$7FFF) is private to it.
+  u8   Read( std::size_t env, u16 addr ) { return _pool.Instance( env ).Read( addr ); }
+  void Write( std::size_t env, u16 addr, u8 value ) { _pool.Instance( env ).Write( addr, value ); }
+
+  u64    StateHash( std::size_t env ) { return _pool.Instance( env ).StateHash(); }
+  u64    GetFrame( std::size_t env ) { return _pool.Instance( env ).ppu.frame; }
+  double FramesPerSecond() const { return _pool.GetMetrics().FramesPerSecond(); }
+
+private:
+  void CopyRam()
+  {
+    for ( std::size_t i = 0; i < _pool.Size(); ++i ) {
+      _pool.Instance( i ).GetRam().CopyTo( &_ram[i * ramSize] );
+    }
+  }
+
+  EmulatorPool                     _pool;
+  std::vector<u32>                 _frames;
+  std::vector<u8>                  _indices;
+  std::vector<u8>                  _ram;
+  std::vector<Pads>                _inputs;
 };
 
 PYBIND11_MODULE( emu, m ) // <-- Python module name. Must match the name in the CMakeLists
@@ -181,5 +505,75 @@ PYBIND11_MODULE( emu, m ) // <-- Python module name. Must match the name in the
       .def( "print_mesen_trace", &Emulator::PrintMesenTrace, "Print Mesen trace log" )
       .def( "read", &Emulator::Read, "Read from CPU memory", py::arg( "addr" ) )
       .def( "ppu_read", &Emulator::PpuRead, "Read from PPU memory", py::arg( "addr" ) )
+      // Bulk memory and states
+      .def( "read_range", &Emulator::ReadRange, "Read length bytes of CPU memory from start", py::arg( "start" ),
+            py::arg( "length" ) )
+      .def( "ram", &Emulator::Ram, "Snapshot of the 2KB CPU RAM, as a memoryview" )
+      .def( "vram", &Emulator::Vram, "Snapshot of the four 1KB nametables, as a memoryview" )
+      .def( "oam", &Emulator::Oam, "Snapshot of the 256 byte OAM, as a memoryview" )
+      .def(
+          "frame_buffer", []( const py::object &self ) { return self.cast<Emulator &>().Frame( self ); },
+          "Live (240, 256, 4) uint8 RGBA view of the frame being drawn" )
+      .def( "save_state", &Emulator::SaveState, "Save the machine state to bytes" )
+      .def( "load_state", &Emulator::LoadState, "Load a state from save_state(), returns False if it is invalid",
+            py::arg( "state" ) )
+      // Input and movies
+      .def( "set_controller", &Emulator::SetController, "Set a controller's button byte", py::arg( "port" ),
+            py::arg( "value" ) )
+      .def( "run_frame", &Emulator::RunFrame, "Run one frame, recording or playing back the active movie" )
+      .def( "run_frames", &Emulator::RunFrames,
+            "Run n frames with optional per-frame inputs, returns the frames run. Releases the GIL", py::arg( "n" ),
+            py::arg( "inputs" ) = py::none() )
+      .def( "run_until", &Emulator::RunUntil,
+            "Run until the PC or the frame count reaches a target, returns False if max_frames passed first. "
+            "Releases the GIL",
+            py::kw_only(), py::arg( "pc" ) = py::none(), py::arg( "frame" ) = py::none(),
+            py::arg( "max_frames" ) = 3600 )
+      .def( "record_movie", &Emulator::RecordMovie, "Start recording a movie", py::arg( "hashes" ) = false,
+            py::arg( "from_power_on" ) = true )
+      .def( "save_movie", &Emulator::SaveMovie, "Stop recording and write the movie", py::arg( "path" ) )
+      .def( "play_movie", &Emulator::PlayMovie, "Load a movie and start playing it back", py::arg( "path" ) )
+      .def( "stop_movie", &Emulator::StopMovie, "Stop recording or playback" )
+      .def( "queue_reset", &Emulator::QueueReset, "Record a reset before the next frame" )
+      .def( "queue_power", &Emulator::QueuePower, "Record a power cycle before the next frame" )
+      .def_property_readonly( "movie_finished", &Emulator::MovieFinished, "Get if movie playback reached the end" )
+      .def_property_readonly( "movie_desync_frame", &Emulator::MovieDesyncFrame,
+                              "Get the first desynced playback frame, -1 if none" )
+      .def( "set_audio", &Emulator::SetAudio, "Turn sound synthesis on or off, CPU visible APU state is unaffected",
+            py::arg( "enabled" ) )
+      .def_property_readonly( "audio", &Emulator::Audio, "Get if sound is synthesized" )
+      .def( "render_wav", &Emulator::RenderWav,
+            "Run frames as fast as possible, writing the audio to a WAV file. Returns the speed vs realtime",
+            py::arg( "path" ), py::arg( "frames" ) )
+      .def( "state_hash", &Emulator::StateHash, "Hash the machine state, for comparing runs",
+            py::arg( "incremental" ) = true )
       .def_static( "test", &Emulator::Test, "Test function" );
+
+  py::class_<BatchEmulator>( m, "BatchEmulator" )
+      .def( py::init<std::size_t, std::size_t>(), py::arg( "num_envs" ), py::arg( "threads" ) = 0 )
+      .def_property_readonly( "num_envs", &BatchEmulator::NumEnvs, "Get the number of environments" )
+      .def_property_readonly( "threads", &BatchEmulator::Threads, "Get the number of worker threads" )
+      .def( "load", &BatchEmulator::Load, "Load a rom file into every environment and reset them", py::arg( "path" ) )
+      .def( "reset", &BatchEmulator::Reset, "Reset every environment" )
+      .def( "step", &BatchEmulator::Step, "Run every environment for one frame, releasing the GIL",
+            py::arg( "actions" ) = py::none() )
+      .def_property_readonly(
+          "frames", []( const py::object &self ) { return self.cast<BatchEmulator &>().Frames( self ); },
+          "RGBA frames, (envs, 240, 256, 4) uint8 view" )
+      .def_property_readonly(
+          "palette_indices",
+          []( const py::object &self ) { return self.cast<BatchEmulator &>().PaletteIndices( self ); },
+          "System palette index per pixel, (envs, 240, 256) uint8 view" )
+      .def_property_readonly(
+          "ram", []( const py::object &self ) { return self.cast<BatchEmulator &>().Ram( self ); },
+          "CPU RAM, (envs, 2048) uint8 view" )
+      .def( "read", &BatchEmulator::Read, "Read from an environment's CPU memory", py::arg( "env" ),
+            py::arg( "addr" ) )
+      .def( "write", &BatchEmulator::Write, "Write to an environment's CPU memory", py::arg( "env" ),
+            py::arg( "addr" ), py::arg( "value" ) )
+      .def( "state_hash", &BatchEmulator::StateHash, "Hash an environment's machine state", py::arg( "env" ) )
+      .def( "frame", &BatchEmulator::GetFrame, "Get an environment's PPU frame count", py::arg( "env" ) )
+      .def_property_readonly( "fps", &BatchEmulator::FramesPerSecond, "Frames per second over all steps so far" );
+
+  m.def( "saves_dir", &paths::saves, "Directory battery saves are written to" );
 }
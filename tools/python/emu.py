@@ -82,6 +82,31 @@ method_names = [
     "debug_reset",
     "read",
     "ppu_read",
+    # Bulk memory and states
+    "read_range",
+    "ram",
+    "vram",
+    "oam",
+    "frame_buffer",
+    "save_state",
+    "load_state",
+    # Input and movies
+    "set_controller",
+    "run_frame",
+    "run_frames",
+    "run_until",
+    "record_movie",
+    "save_movie",
+    "play_movie",
+    "stop_movie",
+    "queue_reset",
+    "queue_power",
+    "movie_finished",
+    "movie_desync_frame",
+    "set_audio",
+    "audio",
+    "render_wav",
+    "state_hash",
 ]
 for name in method_names:
     globals()[name] = bind_method(name)
@@ -15,6 +15,112 @@ class TestExample(unittest.TestCase):
         print(f"Steps: {steps}")
         e.log()
 
+    def test_frames_memory_and_states(self):
+        e = emu.Emulator()
+        e.load("../../roms/nestest.nes")
+        e.debug_reset()
+
+        self.assertEqual(e.run_frames(5, inputs=[0x08] * 5), 5)
+        self.assertTrue(e.run_until(frame=e.frame + 2))
+        self.assertFalse(e.run_until(pc=0x0000, max_frames=1))
+
+        ram = e.ram()
+        self.assertEqual(len(ram), 2048)
+        self.assertEqual(bytes(ram[0x10:0x20]), e.read_range(0x10, 16))
+        self.assertEqual(len(e.vram()), 4096)
+        self.assertEqual(len(e.oam()), 256)
+        self.assertEqual(e.frame_buffer().shape, (240, 256, 4))
+
+        state = e.save_state()
+        before = e.state_hash()
+        e.run_frames(10)
+        self.assertNotEqual(e.state_hash(), before)
+        self.assertTrue(e.load_state(state))
+        self.assertEqual(e.state_hash(), before)
+        self.assertFalse(e.load_state(b"not a state"))
+
+    def test_frames_after_render_wav(self):
+        import os
+        import tempfile
+
+        e = emu.Emulator()
+        e.load("../../roms/nestest.nes")
+        e.debug_reset()
+        e.set_audio(False)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, "out.wav")
+            self.assertGreater(e.render_wav(path, 30), 0)
+            self.assertGreater(os.path.getsize(path), 44)
+        self.assertFalse(e.audio)
+
+        # Nothing reads samples now, several seconds of frames must not fill the sample buffer
+        e.set_audio(True)
+        self.assertEqual(e.run_frames(300), 300)
+
+    def test_batch_matches_single(self):
+        import numpy as np
+
+        batch = emu.BatchEmulator(4, threads=2)
+        batch.load("../../roms/nestest.nes")
+        frames = batch.frames
+        ram = batch.ram
+        self.assertEqual(frames.shape, (4, 240, 256, 4))
+        self.assertEqual(batch.palette_indices.shape, (4, 240, 256))
+
+        single = emu.Emulator()
+        single.load("../../roms/nestest.nes")
+        single.debug_reset()
+        single.set_audio(False)
+
+        actions = np.array([0, 0x10, 0x20, 0x80], dtype=np.uint8)
+        for _ in range(10):
+            batch.step(actions)
+            single.run_frame()
+        self.assertEqual(batch.state_hash(0), single.state_hash())
+
+        # The views taken before stepping show the latest step, nothing was copied
+        self.assertTrue(np.shares_memory(frames, batch.frames))
+        self.assertEqual(int(ram[0][0x10]), single.read(0x10))
+        self.assertTrue((batch.palette_indices < 64).all())
+
+    def test_batch_battery_ram_is_private(self):
+        import os
+        import tempfile
+
+        with open("../../roms/palette.nes", "rb") as f:
+            rom = bytearray(f.read())
+        rom[6] |= 0x02  # battery backed PRG RAM
+        rom[-1] ^= 0x5C
+
+        def saves():
+            directory = emu.saves_dir()
+            if not os.path.isdir(directory):
+                return {}
+            return {name: os.stat(os.path.join(directory, name)).st_mtime_ns for name in os.listdir(directory)}
+
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, "battery.nes")
+            with open(path, "wb") as f:
+                f.write(rom)
+
+            before = saves()
+            batch = emu.BatchEmulator(4, threads=2)
+            batch.load(path)
+            for env in range(4):
+                batch.write(env, 0x6000, 0x20 + env)
+            batch.step(None)
+            batch.write(1, 0x6000, 0x77)
+            for env in range(4):
+                self.assertEqual(batch.read(env, 0x6000), 0x77 if env == 1 else 0x20 + env)
+
+            # A second batch on the same game starts from its own PRG RAM, not the first batch's
+            other = emu.BatchEmulator(2, threads=1)
+            other.load(path)
+            other.write(0, 0x6000, 0x01)
+            self.assertEqual(batch.read(0, 0x6000), 0x20)
+            del batch, other
+            self.assertEqual(saves(), before)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,229 @@
+#include "trace-file.h"
+#include "trace-ring.h"
+#include "global-types.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fmt/base.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+################################
+||         Trace Tool         ||
+################################
+  Offline side of TraceWriter. decode prints a binary trace as text, in the emulator's own
+  (Mesen style) trace format or nestest.log's layout, so it can be read or fed to a text diff
+  against another emulator's log. diff finds the first record where two binary traces part ways,
+  e.g. the same movie run by two builds, and prints it with the records leading up to it.
+*/
+
+namespace
+{
+enum class Format : u8 { Mesen, Short, Nestest };
+
+struct Options {
+  std::string command;
+  std::string pathA;
+  std::string pathB;
+  Format      format = Format::Mesen;
+  u64         from = 0;
+  u64         count = std::numeric_limits<u64>::max();
+  u64         context = 5;
+};
+
+constexpr std::size_t readRecords = 64 * 1024;
+
+void PrintUsage()
+{
+  fmt::print( "Usage: emu_trace decode <trace> [options]\n"
+              "       emu_trace diff <a> <b> [options]\n"
+              "  --format F   mesen (default), short or nestest, how records are printed\n"
+              "  --from N     decode: first record to print (default 0)\n"
+              "  --count N    decode: how many records to print (default all)\n"
+              "  --context N  diff: matching records to print before the divergence (default 5)\n" );
+}
+
+bool ParseArgs( int argc, char **argv, Options &opts )
+{
+  std::vector<std::string_view> const args( argv + 1, argv + argc ); // NOLINT
+  if ( args.empty() ) {
+    return false;
+  }
+  opts.command = args[0];
+  std::vector<std::string> paths;
+  for ( std::size_t i = 1; i < args.size(); ++i ) {
+    auto const arg = args[i];
+    auto       next = [&]() -> std::string {
+      if ( i + 1 >= args.size() ) {
+        throw std::runtime_error( "Missing value for " + std::string( arg ) );
+      }
+      return std::string( args[++i] );
+    };
+
+    if ( arg == "--format" ) {
+      auto const format = next();
+      if ( format == "mesen" ) {
+        opts.format = Format::Mesen;
+      } else if ( format == "short" ) {
+        opts.format = Format::Short;
+      } else if ( format == "nestest" ) {
+        opts.format = Format::Nestest;
+      } else {
+        throw std::runtime_error( "Unknown format: " + format );
+      }
+    } else if ( arg == "--from" ) {
+      opts.from = std::stoull( next() );
+    } else if ( arg == "--count" ) {
+      opts.count = std::stoull( next() );
+    } else if ( arg == "--context" ) {
+      opts.context = std::stoull( next() );
+    } else if ( arg == "-h" || arg == "--help" ) {
+      return false;
+    } else if ( !arg.starts_with( "--" ) ) {
+      paths.emplace_back( arg );
+    } else {
+      throw std::runtime_error( "Unknown option: " + std::string( arg ) );
+    }
+  }
+
+  if ( opts.command == "decode" && paths.size() == 1 ) {
+    opts.pathA = paths[0];
+    return true;
+  }
+  if ( opts.command == "diff" && paths.size() == 2 ) {
+    opts.pathA = paths[0];
+    opts.pathB = paths[1];
+    return true;
+  }
+  return false;
+}
+
+std::string FormatRecord( const TraceRecord &record, Format format )
+{
+  switch ( format ) {
+    case Format::Mesen  : return FormatTraceLine( record );
+    case Format::Short  : return FormatTraceLine( record, false );
+    case Format::Nestest: return FormatNestestLine( record );
+  }
+  return {};
+}
+
+int Decode( const Options &opts )
+{
+  TraceFileReader reader;
+  if ( !reader.Open( opts.pathA ) ) {
+    return EXIT_FAILURE;
+  }
+
+  // Lines go out in large writes, a long trace is millions of them
+  std::vector<TraceRecord> records;
+  std::string              out;
+  u64 const                available = reader.RecordCount() - std::min( opts.from, reader.RecordCount() );
+  u64 const                end = opts.from + std::min( opts.count, available );
+  for ( u64 first = opts.from; first < end; first += readRecords ) {
+    if ( !reader.Read( first, static_cast<std::size_t>( std::min<u64>( readRecords, end - first ) ), records ) ) {
+      fmt::print( stderr, "Failed reading {}\n", opts.pathA );
+      return EXIT_FAILURE;
+    }
+    for ( const TraceRecord &record : records ) {
+      out += FormatRecord( record, opts.format );
+      out += '\n';
+    }
+    std::fwrite( out.data(), 1, out.size(), stdout );
+    out.clear();
+  }
+  return EXIT_SUCCESS;
+}
+
+// The fields two records differ in, for the diff summary
+std::string DifferingFields( const TraceRecord &a, const TraceRecord &b )
+{
+  std::string fields;
+  auto        check = [&]( bool differs, std::string_view name ) {
+    if ( differs ) {
+      fields += fields.empty() ? "" : ", ";
+      fields += name;
+    }
+  };
+  check( a.pc != b.pc, "pc" );
+  check( a.bytes != b.bytes, "instruction" );
+  check( a.a != b.a, "a" );
+  check( a.x != b.x, "x" );
+  check( a.y != b.y, "y" );
+  check( a.s != b.s, "s" );
+  check( a.p != b.p, "p" );
+  check( a.scanline != b.scanline || a.dot != b.dot, "ppu position" );
+  check( a.cycle != b.cycle, "cycle" );
+  return fields;
+}
+
+int Diff( const Options &opts )
+{
+  TraceFileReader a;
+  TraceFileReader b;
+  if ( !a.Open( opts.pathA ) || !b.Open( opts.pathB ) ) {
+    return EXIT_FAILURE;
+  }
+  if ( a.TraceTiming() != b.TraceTiming() ) {
+    fmt::print( "{} and {} were traced with different timing (instruction start vs Mesen), not comparable\n",
+                opts.pathA, opts.pathB );
+    return EXIT_FAILURE;
+  }
+
+  u64 index = 0;
+  if ( !FindFirstDivergence( a, b, index ) ) {
+    fmt::print( "Failed reading the traces\n" );
+    return EXIT_FAILURE;
+  }
+  u64 const shorter = std::min( a.RecordCount(), b.RecordCount() );
+  if ( index == shorter ) {
+    if ( a.RecordCount() == b.RecordCount() ) {
+      fmt::print( "Traces match, {} records\n", shorter );
+      return EXIT_SUCCESS;
+    }
+    std::string const &longer = a.RecordCount() > b.RecordCount() ? opts.pathA : opts.pathB;
+    fmt::print( "Traces match for {} records, then {} goes on ({} vs {} records)\n", shorter, longer, a.RecordCount(),
+                b.RecordCount() );
+    return EXIT_FAILURE;
+  }
+
+  u64 const                first = index - std::min( index, opts.context );
+  std::vector<TraceRecord> left;
+  std::vector<TraceRecord> right;
+  if ( !a.Read( first, static_cast<std::size_t>( index - first + 1 ), left ) ||
+       !b.Read( first, static_cast<std::size_t>( index - first + 1 ), right ) ) {
+    fmt::print( "Failed reading the traces\n" );
+    return EXIT_FAILURE;
+  }
+  fmt::print( "First divergence at record {} of {}\n", index, shorter );
+  for ( std::size_t i = 0; i + 1 < left.size(); ++i ) {
+    fmt::print( "  {}\n", FormatRecord( left[i], opts.format ) );
+  }
+  fmt::print( "- {}\n+ {}\n", FormatRecord( left.back(), opts.format ), FormatRecord( right.back(), opts.format ) );
+  fmt::print( "Differs in: {}\n", DifferingFields( left.back(), right.back() ) );
+  return EXIT_FAILURE;
+}
+} // namespace
+
+int main( int argc, char **argv )
+{
+  Options opts;
+  try {
+    if ( !ParseArgs( argc, argv, opts ) ) {
+      PrintUsage();
+      return EXIT_FAILURE;
+    }
+  } catch ( const std::exception &e ) {
+    fmt::print( "{}\n", e.what() );
+    PrintUsage();
+    return EXIT_FAILURE;
+  }
+  return opts.command == "decode" ? Decode( opts ) : Diff( opts );
+}